@@ -0,0 +1,37 @@
+#!/usr/bin/env bash
+# Description: Compare the IPFS API latency & throughput over TCP (localhost:5001) and the Unix domain socket,
+#   for a small and a large file (the daemon started by the browser needs to be running).
+#
+# Usage: ./scripts/benchmark_ipfs_api.sh <small-file-cid> <large-file-cid> [runs]
+
+if [ $# -lt 2 ]; then
+  echo "Usage: $0 <small-file-cid> <large-file-cid> [runs]"
+  exit 1
+fi
+SMALL_CID=$1
+LARGE_CID=$2
+RUNS=${3:-50}
+SOCKET="${XDG_RUNTIME_DIR:-/run/user/$(id -u)}/libreweb-browser/ipfs-api.sock"
+
+if [ ! -S "$SOCKET" ]; then
+  echo "ERROR: IPFS API socket not found: $SOCKET"
+  exit 1
+fi
+
+# Print average time (ms) and throughput (MB/s) of a keep-alive connection (all runs in a single curl process)
+benchmark() {
+  local name=$1
+  local cid=$2
+  shift 2
+  local urls=()
+  for ((i = 0; i < RUNS; i++)); do
+    urls+=(-o /dev/null "http://localhost:5001/api/v0/cat?arg=$cid")
+  done
+  curl -s -X POST "$@" -w '%{time_total} %{size_download}\n' "${urls[@]}" |
+    awk -v name="$name" '{ time += $1; size += $2 } END { printf "%-22s avg: %8.3f ms  throughput: %8.1f MB/s\n", name, time / NR * 1000, size / time / 1000000 }'
+}
+
+benchmark "TCP small" "$SMALL_CID"
+benchmark "Unix socket small" "$SMALL_CID" --unix-socket "$SOCKET"
+benchmark "TCP large" "$LARGE_CID"
+benchmark "Unix socket large" "$LARGE_CID" --unix-socket "$SOCKET"
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+# Description: Stand-in of the IPFS API for testing the fetch code (eg. the hedged fetcher), answers every request the same way.
+#
+# Usage: ./scripts/ipfs_api_stand_in.py <port> <delay-seconds> <mode>
+#   mode: a single character, the content is 256 KB of that character (sent in parts)
+#         "notfound": status code 500 with the error of the daemon for missing content
+#         "404": status code 404 (not an IPFS API)
+import http.server
+import socketserver
+import sys
+import time
+
+CONTENT_SIZE = 256 * 1024
+PART_SIZE = 16 * 1024
+
+port, delay, mode = int(sys.argv[1]), float(sys.argv[2]), sys.argv[3]
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, *args):
+        pass
+
+    def do_POST(self):
+        time.sleep(delay)
+        try:
+            if mode == "notfound":
+                self.send_body(500, b'{"Message":"merkledag: not found","Code":0,"Type":"error"}')
+            elif mode == "404":
+                self.send_body(404, b"404 page not found")
+            else:
+                self.send_response(200)
+                self.send_header("X-Content-Length", str(CONTENT_SIZE))
+                self.send_header("Content-Length", str(CONTENT_SIZE))
+                self.end_headers()
+                # Sent in parts, the receiver gets the content in several chunks
+                for _ in range(CONTENT_SIZE // PART_SIZE):
+                    self.wfile.write(mode.encode() * PART_SIZE)
+                    self.wfile.flush()
+                    time.sleep(0.005)
+        except (BrokenPipeError, ConnectionResetError):
+            # Cancelled by the client
+            pass
+
+    def send_body(self, status, body):
+        self.send_response(status)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+
+Server(("127.0.0.1", port), Handler).serve_forever()
@@ -0,0 +1,40 @@
+#!/usr/bin/env bash
+# Description: Test the hedged fetcher (--endpoints) against local stand-ins of the IPFS API, with different delays
+#   and failures: the winner, the cancellation of the loser and the ordering by health are checked.
+#   Build the test first: cmake -DBUILD_TESTS=ON -B build && cmake --build build --target hedged-fetcher-test
+#
+# Usage: ./scripts/test_hedged_fetcher.sh [path/to/hedged-fetcher-test] [base-port]
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+TEST_BINARY=${1:-"$SCRIPT_DIR/../build/bin/hedged-fetcher-test"}
+BASE_PORT=${2:-18000}
+
+if [ ! -x "$TEST_BINARY" ]; then
+  echo "ERROR: Test binary not found: $TEST_BINARY"
+  exit 1
+fi
+
+PIDS=()
+trap 'kill "${PIDS[@]}" 2>/dev/null' EXIT
+
+# Port offset, delay (seconds) and mode of each stand-in (nothing listens on offset 9)
+start_stand_in() {
+  python3 "$SCRIPT_DIR/ipfs_api_stand_in.py" $((BASE_PORT + $1)) "$2" "$3" &
+  PIDS+=($!)
+}
+start_stand_in 1 4 a
+start_stand_in 2 0.02 b
+start_stand_in 3 0.02 notfound
+start_stand_in 4 0.02 404
+
+# Wait until the stand-ins listen
+for offset in 1 2 3 4; do
+  for ((i = 0; i < 50; i++)); do
+    if (echo >/dev/tcp/127.0.0.1/$((BASE_PORT + offset))) 2>/dev/null; then
+      break
+    fi
+    sleep 0.1
+  done
+done
+
+"$TEST_BINARY" "$BASE_PORT"
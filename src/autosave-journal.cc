@@ -0,0 +1,422 @@
+#include "autosave-journal.h"
+
+#include <gtkmm/textbuffer.h>
+#include <glibmm/miscutils.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+namespace
+{
+    const char JOURNAL_MAGIC[8] = {'L', 'W', 'J', 'R', 'N', 'L', '0', '1'};
+    const char *JOURNAL_EXTENSION = ".journal";
+    const std::size_t RECORD_HEADER_SIZE = 1 + 3 * sizeof(uint32_t);
+    const std::size_t COMPACT_MIN_SIZE = 1024 * 1024;     /*!< Journal size before compaction is considered */
+    const std::chrono::milliseconds BATCH_INTERVAL(1000); /*!< Time edits are collected before writing them */
+} // namespace
+
+AutosaveJournal::AutosaveJournal()
+    : active(false),
+      stopping(false),
+      hasSnapshot(false),
+      journalSize(0),
+      snapshotSize(0),
+      fd(-1)
+{
+}
+
+AutosaveJournal::~AutosaveJournal()
+{
+    // Keep the journal, the document was not saved
+    this->stop(false);
+}
+
+/**
+ * \brief Start a new journal for the document in the editor
+ * \param text Current document content
+ * \param filePath File path of the document (empty for a new document)
+ */
+void AutosaveJournal::start(const std::string &text, const std::string &filePath)
+{
+    this->stop(true);
+    std::string directory = getJournalDirectory();
+    if (g_mkdir_with_parents(directory.c_str(), 0700) != 0)
+    {
+        std::cerr << "ERROR: Could not create autosave directory: " << directory << std::endl;
+        return;
+    }
+    gchar *uuid = g_uuid_string_random();
+    this->journalPath = directory + G_DIR_SEPARATOR_S + uuid + JOURNAL_EXTENSION;
+    g_free(uuid);
+    this->filePath = filePath;
+    this->pending.clear();
+    this->stopping = false;
+    this->active = true;
+    this->queueSnapshot(text, !filePath.empty());
+    this->worker = std::thread(&AutosaveJournal::processWrites, this);
+}
+
+/**
+ * \brief Write all pending records and stop the journal
+ * \param remove Remove the journal file (the document is no longer edited)
+ */
+void AutosaveJournal::stop(bool remove)
+{
+    if (!this->active)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_one();
+    if (this->worker.joinable())
+        this->worker.join();
+    if (this->fd >= 0)
+    {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    if (remove)
+        AutosaveJournal::remove(this->journalPath);
+    this->active = false;
+}
+
+bool AutosaveJournal::isActive() const
+{
+    return this->active;
+}
+
+/**
+ * \brief Journal inserted text
+ * \param offset Character offset of the insert
+ * \param text Inserted text
+ */
+void AutosaveJournal::insert(int offset, const std::string &text)
+{
+    if (!this->active)
+        return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::size_t before = this->pending.size();
+    encodeRecord(this->pending, RECORD_INSERT, offset, 0, text);
+    this->journalSize += this->pending.size() - before;
+    this->condition.notify_one();
+}
+
+/**
+ * \brief Journal removed text
+ * \param offset Character offset of the removed range
+ * \param count Number of characters removed
+ */
+void AutosaveJournal::erase(int offset, int count)
+{
+    if (!this->active)
+        return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::size_t before = this->pending.size();
+    encodeRecord(this->pending, RECORD_ERASE, offset, count, "");
+    this->journalSize += this->pending.size() - before;
+    this->condition.notify_one();
+}
+
+/**
+ * \brief Journal the (new) file path of the document, eg. after 'save as'
+ */
+void AutosaveJournal::setFilePath(const std::string &filePath)
+{
+    if (!this->active)
+        return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->filePath = filePath;
+    encodeRecord(this->pending, RECORD_PATH, 0, 0, filePath);
+    this->condition.notify_one();
+}
+
+/**
+ * \brief Replace the journal by a snapshot of the document
+ * \param text Current document content
+ * \param isSaved The content is equal to the saved file
+ */
+void AutosaveJournal::compact(const std::string &text, bool isSaved)
+{
+    if (!this->active)
+        return;
+    this->queueSnapshot(text, isSaved);
+}
+
+/**
+ * \brief Check if the journal grew large compared to the document, so compaction pays off
+ */
+bool AutosaveJournal::needsCompaction() const
+{
+    return this->active && (this->journalSize > std::max(COMPACT_MIN_SIZE, this->snapshotSize));
+}
+
+/**
+ * \brief Find journals left behind (eg. after a crash), newest first.
+ * Journals that are still in use (by another browser window) are skipped.
+ */
+std::vector<std::string> AutosaveJournal::findJournals()
+{
+    std::vector<std::pair<time_t, std::string>> journals;
+    std::string directory = getJournalDirectory();
+    GDir *dir = g_dir_open(directory.c_str(), 0, nullptr);
+    if (dir != nullptr)
+    {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != nullptr)
+        {
+            if (!g_str_has_suffix(name, JOURNAL_EXTENSION))
+                continue;
+            std::string path = directory + G_DIR_SEPARATOR_S + name;
+            GStatBuf info;
+            if (g_stat(path.c_str(), &info) == 0 && !isInUse(path))
+                journals.emplace_back(info.st_mtime, path);
+        }
+        g_dir_close(dir);
+    }
+    std::sort(journals.begin(), journals.end(), std::greater<>());
+    std::vector<std::string> paths;
+    for (auto &journal : journals)
+        paths.push_back(journal.second);
+    return paths;
+}
+
+/**
+ * \brief Replay a journal. Replaying stops at the first incomplete or corrupt record (eg. an interrupted write).
+ * \param journalPath Journal file
+ * \param[out] recovery Recovered document
+ * \return True when the journal contains a document
+ */
+bool AutosaveJournal::recover(const std::string &journalPath, Recovery &recovery)
+{
+    std::ifstream file(journalPath, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(JOURNAL_MAGIC) || std::memcmp(data.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+        return false;
+
+    // Replay on a text buffer, where inserts/erases by character offset are cheap
+    auto buffer = Gtk::TextBuffer::create();
+    bool hasSnapshot = false;
+    recovery.journalPath = journalPath;
+    recovery.filePath.clear();
+    recovery.isSaved = false;
+    std::size_t pos = sizeof(JOURNAL_MAGIC);
+    while (pos + RECORD_HEADER_SIZE + sizeof(uint32_t) <= data.size())
+    {
+        uint8_t type = static_cast<uint8_t>(data[pos]);
+        uint32_t offset, count, size, sum;
+        std::memcpy(&offset, data.data() + pos + 1, sizeof(uint32_t));
+        std::memcpy(&count, data.data() + pos + 1 + sizeof(uint32_t), sizeof(uint32_t));
+        std::memcpy(&size, data.data() + pos + 1 + 2 * sizeof(uint32_t), sizeof(uint32_t));
+        if (size > data.size() - pos - RECORD_HEADER_SIZE - sizeof(uint32_t))
+            break;
+        std::memcpy(&sum, data.data() + pos + RECORD_HEADER_SIZE + size, sizeof(uint32_t));
+        if (sum != checksum(data.data() + pos, RECORD_HEADER_SIZE + size))
+            break;
+        const char *payload = data.data() + pos + RECORD_HEADER_SIZE;
+        if (!g_utf8_validate(payload, size, nullptr))
+            break;
+        switch (type)
+        {
+        case RECORD_SNAPSHOT:
+            buffer->set_text(Glib::ustring(payload, payload + size));
+            recovery.isSaved = (count == 1);
+            hasSnapshot = true;
+            break;
+        case RECORD_INSERT:
+            buffer->insert(buffer->get_iter_at_offset(offset), payload, payload + size);
+            recovery.isSaved = false;
+            break;
+        case RECORD_ERASE:
+            buffer->erase(buffer->get_iter_at_offset(offset), buffer->get_iter_at_offset(offset + count));
+            recovery.isSaved = false;
+            break;
+        case RECORD_PATH:
+            recovery.filePath.assign(payload, size);
+            break;
+        default:
+            break;
+        }
+        pos += RECORD_HEADER_SIZE + size + sizeof(uint32_t);
+    }
+    recovery.text = buffer->get_text().raw();
+    return hasSnapshot;
+}
+
+/**
+ * \brief Check if the journal is locked by an active journal writer
+ */
+bool AutosaveJournal::isInUse(const std::string &journalPath)
+{
+    int checkFd = ::open(journalPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (checkFd < 0)
+        return false;
+    bool inUse = (::flock(checkFd, LOCK_EX | LOCK_NB) != 0);
+    ::close(checkFd);
+    return inUse;
+}
+
+/**
+ * \brief Remove a journal file
+ */
+void AutosaveJournal::remove(const std::string &journalPath)
+{
+    if (!journalPath.empty())
+        g_unlink(journalPath.c_str());
+}
+
+/**
+ * \brief Queue a new journal content (snapshot), replacing all records that are not yet written
+ */
+void AutosaveJournal::queueSnapshot(const std::string &text, bool isSaved)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->snapshot.assign(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    if (!this->filePath.empty())
+        encodeRecord(this->snapshot, RECORD_PATH, 0, 0, this->filePath);
+    encodeRecord(this->snapshot, RECORD_SNAPSHOT, 0, isSaved ? 1 : 0, text);
+    this->hasSnapshot = true;
+    this->pending.clear(); // Already part of the snapshot
+    this->journalSize = 0;
+    this->snapshotSize = this->snapshot.size();
+    this->condition.notify_one();
+}
+
+/**
+ * \brief Worker thread, writes the records in batches and syncs them to disk
+ */
+void AutosaveJournal::processWrites()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->condition.wait(lock, [this] { return this->stopping || this->hasSnapshot || !this->pending.empty(); });
+        // Collect more edits for a while, one sync for all of them
+        if (!this->stopping && !this->hasSnapshot)
+            this->condition.wait_for(lock, BATCH_INTERVAL, [this] { return this->stopping || this->hasSnapshot; });
+
+        std::string newSnapshot;
+        bool writeNewSnapshot = this->hasSnapshot;
+        if (writeNewSnapshot)
+            newSnapshot.swap(this->snapshot);
+        this->hasSnapshot = false;
+        std::string records;
+        records.swap(this->pending);
+        bool isStopping = this->stopping;
+        lock.unlock();
+
+        if (writeNewSnapshot)
+            this->writeSnapshot(newSnapshot);
+        if (!records.empty() && this->fd >= 0)
+        {
+            if (!writeAll(this->fd, records.data(), records.size()) || ::fdatasync(this->fd) != 0)
+                std::cerr << "ERROR: Could not write autosave journal: " << this->journalPath << std::endl;
+        }
+
+        lock.lock();
+        if (isStopping && !this->hasSnapshot && this->pending.empty())
+            break;
+    }
+}
+
+/**
+ * \brief Atomically replace the journal: write a temporary file, sync it and rename it over the journal
+ */
+bool AutosaveJournal::writeSnapshot(const std::string &content)
+{
+    std::string tmpPath = this->journalPath + ".tmp";
+    int tmpFd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (tmpFd < 0)
+    {
+        std::cerr << "ERROR: Could not create autosave journal: " << tmpPath << std::endl;
+        return false;
+    }
+    // Lock while in use, so other browser windows will not recover it
+    ::flock(tmpFd, LOCK_EX | LOCK_NB);
+    if (!writeAll(tmpFd, content.data(), content.size()) || ::fsync(tmpFd) != 0 || ::rename(tmpPath.c_str(), this->journalPath.c_str()) != 0)
+    {
+        std::cerr << "ERROR: Could not write autosave journal: " << this->journalPath << std::endl;
+        ::close(tmpFd);
+        g_unlink(tmpPath.c_str());
+        return false;
+    }
+    // Make the rename durable
+    int dirFd = ::open(getJournalDirectory().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0)
+    {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+    // Continue appending to the new journal
+    if (this->fd >= 0)
+        ::close(this->fd);
+    this->fd = tmpFd;
+    ::lseek(this->fd, 0, SEEK_END);
+    return true;
+}
+
+/**
+ * \brief Encode a journal record: type, offset, count, payload size, payload and checksum
+ */
+void AutosaveJournal::encodeRecord(std::string &out, RecordType type, uint32_t offset, uint32_t count, const std::string &payload)
+{
+    std::size_t start = out.size();
+    uint32_t size = static_cast<uint32_t>(payload.size());
+    out.push_back(static_cast<char>(type));
+    out.append(reinterpret_cast<const char *>(&offset), sizeof(uint32_t));
+    out.append(reinterpret_cast<const char *>(&count), sizeof(uint32_t));
+    out.append(reinterpret_cast<const char *>(&size), sizeof(uint32_t));
+    out.append(payload);
+    uint32_t sum = checksum(out.data() + start, out.size() - start);
+    out.append(reinterpret_cast<const char *>(&sum), sizeof(uint32_t));
+}
+
+/**
+ * \brief FNV-1a checksum, detects torn or corrupt records
+ */
+uint32_t AutosaveJournal::checksum(const char *data, std::size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * \brief Write the whole buffer, retrying on partial writes
+ */
+bool AutosaveJournal::writeAll(int fd, const char *data, std::size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+std::string AutosaveJournal::getJournalDirectory()
+{
+    return Glib::build_filename(Glib::get_user_cache_dir(), "libreweb-browser", "autosave");
+}
@@ -0,0 +1,80 @@
+#ifndef AUTOSAVE_JOURNAL_H
+#define AUTOSAVE_JOURNAL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \class AutosaveJournal
+ * \brief Crash-safe autosave of the document in the editor.
+ * Every edit is appended as a small record to a journal file in the user cache directory,
+ * the records are written in batches and synced to disk on a background thread.
+ * Compaction replaces the journal (atomically) by a single snapshot of the document.
+ */
+class AutosaveJournal
+{
+public:
+    /**
+     * \struct Recovery
+     * \brief Document recovered from a journal
+     */
+    struct Recovery
+    {
+        std::string journalPath;
+        std::string filePath; /*!< File path of the document, empty when never saved */
+        std::string text;
+        bool isSaved; /*!< No changes since the document was last saved */
+    };
+
+    AutosaveJournal();
+    ~AutosaveJournal();
+    void start(const std::string &text, const std::string &filePath);
+    void stop(bool remove);
+    bool isActive() const;
+    void insert(int offset, const std::string &text);
+    void erase(int offset, int count);
+    void setFilePath(const std::string &filePath);
+    void compact(const std::string &text, bool isSaved);
+    bool needsCompaction() const;
+
+    static std::vector<std::string> findJournals();
+    static bool recover(const std::string &journalPath, Recovery &recovery);
+    static bool isInUse(const std::string &journalPath);
+    static void remove(const std::string &journalPath);
+
+private:
+    enum RecordType : uint8_t
+    {
+        RECORD_SNAPSHOT = 1,
+        RECORD_INSERT,
+        RECORD_ERASE,
+        RECORD_PATH
+    };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool active;
+    bool stopping;
+    std::string journalPath;
+    std::string filePath;
+    std::string pending;     /*!< Encoded records, not yet written */
+    std::string snapshot;    /*!< Encoded journal content, replacing the current journal (compaction) */
+    bool hasSnapshot;
+    std::size_t journalSize; /*!< Bytes appended since the last snapshot (GUI thread) */
+    std::size_t snapshotSize;
+    int fd;
+
+    void queueSnapshot(const std::string &text, bool isSaved);
+    void processWrites();
+    bool writeSnapshot(const std::string &content);
+    static void encodeRecord(std::string &out, RecordType type, uint32_t offset, uint32_t count, const std::string &payload);
+    static uint32_t checksum(const char *data, std::size_t size);
+    static bool writeAll(int fd, const char *data, std::size_t size);
+    static std::string getJournalDirectory();
+};
+#endif
@@ -0,0 +1,82 @@
+#include "back-forward-cache.h"
+
+/**
+ * \brief Create back/forward cache
+ * \param maxPages Max. number of pages
+ * \param memoryBudget Max. (estimated) number of bytes used by all pages
+ */
+BackForwardCache::BackForwardCache(std::size_t maxPages, std::size_t memoryBudget)
+    : maxPages(maxPages),
+      memoryBudget(memoryBudget),
+      memorySize(0)
+{
+}
+
+/**
+ * \brief Store the page of a history entry, replaces the page stored earlier for this entry
+ */
+void BackForwardCache::put(std::size_t historyIndex, std::shared_ptr<const Page> page)
+{
+    this->erase(historyIndex);
+    std::size_t size = pageSize(*page);
+    if (size > this->memoryBudget)
+        return;
+    while (!this->pages.empty() && (this->pages.size() >= this->maxPages || this->memorySize + size > this->memoryBudget))
+    {
+        this->memorySize -= pageSize(*this->pages.back().second);
+        this->pages.pop_back();
+    }
+    this->pages.emplace_front(historyIndex, page);
+    this->memorySize += size;
+}
+
+/**
+ * \brief Get the page of a history entry
+ * \return Page or nullptr when not cached
+ */
+std::shared_ptr<const BackForwardCache::Page> BackForwardCache::get(std::size_t historyIndex)
+{
+    for (auto it = this->pages.begin(); it != this->pages.end(); ++it)
+    {
+        if (it->first == historyIndex)
+        {
+            this->pages.splice(this->pages.begin(), this->pages, it);
+            return it->second;
+        }
+    }
+    return nullptr;
+}
+
+void BackForwardCache::clear()
+{
+    this->pages.clear();
+    this->memorySize = 0;
+}
+
+void BackForwardCache::erase(std::size_t historyIndex)
+{
+    for (auto it = this->pages.begin(); it != this->pages.end(); ++it)
+    {
+        if (it->first == historyIndex)
+        {
+            this->memorySize -= pageSize(*it->second);
+            this->pages.erase(it);
+            return;
+        }
+    }
+}
+
+/**
+ * \brief Estimated memory usage of a page
+ */
+std::size_t BackForwardCache::pageSize(const Page &page)
+{
+    const RenderedDocument &document = page.document;
+    std::size_t size = sizeof(Page) + page.path.size() + page.pagePath.size() + page.content.size() + document.text.size();
+    size += document.runs.size() * sizeof(RenderedDocument::Run);
+    size += document.styles.size() * (sizeof(RenderedDocument::Style) + 64);
+    size += (document.sourceLines.size() + document.sourceOffsets.size()) * sizeof(int);
+    for (const HeadingIndex::Heading &heading : document.headings)
+        size += sizeof(HeadingIndex::Heading) + heading.text.size();
+    return size;
+}
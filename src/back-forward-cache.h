@@ -0,0 +1,48 @@
+#ifndef BACK_FORWARD_CACHE_H
+#define BACK_FORWARD_CACHE_H
+
+#include "rendered-document.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+
+/**
+ * \class BackForwardCache
+ * \brief Keeps the rendered form of the last visited pages, by history index,
+ * so back/forward navigation restores the page and scroll position without fetching or parsing.
+ * Least recently used pages are evicted when the page limit or memory budget is exceeded.
+ */
+class BackForwardCache
+{
+public:
+    /**
+     * \struct Page
+     * \brief Rendered page with everything needed to show it again
+     */
+    struct Page
+    {
+        std::string path;     /*!< History path (including #fragment) */
+        std::string pagePath; /*!< Path without #fragment */
+        bool isDirectoryPage; /*!< Index or listing page of a directory */
+        std::string content;  /*!< Markdown content */
+        RenderedDocument document;
+        int scrollOffset; /*!< Character offset at the top of the view */
+    };
+
+    explicit BackForwardCache(std::size_t maxPages, std::size_t memoryBudget);
+    void put(std::size_t historyIndex, std::shared_ptr<const Page> page);
+    std::shared_ptr<const Page> get(std::size_t historyIndex);
+    void clear();
+
+private:
+    std::size_t maxPages;
+    std::size_t memoryBudget;
+    std::size_t memorySize;
+    std::list<std::pair<std::size_t, std::shared_ptr<const Page>>> pages; /*!< Most recently used first */
+
+    void erase(std::size_t historyIndex);
+    static std::size_t pageSize(const Page &page);
+};
+#endif
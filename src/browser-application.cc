@@ -0,0 +1,122 @@
+#include "browser-application.h"
+#include "cid.h"
+#include "mainwindow.h"
+
+#include <cstdlib>
+#include <gdkmm/screen.h>
+#include <giomm/file.h>
+#include <gtkmm/cssprovider.h>
+#include <gtkmm/stylecontext.h>
+#include <iostream>
+
+/**
+ * \brief Create the application, the command-line options are only used by the primary instance
+ * \param timeout IPFS time-out (eg. "120s")
+ * \param connections Max. number of IPFS API connections
+ * \param maxFileSize Max. size of a fetched file in MB
+ * \param endpoints Extra IPFS API endpoints (comma separated)
+ */
+Glib::RefPtr<BrowserApplication> BrowserApplication::create(const std::string &timeout, int connections, int maxFileSize, const std::string &endpoints)
+{
+    return Glib::RefPtr<BrowserApplication>(new BrowserApplication(timeout, connections, maxFileSize, endpoints));
+}
+
+BrowserApplication::BrowserApplication(const std::string &timeout, int connections, int maxFileSize, const std::string &endpoints)
+    : Gtk::Application("org.libreweb.browser", Gio::ApplicationFlags::APPLICATION_HANDLES_COMMAND_LINE),
+      timeout(timeout),
+      connections(connections),
+      maxFileSize(maxFileSize),
+      endpoints(endpoints)
+{
+}
+
+BrowserApplication::~BrowserApplication()
+{
+    // The shared state is gone before the supervisor
+    this->supervisor.setReadyCallback(nullptr);
+}
+
+/**
+ * \brief Start-up of the primary instance (only once): find or start the IPFS daemon, create the shared state
+ */
+void BrowserApplication::on_startup()
+{
+    Gtk::Application::on_startup();
+    // The daemon is found or started in the background
+    this->supervisor.start();
+    this->context = std::make_unique<BrowserContext>(this->timeout, this->connections, this->maxFileSize, this->endpoints);
+    // Retry the requests waiting for the daemon at once when it's ready
+    this->supervisor.setReadyCallback([this]() { this->context->notifyDaemonReady(); });
+
+    // Add spinning CSS class for the refresh icons (of all windows)
+    auto cssProvider = Gtk::CssProvider::create();
+    std::string spinningCSS = "@keyframes spin {  to { -gtk-icon-transform: rotate(1turn); }} .spinning { animation-name: spin;  animation-duration: 1s;  animation-timing-function: linear;  animation-iteration-count: infinite;}";
+    if (!cssProvider->load_from_data(spinningCSS))
+    {
+        std::cerr << "ERROR: CSS parsing went wrong." << std::endl;
+    }
+    Gtk::StyleContext::add_provider_for_screen(Gdk::Screen::get_default(), cssProvider, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+}
+
+/**
+ * \brief Launched without URLs (or a new window is requested): open a new window
+ */
+void BrowserApplication::on_activate()
+{
+    this->createWindow("")->present();
+}
+
+/**
+ * \brief Launched with URLs or files (in this or another instance): open a window for each, or a new window without arguments
+ */
+int BrowserApplication::on_command_line(const Glib::RefPtr<Gio::ApplicationCommandLine> &commandLine)
+{
+    int argc = 0;
+    char **argv = commandLine->get_arguments(argc);
+    if (argc <= 1)
+        this->activate();
+    for (int i = 1; i < argc; ++i)
+    {
+        this->createWindow(this->getRequestPath(commandLine, argv[i]))->present();
+    }
+    g_strfreev(argv);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * \brief Request path of a command-line argument: IPFS addresses (eg. "ipfs://<cid>", "/ipns/<name>" or a bare CID)
+ * are kept as-is, local files are made absolute (to the working directory of the launch) and decoded.
+ * \param commandLine Command-line of the launch
+ * \param argument Command-line argument
+ */
+std::string BrowserApplication::getRequestPath(const Glib::RefPtr<Gio::ApplicationCommandLine> &commandLine, const std::string &argument)
+{
+    if (argument.rfind("file://", 0) == 0)
+    {
+        std::string path = Gio::File::create_for_uri(argument)->get_path();
+        if (!path.empty())
+            return "file://" + path;
+        return argument;
+    }
+    if (argument.find("://") != std::string::npos || argument.rfind("about:", 0) == 0 || argument.rfind("/ipfs/", 0) == 0 ||
+        argument.rfind("/ipns/", 0) == 0 || CID::isValid(argument.substr(0, argument.find_first_of("/?#"))))
+        return argument;
+    return "file://" + commandLine->create_file_for_arg(argument)->get_path();
+}
+
+/**
+ * \brief Create a window, which is deleted when it's closed. The application quits after the last window.
+ * \param path Page to open, empty for the home page
+ */
+MainWindow *BrowserApplication::createWindow(const std::string &path)
+{
+    MainWindow *window = new MainWindow(*this->context, path);
+    this->add_window(*window);
+    window->signal_hide().connect(sigc::bind<MainWindow *>(sigc::mem_fun(*this, &BrowserApplication::on_hide_window), window));
+    return window;
+}
+
+void BrowserApplication::on_hide_window(MainWindow *window)
+{
+    delete window;
+}
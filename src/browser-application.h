@@ -0,0 +1,44 @@
+#ifndef BROWSER_APPLICATION_H
+#define BROWSER_APPLICATION_H
+
+#include "browser-context.h"
+#include "ipfs-daemon-supervisor.h"
+
+#include <giomm/applicationcommandline.h>
+#include <gtkmm/application.h>
+#include <memory>
+#include <string>
+
+class MainWindow;
+
+/**
+ * \class BrowserApplication
+ * \brief Unique application: the first launch becomes the primary instance, which supervises the IPFS daemon
+ * and holds the state shared by its windows. Another launch only asks the primary instance (via D-Bus)
+ * to open a new window, or the given URLs.
+ */
+class BrowserApplication : public Gtk::Application
+{
+public:
+    static Glib::RefPtr<BrowserApplication> create(const std::string &timeout, int connections, int maxFileSize, const std::string &endpoints);
+    ~BrowserApplication() override;
+
+protected:
+    explicit BrowserApplication(const std::string &timeout, int connections, int maxFileSize, const std::string &endpoints);
+    void on_startup() override;
+    void on_activate() override;
+    int on_command_line(const Glib::RefPtr<Gio::ApplicationCommandLine> &commandLine) override;
+
+private:
+    std::string timeout;
+    int connections;
+    int maxFileSize;
+    std::string endpoints;
+    IPFSDaemonSupervisor supervisor;
+    std::unique_ptr<BrowserContext> context; /*!< Created at start-up of the primary instance */
+
+    MainWindow *createWindow(const std::string &path);
+    std::string getRequestPath(const Glib::RefPtr<Gio::ApplicationCommandLine> &commandLine, const std::string &argument);
+    void on_hide_window(MainWindow *window);
+};
+#endif
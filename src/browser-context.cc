@@ -0,0 +1,143 @@
+#include "browser-context.h"
+#include "mainwindow.h"
+
+#include <algorithm>
+
+/**
+ * \brief Create the shared state, the IPFS status is polled right away
+ * \param timeout IPFS time-out (eg. "120s")
+ * \param connections Max. number of IPFS API connections
+ * \param maxFileSize Max. size of a fetched file in MB
+ * \param endpoints Extra IPFS API endpoints (comma separated)
+ */
+BrowserContext::BrowserContext(const std::string &timeout, int connections, int maxFileSize, const std::string &endpoints)
+    : host("localhost"),
+      port(5001),
+      timeout(timeout),
+      maxFileSize(static_cast<std::size_t>(std::max(maxFileSize, 1)) * 1024 * 1024),
+      ipfs(host, port, timeout, static_cast<std::size_t>(std::max(connections, 1)), HedgedFetcher::parseEndpoints(endpoints)),
+      fetchCoalescer(ipfs),
+      nameResolver(ipfs, [this](const std::string &path) {
+          std::lock_guard<std::mutex> lock(this->windowsMutex);
+          for (MainWindow *window : this->windows)
+              window->notifyNameRefreshed(path);
+      }),
+      directoryIndex(ipfs),
+      statusMonitor(ipfs, [this]() {
+          std::lock_guard<std::mutex> lock(this->windowsMutex);
+          for (MainWindow *window : this->windows)
+              window->notifyStatusChanged();
+      }),
+      contentCache("ipfs", 64 * 1024 * 1024, 512 * 1024 * 1024),
+      renderCache("render", 32 * 1024 * 1024, 256 * 1024 * 1024),
+      prefetcher(fetchCoalescer, contentCache, std::min<std::size_t>(this->maxFileSize, 4 * 1024 * 1024))
+{
+    // The IPFS status is polled in the background, the first update is done right away
+    this->statusMonitor.start();
+}
+
+/**
+ * \brief Add an opened window, which receives the notifications from now on
+ */
+void BrowserContext::addWindow(MainWindow *window)
+{
+    std::lock_guard<std::mutex> lock(this->windowsMutex);
+    this->windows.insert(window);
+}
+
+/**
+ * \brief Remove a closed window, no notifications are in progress for the window after this call
+ */
+void BrowserContext::removeWindow(MainWindow *window)
+{
+    std::lock_guard<std::mutex> lock(this->windowsMutex);
+    this->windows.erase(window);
+}
+
+/**
+ * \brief Notify all windows that the IPFS daemon is ready (thread-safe)
+ */
+void BrowserContext::notifyDaemonReady()
+{
+    std::lock_guard<std::mutex> lock(this->windowsMutex);
+    for (MainWindow *window : this->windows)
+        window->notifyDaemonReady();
+}
+
+/**
+ * \brief Get an icon (GUI thread), each icon is loaded once and shared by the windows
+ * \param filename Image file
+ * \param width Icon width
+ * \param height Icon height
+ * \throw Glib::FileError or Gdk::PixbufError when the icon could not be loaded
+ */
+Glib::RefPtr<Gdk::Pixbuf> BrowserContext::getIcon(const std::string &filename, int width, int height)
+{
+    std::string key = filename + "@" + std::to_string(width) + "x" + std::to_string(height);
+    auto it = this->icons.find(key);
+    if (it != this->icons.end())
+        return it->second;
+    Glib::RefPtr<Gdk::Pixbuf> icon = Gdk::Pixbuf::create_from_file(filename, width, height);
+    this->icons.emplace(key, icon);
+    return icon;
+}
+
+const std::string &BrowserContext::getHost() const
+{
+    return this->host;
+}
+
+int BrowserContext::getPort() const
+{
+    return this->port;
+}
+
+const std::string &BrowserContext::getTimeout() const
+{
+    return this->timeout;
+}
+
+std::size_t BrowserContext::getMaxFileSize() const
+{
+    return this->maxFileSize;
+}
+
+IPFS &BrowserContext::getIPFS()
+{
+    return this->ipfs;
+}
+
+FetchCoalescer &BrowserContext::getFetchCoalescer()
+{
+    return this->fetchCoalescer;
+}
+
+NameResolver &BrowserContext::getNameResolver()
+{
+    return this->nameResolver;
+}
+
+DirectoryIndex &BrowserContext::getDirectoryIndex()
+{
+    return this->directoryIndex;
+}
+
+IPFSStatusMonitor &BrowserContext::getStatusMonitor()
+{
+    return this->statusMonitor;
+}
+
+ContentCache &BrowserContext::getContentCache()
+{
+    return this->contentCache;
+}
+
+ContentCache &BrowserContext::getRenderCache()
+{
+    return this->renderCache;
+}
+
+PagePrefetcher &BrowserContext::getPrefetcher()
+{
+    return this->prefetcher;
+}
@@ -0,0 +1,63 @@
+#ifndef BROWSER_CONTEXT_H
+#define BROWSER_CONTEXT_H
+
+#include "content-cache.h"
+#include "directory-index.h"
+#include "fetch-coalescer.h"
+#include "ipfs.h"
+#include "ipfs-status-monitor.h"
+#include "name-resolver.h"
+#include "page-prefetcher.h"
+
+#include <gdkmm/pixbuf.h>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+class MainWindow;
+
+/**
+ * \class BrowserContext
+ * \brief State shared by all browser windows of the process: the IPFS connection setup, the caches, the name resolutions,
+ * the background threads and the icons. Notifications of the background threads are forwarded to every window.
+ */
+class BrowserContext
+{
+public:
+    explicit BrowserContext(const std::string &timeout, int connections, int maxFileSize, const std::string &endpoints);
+    void addWindow(MainWindow *window);
+    void removeWindow(MainWindow *window);
+    void notifyDaemonReady();
+    Glib::RefPtr<Gdk::Pixbuf> getIcon(const std::string &filename, int width, int height);
+    const std::string &getHost() const;
+    int getPort() const;
+    const std::string &getTimeout() const;
+    std::size_t getMaxFileSize() const;
+    IPFS &getIPFS();
+    FetchCoalescer &getFetchCoalescer();
+    NameResolver &getNameResolver();
+    DirectoryIndex &getDirectoryIndex();
+    IPFSStatusMonitor &getStatusMonitor();
+    ContentCache &getContentCache();
+    ContentCache &getRenderCache();
+    PagePrefetcher &getPrefetcher();
+
+private:
+    std::string host;
+    int port;
+    std::string timeout;
+    std::size_t maxFileSize;        /*!< Max. size of a fetched file in bytes */
+    std::mutex windowsMutex;        /*!< Locked while a window is notified, so a closed window isn't notified anymore */
+    std::set<MainWindow *> windows; /*!< Open windows */
+    std::map<std::string, Glib::RefPtr<Gdk::Pixbuf>> icons; /*!< Loaded icons by file name and size (GUI thread) */
+    IPFS ipfs;
+    FetchCoalescer fetchCoalescer; /*!< Shares in-flight fetches of the same content */
+    NameResolver nameResolver;     /*!< IPNS and DNSLink resolutions, cached by TTL */
+    DirectoryIndex directoryIndex; /*!< Directory listings cached by CID, for navigation within sites */
+    IPFSStatusMonitor statusMonitor;
+    ContentCache contentCache; /*!< Cache of immutable IPFS content (memory and disk) */
+    ContentCache renderCache;  /*!< Cache of rendered documents, keyed by content hash */
+    PagePrefetcher prefetcher; /*!< Linked pages fetched ahead */
+};
+#endif
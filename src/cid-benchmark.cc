@@ -0,0 +1,163 @@
+#include "cid.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const std::size_t DOCUMENT_SIZE = 8 * 1024 * 1024; /*!< Size of the document for the chunking benchmark */
+    const int REVISIONS = 10;
+
+    /**
+     * \brief Create a large markdown document from random lines of the example (with numbered parts),
+     * an example that is repeated as a whole would give the same chunk boundaries in every copy
+     */
+    std::string createDocument(const std::string &example, std::mt19937_64 &random)
+    {
+        std::vector<std::string> lines;
+        std::istringstream stream(example);
+        for (std::string line; std::getline(stream, line);)
+            lines.push_back(line);
+        if (lines.empty())
+            lines.push_back("Lorem ipsum dolor sit amet, consectetur adipiscing elit.");
+        std::string document;
+        for (int part = 1; document.size() < DOCUMENT_SIZE; ++part)
+        {
+            document += "# Part " + std::to_string(part) + "\n\n";
+            for (std::size_t i = 0; i < lines.size(); ++i)
+                document += lines[random() % lines.size()] + "\n";
+        }
+        return document;
+    }
+
+    /**
+     * \brief Next revision: a line is inserted, changed or removed at a random position
+     */
+    std::string createRevision(const std::string &document, std::mt19937_64 &random)
+    {
+        std::string revision = document;
+        std::size_t pos = revision.find('\n', random() % revision.size());
+        pos = (pos == std::string::npos) ? 0 : pos + 1;
+        std::size_t end = revision.find('\n', pos);
+        switch (random() % 3)
+        {
+        case 0:
+            revision.insert(pos, "An inserted line, with *emphasis* and a [link](https://libreweb.org).\n");
+            break;
+        case 1:
+            if (end != std::string::npos)
+                revision.replace(pos, end - pos, "A changed line.");
+            break;
+        default:
+            if (end != std::string::npos)
+                revision.erase(pos, end - pos + 1);
+            break;
+        }
+        return revision;
+    }
+
+    void benchmarkHashing(std::size_t size)
+    {
+        std::string content(size, '\0');
+        std::mt19937_64 random(42);
+        for (std::size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t value = random();
+            content.replace(i, sizeof(value), reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << "Hashing, content: " << size / (1024 * 1024) << " MiB, cores: " << cores << std::endl;
+        for (int version = 0; version <= 1; ++version)
+        {
+            CID::Options options = CID::getDefaultOptions(version);
+            for (unsigned int threads = 1; threads <= cores; threads = (threads == cores) ? cores + 1 : std::min(threads * 2, cores))
+            {
+                options.threads = threads;
+                auto start = std::chrono::steady_clock::now();
+                std::string cid = CID::compute(content, options);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                std::cout << "CIDv" << version << ", " << std::setw(3) << threads << " thread(s): " << std::fixed << std::setprecision(1)
+                          << std::setw(8) << (size / (1024.0 * 1024.0)) / elapsed.count() << " MiB/s  " << cid << std::endl;
+            }
+        }
+    }
+
+    /**
+     * \brief Import throughput (chunking and hashing) and the deduplication ratio:
+     * bytes of each revision in blocks of the previous revision
+     */
+    void benchmarkChunking(const std::string &example)
+    {
+        std::mt19937_64 random(42);
+        std::vector<std::string> revisions{createDocument(example, random)};
+        for (int i = 1; i < REVISIONS; ++i)
+            revisions.push_back(createRevision(revisions.back(), random));
+
+        std::cout << "Chunking, document: " << revisions.front().size() / (1024 * 1024) << " MiB, revisions: " << REVISIONS << std::endl;
+        for (CID::Chunker chunker : {CID::CHUNKER_FIXED, CID::CHUNKER_BUZHASH})
+        {
+            CID::Options options = CID::getDefaultOptions(1, chunker);
+            options.threads = 1;
+            std::size_t chunks = 0;
+            for (const std::string &revision : revisions)
+                chunks += CID::split(revision.data(), revision.size(), options).size();
+
+            std::set<std::string> previous;
+            uint64_t reusedBytes = 0;
+            uint64_t totalBytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < revisions.size(); ++i)
+            {
+                std::set<std::string> current;
+                CID::compute(revisions[i], options, [&](const std::string &cid, std::string_view block) {
+                    current.insert(cid);
+                    if (i > 0)
+                    {
+                        totalBytes += block.size();
+                        if (previous.count(cid) > 0)
+                            reusedBytes += block.size();
+                    }
+                });
+                previous.swap(current);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            double megabytes = (revisions.front().size() * revisions.size()) / (1024.0 * 1024.0);
+            std::cout << (chunker == CID::CHUNKER_FIXED ? "Fixed:   " : "Buzhash: ") << std::fixed << std::setprecision(1) << std::setw(8)
+                      << megabytes / elapsed.count() << " MiB/s (1 thread), avg. chunk " << std::setw(4) << (megabytes * 1024) / chunks
+                      << " KiB, reused " << std::setw(5) << (totalBytes > 0 ? 100.0 * reusedBytes / totalBytes : 0.0) << "%" << std::endl;
+        }
+    }
+} // namespace
+
+/**
+ * \brief Measure the CID computation throughput with 1 up to the number of cores hashing threads,
+ * and the content-defined chunking throughput and deduplication on successive revisions of a markdown document
+ * Usage: cid-benchmark [size in MiB (default: 256)] [example markdown file (default: big.md)]
+ */
+int main(int argc, char *argv[])
+{
+    std::size_t size = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256) * 1024 * 1024;
+    std::string examplePath = (argc > 2) ? argv[2] : "big.md";
+    std::ifstream exampleFile(examplePath);
+    if (!exampleFile)
+    {
+        std::cerr << "ERROR: Couldn't open the example markdown file: " << examplePath << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::stringstream example;
+    example << exampleFile.rdbuf();
+
+    benchmarkHashing(size);
+    benchmarkChunking(example.str());
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,548 @@
+#include "cid.h"
+
+#include <algorithm>
+#include <array>
+#include <glib.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    const uint64_t CODEC_RAW = 0x55;
+    const uint64_t CODEC_DAG_PB = 0x70;
+    const uint64_t HASH_SHA2_256 = 0x12;
+    const std::size_t SHA2_256_LENGTH = 32;
+    const std::size_t MIN_LEAVES_PER_THREAD = 4; /*!< Smaller files are hashed in the calling thread */
+    const std::size_t BUZHASH_WINDOW = 32;       /*!< Rolling hash window in bytes */
+    const char BASE58_ALPHABET[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+    const char BASE32_ALPHABET[] = "abcdefghijklmnopqrstuvwxyz234567";
+
+    // Protobuf wire format: field number << 3 | wire type
+    const unsigned char PB_NODE_DATA = 0x0a;  /*!< PBNode.Data (1), length-delimited */
+    const unsigned char PB_NODE_LINKS = 0x12; /*!< PBNode.Links (2), length-delimited */
+    const unsigned char PB_LINK_HASH = 0x0a;  /*!< PBLink.Hash (1), length-delimited */
+    const unsigned char PB_LINK_NAME = 0x12;  /*!< PBLink.Name (2), length-delimited */
+    const unsigned char PB_LINK_TSIZE = 0x18; /*!< PBLink.Tsize (3), varint */
+    const unsigned char UNIXFS_TYPE = 0x08;   /*!< Data.Type (1), varint */
+    const unsigned char UNIXFS_DATA = 0x12;   /*!< Data.Data (2), length-delimited */
+    const unsigned char UNIXFS_SIZE = 0x18;   /*!< Data.filesize (3), varint */
+    const unsigned char UNIXFS_BLOCK = 0x20;  /*!< Data.blocksizes (4), varint, not packed */
+    const unsigned char UNIXFS_FILE = 0x02;
+
+    /**
+     * \brief Random value per byte value for the rolling hash, generated once (splitmix64 with a fixed seed),
+     * the table should never change: it defines the chunk boundaries and therefore the CIDs
+     */
+    const std::array<uint32_t, 256> &getBuzhashTable()
+    {
+        static const std::array<uint32_t, 256> table = []() {
+            std::array<uint32_t, 256> values;
+            uint64_t state = 0x4c69627265576562; // "LibreWeb"
+            for (uint32_t &value : values)
+            {
+                uint64_t z = (state += 0x9e3779b97f4a7c15);
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+                value = static_cast<uint32_t>(z ^ (z >> 31));
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    inline uint32_t rotateLeft(uint32_t value, unsigned int bits)
+    {
+        return (value << bits) | (value >> (32 - bits));
+    }
+} // namespace
+
+/**
+ * \brief Get the import settings of `ipfs add` (CIDv1 implies raw leaves)
+ * \param version CID version 0 or 1
+ * \param chunker Fixed-size chunks (256 KiB) or content-defined chunks (16 KiB - 256 KiB, 48 KiB average for random data).
+ * The daemon can't produce content-defined chunks with the same boundaries, those blocks are imported as is.
+ */
+CID::Options CID::getDefaultOptions(int version, Chunker chunker)
+{
+    if (chunker == CHUNKER_BUZHASH)
+        return Options{version, version == 1, chunker, 48 * 1024, 16 * 1024, 256 * 1024, 174, 0};
+    return Options{version, version == 1, chunker, 256 * 1024, 0, 0, 174, 0};
+}
+
+/**
+ * \brief Compute the CID of a file (blocking, the leaves are hashed in parallel)
+ * \param data File content
+ * \param size Content size in bytes
+ * \param options Import settings
+ * \param onBlock Optional callback, called for every block of the DAG
+ * \return CID as string (CIDv0 base58btc, CIDv1 base32)
+ */
+std::string CID::compute(const char *data, std::size_t size, const Options &options, const BlockCallback &onBlock)
+{
+    return toString(computeRoot(data, size, options, onBlock));
+}
+
+std::string CID::compute(const std::string &content, const Options &options, const BlockCallback &onBlock)
+{
+    return compute(content.data(), content.size(), options, onBlock);
+}
+
+/**
+ * \brief Compute the CID of a file on disk, the file is memory mapped instead of read into memory
+ * \throw std::runtime_error when the file can't be opened
+ */
+std::string CID::computeFile(const std::string &path, const Options &options, const BlockCallback &onBlock)
+{
+    GError *error = nullptr;
+    GMappedFile *file = g_mapped_file_new(path.c_str(), FALSE, &error);
+    if (file == nullptr)
+    {
+        std::string message = error != nullptr ? error->message : "unknown error";
+        g_clear_error(&error);
+        throw std::runtime_error("Couldn't open file " + path + ": " + message);
+    }
+    try
+    {
+        std::string cid = compute(g_mapped_file_get_contents(file), g_mapped_file_get_length(file), options, onBlock);
+        g_mapped_file_unref(file);
+        return cid;
+    }
+    catch (...)
+    {
+        g_mapped_file_unref(file);
+        throw;
+    }
+}
+
+/**
+ * \brief Split the content into chunks (the leaves)
+ * \return Chunk sizes in bytes, empty content is a single empty chunk
+ */
+std::vector<std::size_t> CID::split(const char *data, std::size_t size, const Options &options)
+{
+    if (options.chunkSize == 0 || (options.chunker == CHUNKER_BUZHASH && (options.minChunkSize < BUZHASH_WINDOW || options.maxChunkSize < options.minChunkSize)))
+        throw std::invalid_argument("Invalid chunk size");
+    std::vector<std::size_t> chunks;
+    std::size_t offset = 0;
+    do
+    {
+        std::size_t length = (options.chunker == CHUNKER_BUZHASH) ? findBoundary(data + offset, size - offset, options)
+                                                                   : std::min(options.chunkSize, size - offset);
+        chunks.push_back(length);
+        offset += length;
+    } while (offset < size);
+    return chunks;
+}
+
+/**
+ * \brief Decode a CID string to the binary CID (CIDv0: multihash only), the multihash isn't checked
+ * \return True if the CID could be decoded
+ */
+bool CID::decode(const std::string &cid, std::string &binaryCID)
+{
+    if (cid.size() == 46 && cid.compare(0, 2, "Qm") == 0)
+        return decodeBase58(cid, binaryCID);
+    if (cid.size() < 2)
+        return false;
+    if (cid[0] == 'b')
+        return decodeBase32(cid.substr(1), binaryCID);
+    if (cid[0] == 'B')
+    {
+        std::string lower = cid.substr(1);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        return decodeBase32(lower, binaryCID);
+    }
+    if (cid[0] == 'z')
+        return decodeBase58(cid.substr(1), binaryCID);
+    return false;
+}
+
+/**
+ * \brief Encode a binary CID: CIDv0 (a sha2-256 multihash) in base58btc, CIDv1 in base32
+ */
+std::string CID::toString(const std::string &binaryCID)
+{
+    if (binaryCID.size() == 2 + SHA2_256_LENGTH && binaryCID[0] == static_cast<char>(HASH_SHA2_256) && binaryCID[1] == static_cast<char>(SHA2_256_LENGTH))
+        return encodeBase58(binaryCID);
+    return "b" + encodeBase32(binaryCID);
+}
+
+/**
+ * \brief Parse a CIDv0 (base58btc 'Qm...') or CIDv1 (multibase 'b' base32 or 'z' base58btc)
+ * \param cid CID as string
+ * \param decoded Parsed CID
+ * \return True if the CID is valid
+ */
+bool CID::parse(const std::string &cid, Decoded &decoded)
+{
+    std::string binary;
+    std::size_t pos = 0;
+    if (!decode(cid, binary))
+        return false;
+    if (cid.compare(0, 2, "Qm") == 0)
+    {
+        decoded.version = 0;
+        decoded.codec = CODEC_DAG_PB;
+    }
+    else
+    {
+        uint64_t version;
+        if (!readVarint(binary, pos, version) || version != 1 || !readVarint(binary, pos, decoded.codec))
+            return false;
+        decoded.version = 1;
+    }
+    uint64_t length;
+    if (!readVarint(binary, pos, decoded.hashFunction) || !readVarint(binary, pos, length) || binary.size() - pos != length)
+        return false;
+    if (decoded.hashFunction == HASH_SHA2_256 && length != SHA2_256_LENGTH)
+        return false;
+    decoded.digest = binary.substr(pos);
+    return true;
+}
+
+/**
+ * \brief Check the CID syntax (no daemon needed)
+ */
+bool CID::isValid(const std::string &cid)
+{
+    Decoded decoded;
+    return parse(cid, decoded);
+}
+
+/**
+ * \brief Verify that the content matches the CID of a file. Both leaf settings are tried for CIDv1,
+ * since content can be added with or without raw leaves.
+ * Only a raw block is a definite mismatch: a dag-pb file that doesn't match the default import settings
+ * could be added with another chunker or layout, so that's unknown.
+ * \return Match, mismatch or unknown if the CID can't be verified locally (eg. another hash function or a directory)
+ */
+CID::Verification CID::verify(const std::string &cid, const std::string &content)
+{
+    Decoded decoded;
+    if (!parse(cid, decoded) || decoded.hashFunction != HASH_SHA2_256)
+        return VERIFY_UNKNOWN;
+    if (decoded.codec == CODEC_RAW)
+        return (sha256(content) == decoded.digest) ? VERIFY_MATCH : VERIFY_MISMATCH;
+    if (decoded.codec != CODEC_DAG_PB)
+        return VERIFY_UNKNOWN;
+    Options options = getDefaultOptions(decoded.version);
+    if (compute(content, options) == cid)
+        return VERIFY_MATCH;
+    if (decoded.version == 0)
+        return VERIFY_UNKNOWN;
+    options.rawLeaves = !options.rawLeaves;
+    return (compute(content, options) == cid) ? VERIFY_MATCH : VERIFY_UNKNOWN;
+}
+
+/**
+ * \brief Build the balanced DAG: the leaves are grouped in parents of max. links, level by level,
+ * which gives the same tree as the depth-first fill of the balanced layout
+ * \return Binary CID of the root
+ */
+std::string CID::computeRoot(const char *data, std::size_t size, const Options &options, const BlockCallback &onBlock)
+{
+    if (options.maxLinks < 2)
+        throw std::invalid_argument("Invalid max. links");
+    std::vector<std::size_t> chunks = split(data, size, options);
+    std::vector<std::size_t> offsets(chunks.size(), 0);
+    for (std::size_t i = 1; i < chunks.size(); ++i)
+        offsets[i] = offsets[i - 1] + chunks[i - 1];
+    std::size_t nrLeaves = chunks.size();
+    std::vector<Node> nodes(nrLeaves);
+    auto hashLeaves = [&](std::size_t first, std::size_t last) {
+        for (std::size_t i = first; i < last; ++i)
+            nodes[i] = createLeaf(data + offsets[i], chunks[i], options, onBlock);
+    };
+    std::size_t nrThreads = options.threads != 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    nrThreads = std::min(nrThreads, nrLeaves / MIN_LEAVES_PER_THREAD);
+    if (nrThreads <= 1)
+    {
+        hashLeaves(0, nrLeaves);
+    }
+    else
+    {
+        std::vector<std::thread> threads;
+        std::size_t perThread = (nrLeaves + nrThreads - 1) / nrThreads;
+        for (std::size_t first = perThread; first < nrLeaves; first += perThread)
+            threads.emplace_back(hashLeaves, first, std::min(first + perThread, nrLeaves));
+        hashLeaves(0, std::min(perThread, nrLeaves));
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+    while (nodes.size() > 1)
+    {
+        std::vector<Node> parents;
+        parents.reserve((nodes.size() + options.maxLinks - 1) / options.maxLinks);
+        for (std::size_t first = 0; first < nodes.size(); first += options.maxLinks)
+            parents.push_back(createParent(&nodes[first], std::min(options.maxLinks, nodes.size() - first), options, onBlock));
+        nodes.swap(parents);
+    }
+    return nodes.front().cid;
+}
+
+/**
+ * \brief Find the next content-defined chunk boundary: where the rolling hash of the last window bytes
+ * has its low bits zero, between the min. and max. chunk size
+ * \return Chunk size in bytes
+ */
+std::size_t CID::findBoundary(const char *data, std::size_t size, const Options &options)
+{
+    if (size <= options.minChunkSize)
+        return size;
+    // Largest power of two mask within the average distance after the min. size
+    uint32_t mask = 1;
+    while (mask * 2 <= options.chunkSize - std::min(options.chunkSize - 1, options.minChunkSize))
+        mask *= 2;
+    --mask;
+    const std::array<uint32_t, 256> &table = getBuzhashTable();
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    std::size_t end = std::min(size, options.maxChunkSize);
+    uint32_t state = 0;
+    for (std::size_t i = options.minChunkSize - BUZHASH_WINDOW; i < options.minChunkSize; ++i)
+        state = rotateLeft(state, 1) ^ table[bytes[i]];
+    for (std::size_t i = options.minChunkSize; i < end; ++i)
+    {
+        if ((state & mask) == 0)
+            return i;
+        // The outgoing byte was rotated by the window size (32), which is a no-op
+        state = rotateLeft(state, 1) ^ table[bytes[i - BUZHASH_WINDOW]] ^ table[bytes[i]];
+    }
+    return end;
+}
+
+/**
+ * \brief Create leaf: raw block or UnixFS file node with the chunk as data
+ */
+CID::Node CID::createLeaf(const char *data, std::size_t size, const Options &options, const BlockCallback &onBlock)
+{
+    std::string block;
+    std::string_view view;
+    uint64_t codec;
+    if (options.rawLeaves)
+    {
+        view = std::string_view(data, size);
+        codec = CODEC_RAW;
+    }
+    else
+    {
+        std::string unixfs;
+        unixfs += UNIXFS_TYPE;
+        unixfs += UNIXFS_FILE;
+        if (size > 0)
+        {
+            unixfs += UNIXFS_DATA;
+            appendVarint(unixfs, size);
+            unixfs.append(data, size);
+        }
+        unixfs += UNIXFS_SIZE;
+        appendVarint(unixfs, size);
+        block += PB_NODE_DATA;
+        appendVarint(block, unixfs.size());
+        block += unixfs;
+        view = block;
+        codec = CODEC_DAG_PB;
+    }
+    Node leaf{getBinaryCID(codec, view, options.version), view.size(), size};
+    if (onBlock)
+        onBlock(leaf.cid, view);
+    return leaf;
+}
+
+/**
+ * \brief Create UnixFS file node linking to the children (links are serialized before the data)
+ */
+CID::Node CID::createParent(const Node *children, std::size_t count, const Options &options, const BlockCallback &onBlock)
+{
+    std::string block;
+    std::string unixfs;
+    unixfs += UNIXFS_TYPE;
+    unixfs += UNIXFS_FILE;
+    uint64_t fileSize = 0;
+    uint64_t tsize = 0;
+    std::string blockSizes;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const Node &child = children[i];
+        std::string link;
+        link += PB_LINK_HASH;
+        appendVarint(link, child.cid.size());
+        link += child.cid;
+        link += PB_LINK_NAME;
+        link += '\0';
+        link += PB_LINK_TSIZE;
+        appendVarint(link, child.tsize);
+        block += PB_NODE_LINKS;
+        appendVarint(block, link.size());
+        block += link;
+        blockSizes += UNIXFS_BLOCK;
+        appendVarint(blockSizes, child.fileSize);
+        fileSize += child.fileSize;
+        tsize += child.tsize;
+    }
+    unixfs += UNIXFS_SIZE;
+    appendVarint(unixfs, fileSize);
+    unixfs += blockSizes;
+    block += PB_NODE_DATA;
+    appendVarint(block, unixfs.size());
+    block += unixfs;
+    Node parent{getBinaryCID(CODEC_DAG_PB, block, options.version), block.size() + tsize, fileSize};
+    if (onBlock)
+        onBlock(parent.cid, block);
+    return parent;
+}
+
+/**
+ * \brief Hash the block, CIDv0 is the multihash only
+ */
+std::string CID::getBinaryCID(uint64_t codec, std::string_view block, int version)
+{
+    std::string cid;
+    if (version != 0)
+    {
+        appendVarint(cid, 1);
+        appendVarint(cid, codec);
+    }
+    appendVarint(cid, HASH_SHA2_256);
+    appendVarint(cid, SHA2_256_LENGTH);
+    cid += sha256(block);
+    return cid;
+}
+
+/**
+ * \brief SHA-256 digest (binary)
+ */
+std::string CID::sha256(std::string_view data)
+{
+    GChecksum *checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    g_checksum_update(checksum, reinterpret_cast<const guchar *>(data.data()), data.size());
+    guint8 digest[SHA2_256_LENGTH];
+    gsize length = sizeof(digest);
+    g_checksum_get_digest(checksum, digest, &length);
+    g_checksum_free(checksum);
+    return std::string(reinterpret_cast<const char *>(digest), length);
+}
+
+void CID::appendVarint(std::string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool CID::readVarint(const std::string &data, std::size_t &pos, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; pos < data.size() && shift < 64; shift += 7)
+    {
+        unsigned char byte = data[pos++];
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+std::string CID::encodeBase58(const std::string &data)
+{
+    std::size_t zeros = 0;
+    while (zeros < data.size() && data[zeros] == '\0')
+        ++zeros;
+    // Repeated division of the big-endian number by 58, digits in reverse order
+    std::vector<unsigned char> digits;
+    for (std::size_t i = zeros; i < data.size(); ++i)
+    {
+        unsigned int carry = static_cast<unsigned char>(data[i]);
+        for (unsigned char &digit : digits)
+        {
+            carry += static_cast<unsigned int>(digit) << 8;
+            digit = carry % 58;
+            carry /= 58;
+        }
+        while (carry > 0)
+        {
+            digits.push_back(carry % 58);
+            carry /= 58;
+        }
+    }
+    std::string text(zeros, '1');
+    for (auto it = digits.rbegin(); it != digits.rend(); ++it)
+        text += BASE58_ALPHABET[*it];
+    return text;
+}
+
+bool CID::decodeBase58(const std::string &text, std::string &data)
+{
+    std::size_t zeros = 0;
+    while (zeros < text.size() && text[zeros] == '1')
+        ++zeros;
+    std::vector<unsigned char> bytes; // Little-endian
+    for (std::size_t i = zeros; i < text.size(); ++i)
+    {
+        const char *found = std::char_traits<char>::find(BASE58_ALPHABET, 58, text[i]);
+        if (found == nullptr)
+            return false;
+        unsigned int carry = found - BASE58_ALPHABET;
+        for (unsigned char &byte : bytes)
+        {
+            carry += static_cast<unsigned int>(byte) * 58;
+            byte = carry & 0xff;
+            carry >>= 8;
+        }
+        while (carry > 0)
+        {
+            bytes.push_back(carry & 0xff);
+            carry >>= 8;
+        }
+    }
+    data.assign(zeros, '\0');
+    data.append(bytes.rbegin(), bytes.rend());
+    return true;
+}
+
+/**
+ * \brief Lower-case RFC 4648 base32 without padding (multibase 'b')
+ */
+std::string CID::encodeBase32(const std::string &data)
+{
+    std::string text;
+    unsigned int buffer = 0;
+    int bits = 0;
+    for (unsigned char byte : data)
+    {
+        buffer = (buffer << 8) | byte;
+        bits += 8;
+        while (bits >= 5)
+        {
+            text += BASE32_ALPHABET[(buffer >> (bits - 5)) & 0x1f];
+            bits -= 5;
+        }
+    }
+    if (bits > 0)
+        text += BASE32_ALPHABET[(buffer << (5 - bits)) & 0x1f];
+    return text;
+}
+
+bool CID::decodeBase32(const std::string &text, std::string &data)
+{
+    data.clear();
+    unsigned int buffer = 0;
+    int bits = 0;
+    for (char c : text)
+    {
+        const char *found = std::char_traits<char>::find(BASE32_ALPHABET, 32, c);
+        if (found == nullptr)
+            return false;
+        buffer = (buffer << 5) | static_cast<unsigned int>(found - BASE32_ALPHABET);
+        bits += 5;
+        if (bits >= 8)
+        {
+            data += static_cast<char>((buffer >> (bits - 8)) & 0xff);
+            bits -= 8;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef CID_H
+#define CID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * \class CID
+ * \brief Local computation of IPFS content identifiers, the same as `ipfs add` with the default settings:
+ * UnixFS file with fixed-size chunks (256 KiB), balanced DAG layout (174 links per node) and a SHA-256 multihash.
+ * CIDv0 uses dag-pb leaves (base58btc), CIDv1 uses raw leaves (base32).
+ * Can also parse and validate CIDs, and verify content against a CID.
+ * Optionally the content is split by a content-defined chunker (buzhash), so an edit only changes the blocks around it.
+ */
+class CID
+{
+public:
+    /**
+     * \brief Chunker, how the content is split into leaves
+     */
+    enum Chunker
+    {
+        CHUNKER_FIXED,  /*!< Fixed-size chunks, the same as `ipfs add` */
+        CHUNKER_BUZHASH /*!< Content-defined chunks, boundaries by a rolling hash (buzhash) of the content */
+    };
+
+    /**
+     * \brief Result of verifying content against a CID
+     */
+    enum Verification
+    {
+        VERIFY_MATCH,    /*!< The content has this CID */
+        VERIFY_MISMATCH, /*!< The content can't have this CID */
+        VERIFY_UNKNOWN   /*!< Can't be verified locally, eg. another hash function or other import settings */
+    };
+
+    /**
+     * \struct Options
+     * \brief Import settings
+     */
+    struct Options
+    {
+        int version;              /*!< CID version: 0 or 1 */
+        bool rawLeaves;           /*!< Leaves as raw blocks (instead of UnixFS dag-pb nodes) */
+        Chunker chunker;
+        std::size_t chunkSize;    /*!< Chunk size in bytes (fixed), or the approx. average chunk size (content-defined) */
+        std::size_t minChunkSize; /*!< Min. chunk size in bytes (content-defined) */
+        std::size_t maxChunkSize; /*!< Max. chunk size in bytes (content-defined) */
+        std::size_t maxLinks;     /*!< Max. number of links per node */
+        unsigned int threads;     /*!< Hashing threads, 0 is the number of cores */
+    };
+
+    /**
+     * \struct Decoded
+     * \brief Parsed CID
+     */
+    struct Decoded
+    {
+        int version;
+        uint64_t codec;         /*!< Multicodec, eg. 0x70 (dag-pb) or 0x55 (raw) */
+        uint64_t hashFunction;  /*!< Multihash function, eg. 0x12 (sha2-256) */
+        std::string digest;     /*!< Hash digest (binary) */
+    };
+
+    /**
+     * \brief Block callback, with the binary CID and the serialized block (called from the hashing threads).
+     * A raw leaf points into the content (not copied), eg. to locate the block within a file.
+     */
+    typedef std::function<void(const std::string &cid, std::string_view block)> BlockCallback;
+
+    static Options getDefaultOptions(int version, Chunker chunker = CHUNKER_FIXED);
+    static std::string compute(const char *data, std::size_t size, const Options &options, const BlockCallback &onBlock = nullptr);
+    static std::string compute(const std::string &content, const Options &options, const BlockCallback &onBlock = nullptr);
+    static std::string computeFile(const std::string &path, const Options &options, const BlockCallback &onBlock = nullptr);
+    static std::vector<std::size_t> split(const char *data, std::size_t size, const Options &options);
+    static bool decode(const std::string &cid, std::string &binaryCID);
+    static std::string toString(const std::string &binaryCID);
+    static bool parse(const std::string &cid, Decoded &decoded);
+    static bool isValid(const std::string &cid);
+    static Verification verify(const std::string &cid, const std::string &content);
+    static void appendVarint(std::string &out, uint64_t value);
+    static bool readVarint(const std::string &data, std::size_t &pos, uint64_t &value);
+
+private:
+    struct Node
+    {
+        std::string cid;  /*!< Binary CID (CIDv0: multihash only) */
+        uint64_t tsize;   /*!< Cumulative size of the serialized node and its children */
+        uint64_t fileSize;
+    };
+
+    static std::string computeRoot(const char *data, std::size_t size, const Options &options, const BlockCallback &onBlock);
+    static std::size_t findBoundary(const char *data, std::size_t size, const Options &options);
+    static Node createLeaf(const char *data, std::size_t size, const Options &options, const BlockCallback &onBlock);
+    static Node createParent(const Node *children, std::size_t count, const Options &options, const BlockCallback &onBlock);
+    static std::string getBinaryCID(uint64_t codec, std::string_view block, int version);
+    static std::string sha256(std::string_view data);
+    static std::string encodeBase58(const std::string &data);
+    static bool decodeBase58(const std::string &text, std::string &data);
+    static std::string encodeBase32(const std::string &data);
+    static bool decodeBase32(const std::string &text, std::string &data);
+};
+#endif
@@ -0,0 +1,591 @@
+#include "content-cache.h"
+
+#include <glibmm/miscutils.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace
+{
+    const char INDEX_MAGIC[8] = {'L', 'W', 'C', 'A', 'C', 'H', 'E', '1'};
+    const uint32_t INDEX_VERSION = 1;
+    const uint32_t INDEX_CAPACITY = 8192; /*!< Number of slots in the index (max. 75% is used) */
+
+    /**
+     * \brief Lock the index file, the disk cache can be shared by multiple browser processes
+     */
+    class IndexLock
+    {
+    public:
+        explicit IndexLock(int fd) : fd(fd)
+        {
+            ::flock(this->fd, LOCK_EX);
+        }
+        ~IndexLock()
+        {
+            ::flock(this->fd, LOCK_UN);
+        }
+
+    private:
+        int fd;
+    };
+} // namespace
+
+/**
+ * \brief Create content cache
+ * \param name Sub-directory name within the cache directory
+ * \param memoryBudget Max. number of bytes kept in memory
+ * \param diskBudget Max. number of (compressed) bytes stored on disk
+ */
+ContentCache::ContentCache(const std::string &name, std::size_t memoryBudget, std::size_t diskBudget)
+    : directory(Glib::build_filename(Glib::get_user_cache_dir(), "libreweb-browser", name)),
+      memoryBudget(memoryBudget),
+      diskBudget(diskBudget),
+      memorySize(0),
+      indexFd(-1),
+      index(nullptr),
+      entries(nullptr),
+      indexMapSize(0),
+      isStopping(false)
+{
+    this->openIndex();
+}
+
+/**
+ * \brief Pending writes of putLater() are finished before the cache is closed
+ */
+ContentCache::~ContentCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->writeMutex);
+        this->isStopping = true;
+    }
+    this->writeCondition.notify_all();
+    if (this->writer.joinable())
+        this->writer.join();
+    this->closeIndex();
+}
+
+/**
+ * \brief Retrieve content from the cache, a disk hit is promoted to the memory tier
+ * \param key Cache key (eg. CID with path)
+ * \param[out] content Cached content
+ * \return True on a cache hit
+ */
+bool ContentCache::get(const std::string &key, std::string &content)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->lruMap.find(key);
+    if (it != this->lruMap.end())
+    {
+        this->lruList.splice(this->lruList.begin(), this->lruList, it->second);
+        content = it->second->second;
+        return true;
+    }
+    if (this->getDisk(key, content))
+    {
+        this->putMemory(key, content);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * \brief Store content in both cache tiers
+ * \param key Cache key (eg. CID with path)
+ * \param content Content
+ */
+void ContentCache::put(const std::string &key, const std::string &content)
+{
+    // Compression and the file write are done before the lock, which then only covers the index updates
+    std::size_t blobSize = 0;
+    std::string blobFile = this->writeBlob(key, content, blobSize);
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->putMemory(key, content);
+    if (!blobFile.empty())
+        this->putDisk(key, blobFile, blobSize);
+}
+
+/**
+ * \brief Store content in both cache tiers on a background thread, eg. to keep the serialization
+ * and the disk write (gzip compression) off the GUI thread. Writes are done in the order of the calls.
+ * \param key Cache key
+ * \param produce Returns the content, called on the background thread
+ */
+void ContentCache::putLater(const std::string &key, std::function<std::string()> produce)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->writeMutex);
+        if (this->isStopping)
+            return;
+        if (!this->writer.joinable())
+            this->writer = std::thread(&ContentCache::writeLoop, this);
+        this->writeQueue.emplace_back(key, std::move(produce));
+    }
+    this->writeCondition.notify_one();
+}
+
+/**
+ * \brief Check if the content is in the cache (without reading it), the key hash is used for the disk tier
+ */
+bool ContentCache::contains(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->lruMap.count(key) > 0)
+        return true;
+    if (this->index == nullptr)
+        return false;
+    IndexLock indexLock(this->indexFd);
+    return this->findEntry(hashKey(key)) != nullptr;
+}
+
+/**
+ * \brief Remove content from both cache tiers
+ */
+void ContentCache::remove(const std::string &key)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->lruMap.find(key);
+    if (it != this->lruMap.end())
+    {
+        this->memorySize -= it->second->second.size();
+        this->lruList.erase(it->second);
+        this->lruMap.erase(it);
+    }
+    if (this->index != nullptr)
+    {
+        IndexLock indexLock(this->indexFd);
+        IndexEntry *entry = this->findEntry(hashKey(key));
+        if (entry != nullptr)
+            this->removeEntry(entry);
+    }
+}
+
+/**
+ * \brief Background writer of putLater(), runs until the cache is destroyed and the queue is empty
+ */
+void ContentCache::writeLoop()
+{
+    std::unique_lock<std::mutex> lock(this->writeMutex);
+    while (true)
+    {
+        this->writeCondition.wait(lock, [this] { return this->isStopping || !this->writeQueue.empty(); });
+        if (this->writeQueue.empty())
+            return;
+        std::pair<std::string, std::function<std::string()>> write = std::move(this->writeQueue.front());
+        this->writeQueue.pop_front();
+        lock.unlock();
+        this->put(write.first, write.second());
+        lock.lock();
+    }
+}
+
+/**
+ * \brief Add to the memory tier, least recently used entries are dropped when the memory budget is exceeded
+ */
+void ContentCache::putMemory(const std::string &key, const std::string &content)
+{
+    if (content.size() > this->memoryBudget)
+        return;
+    auto it = this->lruMap.find(key);
+    if (it != this->lruMap.end())
+    {
+        this->memorySize -= it->second->second.size();
+        this->lruList.erase(it->second);
+        this->lruMap.erase(it);
+    }
+    while (!this->lruList.empty() && this->memorySize + content.size() > this->memoryBudget)
+    {
+        auto &last = this->lruList.back();
+        this->memorySize -= last.second.size();
+        this->lruMap.erase(last.first);
+        this->lruList.pop_back();
+    }
+    this->lruList.emplace_front(key, content);
+    this->lruMap[key] = this->lruList.begin();
+    this->memorySize += content.size();
+}
+
+/**
+ * \brief Read from the disk tier. The blob starts with the full key, to detect hash collisions.
+ */
+bool ContentCache::getDisk(const std::string &key, std::string &content)
+{
+    if (this->index == nullptr)
+        return false;
+    uint64_t keyHash = hashKey(key);
+    IndexLock indexLock(this->indexFd);
+    IndexEntry *entry = this->findEntry(keyHash);
+    if (entry == nullptr)
+        return false;
+
+    gchar *data = nullptr;
+    gsize size = 0;
+    if (!g_file_get_contents(this->blobPath(keyHash).c_str(), &data, &size, nullptr))
+    {
+        // Blob is gone (eg. removed by the user)
+        this->removeEntry(entry);
+        return false;
+    }
+    bool isHit = false;
+    uint32_t keySize = 0;
+    if (size >= sizeof(uint32_t))
+        std::memcpy(&keySize, data, sizeof(uint32_t));
+    if (size >= sizeof(uint32_t) + keySize && key.compare(0, std::string::npos, data + sizeof(uint32_t), keySize) == 0)
+    {
+        std::size_t headerSize = sizeof(uint32_t) + keySize;
+        isHit = decompress(data + headerSize, size - headerSize, content);
+    }
+    g_free(data);
+    if (isHit)
+        entry->lastAccess = ++this->index->clock;
+    return isHit;
+}
+
+/**
+ * \brief Compress content into a temporary blob file, which putDisk() moves into the disk tier (no lock needed)
+ * \param[out] size Size of the blob file
+ * \return Path of the temporary file, empty when the disk tier is disabled or the blob doesn't fit
+ */
+std::string ContentCache::writeBlob(const std::string &key, const std::string &content, std::size_t &size) const
+{
+    if (this->index == nullptr)
+        return std::string();
+    std::string blob;
+    uint32_t keySize = static_cast<uint32_t>(key.size());
+    blob.append(reinterpret_cast<const char *>(&keySize), sizeof(uint32_t));
+    blob.append(key);
+    std::string compressed;
+    if (!compress(content, compressed))
+        return std::string();
+    blob.append(compressed);
+    if (blob.size() > this->diskBudget)
+        return std::string();
+
+    // Same suffix as the blob files, a left-over temporary file is removed with the blob files
+    std::string path = Glib::build_filename(this->directory, "tmp-XXXXXX.gz");
+    int fd = g_mkstemp_full(&path[0], O_WRONLY | O_CLOEXEC, 0600);
+    if (fd < 0)
+    {
+        std::cerr << "ERROR: Could not write to the disk cache: " << std::strerror(errno) << std::endl;
+        return std::string();
+    }
+    std::size_t written = 0;
+    while (written < blob.size())
+    {
+        ssize_t result = ::write(fd, blob.data() + written, blob.size() - written);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            break;
+        written += static_cast<std::size_t>(result);
+    }
+    if (::close(fd) != 0 || written < blob.size())
+    {
+        std::cerr << "ERROR: Could not write to the disk cache: " << std::strerror(errno) << std::endl;
+        g_unlink(path.c_str());
+        return std::string();
+    }
+    size = blob.size();
+    return path;
+}
+
+/**
+ * \brief Move a blob file written by writeBlob() into the disk tier, atomically (rename)
+ */
+void ContentCache::putDisk(const std::string &key, const std::string &blobFile, std::size_t size)
+{
+    uint64_t keyHash = hashKey(key);
+    IndexLock indexLock(this->indexFd);
+    IndexEntry *existing = this->findEntry(keyHash);
+    if (existing != nullptr)
+        this->removeEntry(existing);
+    this->evictDisk(size);
+
+    if (g_rename(blobFile.c_str(), this->blobPath(keyHash).c_str()) != 0)
+    {
+        std::cerr << "ERROR: Could not write to the disk cache: " << std::strerror(errno) << std::endl;
+        g_unlink(blobFile.c_str());
+        return;
+    }
+    IndexEntry *entry = this->insertEntry(keyHash);
+    if (entry == nullptr)
+        return;
+    entry->size = static_cast<uint32_t>(size);
+    entry->lastAccess = ++this->index->clock;
+    this->index->totalBytes += entry->size;
+}
+
+/**
+ * \brief Open (or create) the memory-mapped index file
+ */
+void ContentCache::openIndex()
+{
+    if (g_mkdir_with_parents(this->directory.c_str(), 0700) != 0)
+    {
+        std::cerr << "ERROR: Could not create cache directory: " << this->directory << ". Disk cache is disabled." << std::endl;
+        return;
+    }
+    std::string indexPath = Glib::build_filename(this->directory, "index");
+    this->indexFd = ::open(indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (this->indexFd < 0)
+    {
+        std::cerr << "ERROR: Could not open cache index: " << indexPath << ". Disk cache is disabled." << std::endl;
+        return;
+    }
+    this->indexMapSize = sizeof(IndexHeader) + INDEX_CAPACITY * sizeof(IndexEntry);
+    IndexLock indexLock(this->indexFd);
+    struct stat info;
+    bool isNew = (::fstat(this->indexFd, &info) != 0 || static_cast<std::size_t>(info.st_size) != this->indexMapSize);
+    if (isNew && ::ftruncate(this->indexFd, this->indexMapSize) != 0)
+    {
+        this->closeIndex();
+        return;
+    }
+    void *map = ::mmap(nullptr, this->indexMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, this->indexFd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "ERROR: Could not map cache index: " << indexPath << ". Disk cache is disabled." << std::endl;
+        this->closeIndex();
+        return;
+    }
+    this->index = static_cast<IndexHeader *>(map);
+    this->entries = reinterpret_cast<IndexEntry *>(static_cast<char *>(map) + sizeof(IndexHeader));
+    if (isNew || std::memcmp(this->index->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        this->index->version != INDEX_VERSION || this->index->capacity != INDEX_CAPACITY)
+    {
+        this->resetIndex();
+    }
+}
+
+void ContentCache::closeIndex()
+{
+    if (this->index != nullptr)
+    {
+        ::munmap(this->index, this->indexMapSize);
+        this->index = nullptr;
+        this->entries = nullptr;
+    }
+    if (this->indexFd >= 0)
+    {
+        ::close(this->indexFd);
+        this->indexFd = -1;
+    }
+}
+
+/**
+ * \brief Start with an empty index, all blob files are removed
+ */
+void ContentCache::resetIndex()
+{
+    GDir *dir = g_dir_open(this->directory.c_str(), 0, nullptr);
+    if (dir != nullptr)
+    {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != nullptr)
+        {
+            if (g_str_has_suffix(name, ".gz"))
+                g_unlink(Glib::build_filename(this->directory, name).c_str());
+        }
+        g_dir_close(dir);
+    }
+    std::memset(this->index, 0, this->indexMapSize);
+    std::memcpy(this->index->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    this->index->version = INDEX_VERSION;
+    this->index->capacity = INDEX_CAPACITY;
+}
+
+/**
+ * \brief Find the index entry of a key hash (linear probing)
+ * \return Entry or nullptr when not found
+ */
+ContentCache::IndexEntry *ContentCache::findEntry(uint64_t keyHash)
+{
+    for (uint32_t i = 0; i < INDEX_CAPACITY; ++i)
+    {
+        IndexEntry *entry = &this->entries[(keyHash + i) % INDEX_CAPACITY];
+        if (entry->flags == ENTRY_EMPTY)
+            return nullptr;
+        if (entry->flags == ENTRY_USED && entry->keyHash == keyHash)
+            return entry;
+    }
+    return nullptr;
+}
+
+/**
+ * \brief Claim a new index entry, the table is cleaned up first when it gets too full
+ * \return Entry or nullptr when there is no room
+ */
+ContentCache::IndexEntry *ContentCache::insertEntry(uint64_t keyHash)
+{
+    uint32_t used = 0, occupied = 0;
+    for (uint32_t i = 0; i < INDEX_CAPACITY; ++i)
+    {
+        used += (this->entries[i].flags == ENTRY_USED);
+        occupied += (this->entries[i].flags != ENTRY_EMPTY);
+    }
+    // Keep the load factor below 75%, so probe sequences stay short
+    if (used >= INDEX_CAPACITY * 3 / 4)
+        this->evictDisk(0);
+    if (occupied >= INDEX_CAPACITY * 3 / 4)
+        this->rehashIndex();
+
+    for (uint32_t i = 0; i < INDEX_CAPACITY; ++i)
+    {
+        IndexEntry *entry = &this->entries[(keyHash + i) % INDEX_CAPACITY];
+        if (entry->flags != ENTRY_USED)
+        {
+            entry->keyHash = keyHash;
+            entry->flags = ENTRY_USED;
+            entry->size = 0;
+            entry->lastAccess = 0;
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * \brief Remove the blob file and mark the index entry as deleted
+ */
+void ContentCache::removeEntry(IndexEntry *entry)
+{
+    g_unlink(this->blobPath(entry->keyHash).c_str());
+    this->index->totalBytes -= std::min<uint64_t>(entry->size, this->index->totalBytes);
+    entry->flags = ENTRY_DELETED;
+}
+
+/**
+ * \brief Evict the least recently used blobs, until the new blob fits in the disk budget
+ * (and at least one entry is evicted when the index is full)
+ * \param neededBytes Size of the new blob
+ */
+void ContentCache::evictDisk(std::size_t neededBytes)
+{
+    bool evictOne = (neededBytes == 0);
+    while (evictOne || this->index->totalBytes + neededBytes > this->diskBudget)
+    {
+        IndexEntry *oldest = nullptr;
+        for (uint32_t i = 0; i < INDEX_CAPACITY; ++i)
+        {
+            IndexEntry *entry = &this->entries[i];
+            if (entry->flags == ENTRY_USED && (oldest == nullptr || entry->lastAccess < oldest->lastAccess))
+                oldest = entry;
+        }
+        if (oldest == nullptr)
+        {
+            this->index->totalBytes = 0;
+            break;
+        }
+        this->removeEntry(oldest);
+        evictOne = false;
+    }
+}
+
+/**
+ * \brief Rebuild the hash table without tombstones
+ */
+void ContentCache::rehashIndex()
+{
+    std::vector<IndexEntry> used;
+    for (uint32_t i = 0; i < INDEX_CAPACITY; ++i)
+    {
+        if (this->entries[i].flags == ENTRY_USED)
+            used.push_back(this->entries[i]);
+    }
+    std::memset(static_cast<void *>(this->entries), 0, INDEX_CAPACITY * sizeof(IndexEntry));
+    for (const IndexEntry &entry : used)
+    {
+        for (uint32_t i = 0; i < INDEX_CAPACITY; ++i)
+        {
+            IndexEntry *slot = &this->entries[(entry.keyHash + i) % INDEX_CAPACITY];
+            if (slot->flags == ENTRY_EMPTY)
+            {
+                *slot = entry;
+                break;
+            }
+        }
+    }
+}
+
+std::string ContentCache::blobPath(uint64_t keyHash) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.gz", static_cast<unsigned long long>(keyHash));
+    return Glib::build_filename(this->directory, name);
+}
+
+/**
+ * \brief 64-bit FNV-1a hash of the key
+ */
+uint64_t ContentCache::hashKey(const std::string &key)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+namespace
+{
+    /**
+     * \brief Run all input through a GLib (de)compressor
+     */
+    bool convert(GConverter *converter, const char *input, std::size_t size, std::string &output)
+    {
+        output.clear();
+        char buffer[64 * 1024];
+        std::size_t pos = 0;
+        while (true)
+        {
+            gsize bytesRead = 0, bytesWritten = 0;
+            GError *error = nullptr;
+            GConverterResult result = g_converter_convert(converter, input + pos, size - pos, buffer, sizeof(buffer),
+                                                          G_CONVERTER_INPUT_AT_END, &bytesRead, &bytesWritten, &error);
+            if (result == G_CONVERTER_ERROR)
+            {
+                g_error_free(error);
+                return false;
+            }
+            pos += bytesRead;
+            output.append(buffer, bytesWritten);
+            if (result == G_CONVERTER_FINISHED)
+                return true;
+        }
+    }
+} // namespace
+
+/**
+ * \brief Compress using gzip (GZlibCompressor)
+ */
+bool ContentCache::compress(const std::string &input, std::string &output)
+{
+    GZlibCompressor *compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, 6);
+    bool success = convert(G_CONVERTER(compressor), input.data(), input.size(), output);
+    g_object_unref(compressor);
+    return success;
+}
+
+/**
+ * \brief Decompress gzip data (GZlibDecompressor)
+ */
+bool ContentCache::decompress(const char *input, std::size_t size, std::string &output)
+{
+    GZlibDecompressor *decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+    bool success = convert(G_CONVERTER(decompressor), input, size, output);
+    g_object_unref(decompressor);
+    return success;
+}
@@ -0,0 +1,99 @@
+#ifndef CONTENT_CACHE_H
+#define CONTENT_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/**
+ * \class ContentCache
+ * \brief Two-tier cache for immutable content: an in-memory LRU with a byte budget,
+ * backed by an on-disk store in the user cache directory (thread-safe).
+ * On disk each entry is a gzip compressed blob file, the entries are tracked in a memory-mapped index
+ * (open addressing hash table), which is used for least recently used eviction when the disk budget is exceeded.
+ */
+class ContentCache
+{
+public:
+    explicit ContentCache(const std::string &name, std::size_t memoryBudget, std::size_t diskBudget);
+    ~ContentCache();
+    bool get(const std::string &key, std::string &content);
+    void put(const std::string &key, const std::string &content);
+    void putLater(const std::string &key, std::function<std::string()> produce);
+    bool contains(const std::string &key);
+    void remove(const std::string &key);
+
+private:
+    struct IndexHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t capacity;
+        uint64_t totalBytes; /*!< Size of all blob files */
+        uint64_t clock;      /*!< Logical clock, used for the last access time */
+    };
+
+    struct IndexEntry
+    {
+        uint64_t keyHash;
+        uint64_t lastAccess;
+        uint32_t size;
+        uint32_t flags;
+    };
+
+    enum EntryFlags : uint32_t
+    {
+        ENTRY_EMPTY = 0,
+        ENTRY_USED = 1,
+        ENTRY_DELETED = 2 /*!< Tombstone, keeps the probe sequences intact */
+    };
+
+    std::mutex mutex;
+    std::string directory;
+    std::size_t memoryBudget;
+    std::size_t diskBudget;
+
+    // Memory tier
+    std::list<std::pair<std::string, std::string>> lruList; /*!< Most recently used first */
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> lruMap;
+    std::size_t memorySize;
+
+    // Disk tier
+    int indexFd;
+    IndexHeader *index;
+    IndexEntry *entries;
+    std::size_t indexMapSize;
+
+    // Background writer
+    std::thread writer;                     /*!< Started by the first putLater() call */
+    std::mutex writeMutex;
+    std::condition_variable writeCondition;
+    std::deque<std::pair<std::string, std::function<std::string()>>> writeQueue; /*!< Key and content producer */
+    bool isStopping;
+
+    void writeLoop();
+    void putMemory(const std::string &key, const std::string &content);
+    bool getDisk(const std::string &key, std::string &content);
+    std::string writeBlob(const std::string &key, const std::string &content, std::size_t &size) const;
+    void putDisk(const std::string &key, const std::string &blobFile, std::size_t size);
+    void openIndex();
+    void closeIndex();
+    void resetIndex();
+    IndexEntry *findEntry(uint64_t keyHash);
+    IndexEntry *insertEntry(uint64_t keyHash);
+    void removeEntry(IndexEntry *entry);
+    void evictDisk(std::size_t neededBytes);
+    void rehashIndex();
+    std::string blobPath(uint64_t keyHash) const;
+
+    static uint64_t hashKey(const std::string &key);
+    static bool compress(const std::string &input, std::string &output);
+    static bool decompress(const char *input, std::size_t size, std::string &output);
+};
+#endif
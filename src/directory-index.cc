@@ -0,0 +1,301 @@
+#include "directory-index.h"
+#include "cid.h"
+
+#include <algorithm>
+#include <glibmm/miscutils.h>
+#include <nlohmann/json.hpp>
+#include <strings.h>
+
+namespace
+{
+    const std::size_t ENTRIES_PER_PAGE = 200;                 /*!< Entries of a listing page, large directories are paginated */
+    const char *const INDEX_PAGES[] = {"index.md", "README.md"}; /*!< Index pages of a directory, by preference */
+    const uint64_t CODEC_RAW = 0x55;                              /*!< Multicodec of a raw block, always a file */
+} // namespace
+
+/**
+ * \brief Create directory index, with its own listing cache
+ * \param ipfs IPFS daemon connection
+ */
+DirectoryIndex::DirectoryIndex(IPFS &ipfs)
+    : ipfs(ipfs),
+      cache("listings", 8 * 1024 * 1024, 64 * 1024 * 1024)
+{
+}
+
+/**
+ * \brief Get the first pages of a directory listing, from the cache or else streamed from the IPFS daemon
+ * \param cid Directory CID
+ * \param pages Number of listing pages, at least the entries of these pages are fetched (when available)
+ * \param[out] listing Directory entries, in the order of the directory (can be more than requested when cached)
+ * \throw std::runtime_error when the directory can't be listed
+ * \return True if the listing is complete
+ */
+bool DirectoryIndex::getListing(const std::string &cid, std::size_t pages, std::vector<IPFS::DirectoryEntry> &listing)
+{
+    // One entry more than the pages, which tells if there's a next page
+    return fetchListing(
+        cid, [pages](const std::vector<IPFS::DirectoryEntry> &entries, std::size_t) { return entries.size() > pages * ENTRIES_PER_PAGE; }, listing);
+}
+
+/**
+ * \brief Resolve a path within a directory to the CID of the target, using the (cached) listings.
+ * A bare CID is only resolved when it's a known directory (its listing is cached),
+ * the root of a longer path is checked (files/stat) before it's listed: `ls` also lists the blocks of a file.
+ * \param path Path starting with a CID, eg. "<cid>/docs/index.md"
+ * \param target Resolved entry (the name is empty for a bare CID), the type is unknown when it's not listed or resolved
+ * \throw std::runtime_error when a directory can't be listed, or the path continues within a file
+ * \return True if the path is resolved, false if the path should be fetched as-is (eg. a file CID or an unknown name)
+ */
+bool DirectoryIndex::resolve(const std::string &path, IPFS::DirectoryEntry &target)
+{
+    std::size_t pos = path.find('/');
+    target = IPFS::DirectoryEntry{std::string(), path.substr(0, pos), 0, IPFS::ENTRY_UNKNOWN};
+    if (cache.contains(target.cid))
+        target.type = IPFS::ENTRY_DIRECTORY;
+    if (pos == std::string::npos)
+        return target.type == IPFS::ENTRY_DIRECTORY;
+    while (pos != std::string::npos)
+    {
+        std::size_t end = path.find('/', pos + 1);
+        std::string name = path.substr(pos + 1, (end == std::string::npos) ? std::string::npos : end - pos - 1);
+        pos = end;
+        if (name.empty() || name == ".")
+            continue;
+        if (!isDirectory(target) || !findEntry(target.cid, name, target))
+            return false;
+    }
+    if (target.type == IPFS::ENTRY_UNKNOWN && cache.contains(target.cid))
+        target.type = IPFS::ENTRY_DIRECTORY;
+    return true;
+}
+
+/**
+ * \brief Find the index page of a directory (index.md, else README.md; case-insensitive within the first listing page).
+ * A large directory isn't listed completely, the exact names are looked up instead.
+ * \param cid Directory CID
+ * \param[out] indexPage Index page entry
+ * \throw std::runtime_error when the directory can't be listed
+ * \return True if the directory has an index page
+ */
+bool DirectoryIndex::findIndexPage(const std::string &cid, IPFS::DirectoryEntry &indexPage)
+{
+    std::vector<IPFS::DirectoryEntry> listing;
+    bool isComplete = getListing(cid, 1, listing);
+    for (const char *name : INDEX_PAGES)
+    {
+        for (const IPFS::DirectoryEntry &entry : listing)
+        {
+            if (entry.type != IPFS::ENTRY_DIRECTORY && strcasecmp(entry.name.c_str(), name) == 0)
+            {
+                indexPage = entry;
+                return true;
+            }
+        }
+    }
+    if (isComplete)
+        return false;
+    for (const char *name : INDEX_PAGES)
+    {
+        IPFS::FileStat stat;
+        try
+        {
+            if (ipfs.getFileStat("/ipfs/" + cid + "/" + name, stat) && !stat.isDirectory)
+            {
+                indexPage = IPFS::DirectoryEntry{name, stat.cid, stat.size, IPFS::ENTRY_FILE};
+                return true;
+            }
+        }
+        catch (const std::runtime_error &)
+        {
+            // Not in the directory
+        }
+    }
+    return false;
+}
+
+/**
+ * \brief Create a markdown listing page of a directory without an index page, in the order of the directory.
+ * Only the entries up to the page are listed. Links are relative to the directory, pages link to each other with "?page=<n>".
+ * \param path Path of the directory, shown as title
+ * \param cid Directory CID
+ * \param page Page number (starting at 1)
+ * \throw std::runtime_error when the directory can't be listed
+ * \return Markdown content
+ */
+std::string DirectoryIndex::createListingPage(const std::string &path, const std::string &cid, std::size_t page)
+{
+    page = std::max<std::size_t>(page, 1);
+    std::vector<IPFS::DirectoryEntry> listing;
+    bool isComplete = getListing(cid, page, listing);
+    std::size_t pages = std::max<std::size_t>(1, (listing.size() + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE);
+    if (isComplete)
+        page = std::min(page, pages);
+    std::size_t begin = std::min(listing.size(), (page - 1) * ENTRIES_PER_PAGE);
+    std::size_t end = std::min(listing.size(), page * ENTRIES_PER_PAGE);
+    bool hasNextPage = !isComplete || end < listing.size();
+
+    std::string content = "# Index of " + escapeText(path) + "\n\n";
+    if (isComplete)
+    {
+        content += std::to_string(listing.size()) + (listing.size() == 1 ? " entry" : " entries");
+        if (pages > 1)
+            content += ", page " + std::to_string(page) + " of " + std::to_string(pages);
+    }
+    else
+    {
+        content += "Entries " + std::to_string(begin + 1) + " to " + std::to_string(end) + ", page " + std::to_string(page);
+    }
+    content += "\n\n";
+    if (path.find('/', path.rfind("/ipfs/", 0) == 0 ? 6 : 0) != std::string::npos)
+        content += "- 📁 [Parent directory](<../>)\n";
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        const IPFS::DirectoryEntry &entry = listing[i];
+        if (entry.type == IPFS::ENTRY_DIRECTORY)
+            content += "- 📁 [" + escapeText(entry.name) + "/](<" + entry.name + "/>)\n";
+        else if (entry.type == IPFS::ENTRY_FILE)
+            content += "- 📄 [" + escapeText(entry.name) + "](<" + entry.name + ">) · " + Glib::format_size(entry.size) + "\n";
+        else
+            content += "- 🔗 [" + escapeText(entry.name) + "](<" + entry.name + ">)\n";
+    }
+    if (page > 1 || hasNextPage)
+    {
+        content += "\n";
+        if (page > 1)
+            content += "[« Previous page](?page=" + std::to_string(page - 1) + ")";
+        if (page > 1 && hasNextPage)
+            content += " · ";
+        if (hasNextPage)
+            content += "[Next page »](?page=" + std::to_string(page + 1) + ")";
+        content += "\n";
+    }
+    return content;
+}
+
+/**
+ * \brief Get a directory listing from the cache, or else stream it from the start until enough entries are received.
+ * The fetched entries are cached, a next call continues with a longer listing when needed.
+ * Only a directory is cached: `ls` also lists the blocks of a chunked file (links without a name), or nothing for a single block.
+ * \param cid Directory CID
+ * \param isEnough Tells if the listing has enough entries
+ * \param[out] listing Directory entries
+ * \throw std::runtime_error when the directory can't be listed, or it's not a directory
+ * \return True if the listing is complete
+ */
+bool DirectoryIndex::fetchListing(const std::string &cid, const EnoughCallback &isEnough, std::vector<IPFS::DirectoryEntry> &listing)
+{
+    std::string data;
+    bool isComplete = false;
+    if (cache.get(cid, data) && deserialize(data, listing, isComplete) && (isComplete || isEnough(listing, 0)))
+        return isComplete;
+    CID::Decoded decoded;
+    if (CID::parse(cid, decoded) && decoded.codec == CODEC_RAW)
+        throw std::runtime_error("Not a directory: " + cid);
+    std::vector<IPFS::DirectoryEntry> entries;
+    bool isFile = false;
+    isComplete = true;
+    ipfs.listDirectory("/ipfs/" + cid, [&](const IPFS::DirectoryEntry &entry) {
+        if (entry.name.empty())
+        {
+            isFile = true;
+            return false;
+        }
+        entries.push_back(entry);
+        if (isEnough(entries, entries.size() - 1))
+            isComplete = false;
+        return isComplete;
+    });
+    if (isFile)
+        throw std::runtime_error("Not a directory: " + cid);
+    // An empty listing is also a single block file, it's only cached when the daemon tells it's a directory
+    if (entries.empty())
+    {
+        IPFS::FileStat stat;
+        bool isKnown = ipfs.getFileStat("/ipfs/" + cid, stat);
+        if (isKnown && !stat.isDirectory)
+            throw std::runtime_error("Not a directory: " + cid);
+        if (!isKnown)
+        {
+            listing.clear();
+            return isComplete;
+        }
+    }
+    cache.put(cid, serialize(entries, isComplete));
+    listing.swap(entries);
+    return isComplete;
+}
+
+/**
+ * \brief Find an entry of a directory by name, the listing is fetched until the name is found
+ * \return True if found
+ */
+bool DirectoryIndex::findEntry(const std::string &cid, const std::string &name, IPFS::DirectoryEntry &entry)
+{
+    std::vector<IPFS::DirectoryEntry> listing;
+    fetchListing(
+        cid,
+        [&name](const std::vector<IPFS::DirectoryEntry> &entries, std::size_t first) {
+            return std::any_of(entries.begin() + first, entries.end(), [&name](const IPFS::DirectoryEntry &entry) { return entry.name == name; });
+        },
+        listing);
+    auto it = std::find_if(listing.begin(), listing.end(), [&name](const IPFS::DirectoryEntry &entry) { return entry.name == name; });
+    if (it == listing.end())
+        return false;
+    entry = *it;
+    return true;
+}
+
+/**
+ * \brief Check if an entry is a directory before it's listed, an entry of unknown type is resolved via the daemon
+ * \throw std::runtime_error when the entry can't be resolved
+ */
+bool DirectoryIndex::isDirectory(const IPFS::DirectoryEntry &entry)
+{
+    if (entry.type != IPFS::ENTRY_UNKNOWN)
+        return entry.type == IPFS::ENTRY_DIRECTORY;
+    if (cache.contains(entry.cid))
+        return true;
+    // Without the stat request (remote daemon) the listing is tried
+    IPFS::FileStat stat;
+    return !ipfs.getFileStat("/ipfs/" + entry.cid, stat) || stat.isDirectory;
+}
+
+std::string DirectoryIndex::serialize(const std::vector<IPFS::DirectoryEntry> &listing, bool isComplete)
+{
+    nlohmann::json entries = nlohmann::json::array();
+    for (const IPFS::DirectoryEntry &entry : listing)
+        entries.push_back({entry.name, entry.cid, entry.size, entry.type});
+    return nlohmann::json{{"complete", isComplete}, {"entries", entries}}.dump();
+}
+
+bool DirectoryIndex::deserialize(const std::string &data, std::vector<IPFS::DirectoryEntry> &listing, bool &isComplete)
+{
+    try
+    {
+        listing.clear();
+        nlohmann::json content = nlohmann::json::parse(data);
+        isComplete = content.at("complete").get<bool>();
+        for (const auto &entry : content.at("entries"))
+            listing.push_back(IPFS::DirectoryEntry{entry.at(0).get<std::string>(), entry.at(1).get<std::string>(), entry.at(2).get<uint64_t>(),
+                                                   entry.at(3).get<IPFS::EntryType>()});
+        return true;
+    }
+    catch (const nlohmann::json::exception &)
+    {
+        listing.clear();
+        return false;
+    }
+}
+
+std::string DirectoryIndex::escapeText(const std::string &text)
+{
+    std::string escaped;
+    for (char c : text)
+    {
+        if (std::string("\\`*_[]<>#!|").find(c) != std::string::npos)
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
@@ -0,0 +1,44 @@
+#ifndef DIRECTORY_INDEX_H
+#define DIRECTORY_INDEX_H
+
+#include "content-cache.h"
+#include "ipfs.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * \class DirectoryIndex
+ * \brief Navigation within IPFS directories (sites): directory listings are cached per CID (they are immutable),
+ * so a path within a site is resolved to the CID of the file with cached listings, instead of a round trip
+ * to the IPFS daemon for every page. Also picks the index page of a directory, or creates a listing page (thread-safe).
+ * Listings are streamed and fetched as far as needed (eg. the pages shown), large directories aren't listed at once.
+ */
+class DirectoryIndex
+{
+public:
+    explicit DirectoryIndex(IPFS &ipfs);
+    bool getListing(const std::string &cid, std::size_t pages, std::vector<IPFS::DirectoryEntry> &listing);
+    bool resolve(const std::string &path, IPFS::DirectoryEntry &target);
+    bool findIndexPage(const std::string &cid, IPFS::DirectoryEntry &indexPage);
+    std::string createListingPage(const std::string &path, const std::string &cid, std::size_t page);
+
+private:
+    IPFS &ipfs;
+    ContentCache cache; /*!< Serialized listings (the entries fetched so far), keyed by directory CID */
+
+    /**
+     * \brief Tells if enough of a listing is fetched, the entries from first are not checked before
+     */
+    typedef std::function<bool(const std::vector<IPFS::DirectoryEntry> &listing, std::size_t first)> EnoughCallback;
+
+    bool fetchListing(const std::string &cid, const EnoughCallback &isEnough, std::vector<IPFS::DirectoryEntry> &listing);
+    bool findEntry(const std::string &cid, const std::string &name, IPFS::DirectoryEntry &entry);
+    bool isDirectory(const IPFS::DirectoryEntry &entry);
+    static std::string serialize(const std::vector<IPFS::DirectoryEntry> &listing, bool isComplete);
+    static bool deserialize(const std::string &data, std::vector<IPFS::DirectoryEntry> &listing, bool &isComplete);
+    static std::string escapeText(const std::string &text);
+};
+#endif
@@ -3,13 +3,16 @@
 #include "syntax_extension.h"
 #include "strikethrough.h"
 #include "mainwindow.h"
+#include "content-cache.h"
 #include <gdk/gdkthreads.h>
 #include <gdk/gdkselection.h>
 #include <gtkmm/textiter.h>
 #include <gdkmm/window.h>
+#include <glibmm/checksum.h>
 #include <iostream>
 #include <regex>
 #include <algorithm>
+#include <memory>
 #include <stdexcept>
 
 #define PANGO_SCALE_XXX_LARGE ((double)1.98)
@@ -24,6 +27,15 @@ struct DispatchData
     int charsTruncated;
     // Optional URL formatting
     std::string urlFont;
+    // For recording source positions
+    Draw *draw;
+    int sourceLine;
+    int headingLevel;
+    // For the render cache
+    RenderedDocument *document;
+    ContentCache *cache;
+    // Idle source, removed when the view is destroyed before the call
+    guint sourceId;
 };
 
 Draw::Draw(MainWindow &mainWindow)
@@ -46,8 +58,14 @@ Draw::Draw(MainWindow &mainWindow)
       isOrderedList(false),
       isLink(false),
       hovingOverLink(false),
+      hoveredLink(),
       defaultFont(fontFamily),
-      isUserAction(false)
+      isUserAction(false),
+      userActionCount(0),
+      tailOffset(-1),
+      tailSourceMapSize(0),
+      tailHeadingCount(0),
+      highlighter(*this)
 {
     this->disableEdit();
     set_indent(15);
@@ -74,6 +92,20 @@ Draw::Draw(MainWindow &mainWindow)
     signal_populate_popup().connect(sigc::mem_fun(this, &Draw::populate_popup));
 }
 
+/**
+ * \brief The idle calls that didn't run yet are removed, they would use the destroyed view
+ */
+Draw::~Draw()
+{
+    std::set<guint> sources;
+    {
+        std::lock_guard<std::mutex> lock(this->idleMutex);
+        sources.swap(this->idleSources);
+    }
+    for (guint sourceId : sources)
+        g_source_remove(sourceId);
+}
+
 /**
  * Links can be activated by clicking or touching the screen.
  */
@@ -182,6 +214,18 @@ void Draw::showMessage(const std::string &message, const std::string &detailed_i
     this->insertText(detailed_info);
 }
 
+/**
+ * \brief Show a message about a file that isn't shown as page (eg. a video), with a link to save it to disk
+ * \param message Headliner
+ * \param detailed_info Additional text info
+ * \param url URL of the save link
+ */
+void Draw::showDownloadMessage(const std::string &message, const std::string &detailed_info, const std::string &url)
+{
+    this->showMessage(message, detailed_info + "\n\n");
+    this->insertLink("💾 Save to disk", url, defaultFont.to_string());
+}
+
 /**
  * \brief Draw homepage
  */
@@ -207,17 +251,122 @@ This browser has even a built-in editor. Check it out in the menu: File->New Doc
  * \param root_node Markdown AST tree that will be displayed on screen
  */
 void Draw::processDocument(cmark_node *root_node)
+{
+    this->beginDocument();
+    this->processNodes(root_node, 0);
+    this->endDocument();
+}
+
+/**
+ * \brief Start a new document, which is drawn in parts via appendDocument() (thread-safe)
+ */
+void Draw::beginDocument()
 {
     if (get_editable())
         this->disableEdit();
     this->clearOnThread();
+    this->dispatch((GSourceFunc)beginDocumentIdle, new DispatchData());
+}
+
+/**
+ * \brief Draw the next part of the document, replacing the previous tail part (thread-safe)
+ * \param root_node Markdown AST tree of the part
+ * \param lineOffset Source line of the first line of the part
+ * \param isTail The part is not yet complete, it will be replaced by the next appended part
+ */
+void Draw::appendDocument(cmark_node *root_node, int lineOffset, bool isTail)
+{
+    this->dispatch((GSourceFunc)removeTailIdle, new DispatchData());
+    if (isTail)
+        this->dispatch((GSourceFunc)beginTailIdle, new DispatchData());
+    this->processNodes(root_node, lineOffset);
+}
+
+/**
+ * \brief All parts of the document are drawn (thread-safe)
+ */
+void Draw::endDocument()
+{
+    this->dispatch((GSourceFunc)removeTailIdle, new DispatchData());
+    this->dispatch((GSourceFunc)documentRenderedIdle, new DispatchData());
+}
+
+/**
+ * \brief Render cache key of markdown content: content hash, renderer version and style settings
+ * \param content Markdown content
+ */
+std::string Draw::getRenderCacheKey(const std::string &content) const
+{
+    return Glib::Checksum::compute_checksum(Glib::Checksum::CHECKSUM_SHA256, content) + "/v" +
+           std::to_string(RenderedDocument::VERSION) + "/" + defaultFont.to_string() + "/" + std::to_string(fontSize);
+}
+
+/**
+ * \brief Display a document from the render cache, without parsing and processing the markdown (thread-safe)
+ * \param rendered Serialized rendered document
+ * \return False when the data is invalid, nothing is displayed
+ */
+bool Draw::loadDocument(const std::string &rendered)
+{
+    RenderedDocument *document = new RenderedDocument();
+    if (!document->deserialize(rendered))
+    {
+        delete document;
+        return false;
+    }
+    this->showDocument(document);
+    return true;
+}
+
+/**
+ * \brief Display a rendered document again, eg. from the back/forward cache (thread-safe)
+ */
+void Draw::restoreDocument(const RenderedDocument &document)
+{
+    this->showDocument(new RenderedDocument(document));
+}
 
-    // Loop over AST nodes
+/**
+ * \brief Capture the document currently displayed (not thread-safe)
+ * \param[out] document Rendered document
+ */
+void Draw::captureDocument(RenderedDocument &document)
+{
+    document.capture(buffer, this->sourceMap, this->headingIndex);
+}
+
+/**
+ * \brief Store the document rendered by processDocument() in the render cache, once it's in the buffer (thread-safe)
+ * \param cache Render cache
+ * \param key Key from getRenderCacheKey()
+ */
+void Draw::cacheDocument(ContentCache &cache, const std::string &key)
+{
+    DispatchData *data = new DispatchData();
+    data->text = key;
+    data->cache = &cache;
+    this->dispatch((GSourceFunc)cacheDocumentIdle, data);
+}
+
+/**
+ * \brief Loop over the AST nodes and draw them at the end of the buffer
+ * \param root_node Markdown AST tree
+ * \param lineOffset Added to the source lines of the nodes
+ */
+void Draw::processNodes(cmark_node *root_node, int lineOffset)
+{
     cmark_event_type ev_type;
     cmark_iter *iter = cmark_iter_new(root_node);
     while ((ev_type = cmark_iter_next(iter)) != CMARK_EVENT_DONE)
     {
         cmark_node *cur = cmark_iter_get_node(iter);
+        // Block nodes mark the source position of their start and end in the rendered document
+        bool isBlock = ((cmark_node_get_type(cur) & CMARK_NODE_TYPE_MASK) == CMARK_NODE_TYPE_BLOCK) &&
+                       (cmark_node_get_type(cur) != CMARK_NODE_DOCUMENT);
+        if (isBlock && ev_type == CMARK_EVENT_ENTER)
+            this->recordSourcePosition(lineOffset + cmark_node_get_start_line(cur) - 1);
+        if (ev_type == CMARK_EVENT_ENTER && cmark_node_get_type(cur) == CMARK_NODE_HEADING)
+            this->recordHeading(cmark_node_get_heading_level(cur), HeadingIndex::headingText(cur), lineOffset + cmark_node_get_start_line(cur) - 1);
         try
         {
             processNode(cur, ev_type);
@@ -227,7 +376,10 @@ void Draw::processDocument(cmark_node *root_node)
             std::cerr << "ERROR: Processing node failed, with message: " << error.what() << std::endl;
             // Continue nevertheless
         }
+        if (isBlock && (ev_type == CMARK_EVENT_EXIT || cmark_node_first_child(cur) == nullptr))
+            this->recordSourcePosition(lineOffset + cmark_node_get_end_line(cur));
     }
+    cmark_iter_free(iter);
 }
 
 void Draw::setViewSourceMenuItem(bool isEnabled)
@@ -235,6 +387,45 @@ void Draw::setViewSourceMenuItem(bool isEnabled)
     this->addViewSourceMenuItem = isEnabled;
 }
 
+/**
+ * \brief Source line to rendered offset mapping of the last processed document (not thread-safe)
+ */
+const SourceMap &Draw::getSourceMap() const
+{
+    return this->sourceMap;
+}
+
+/**
+ * \brief Headings of the last processed document (not thread-safe)
+ */
+const HeadingIndex &Draw::getHeadingIndex() const
+{
+    return this->headingIndex;
+}
+
+/**
+ * \brief Get the link URLs in the visible part of the text view (in order, without duplicates)
+ */
+std::vector<std::string> Draw::getVisibleLinks()
+{
+    std::vector<std::string> links;
+    Gdk::Rectangle rect;
+    get_visible_rect(rect);
+    Gtk::TextBuffer::iterator iter, end;
+    get_iter_at_location(iter, rect.get_x(), rect.get_y());
+    get_iter_at_location(end, rect.get_x() + rect.get_width(), rect.get_y() + rect.get_height());
+    do
+    {
+        for (auto &tag : iter.get_tags())
+        {
+            char *url = static_cast<char *>(tag->get_data("url"));
+            if (url != 0 && (strlen(url) > 0) && std::find(links.begin(), links.end(), url) == links.end())
+                links.push_back(url);
+        }
+    } while (iter.forward_to_tag_toggle(Glib::RefPtr<Gtk::TextTag>()) && iter < end);
+    return links;
+}
+
 /**
  * \brief Prepare for new document
  */
@@ -263,9 +454,8 @@ std::string Draw::getText()
 void Draw::setText(const std::string &content)
 {
     DispatchData *data = new DispatchData();
-    data->buffer = buffer;
     data->text = content;
-    gdk_threads_add_idle((GSourceFunc)insertPlainTextIdle, data);
+    this->dispatch((GSourceFunc)insertPlainTextIdle, data);
 }
 
 /**
@@ -278,56 +468,38 @@ void Draw::clearText()
 }
 
 /**
- * Undo action (Ctrl + Z)
+ * Undo action (Ctrl + Z), all changes of the last user action are undone at once
  */
 void Draw::undo()
 {
     if (get_editable() && (undoPool.size() > 0))
     {
-        auto undoAction = undoPool.at(undoPool.size() - 1);
-        auto buffer = get_buffer();
-        undoPool.pop_back();
-        if (undoAction.isInsert)
-        {
-            Gtk::TextBuffer::iterator startIter = buffer->get_iter_at_offset(undoAction.beginOffset);
-            Gtk::TextBuffer::iterator endIter = buffer->get_iter_at_offset(undoAction.endOffset);
-            buffer->erase(startIter, endIter);
-            buffer->place_cursor(buffer->get_iter_at_offset(undoAction.beginOffset));
-        }
-        else
+        int userActionId = undoPool.back().userActionId;
+        while (undoPool.size() > 0 && undoPool.back().userActionId == userActionId)
         {
-            Gtk::TextBuffer::iterator startIter = buffer->get_iter_at_offset(undoAction.beginOffset);
-            buffer->insert(startIter, undoAction.text);
-            buffer->place_cursor(buffer->get_iter_at_offset(undoAction.endOffset));
+            auto undoAction = undoPool.back();
+            undoPool.pop_back();
+            applyUndoRedo(undoAction, true);
+            redoPool.push_back(undoAction);
         }
-        redoPool.push_back(undoAction);
     }
 }
 
 /**
- * Redo action (Ctrl + Y)
+ * Redo action (Ctrl + Y), all changes of the next user action are redone at once
  */
 void Draw::redo()
 {
     if (get_editable() && (redoPool.size() > 0))
     {
-        auto redoAction = redoPool.at(redoPool.size() - 1);
-        auto buffer = get_buffer();
-        redoPool.pop_back();
-        if (redoAction.isInsert)
-        {
-            Gtk::TextBuffer::iterator startIter = buffer->get_iter_at_offset(redoAction.beginOffset);
-            buffer->insert(startIter, redoAction.text);
-            buffer->place_cursor(buffer->get_iter_at_offset(redoAction.endOffset));
-        }
-        else
+        int userActionId = redoPool.back().userActionId;
+        while (redoPool.size() > 0 && redoPool.back().userActionId == userActionId)
         {
-            Gtk::TextBuffer::iterator startIter = buffer->get_iter_at_offset(redoAction.beginOffset);
-            Gtk::TextBuffer::iterator endIter = buffer->get_iter_at_offset(redoAction.endOffset);
-            buffer->erase(startIter, endIter);
-            buffer->place_cursor(buffer->get_iter_at_offset(redoAction.beginOffset));
+            auto redoAction = redoPool.back();
+            redoPool.pop_back();
+            applyUndoRedo(redoAction, false);
+            undoPool.push_back(redoAction);
         }
-        undoPool.push_back(redoAction);
     }
 }
 
@@ -886,6 +1058,7 @@ void Draw::make_highlight()
 void Draw::begin_user_action()
 {
     this->isUserAction = true;
+    this->userActionCount++;
 }
 
 void Draw::end_user_action()
@@ -905,6 +1078,7 @@ void Draw::on_insert(const Gtk::TextBuffer::iterator &pos, const Glib::ustring &
         undoData.beginOffset = pos.get_offset();
         undoData.endOffset = pos.get_offset() + text.size();
         undoData.text = text;
+        undoData.userActionId = this->userActionCount;
         this->undoPool.push_back(undoData);
         this->redoPool.clear();
     }
@@ -923,6 +1097,7 @@ void Draw::on_delete(const Gtk::TextBuffer::iterator &range_start, const Gtk::Te
         undoData.beginOffset = range_start.get_offset();
         undoData.endOffset = range_end.get_offset();
         undoData.text = text;
+        undoData.userActionId = this->userActionCount;
         this->undoPool.push_back(undoData);
     }
 }
@@ -940,6 +1115,8 @@ void Draw::enableEdit()
     this->endUserActionSignalHandler = buffer->signal_end_user_action().connect(sigc::mem_fun(this, &Draw::end_user_action), false);
     this->insertTextSignalHandler = buffer->signal_insert().connect(sigc::mem_fun(this, &Draw::on_insert), false);
     this->deleteTextSignalHandler = buffer->signal_erase().connect(sigc::mem_fun(this, &Draw::on_delete), false);
+    // Highlight the markdown source
+    this->highlighter.enable();
 }
 
 void Draw::disableEdit()
@@ -951,6 +1128,31 @@ void Draw::disableEdit()
     this->endUserActionSignalHandler.disconnect();
     this->insertTextSignalHandler.disconnect();
     this->deleteTextSignalHandler.disconnect();
+    this->highlighter.disable();
+}
+
+/**
+ * \brief Apply a single undo/redo change to the buffer
+ * \param action Recorded change
+ * \param revert True when undoing the change, false when redoing it
+ */
+void Draw::applyUndoRedo(const UndoRedoData &action, bool revert)
+{
+    auto buffer = get_buffer();
+    // Undoing an insert or redoing a delete both remove the text again
+    if (action.isInsert == revert)
+    {
+        Gtk::TextBuffer::iterator startIter = buffer->get_iter_at_offset(action.beginOffset);
+        Gtk::TextBuffer::iterator endIter = buffer->get_iter_at_offset(action.endOffset);
+        buffer->erase(startIter, endIter);
+        buffer->place_cursor(buffer->get_iter_at_offset(action.beginOffset));
+    }
+    else
+    {
+        Gtk::TextBuffer::iterator startIter = buffer->get_iter_at_offset(action.beginOffset);
+        buffer->insert(startIter, action.text);
+        buffer->place_cursor(buffer->get_iter_at_offset(action.endOffset));
+    }
 }
 
 /**
@@ -965,7 +1167,7 @@ void Draw::followLink(Gtk::TextBuffer::iterator &iter)
         if (url != 0 && (strlen(url) > 0))
         {
             // Get the URL
-            mainWindow.doRequest(url, true);
+            mainWindow.doRequest(mainWindow.resolveLink(url), true);
             break;
         }
     }
@@ -1380,11 +1582,10 @@ void Draw::insertText(std::string text, const std::string &url, CodeTypeEnum cod
 void Draw::insertLink(const std::string &text, const std::string &url, const std::string &urlFont)
 {
     DispatchData *data = new DispatchData();
-    data->buffer = buffer;
     data->text = text;
     data->url = url;
     data->urlFont = urlFont;
-    gdk_threads_add_idle((GSourceFunc)insertLinkIdle, data);
+    this->dispatch((GSourceFunc)insertLinkIdle, data);
 }
 
 /**
@@ -1393,9 +1594,47 @@ void Draw::insertLink(const std::string &text, const std::string &url, const std
 void Draw::truncateText(int charsTruncated)
 {
     DispatchData *data = new DispatchData();
-    data->buffer = buffer;
     data->charsTruncated = charsTruncated;
-    gdk_threads_add_idle((GSourceFunc)truncateTextIdle, data);
+    this->dispatch((GSourceFunc)truncateTextIdle, data);
+}
+
+/**
+ * Record the current end of the buffer as the rendered position of a source line - thread safe
+ * \param line Zero-based source line
+ */
+void Draw::recordSourcePosition(int line)
+{
+    DispatchData *data = new DispatchData();
+    data->sourceLine = line;
+    this->dispatch((GSourceFunc)sourcePositionIdle, data);
+}
+
+/**
+ * Record a heading at the current end of the buffer - thread safe
+ * \param level Heading level
+ * \param text Plain heading text
+ * \param line Zero-based source line
+ */
+void Draw::recordHeading(int level, const std::string &text, int line)
+{
+    DispatchData *data = new DispatchData();
+    data->text = text;
+    data->sourceLine = line;
+    data->headingLevel = level;
+    this->dispatch((GSourceFunc)headingIdle, data);
+}
+
+/**
+ * Replace the buffer by a rendered document - thread safe
+ * \param document Rendered document, ownership is transferred
+ */
+void Draw::showDocument(RenderedDocument *document)
+{
+    this->beginDocument();
+    DispatchData *data = new DispatchData();
+    data->document = document;
+    this->dispatch((GSourceFunc)loadDocumentIdle, data);
+    this->dispatch((GSourceFunc)documentRenderedIdle, new DispatchData());
 }
 
 /**
@@ -1431,9 +1670,8 @@ void Draw::encodeText(std::string &string)
 void Draw::insertMarkupTextOnThread(const std::string &text)
 {
     DispatchData *data = new DispatchData();
-    data->buffer = buffer;
     data->text = text;
-    gdk_threads_add_idle((GSourceFunc)insertTextIdle, data);
+    this->dispatch((GSourceFunc)insertTextIdle, data);
 }
 
 /**
@@ -1441,7 +1679,21 @@ void Draw::insertMarkupTextOnThread(const std::string &text)
  */
 void Draw::clearOnThread()
 {
-    gdk_threads_add_idle((GSourceFunc)clearBufferIdle, buffer);
+    this->dispatch((GSourceFunc)clearBufferIdle, new DispatchData());
+}
+
+/**
+ * Queue a call on the GUI thread (on idle), the data is deleted after the call - thread safe
+ * \param function Idle call function
+ * \param data Data of the call, ownership is transferred
+ */
+void Draw::dispatch(GSourceFunc function, DispatchData *data)
+{
+    data->buffer = buffer;
+    data->draw = this;
+    std::lock_guard<std::mutex> lock(this->idleMutex);
+    data->sourceId = gdk_threads_add_idle_full(G_PRIORITY_DEFAULT_IDLE, function, data, (GDestroyNotify)idleFinished);
+    this->idleSources.insert(data->sourceId);
 }
 
 /**
@@ -1453,6 +1705,7 @@ void Draw::changeCursor(int x, int y)
 {
     Gtk::TextBuffer::iterator iter;
     bool hovering = false;
+    std::string link;
 
     get_iter_at_location(iter, x, y);
     auto tags = iter.get_tags();
@@ -1463,10 +1716,17 @@ void Draw::changeCursor(int x, int y)
         {
             // Link
             hovering = true;
+            link = url;
             break;
         }
     }
 
+    if (link != hoveredLink)
+    {
+        hoveredLink = link;
+        link_hovered.emit(hoveredLink);
+    }
+
     if (hovering != hovingOverLink)
     {
         hovingOverLink = hovering;
@@ -1486,7 +1746,6 @@ gboolean Draw::insertTextIdle(struct DispatchData *data)
     GtkTextIter end_iter;
     gtk_text_buffer_get_end_iter(data->buffer, &end_iter);
     gtk_text_buffer_insert_markup(data->buffer, &end_iter, data->text.c_str(), -1);
-    g_free(data);
     return FALSE;
 }
 
@@ -1496,7 +1755,6 @@ gboolean Draw::insertTextIdle(struct DispatchData *data)
 gboolean Draw::insertPlainTextIdle(struct DispatchData *data)
 {
     gtk_text_buffer_set_text(data->buffer, data->text.c_str(), -1);
-    g_free(data);
     return FALSE;
 }
 
@@ -1515,7 +1773,6 @@ gboolean Draw::insertLinkIdle(struct DispatchData *data)
                                      NULL);
     g_object_set_data(G_OBJECT(tag), "url", g_strdup(data->url.c_str()));
     gtk_text_buffer_insert_with_tags(data->buffer, &end_iter, data->text.c_str(), -1, tag, NULL);
-    g_free(data);
     return FALSE;
 }
 
@@ -1529,22 +1786,126 @@ gboolean Draw::truncateTextIdle(struct DispatchData *data)
     GtkTextIter begin_iter = end_iter;
     gtk_text_iter_backward_chars(&begin_iter, data->charsTruncated);
     gtk_text_buffer_delete(data->buffer, &begin_iter, &end_iter);
-    g_free(data);
     return FALSE;
 }
 
 /**
  * clearOnThread Text on Idle Call function
  */
-gboolean Draw::clearBufferIdle(GtkTextBuffer *textBuffer)
+gboolean Draw::clearBufferIdle(struct DispatchData *data)
 {
     GtkTextIter start_iter, end_iter;
-    gtk_text_buffer_get_start_iter(textBuffer, &start_iter);
-    gtk_text_buffer_get_end_iter(textBuffer, &end_iter);
-    gtk_text_buffer_delete(textBuffer, &start_iter, &end_iter);
+    gtk_text_buffer_get_start_iter(data->buffer, &start_iter);
+    gtk_text_buffer_get_end_iter(data->buffer, &end_iter);
+    gtk_text_buffer_delete(data->buffer, &start_iter, &end_iter);
     return FALSE;
 }
 
+/**
+ * Add source map entry on Idle call function, the buffer end is the position of all text dispatched before
+ */
+gboolean Draw::sourcePositionIdle(struct DispatchData *data)
+{
+    data->draw->sourceMap.add(data->sourceLine, gtk_text_buffer_get_char_count(data->buffer));
+    return FALSE;
+}
+
+/**
+ * Add heading on Idle call function
+ */
+gboolean Draw::headingIdle(struct DispatchData *data)
+{
+    data->draw->headingIndex.add(data->headingLevel, data->text, gtk_text_buffer_get_char_count(data->buffer), data->sourceLine);
+    return FALSE;
+}
+
+/**
+ * Start of a new document on Idle call function, clear the indexes
+ */
+gboolean Draw::beginDocumentIdle(struct DispatchData *data)
+{
+    Draw *draw = data->draw;
+    draw->sourceMap.clear();
+    draw->headingIndex.clear();
+    draw->tailOffset = -1;
+    return FALSE;
+}
+
+/**
+ * Start of the (incomplete) tail part of the document on Idle call function
+ */
+gboolean Draw::beginTailIdle(struct DispatchData *data)
+{
+    Draw *draw = data->draw;
+    draw->tailOffset = gtk_text_buffer_get_char_count(draw->buffer);
+    draw->tailSourceMapSize = draw->sourceMap.getLines().size();
+    draw->tailHeadingCount = draw->headingIndex.getHeadings().size();
+    return FALSE;
+}
+
+/**
+ * Remove the tail part of the document (if any) on Idle call function
+ */
+gboolean Draw::removeTailIdle(struct DispatchData *data)
+{
+    Draw *draw = data->draw;
+    if (draw->tailOffset >= 0)
+    {
+        GtkTextIter start_iter, end_iter;
+        gtk_text_buffer_get_iter_at_offset(draw->buffer, &start_iter, draw->tailOffset);
+        gtk_text_buffer_get_end_iter(draw->buffer, &end_iter);
+        gtk_text_buffer_delete(draw->buffer, &start_iter, &end_iter);
+        draw->sourceMap.truncate(draw->tailSourceMapSize);
+        draw->headingIndex.truncate(draw->tailHeadingCount);
+        draw->tailOffset = -1;
+    }
+    return FALSE;
+}
+
+/**
+ * Document rendered on Idle call function
+ */
+gboolean Draw::documentRenderedIdle(struct DispatchData *data)
+{
+    Draw *draw = data->draw;
+    draw->document_rendered.emit();
+    return FALSE;
+}
+
+/**
+ * Restore a cached document on Idle call function
+ */
+gboolean Draw::loadDocumentIdle(struct DispatchData *data)
+{
+    data->document->apply(data->buffer, data->draw->sourceMap, data->draw->headingIndex);
+    return FALSE;
+}
+
+/**
+ * Capture the rendered document into the render cache on Idle call function
+ */
+gboolean Draw::cacheDocumentIdle(struct DispatchData *data)
+{
+    // Only the capture needs the buffer, the serialization and the disk write are done by the cache writer thread
+    auto document = std::make_shared<RenderedDocument>();
+    document->capture(data->buffer, data->draw->sourceMap, data->draw->headingIndex);
+    data->cache->putLater(data->text, [document] { return document->serialize(); });
+    return FALSE;
+}
+
+/**
+ * Idle call is done or removed, delete its data
+ */
+void Draw::idleFinished(struct DispatchData *data)
+{
+    {
+        std::lock_guard<std::mutex> lock(data->draw->idleMutex);
+        data->draw->idleSources.erase(data->sourceId);
+    }
+    delete data->document;
+    delete data;
+}
+
 /**
  * Convert number to roman numerals
  */
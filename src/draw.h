@@ -1,13 +1,22 @@
 #ifndef DRAW_H
 #define DRAW_H
 
+#include "syntax-highlighter.h"
+#include "source-map.h"
+#include "heading-index.h"
+#include "rendered-document.h"
+
 #include <gtkmm/textview.h>
 #include <gtkmm/menu.h>
 #include <gdkmm/cursor.h>
 #include <pangomm/layout.h>
 #include <cmark-gfm.h>
+#include <mutex>
+#include <set>
+#include <vector>
 
 class MainWindow;
+class ContentCache;
 
 /**
  * \struct DispatchData
@@ -25,6 +34,7 @@ struct UndoRedoData
     std::string text;
     int beginOffset;
     int endOffset;
+    int userActionId; /*!< Changes with the same user action ID are undone/redone as a single step */
 };
 
 /**
@@ -35,6 +45,8 @@ class Draw : public Gtk::TextView
 {
 public:
     sigc::signal<void> source_code;
+    sigc::signal<void> document_rendered; /*!< Emitted when all the content of processDocument() is in the buffer */
+    sigc::signal<void, std::string> link_hovered; /*!< Emitted with the URL when the pointer moves onto a link (empty URL when leaving) */
     enum CodeTypeEnum
     {
         NONE = 0,
@@ -43,10 +55,23 @@ public:
     };
 
     explicit Draw(MainWindow &mainWindow);
+    ~Draw() override;
     void showMessage(const std::string &message, const std::string &detailed_info = "");
+    void showDownloadMessage(const std::string &message, const std::string &detailed_info, const std::string &url);
     void showStartPage();
     void processDocument(cmark_node *root_node);
+    void beginDocument();
+    void appendDocument(cmark_node *root_node, int lineOffset, bool isTail);
+    void endDocument();
+    std::string getRenderCacheKey(const std::string &content) const;
+    bool loadDocument(const std::string &rendered);
+    void restoreDocument(const RenderedDocument &document);
+    void captureDocument(RenderedDocument &document);
+    void cacheDocument(ContentCache &cache, const std::string &key);
     void setViewSourceMenuItem(bool isEnabled);
+    const SourceMap &getSourceMap() const;
+    const HeadingIndex &getHeadingIndex() const;
+    std::vector<std::string> getVisibleLinks();
     void newDocument();
     std::string getText();
     void setText(const std::string &content);
@@ -109,8 +134,18 @@ private:
     Glib::RefPtr<Gdk::Cursor> linkCursor;
     Glib::RefPtr<Gdk::Cursor> textCursor;
     bool hovingOverLink;
+    std::string hoveredLink;
     Pango::FontDescription defaultFont;
     bool isUserAction;
+    int userActionCount;
+    int tailOffset;                /*!< Buffer offset of the incomplete tail part of the document, -1 if none (GUI thread) */
+    std::size_t tailSourceMapSize; /*!< Source map entries before the tail part */
+    std::size_t tailHeadingCount;  /*!< Headings before the tail part */
+    SyntaxHighlighter highlighter;
+    SourceMap sourceMap;
+    HeadingIndex headingIndex;
+    std::mutex idleMutex;        /*!< Guards the pending idle sources, which are queued by the request thread */
+    std::set<guint> idleSources; /*!< Pending idle calls, removed when the view is destroyed */
 
     std::vector<UndoRedoData> undoPool;
     std::vector<UndoRedoData> redoPool;
@@ -121,22 +156,37 @@ private:
 
     void enableEdit();
     void disableEdit();
+    void applyUndoRedo(const UndoRedoData &action, bool revert);
     void followLink(Gtk::TextBuffer::iterator &iter);
+    void processNodes(cmark_node *root_node, int lineOffset);
     void processNode(cmark_node *node, cmark_event_type ev_type);
     // Helper functions for inserting text (thread-safe)
     void insertText(std::string text, const std::string &url = "", CodeTypeEnum codeType = CodeTypeEnum::NONE);
     void insertLink(const std::string &text, const std::string &url, const std::string &urlFont = "");
     void truncateText(int charsTruncated);
+    void recordSourcePosition(int line);
+    void recordHeading(int level, const std::string &text, int line);
+    void showDocument(RenderedDocument *document);
     void encodeText(std::string &string);
 
     void insertMarkupTextOnThread(const std::string &text);
     void clearOnThread();
+    void dispatch(GSourceFunc function, DispatchData *data);
     void changeCursor(int x, int y);
     static gboolean insertTextIdle(struct DispatchData *data);
     static gboolean insertPlainTextIdle(struct DispatchData *data);
     static gboolean insertLinkIdle(struct DispatchData *data);
     static gboolean truncateTextIdle(struct DispatchData *data);
-    static gboolean clearBufferIdle(GtkTextBuffer *textBuffer);
+    static gboolean clearBufferIdle(struct DispatchData *data);
+    static gboolean sourcePositionIdle(struct DispatchData *data);
+    static gboolean headingIdle(struct DispatchData *data);
+    static gboolean beginDocumentIdle(struct DispatchData *data);
+    static gboolean beginTailIdle(struct DispatchData *data);
+    static gboolean removeTailIdle(struct DispatchData *data);
+    static gboolean documentRenderedIdle(struct DispatchData *data);
+    static gboolean loadDocumentIdle(struct DispatchData *data);
+    static gboolean cacheDocumentIdle(struct DispatchData *data);
+    static void idleFinished(struct DispatchData *data);
     static std::string const intToRoman(int num);
 };
 
@@ -0,0 +1,196 @@
+#include "fetch-coalescer.h"
+#include "ipfs.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // A transfer without waiters is kept for a moment, the same page is often requested again right away (eg. repeated clicks)
+    const std::chrono::milliseconds ABANDON_GRACE_PERIOD(1000);
+    // A waiter checks its own sink while no data arrives (eg. an aborted prefetch leaves a stalled transfer)
+    const std::chrono::milliseconds ABORT_CHECK_INTERVAL(250);
+
+    std::runtime_error tooLargeError(const FetchSink &sink)
+    {
+        return std::runtime_error("File is too large, the maximum size is " + std::to_string(sink.getMaxSize() / (1024 * 1024)) + " MB");
+    }
+} // namespace
+
+FetchCoalescer::FetchCoalescer(IPFS &ipfs)
+    : ipfs(ipfs),
+      runningTransfers(0)
+{
+}
+
+/**
+ * \brief Abort all transfers and wait until their threads are finished
+ */
+FetchCoalescer::~FetchCoalescer()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (auto &entry : this->transfers)
+    {
+        std::lock_guard<std::mutex> transferLock(entry.second->mutex);
+        entry.second->isAborted = true;
+        if (entry.second->sink)
+            entry.second->sink->abort();
+    }
+    this->transferEnded.wait(lock, [this] { return this->runningTransfers == 0; });
+}
+
+/**
+ * \brief Fetch file, joins the in-flight transfer of the same key when there is one (blocking)
+ * \param key Coalescing key (eg. the normalized CID path)
+ * \param path IPFS path
+ * \param sink Destination, the max. size of the first waiter's sink applies to the shared transfer
+ * \param cacheState If all blocks are local (eg. from a pre-flight stat), passed to IPFS::fetch of a new transfer
+ * \throw std::runtime_error when the (shared) transfer failed
+ */
+void FetchCoalescer::fetch(const std::string &key, const std::string &path, FetchSink &sink, FetchTimeoutPolicy::CacheState cacheState)
+{
+    std::shared_ptr<Transfer> transfer;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->transfers.find(key);
+        if (it != this->transfers.end())
+        {
+            std::lock_guard<std::mutex> transferLock(it->second->mutex);
+            if (!it->second->isAborted)
+            {
+                transfer = it->second;
+                ++transfer->waiters;
+            }
+        }
+        if (!transfer)
+        {
+            transfer = std::make_shared<Transfer>();
+            transfer->totalSize = 0;
+            transfer->isDone = false;
+            transfer->isAborted = false;
+            transfer->waiters = 1;
+            transfer->sink = nullptr;
+            this->transfers[key] = transfer;
+            ++this->runningTransfers;
+            std::thread(&FetchCoalescer::runTransfer, this, key, path, sink.getMaxSize(), cacheState, transfer).detach();
+        }
+    }
+    receive(*transfer, sink);
+}
+
+/**
+ * \brief Run the shared transfer (in its own thread)
+ */
+void FetchCoalescer::runTransfer(const std::string &key, const std::string &path, std::size_t maxSize, FetchTimeoutPolicy::CacheState cacheState,
+                                 std::shared_ptr<Transfer> transfer)
+{
+    FetchSink sink(transfer->content, maxSize, [transfer](std::size_t, std::size_t total) {
+        std::lock_guard<std::mutex> lock(transfer->mutex);
+        transfer->totalSize = total;
+        if (!transfer->content.empty())
+        {
+            std::string chunk;
+            chunk.swap(transfer->content);
+            // The first chunk can hold the buffer reserved for the total size
+            if (chunk.capacity() > 2 * chunk.size())
+                chunk.shrink_to_fit();
+            transfer->chunks.push_back(std::make_shared<const std::string>(std::move(chunk)));
+        }
+        transfer->changed.notify_all();
+    });
+    sink.setBufferMutex(transfer->mutex);
+    // Checked while no data arrives as well, a stalled transfer is the usual reason why all waiters left
+    sink.setAbortCheck([transfer] {
+        std::lock_guard<std::mutex> lock(transfer->mutex);
+        if (transfer->waiters == 0 && std::chrono::steady_clock::now() - transfer->abandoned >= ABANDON_GRACE_PERIOD)
+            transfer->isAborted = true;
+        return transfer->isAborted;
+    });
+    {
+        std::lock_guard<std::mutex> lock(transfer->mutex);
+        transfer->sink = &sink;
+    }
+    std::exception_ptr error;
+    try
+    {
+        this->ipfs.fetch(path, sink, cacheState);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard<std::mutex> lock(transfer->mutex);
+        transfer->sink = nullptr;
+        transfer->error = error;
+        transfer->isDone = true;
+        transfer->changed.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->transfers.find(key);
+    if (it != this->transfers.end() && it->second == transfer)
+        this->transfers.erase(it);
+    --this->runningTransfers;
+    this->transferEnded.notify_all();
+}
+
+/**
+ * \brief Pass the data of the transfer into the sink while it arrives, until the transfer is done
+ */
+void FetchCoalescer::receive(Transfer &transfer, FetchSink &sink)
+{
+    // Leaving also happens on errors and thread cancellation
+    struct Leave
+    {
+        Transfer &transfer;
+        ~Leave()
+        {
+            std::lock_guard<std::mutex> lock(transfer.mutex);
+            if (--transfer.waiters == 0)
+                transfer.abandoned = std::chrono::steady_clock::now();
+        }
+    } leave{transfer};
+
+    std::size_t received = 0;
+    bool isSizeSet = false;
+    std::unique_lock<std::mutex> lock(transfer.mutex);
+    while (true)
+    {
+        while (!transfer.changed.wait_for(lock, ABORT_CHECK_INTERVAL, [&] {
+            return transfer.isDone || transfer.chunks.size() > received || (!isSizeSet && transfer.totalSize > 0);
+        }))
+        {
+            if (sink.checkAbort())
+                throw std::runtime_error("Transfer is aborted");
+        }
+        std::size_t totalSize = transfer.totalSize;
+        // The chunks are immutable, they're appended without holding the lock (and without copying them first)
+        std::vector<std::shared_ptr<const std::string>> chunks(transfer.chunks.begin() + received, transfer.chunks.end());
+        received = transfer.chunks.size();
+        bool isDone = transfer.isDone;
+        lock.unlock();
+        // The sink's progress callback is called without holding the lock
+        if (!isSizeSet && totalSize > 0)
+        {
+            isSizeSet = true;
+            if (!sink.setTotalSize(totalSize))
+                throw tooLargeError(sink);
+        }
+        for (const std::shared_ptr<const std::string> &chunk : chunks)
+        {
+            if (!sink.append(chunk->data(), chunk->size()))
+            {
+                // The waiter's own sink is aborted, the shared transfer continues
+                if (sink.isAborted())
+                    throw std::runtime_error("Transfer is aborted");
+                throw tooLargeError(sink);
+            }
+        }
+        if (isDone)
+            break;
+        lock.lock();
+    }
+    // Done is final, the error isn't modified anymore
+    if (transfer.error)
+        std::rethrow_exception(transfer.error);
+}
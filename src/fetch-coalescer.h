@@ -0,0 +1,62 @@
+#ifndef FETCH_COALESCER_H
+#define FETCH_COALESCER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "fetch-sink.h"
+#include "fetch-timeout-policy.h"
+
+class IPFS;
+
+/**
+ * \class FetchCoalescer
+ * \brief Single-flight layer in front of IPFS::fetch (thread-safe).
+ * Concurrent requests for the same key share one transfer, which runs in its own thread.
+ * Each waiter receives the data in its own sink while it arrives. A waiter can leave (eg. thread cancellation)
+ * without aborting the transfer, only when no waiter is left for a moment the transfer is aborted (also when it's stalled).
+ */
+class FetchCoalescer
+{
+public:
+    explicit FetchCoalescer(IPFS &ipfs);
+    ~FetchCoalescer();
+    void fetch(const std::string &key, const std::string &path, FetchSink &sink,
+               FetchTimeoutPolicy::CacheState cacheState = FetchTimeoutPolicy::CACHE_UNKNOWN);
+
+private:
+    /**
+     * \struct Transfer
+     * \brief Shared in-flight transfer, all members are guarded by the mutex
+     */
+    struct Transfer
+    {
+        std::mutex mutex;
+        std::condition_variable changed; /*!< Data received or transfer done */
+        std::string content;             /*!< Buffer of the transfer's sink, the data is moved into the chunks */
+        std::vector<std::shared_ptr<const std::string>> chunks; /*!< Received data, shared by the waiters */
+        std::size_t totalSize;
+        bool isDone;
+        bool isAborted;
+        std::exception_ptr error;
+        std::size_t waiters;
+        std::chrono::steady_clock::time_point abandoned; /*!< Time the last waiter left */
+        FetchSink *sink;                                 /*!< Sink of the running transfer */
+    };
+
+    IPFS &ipfs;
+    std::mutex mutex;
+    std::condition_variable transferEnded;
+    std::map<std::string, std::shared_ptr<Transfer>> transfers; /*!< In-flight transfers by key */
+    std::size_t runningTransfers;
+
+    void runTransfer(const std::string &key, const std::string &path, std::size_t maxSize, FetchTimeoutPolicy::CacheState cacheState,
+                     std::shared_ptr<Transfer> transfer);
+    static void receive(Transfer &transfer, FetchSink &sink);
+};
+#endif
@@ -0,0 +1,168 @@
+#include "fetch-sink.h"
+
+/**
+ * \brief Create sink, the buffer is cleared
+ * \param buffer Destination buffer
+ * \param maxSize Max. number of bytes, 0 is unlimited
+ * \param progress Optional progress callback, called for every received chunk (on the fetching thread)
+ */
+FetchSink::FetchSink(std::string &buffer, std::size_t maxSize, const ProgressCallback &progress)
+    : buffer(buffer),
+      maxSize(maxSize),
+      totalSize(0),
+      tooLarge(false),
+      aborted(false),
+      bufferMutex(nullptr),
+      stream(nullptr),
+      received(0),
+      dataReceived(false),
+      progress(progress)
+{
+    this->buffer.clear();
+}
+
+/**
+ * \brief Set the expected size (when known upfront), the buffer is allocated at once
+ * \return False when the size exceeds the maximum
+ */
+bool FetchSink::setTotalSize(std::size_t totalSize)
+{
+    this->totalSize = totalSize;
+    if (this->maxSize > 0 && totalSize > this->maxSize)
+    {
+        this->tooLarge = true;
+        return false;
+    }
+    if (this->stream)
+        return true;
+    std::unique_lock<std::mutex> lock;
+    if (this->bufferMutex)
+        lock = std::unique_lock<std::mutex>(*this->bufferMutex);
+    this->buffer.reserve(totalSize);
+    return true;
+}
+
+/**
+ * \brief Append received data
+ * \return False when the maximum size is exceeded (the data is dropped)
+ */
+bool FetchSink::append(const char *data, std::size_t size)
+{
+    if (this->tooLarge || this->aborted)
+        return false;
+    if (!this->dataReceived)
+    {
+        this->firstDataTime = std::chrono::steady_clock::now();
+        this->dataReceived = true;
+    }
+    if (this->maxSize > 0 && this->received + size > this->maxSize)
+    {
+        this->tooLarge = true;
+        return false;
+    }
+    if (this->stream)
+    {
+        // A write error (eg. disk full) aborts the transfer
+        if (!this->stream->write(data, static_cast<std::streamsize>(size)))
+        {
+            this->aborted = true;
+            return false;
+        }
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock;
+        if (this->bufferMutex)
+            lock = std::unique_lock<std::mutex>(*this->bufferMutex);
+        this->buffer.append(data, size);
+    }
+    this->received += size;
+    if (this->progress)
+        this->progress(this->received, this->totalSize);
+    return true;
+}
+
+/**
+ * \brief Set the mutex that is locked while the buffer is modified, when the buffer is read by other threads.
+ * A reader may also take the data out of the buffer, the max. size applies to all received data.
+ */
+void FetchSink::setBufferMutex(std::mutex &bufferMutex)
+{
+    this->bufferMutex = &bufferMutex;
+}
+
+/**
+ * \brief Write the received data to a stream (eg. a file) instead of the buffer, large files aren't kept in memory
+ */
+void FetchSink::setStream(std::ostream &stream)
+{
+    this->stream = &stream;
+}
+
+/**
+ * \brief Set a condition that aborts the transfer, it's evaluated by checkAbort()
+ */
+void FetchSink::setAbortCheck(const AbortCheck &abortCheck)
+{
+    this->abortCheck = abortCheck;
+}
+
+/**
+ * \brief Stop receiving (thread-safe), the next received data is refused and the transfer is aborted
+ */
+void FetchSink::abort()
+{
+    this->aborted = true;
+}
+
+/**
+ * \brief Evaluate the abort condition (if any), called periodically by the transfer also while no data arrives
+ * \return True when the sink is aborted
+ */
+bool FetchSink::checkAbort()
+{
+    if (!this->aborted && this->abortCheck && this->abortCheck())
+        this->aborted = true;
+    return this->aborted;
+}
+
+bool FetchSink::isTooLarge() const
+{
+    return this->tooLarge;
+}
+
+bool FetchSink::isAborted() const
+{
+    return this->aborted;
+}
+
+std::size_t FetchSink::getMaxSize() const
+{
+    return this->maxSize;
+}
+
+/**
+ * \brief Check if any data is received, a transfer with data can't be retried (the sink can't be rewound)
+ */
+bool FetchSink::hasData() const
+{
+    return this->dataReceived;
+}
+
+std::chrono::steady_clock::time_point FetchSink::getFirstDataTime() const
+{
+    return this->firstDataTime;
+}
+
+std::streamsize FetchSink::xsputn(const char *data, std::streamsize size)
+{
+    return this->append(data, static_cast<std::size_t>(size)) ? size : 0;
+}
+
+FetchSink::int_type FetchSink::overflow(int_type c)
+{
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+        return traits_type::not_eof(c);
+    char data = traits_type::to_char_type(c);
+    return this->append(&data, 1) ? c : traits_type::eof();
+}
@@ -0,0 +1,63 @@
+#ifndef FETCH_SINK_H
+#define FETCH_SINK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+/**
+ * \class FetchSink
+ * \brief Receives a (streamed) file directly into the caller's string buffer.
+ * Enforces a maximum size and reports the number of bytes received.
+ * Can also be used as output stream buffer (std::ostream), or stream to a file instead of the buffer.
+ */
+class FetchSink : public std::streambuf
+{
+public:
+    /**
+     * \brief Progress callback, with the number of bytes received and the total size (0 if unknown)
+     */
+    typedef std::function<void(std::size_t received, std::size_t total)> ProgressCallback;
+    /**
+     * \brief Abort condition, returns true when the transfer should be aborted
+     */
+    typedef std::function<bool()> AbortCheck;
+
+    explicit FetchSink(std::string &buffer, std::size_t maxSize = 0, const ProgressCallback &progress = nullptr);
+    bool setTotalSize(std::size_t totalSize);
+    bool append(const char *data, std::size_t size);
+    void setBufferMutex(std::mutex &bufferMutex);
+    void setStream(std::ostream &stream);
+    void setAbortCheck(const AbortCheck &abortCheck);
+    void abort();
+    bool checkAbort();
+    bool isTooLarge() const;
+    bool isAborted() const;
+    std::size_t getMaxSize() const;
+    bool hasData() const;
+    std::chrono::steady_clock::time_point getFirstDataTime() const;
+
+protected:
+    std::streamsize xsputn(const char *data, std::streamsize size) override;
+    int_type overflow(int_type c) override;
+
+private:
+    std::string &buffer;
+    std::size_t maxSize; /*!< 0 is unlimited */
+    std::size_t totalSize;
+    bool tooLarge;
+    std::atomic<bool> aborted;
+    std::mutex *bufferMutex; /*!< Optional, held while the buffer is modified */
+    std::ostream *stream;    /*!< Optional, receives the data instead of the buffer (eg. a file) */
+    std::size_t received;    /*!< Bytes received (in the buffer, taken out of the buffer or written to the stream) */
+    bool dataReceived;
+    std::chrono::steady_clock::time_point firstDataTime; /*!< For the time to first byte */
+    ProgressCallback progress;
+    AbortCheck abortCheck; /*!< Optional, see checkAbort() */
+};
+#endif
@@ -0,0 +1,200 @@
+#include "fetch-timeout-policy.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+    const std::size_t MAX_SAMPLES = 64;  /*!< Window of recent fetches, per source and cache state */
+    const std::size_t MIN_SAMPLES = 5;   /*!< Fewer samples use the max. time-out */
+    const double HEADROOM = 3.0;         /*!< Deadline is the 95th percentile times the headroom */
+    const std::chrono::milliseconds MIN_LOCAL_DEADLINE(1000);
+    const std::chrono::milliseconds MIN_NETWORK_DEADLINE(5000); /*!< Content discovery (DHT) varies a lot */
+    const std::chrono::milliseconds BACKOFF_BASE(250);
+    const std::chrono::milliseconds MAX_BACKOFF(2000);
+    const std::chrono::milliseconds DEFAULT_TIMEOUT(120000); /*!< When the configured time-out can't be parsed */
+    const char *const TRANSIENT_ERRORS[] = {"context deadline exceeded", "Timeout was reached", "Connection reset", "Recv failure",
+                                            "Send failure", "Empty reply from server", "transfer closed"};
+} // namespace
+
+/**
+ * \brief Create policy
+ * \param maxTimeout Max. time-out, the upper cap of the deadlines (a duration string, eg. "120s" or "2m")
+ */
+FetchTimeoutPolicy::FetchTimeoutPolicy(const std::string &maxTimeout)
+    : maxTimeout(parseDuration(maxTimeout)),
+      random(std::random_device()())
+{
+    if (this->maxTimeout.count() <= 0)
+        this->maxTimeout = DEFAULT_TIMEOUT;
+}
+
+/**
+ * \brief Get the deadlines of a fetch attempt, each retry gets twice the time (up to the max. time-out)
+ * \param source Content source
+ * \param cacheState Cache state of the content
+ * \param attempt Attempt, starting at 0
+ */
+FetchTimeoutPolicy::Deadline FetchTimeoutPolicy::getDeadline(Source source, CacheState cacheState, int attempt)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->computeDeadline(Key(source, cacheState), attempt);
+}
+
+/**
+ * \brief Record the latency of a successful fetch
+ * \param firstByte Time to first byte
+ * \param total Total fetch time
+ */
+void FetchTimeoutPolicy::recordSuccess(Source source, CacheState cacheState, std::chrono::milliseconds firstByte, std::chrono::milliseconds total)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    Samples &samples = this->samples[Key(source, cacheState)];
+    samples.firstByte.push_back(firstByte);
+    samples.total.push_back(total);
+    if (samples.firstByte.size() > MAX_SAMPLES)
+    {
+        samples.firstByte.pop_front();
+        samples.total.pop_front();
+    }
+    const std::vector<std::chrono::milliseconds> &limits = getBucketLimits();
+    samples.histogram.resize(limits.size() + 1);
+    samples.histogram[std::upper_bound(limits.begin(), limits.end(), total) - limits.begin()]++;
+}
+
+/**
+ * \brief Record a fetch attempt that failed by a transient error (eg. a time-out)
+ */
+void FetchTimeoutPolicy::recordTimeout(Source source, CacheState cacheState)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->samples[Key(source, cacheState)].timeouts++;
+}
+
+/**
+ * \brief Get the waiting time before a retry: exponential backoff, of which the upper half is random (jitter),
+ * so retries of several fetches are spread
+ * \param attempt Failed attempt, starting at 0
+ */
+std::chrono::milliseconds FetchTimeoutPolicy::getBackoff(int attempt)
+{
+    std::chrono::milliseconds backoff = std::min(MAX_BACKOFF, BACKOFF_BASE * (1 << std::min(attempt, 8)));
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::uniform_int_distribution<long> jitter(0, backoff.count() / 2);
+    return backoff / 2 + std::chrono::milliseconds(jitter(this->random));
+}
+
+std::chrono::milliseconds FetchTimeoutPolicy::getMaxTimeout() const
+{
+    return this->maxTimeout;
+}
+
+/**
+ * \brief Get the latency statistics, of each source and cache state with fetches
+ */
+std::vector<FetchTimeoutPolicy::Stats> FetchTimeoutPolicy::getStats()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<Stats> stats;
+    for (const auto &entry : this->samples)
+    {
+        const Samples &samples = entry.second;
+        std::vector<uint64_t> histogram = samples.histogram;
+        histogram.resize(getBucketLimits().size() + 1);
+        stats.push_back(Stats{entry.first.first, entry.first.second, samples.total.size(), samples.timeouts,
+                              percentile(samples.firstByte, 0.5), percentile(samples.firstByte, 0.95),
+                              percentile(samples.total, 0.5), percentile(samples.total, 0.95),
+                              this->computeDeadline(entry.first, 0), histogram});
+    }
+    return stats;
+}
+
+/**
+ * \brief Check if a fetch error is transient (eg. a time-out or a dropped connection), which is worth a retry
+ * \param errorMessage Error message of the fetch
+ */
+bool FetchTimeoutPolicy::isTransient(const std::string &errorMessage)
+{
+    return std::any_of(std::begin(TRANSIENT_ERRORS), std::end(TRANSIENT_ERRORS),
+                       [&errorMessage](const char *error) { return errorMessage.find(error) != std::string::npos; });
+}
+
+/**
+ * \brief Parse a duration string, the same format as the IPFS time-out (eg. "500ms", "120s" or "1m30s")
+ * \return Duration, 0 when invalid
+ */
+std::chrono::milliseconds FetchTimeoutPolicy::parseDuration(const std::string &duration)
+{
+    static const std::pair<const char *, double> UNITS[] = {{"ms", 1.0}, {"us", 0.001}, {"ns", 0.000001}, {"h", 3600000.0}, {"m", 60000.0}, {"s", 1000.0}};
+    double milliseconds = 0.0;
+    const char *pos = duration.c_str();
+    while (*pos != '\0')
+    {
+        char *end = nullptr;
+        double value = std::strtod(pos, &end);
+        if (end == pos)
+            return std::chrono::milliseconds(0);
+        pos = end;
+        bool isUnitFound = false;
+        for (const auto &unit : UNITS)
+        {
+            std::size_t length = std::char_traits<char>::length(unit.first);
+            if (std::char_traits<char>::compare(pos, unit.first, length) == 0)
+            {
+                milliseconds += value * unit.second;
+                pos += length;
+                isUnitFound = true;
+                break;
+            }
+        }
+        if (!isUnitFound)
+            return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds(static_cast<long>(std::llround(milliseconds)));
+}
+
+/**
+ * \brief Upper limits of the latency histogram buckets, the last bucket is everything above
+ */
+const std::vector<std::chrono::milliseconds> &FetchTimeoutPolicy::getBucketLimits()
+{
+    static const std::vector<std::chrono::milliseconds> LIMITS{
+        std::chrono::milliseconds(10), std::chrono::milliseconds(25), std::chrono::milliseconds(50), std::chrono::milliseconds(100),
+        std::chrono::milliseconds(250), std::chrono::milliseconds(500), std::chrono::milliseconds(1000), std::chrono::milliseconds(2500),
+        std::chrono::milliseconds(5000), std::chrono::milliseconds(10000), std::chrono::milliseconds(30000)};
+    return LIMITS;
+}
+
+FetchTimeoutPolicy::Deadline FetchTimeoutPolicy::computeDeadline(const Key &key, int attempt) const
+{
+    Deadline deadline{this->maxTimeout, this->maxTimeout, this->maxTimeout};
+    auto it = this->samples.find(key);
+    // A fixed time-out can't be changed per request (TCP client)
+    if (key.first != SOURCE_TCP && it != this->samples.end() && it->second.total.size() >= MIN_SAMPLES)
+    {
+        std::chrono::milliseconds minDeadline = (key.second == CACHE_LOCAL) ? MIN_LOCAL_DEADLINE : MIN_NETWORK_DEADLINE;
+        deadline.firstByte = std::max(minDeadline, std::chrono::duration_cast<std::chrono::milliseconds>(percentile(it->second.firstByte, 0.95) * HEADROOM));
+        deadline.total = std::max(deadline.firstByte, std::chrono::duration_cast<std::chrono::milliseconds>(percentile(it->second.total, 0.95) * HEADROOM));
+        deadline.firstByte *= (1 << std::min(attempt, 8));
+        deadline.total *= (1 << std::min(attempt, 8));
+    }
+    deadline.firstByte = std::min(deadline.firstByte, this->maxTimeout);
+    deadline.total = std::min(deadline.total, this->maxTimeout);
+    return deadline;
+}
+
+/**
+ * \brief Percentile by the nearest rank
+ * \param fraction Percentile as fraction, eg. 0.95
+ */
+std::chrono::milliseconds FetchTimeoutPolicy::percentile(const std::deque<std::chrono::milliseconds> &values, double fraction)
+{
+    if (values.empty())
+        return std::chrono::milliseconds(0);
+    std::vector<std::chrono::milliseconds> sorted(values.begin(), values.end());
+    std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * sorted.size()));
+    std::size_t index = std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
@@ -0,0 +1,105 @@
+#ifndef FETCH_TIMEOUT_POLICY_H
+#define FETCH_TIMEOUT_POLICY_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * \class FetchTimeoutPolicy
+ * \brief Adaptive fetch time-outs (thread-safe). The time to first byte and the total time of recent fetches are tracked
+ * per content source (API socket, TCP or multiple endpoints) and cache state (content in the local blockstore or not).
+ * The deadlines of a fetch follow from the recent percentiles (with headroom), capped by the configured time-out.
+ * Transient failures (eg. a time-out) are retried with a longer deadline, after a jittered backoff.
+ */
+class FetchTimeoutPolicy
+{
+public:
+    /**
+     * \brief Content source, how the content is fetched
+     */
+    enum Source
+    {
+        SOURCE_SOCKET,   /*!< Local daemon via the API socket */
+        SOURCE_TCP,      /*!< Daemon via TCP (time-out is fixed per client) */
+        SOURCE_ENDPOINTS /*!< Multiple API endpoints, hedged */
+    };
+
+    /**
+     * \brief Cache state of the content in the daemon
+     */
+    enum CacheState
+    {
+        CACHE_LOCAL,   /*!< All blocks are in the local blockstore */
+        CACHE_NETWORK, /*!< (Some) blocks are fetched from the network */
+        CACHE_UNKNOWN  /*!< Not checked (TCP or multiple endpoints) */
+    };
+
+    /**
+     * \struct Deadline
+     * \brief Deadlines of a fetch attempt
+     */
+    struct Deadline
+    {
+        std::chrono::milliseconds firstByte; /*!< No data received yet */
+        std::chrono::milliseconds total;     /*!< After this, a stalled transfer is aborted (a progressing transfer continues) */
+        std::chrono::milliseconds timeout;   /*!< Time-out of the request in the daemon, the remaining time of the fetch (0 is the configured time-out) */
+    };
+
+    /**
+     * \struct Stats
+     * \brief Latency statistics of a source and cache state
+     */
+    struct Stats
+    {
+        Source source;
+        CacheState cacheState;
+        std::size_t samples; /*!< Recent fetches, used for the percentiles */
+        uint64_t timeouts;
+        std::chrono::milliseconds firstByteMedian;
+        std::chrono::milliseconds firstBytePercentile95;
+        std::chrono::milliseconds totalMedian;
+        std::chrono::milliseconds totalPercentile95;
+        Deadline deadline;             /*!< Deadline of the next (first) attempt */
+        std::vector<uint64_t> histogram; /*!< Fetches per total latency bucket, see getBucketLimits() */
+    };
+
+    static const int MAX_ATTEMPTS = 3;
+
+    explicit FetchTimeoutPolicy(const std::string &maxTimeout);
+    Deadline getDeadline(Source source, CacheState cacheState, int attempt);
+    void recordSuccess(Source source, CacheState cacheState, std::chrono::milliseconds firstByte, std::chrono::milliseconds total);
+    void recordTimeout(Source source, CacheState cacheState);
+    std::chrono::milliseconds getBackoff(int attempt);
+    std::chrono::milliseconds getMaxTimeout() const;
+    std::vector<Stats> getStats();
+    static bool isTransient(const std::string &errorMessage);
+    static std::chrono::milliseconds parseDuration(const std::string &duration);
+    static const std::vector<std::chrono::milliseconds> &getBucketLimits();
+
+private:
+    typedef std::pair<Source, CacheState> Key;
+
+    struct Samples
+    {
+        std::deque<std::chrono::milliseconds> firstByte; /*!< Most recent last */
+        std::deque<std::chrono::milliseconds> total;
+        uint64_t timeouts;
+        std::vector<uint64_t> histogram;
+    };
+
+    std::mutex mutex;
+    std::chrono::milliseconds maxTimeout;
+    std::map<Key, Samples> samples;
+    std::mt19937 random;
+
+    Deadline computeDeadline(const Key &key, int attempt) const;
+    static std::chrono::milliseconds percentile(const std::deque<std::chrono::milliseconds> &values, double fraction);
+};
+#endif
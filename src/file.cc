@@ -1,7 +1,15 @@
 #include "file.h"
 #include <ipfs/client.h>
+#include <giomm/contenttype.h>
+#include <algorithm>
 #include <stdexcept>
 #include <fstream>
+#include <cerrno>
+#include <cstdlib>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #ifdef LEGACY_CXX
 #include <experimental/filesystem>
@@ -37,17 +45,80 @@ std::string const File::read(const std::string &path)
 }
 
 /**
- * \brief Write file to disk
+ * \brief Write file to disk. The content is written to a temporary file first, which is synced and
+ * renamed over the destination, so the file is never left half-written (eg. on a crash or full disk).
+ * A symbolic link is followed (the link stays) and the permissions of an existing file are kept.
  * \param path File path location for storing the file
  * \param content Content that needs to be written to file
  * \throw std::ios_base::failure when file can't be written to
  */
 void File::write(const std::string &path, const std::string &content)
 {
-    std::ofstream file;
-    file.open(path.c_str());
-    file << content;
-    file.close();
+    // Replace the target of a symbolic link, not the link itself
+    std::string targetPath = path;
+    char *resolved = ::realpath(path.c_str(), nullptr);
+    if (resolved != nullptr)
+    {
+        targetPath = resolved;
+        ::free(resolved);
+    }
+    struct stat info;
+    bool exists = (::stat(targetPath.c_str(), &info) == 0);
+    mode_t mode = exists ? (info.st_mode & 07777) : 0644;
+
+    // Unique temporary file in the same directory (rename is atomic within a file system)
+    n_fs::path target(targetPath);
+    std::string directory = target.parent_path();
+    std::string tmpPath = (directory.empty() ? std::string() : directory + "/") + "." + target.filename().string() + ".XXXXXX";
+    std::vector<char> tmpTemplate(tmpPath.begin(), tmpPath.end());
+    tmpTemplate.push_back('\0');
+    int fd = ::mkostemp(tmpTemplate.data(), O_CLOEXEC);
+    if (fd < 0)
+        throw std::ios_base::failure("Could not create file: " + tmpPath);
+    tmpPath = tmpTemplate.data();
+    if (exists)
+    {
+        // Keep the owner when allowed (eg. a file of another user edited as root)
+        if (::fchown(fd, info.st_uid, info.st_gid) != 0)
+        {
+            // ignore, the file gets the current owner
+        }
+    }
+    if (::fchmod(fd, mode) != 0)
+    {
+        ::close(fd);
+        ::unlink(tmpPath.c_str());
+        throw std::ios_base::failure("Could not set permissions of file: " + tmpPath);
+    }
+
+    const char *data = content.data();
+    std::size_t remaining = content.size();
+    while (remaining > 0)
+    {
+        ssize_t written = ::write(fd, data, remaining);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+        {
+            ::close(fd);
+            ::unlink(tmpPath.c_str());
+            throw std::ios_base::failure("Could not write file: " + tmpPath);
+        }
+        data += written;
+        remaining -= static_cast<std::size_t>(written);
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0 || ::rename(tmpPath.c_str(), targetPath.c_str()) != 0)
+    {
+        ::unlink(tmpPath.c_str());
+        throw std::ios_base::failure("Could not store file: " + path);
+    }
+    // Make the rename durable
+    int dirFd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd >= 0)
+    {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
 }
 
 /**
@@ -59,3 +130,18 @@ std::string const File::getFilename(const std::string &path)
 {
     return n_fs::path(path).filename();
 }
+
+/**
+ * \brief Sniff the content type from the first bytes of the content (and the file name)
+ * \param path Path of the file, the name (extension) is a hint
+ * \param content Content, or the first part of it
+ * \return MIME type, eg. "text/markdown" or "video/mp4"
+ */
+std::string const File::sniffContentType(const std::string &path, const std::string &content)
+{
+    if (content.empty())
+        return "text/plain";
+    bool isUncertain = false;
+    std::size_t size = std::min<std::size_t>(content.size(), 4096);
+    return Gio::content_type_guess(path.substr(path.find_last_of('/') + 1), reinterpret_cast<const guchar *>(content.data()), size, isUncertain);
+}
@@ -5,7 +5,7 @@
 
 /**
  * \class File
- * \brief Read/write markdown files from disk and retrieve filename from path
+ * \brief Read/write markdown files from disk, retrieve filename from path and sniff the content type
  */
 class File
 {
@@ -13,5 +13,6 @@ public:
     static std::string const read(const std::string &path);
     static void write(const std::string &path, const std::string &content);
     static std::string const getFilename(const std::string &path);
+    static std::string const sniffContentType(const std::string &path, const std::string &content);
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "heading-index.h"
+
+#include <glib.h>
+
+/**
+ * \brief Remove all headings (new document)
+ */
+void HeadingIndex::clear()
+{
+    this->headings.clear();
+    this->slugs.clear();
+}
+
+/**
+ * \brief Add the next heading of the document, duplicate slugs get a "-1", "-2", .. suffix (like GitHub)
+ * \param level Heading level (1-6)
+ * \param text Plain heading text
+ * \param offset Character offset in the rendered text buffer
+ * \param line Zero-based source line
+ */
+void HeadingIndex::add(int level, const std::string &text, int offset, int line)
+{
+    std::string baseSlug = slugify(text);
+    std::string slug = baseSlug;
+    for (int suffix = 1; this->slugs.count(slug) > 0; ++suffix)
+        slug = baseSlug + "-" + std::to_string(suffix);
+    this->slugs.emplace(slug, this->headings.size());
+    this->headings.push_back(Heading{level, text, slug, offset, line});
+}
+
+/**
+ * \brief Remove the headings after the first count headings (eg. re-rendered part of the document)
+ */
+void HeadingIndex::truncate(std::size_t count)
+{
+    while (this->headings.size() > count)
+    {
+        this->slugs.erase(this->headings.back().slug);
+        this->headings.pop_back();
+    }
+}
+
+const std::vector<HeadingIndex::Heading> &HeadingIndex::getHeadings() const
+{
+    return this->headings;
+}
+
+/**
+ * \brief Find the heading of a URL fragment
+ * \param fragment Fragment without the '#'-sign (may be percent-encoded)
+ * \return Heading or nullptr when not found
+ */
+const HeadingIndex::Heading *HeadingIndex::find(const std::string &fragment) const
+{
+    auto it = this->slugs.find(fragment);
+    if (it == this->slugs.end())
+    {
+        // Try again with the decoded fragment, as slug
+        char *decoded = g_uri_unescape_string(fragment.c_str(), nullptr);
+        if (decoded != nullptr)
+        {
+            it = this->slugs.find(slugify(decoded));
+            g_free(decoded);
+        }
+    }
+    return (it != this->slugs.end()) ? &this->headings[it->second] : nullptr;
+}
+
+/**
+ * \brief Retrieve the plain text of a heading node (all text and code literals)
+ */
+std::string HeadingIndex::headingText(cmark_node *heading)
+{
+    std::string text;
+    cmark_iter *iter = cmark_iter_new(heading);
+    cmark_event_type evType;
+    while ((evType = cmark_iter_next(iter)) != CMARK_EVENT_DONE)
+    {
+        cmark_node *node = cmark_iter_get_node(iter);
+        if (evType != CMARK_EVENT_ENTER)
+            continue;
+        switch (cmark_node_get_type(node))
+        {
+        case CMARK_NODE_TEXT:
+        case CMARK_NODE_CODE:
+            text += cmark_node_get_literal(node);
+            break;
+        case CMARK_NODE_SOFTBREAK:
+        case CMARK_NODE_LINEBREAK:
+            text += " ";
+            break;
+        default:
+            break;
+        }
+    }
+    cmark_iter_free(iter);
+    return text;
+}
+
+/**
+ * \brief Create an anchor slug from a heading text, like GitHub does:
+ * lower-case, punctuation removed (except '-' and '_') and spaces replaced by '-'
+ */
+std::string HeadingIndex::slugify(const std::string &text)
+{
+    std::string slug;
+    gchar *lower = g_utf8_strdown(text.c_str(), -1);
+    for (const gchar *c = lower; *c != '\0'; ++c)
+    {
+        unsigned char byte = static_cast<unsigned char>(*c);
+        if (byte >= 0x80 || g_ascii_isalnum(byte) || byte == '-' || byte == '_')
+            slug += *c;
+        else if (byte == ' ')
+            slug += '-';
+    }
+    g_free(lower);
+    return slug;
+}
@@ -0,0 +1,42 @@
+#ifndef HEADING_INDEX_H
+#define HEADING_INDEX_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cmark-gfm.h>
+
+/**
+ * \class HeadingIndex
+ * \brief Index of the headings of a rendered document, used for the outline and #fragment navigation
+ */
+class HeadingIndex
+{
+public:
+    /**
+     * \struct Heading
+     * \brief Heading with its (unique) anchor slug, position in the rendered buffer and source line
+     */
+    struct Heading
+    {
+        int level;
+        std::string text;
+        std::string slug;
+        int offset;
+        int line;
+    };
+
+    void clear();
+    void add(int level, const std::string &text, int offset, int line);
+    void truncate(std::size_t count);
+    const std::vector<Heading> &getHeadings() const;
+    const Heading *find(const std::string &fragment) const;
+
+    static std::string headingText(cmark_node *heading);
+    static std::string slugify(const std::string &text);
+
+private:
+    std::vector<Heading> headings;
+    std::unordered_map<std::string, std::size_t> slugs; /*!< Slug -> index in headings */
+};
+#endif
@@ -0,0 +1,169 @@
+#include "hedged-fetcher.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <curl/curl.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Test of the hedged fetcher against local stand-ins of the IPFS API, see scripts/test_hedged_fetcher.sh
+ * which starts the stand-ins (scripts/ipfs_api_stand_in.py) on the ports after the base port:
+ *   +1 slow (4 s delay, content 'a'), +2 fast (content 'b'), +3 content not found, +4 not an IPFS API (404),
+ *   +9 nothing listening.
+ */
+namespace
+{
+    const std::size_t CONTENT_SIZE = 256 * 1024;
+    const FetchTimeoutPolicy::Deadline DEADLINE{std::chrono::milliseconds(10000), std::chrono::milliseconds(20000), std::chrono::milliseconds(30000)};
+    int failures = 0;
+
+    void check(bool isPassed, const std::string &description)
+    {
+        std::cout << (isPassed ? "PASS: " : "FAIL: ") << description << std::endl;
+        if (!isPassed)
+            failures++;
+    }
+
+    std::chrono::milliseconds since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    }
+
+    /**
+     * \brief Fetch into a buffer
+     * \return Error message, empty on success
+     */
+    std::string fetch(HedgedFetcher &fetcher, std::string &content, std::size_t maxSize = 0)
+    {
+        FetchSink sink(content, maxSize);
+        try
+        {
+            fetcher.fetch("/ipfs/QmTest", sink, DEADLINE);
+        }
+        catch (const std::exception &error)
+        {
+            return error.what();
+        }
+        return "";
+    }
+
+    bool isContent(const std::string &content, char character)
+    {
+        return content.size() == CONTENT_SIZE && content.find_first_not_of(character) == std::string::npos;
+    }
+
+    HedgedFetcher::EndpointStatus getStatus(HedgedFetcher &fetcher, const std::string &name)
+    {
+        for (const HedgedFetcher::EndpointStatus &status : fetcher.getStatus())
+        {
+            if (status.name == name)
+                return status;
+        }
+        return HedgedFetcher::EndpointStatus{};
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <base-port>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    int basePort = std::atoi(argv[1]);
+    auto endpoint = [basePort](int offset) { return "127.0.0.1:" + std::to_string(basePort + offset); };
+    const std::string slow = endpoint(1), fast = endpoint(2), notFound = endpoint(3), notIPFS = endpoint(4), dead = endpoint(9);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    {
+        // Slow endpoint first (no measurements yet): hedged to the fast endpoint, which wins
+        auto start = std::chrono::steady_clock::now();
+        {
+            HedgedFetcher fetcher({slow, fast}, "120s", 2);
+            std::string content;
+            std::string error = fetch(fetcher, content);
+            check(error.empty() && isContent(content, 'b'), "hedged to the fast endpoint, which wins (" + error + ")");
+            HedgedFetcher::EndpointStatus slowStatus = getStatus(fetcher, slow);
+            HedgedFetcher::EndpointStatus fastStatus = getStatus(fetcher, fast);
+            check(fastStatus.wins == 1 && slowStatus.wins == 0, "the fast endpoint has the win");
+            check(slowStatus.failures == 0 && slowStatus.isHealthy, "losing isn't a failure");
+
+            // Ordered by health: the fast endpoint is tried first, without hedging
+            auto second = std::chrono::steady_clock::now();
+            error = fetch(fetcher, content);
+            check(error.empty() && isContent(content, 'b'), "the fast endpoint wins again (" + error + ")");
+            check(since(second) < std::chrono::milliseconds(900), "the fast endpoint is tried first, in " + std::to_string(since(second).count()) + " ms");
+            check(getStatus(fetcher, slow).requests == 1, "the slow endpoint isn't asked again");
+        }
+        // The fetcher waits for its attempts, the slow endpoint answers after 4 seconds
+        check(since(start) < std::chrono::milliseconds(3500), "the losing attempt is cancelled, done in " + std::to_string(since(start).count()) + " ms");
+    }
+
+    {
+        // Nothing listening: the next endpoint is tried at once, the failing endpoint is skipped afterwards
+        HedgedFetcher fetcher({dead, fast}, "120s", 2);
+        std::string content;
+        auto start = std::chrono::steady_clock::now();
+        std::string error = fetch(fetcher, content);
+        check(error.empty() && isContent(content, 'b'), "unreachable endpoint, the next endpoint wins (" + error + ")");
+        check(since(start) < std::chrono::milliseconds(900), "the next endpoint is tried without waiting, in " + std::to_string(since(start).count()) + " ms");
+        HedgedFetcher::EndpointStatus deadStatus = getStatus(fetcher, dead);
+        check(!deadStatus.isHealthy && deadStatus.failures == 1, "the unreachable endpoint is unhealthy");
+        error = fetch(fetcher, content);
+        check(error.empty() && getStatus(fetcher, dead).requests == 1, "the unhealthy endpoint is skipped");
+    }
+
+    {
+        // Not an IPFS API: endpoint failure, the next endpoint wins
+        HedgedFetcher fetcher({notIPFS, fast}, "120s", 2);
+        std::string content;
+        std::string error = fetch(fetcher, content);
+        check(error.empty() && isContent(content, 'b'), "not an IPFS API, the next endpoint wins (" + error + ")");
+        check(getStatus(fetcher, notIPFS).failures == 1, "the endpoint without IPFS API has a failure");
+    }
+
+    {
+        // Content not found is the answer, the other endpoints would give the same
+        auto start = std::chrono::steady_clock::now();
+        HedgedFetcher fetcher({notFound, slow}, "120s", 2);
+        std::string content;
+        std::string error = fetch(fetcher, content);
+        check(error.find("not found") != std::string::npos, "content not found is the answer (" + error + ")");
+        check(since(start) < std::chrono::milliseconds(900), "without waiting for the slow endpoint, in " + std::to_string(since(start).count()) + " ms");
+        check(getStatus(fetcher, notFound).failures == 0, "a content error isn't an endpoint failure");
+    }
+
+    {
+        // Streamed to a file (stream), the content isn't kept in the buffer
+        HedgedFetcher fetcher({fast, slow}, "120s", 2);
+        std::string content;
+        std::ostringstream stream;
+        FetchSink sink(content, 0);
+        sink.setStream(stream);
+        std::string error;
+        try
+        {
+            fetcher.fetch("/ipfs/QmTest", sink, DEADLINE);
+        }
+        catch (const std::exception &exception)
+        {
+            error = exception.what();
+        }
+        check(error.empty() && content.empty() && isContent(stream.str(), 'b'), "streamed to the stream only (" + error + ")");
+    }
+
+    {
+        // The max. size applies to all data passed through the sink
+        HedgedFetcher fetcher({fast, slow}, "120s", 2);
+        std::string content;
+        std::string error = fetch(fetcher, content, CONTENT_SIZE / 2);
+        check(error.starts_with("File is too large"), "the max. size is enforced (" + error + ")");
+    }
+
+    curl_global_cleanup();
+    std::cout << (failures == 0 ? "All tests passed" : std::to_string(failures) + " test(s) failed") << std::endl;
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,449 @@
+#include "hedged-fetcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    const std::size_t MAX_SAMPLES = 32;                          /*!< Recent times to first byte, per endpoint */
+    const std::size_t MIN_SAMPLES = 5;                           /*!< Fewer samples use the default hedge delay */
+    const double HEDGE_PERCENTILE = 0.9;
+    const std::chrono::milliseconds DEFAULT_HEDGE_DELAY(1000);
+    const std::chrono::milliseconds MIN_HEDGE_DELAY(20);
+    const std::chrono::milliseconds MAX_RETRY_AFTER(60000);      /*!< Max. time a failing endpoint is skipped */
+    const double AVERAGE_WEIGHT = 0.2;                           /*!< Weight of a new sample in the moving average */
+    const std::chrono::milliseconds ABORT_CHECK_INTERVAL(1000);  /*!< The caller's sink is checked while no data arrives */
+
+    std::runtime_error tooLargeError(const FetchSink &sink)
+    {
+        return std::runtime_error("File is too large, the maximum size is " + std::to_string(sink.getMaxSize() / (1024 * 1024)) + " MB");
+    }
+
+    /**
+     * \brief Check if an error tells something about the endpoint (unreachable, slow or not an IPFS API), not about the content.
+     * The daemon answers content errors (eg. not found) with status code 500.
+     */
+    bool isEndpointError(const std::exception_ptr &error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const IPFSSocketClient::ConnectError &)
+        {
+            return true;
+        }
+        catch (const std::exception &exception)
+        {
+            std::string message = exception.what();
+            if (message.starts_with("File is too large") || message.starts_with("Transfer is aborted"))
+                return false;
+            if (message.starts_with("HTTP request failed with status code 500"))
+                return FetchTimeoutPolicy::isTransient(message);
+            return true;
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }
+} // namespace
+
+/**
+ * \brief Create fetcher
+ * \param endpoints API endpoints, "host:port" or "unix:/path/to/api.sock", the first is preferred until there are measurements
+ * \param timeout IPFS time-out (which is a string, eg. "6s" for 6 seconds)
+ * \param connections Max. number of idle (keep-alive) connections, per endpoint
+ */
+HedgedFetcher::HedgedFetcher(const std::vector<std::string> &endpoints, const std::string &timeout, std::size_t connections)
+    : runningAttempts(0)
+{
+    for (const std::string &name : endpoints)
+    {
+        Endpoint endpoint{name, nullptr, {}, -1.0, 0, std::chrono::steady_clock::time_point(), 0, 0, 0};
+        if (name.starts_with("unix:"))
+        {
+            endpoint.client = std::make_unique<IPFSSocketClient>(name.substr(5), timeout, connections);
+        }
+        else
+        {
+            std::size_t colon = name.rfind(':');
+            int port = (colon != std::string::npos) ? std::atoi(name.c_str() + colon + 1) : 0;
+            endpoint.client = std::make_unique<IPFSSocketClient>(name.substr(0, colon), (port > 0) ? port : 5001, timeout, connections);
+        }
+        this->endpoints.push_back(std::move(endpoint));
+    }
+}
+
+/**
+ * \brief Cancel all attempts and wait until their threads are finished
+ */
+HedgedFetcher::~HedgedFetcher()
+{
+    std::set<std::shared_ptr<Hedge>> hedges;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        hedges = this->hedges;
+    }
+    for (const auto &hedge : hedges)
+    {
+        std::lock_guard<std::mutex> lock(hedge->mutex);
+        cancelAttempts(*hedge, -1);
+    }
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->attemptEnded.wait(lock, [this] { return this->runningAttempts == 0; });
+}
+
+/**
+ * \brief Number of endpoints, hedging needs at least two
+ */
+std::size_t HedgedFetcher::getSize() const
+{
+    return this->endpoints.size();
+}
+
+/**
+ * \brief Fetch file, hedged across the endpoints (blocking). The data of the winning endpoint is streamed into the sink.
+ * \param path IPFS path
+ * \param sink Destination, the max. size of the sink applies to each attempt
+ * \param deadline Deadlines of each attempt
+ * \throw std::runtime_error when all endpoints failed (the error of the last attempt), or the content can't be fetched
+ */
+void HedgedFetcher::fetch(const std::string &path, FetchSink &sink, const FetchTimeoutPolicy::Deadline &deadline)
+{
+    std::vector<std::size_t> order = this->getOrder();
+    std::vector<std::chrono::milliseconds> hedgeDelays;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (std::size_t index : order)
+            hedgeDelays.push_back(this->getHedgeDelay(this->endpoints[index], deadline));
+    }
+    auto hedge = std::make_shared<Hedge>();
+    hedge->totalSize = 0;
+    hedge->winner = -1;
+    hedge->isDone = false;
+    hedge->failed = 0;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->hedges.insert(hedge);
+    }
+    // Leaving also happens on errors and thread cancellation, the remaining attempts are cancelled
+    struct Leave
+    {
+        HedgedFetcher &fetcher;
+        std::shared_ptr<Hedge> hedge;
+        ~Leave()
+        {
+            {
+                std::lock_guard<std::mutex> lock(hedge->mutex);
+                cancelAttempts(*hedge, -1);
+            }
+            std::lock_guard<std::mutex> lock(fetcher.mutex);
+            fetcher.hedges.erase(hedge);
+        }
+    } leave{*this, hedge};
+
+    std::size_t launched = 0;
+    bool isSizeSet = false;
+    std::unique_lock<std::mutex> lock(hedge->mutex);
+    this->launch(hedge, order[launched], path, sink.getMaxSize(), deadline);
+    auto hedgeTime = std::chrono::steady_clock::now() + hedgeDelays[launched++];
+    auto isReady = [&] {
+        if (hedge->winner < 0)
+            return hedge->failed == launched;
+        return hedge->isDone || !hedge->contents[hedge->winner].empty() || (!isSizeSet && hedge->totalSize > 0);
+    };
+    while (true)
+    {
+        if (hedge->winner < 0 && launched < order.size())
+        {
+            if (!hedge->changed.wait_until(lock, hedgeTime, isReady))
+            {
+                // No first byte in time, hedge to the next endpoint
+                this->launch(hedge, order[launched], path, sink.getMaxSize(), deadline);
+                hedgeTime = std::chrono::steady_clock::now() + hedgeDelays[launched++];
+                continue;
+            }
+        }
+        else
+        {
+            // The caller's sink can be aborted while the attempts are stalled (eg. by the fetch coalescer)
+            while (!hedge->changed.wait_for(lock, ABORT_CHECK_INTERVAL, isReady))
+            {
+                if (sink.checkAbort())
+                    throw std::runtime_error("Transfer is aborted");
+            }
+        }
+        if (hedge->winner < 0)
+        {
+            // All running attempts failed, go to the next endpoint right away
+            if (launched == order.size())
+                std::rethrow_exception(hedge->error);
+            this->launch(hedge, order[launched], path, sink.getMaxSize(), deadline);
+            hedgeTime = std::chrono::steady_clock::now() + hedgeDelays[launched++];
+            continue;
+        }
+        std::size_t totalSize = hedge->totalSize;
+        // The received data is taken out of the attempt buffer, the content is only held by the caller's sink
+        std::string chunk;
+        chunk.swap(hedge->contents[hedge->winner]);
+        bool isDone = hedge->isDone;
+        lock.unlock();
+        // The sink's progress callback is called without holding the lock
+        if (!isSizeSet && totalSize > 0)
+        {
+            isSizeSet = true;
+            if (!sink.setTotalSize(totalSize))
+                throw tooLargeError(sink);
+        }
+        if (!chunk.empty() && !sink.append(chunk.data(), chunk.size()))
+        {
+            if (sink.isAborted())
+                throw std::runtime_error("Transfer is aborted");
+            throw tooLargeError(sink);
+        }
+        if (isDone)
+            break;
+        lock.lock();
+    }
+    // Done is final, the error isn't modified anymore
+    if (hedge->error)
+        std::rethrow_exception(hedge->error);
+}
+
+/**
+ * \brief Health of the endpoints, in the configured order
+ */
+std::vector<HedgedFetcher::EndpointStatus> HedgedFetcher::getStatus()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    std::vector<EndpointStatus> status;
+    auto now = std::chrono::steady_clock::now();
+    // Without deadline, the delay is only capped by the default
+    FetchTimeoutPolicy::Deadline deadline{std::chrono::milliseconds::max(), std::chrono::milliseconds::max(), std::chrono::milliseconds(0)};
+    for (const Endpoint &endpoint : this->endpoints)
+    {
+        status.push_back(EndpointStatus{endpoint.name, now >= endpoint.retryAfter,
+                                        std::chrono::milliseconds(static_cast<long>(std::max(endpoint.averageFirstByte, 0.0))),
+                                        this->getHedgeDelay(endpoint, deadline), endpoint.requests, endpoint.wins, endpoint.failures});
+    }
+    return status;
+}
+
+/**
+ * \brief Parse a list of API endpoints
+ * \param endpoints Comma-separated list, eg. "192.168.1.10:5001, 192.168.1.11:5001"
+ */
+std::vector<std::string> HedgedFetcher::parseEndpoints(const std::string &endpoints)
+{
+    std::vector<std::string> list;
+    std::size_t start = 0;
+    while (start <= endpoints.size())
+    {
+        std::size_t end = endpoints.find(',', start);
+        if (end == std::string::npos)
+            end = endpoints.size();
+        std::string endpoint = endpoints.substr(start, end - start);
+        endpoint.erase(0, endpoint.find_first_not_of(" \t"));
+        endpoint.erase(endpoint.find_last_not_of(" \t") + 1);
+        if (!endpoint.empty())
+            list.push_back(endpoint);
+        start = end + 1;
+    }
+    return list;
+}
+
+/**
+ * \brief Endpoints ordered by health: measured healthy endpoints by their average time to first byte,
+ * then unmeasured healthy endpoints, failing endpoints are tried last
+ */
+std::vector<std::size_t> HedgedFetcher::getOrder()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto now = std::chrono::steady_clock::now();
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < this->endpoints.size(); ++i)
+        order.push_back(i);
+    std::stable_sort(order.begin(), order.end(), [this, now](std::size_t a, std::size_t b) {
+        const Endpoint &first = this->endpoints[a];
+        const Endpoint &second = this->endpoints[b];
+        bool isFirstHealthy = now >= first.retryAfter;
+        bool isSecondHealthy = now >= second.retryAfter;
+        if (isFirstHealthy != isSecondHealthy)
+            return isFirstHealthy;
+        if (!isFirstHealthy)
+            return first.retryAfter < second.retryAfter;
+        bool isFirstMeasured = first.averageFirstByte >= 0.0;
+        bool isSecondMeasured = second.averageFirstByte >= 0.0;
+        if (isFirstMeasured != isSecondMeasured)
+            return isFirstMeasured;
+        return first.averageFirstByte < second.averageFirstByte;
+    });
+    return order;
+}
+
+/**
+ * \brief Time without first byte before the next endpoint is tried: the recent 90th percentile of the endpoint (mutex is held)
+ */
+std::chrono::milliseconds HedgedFetcher::getHedgeDelay(const Endpoint &endpoint, const FetchTimeoutPolicy::Deadline &deadline) const
+{
+    std::chrono::milliseconds delay = DEFAULT_HEDGE_DELAY;
+    if (endpoint.firstByte.size() >= MIN_SAMPLES)
+    {
+        std::vector<std::chrono::milliseconds> sorted(endpoint.firstByte.begin(), endpoint.firstByte.end());
+        std::size_t index = std::min(sorted.size() - 1, static_cast<std::size_t>(HEDGE_PERCENTILE * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        delay = sorted[index];
+    }
+    return std::max(MIN_HEDGE_DELAY, std::min(delay, deadline.firstByte));
+}
+
+/**
+ * \brief Start an attempt on an endpoint, in its own thread (hedge mutex is held)
+ */
+void HedgedFetcher::launch(std::shared_ptr<Hedge> hedge, std::size_t endpoint, const std::string &path, std::size_t maxSize,
+                           const FetchTimeoutPolicy::Deadline &deadline)
+{
+    int attempt = static_cast<int>(hedge->contents.size());
+    hedge->contents.emplace_back();
+    hedge->cancelled.emplace_back(false);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        ++this->runningAttempts;
+        ++this->endpoints[endpoint].requests;
+    }
+    std::thread(&HedgedFetcher::runAttempt, this, hedge, attempt, endpoint, path, maxSize, deadline).detach();
+}
+
+/**
+ * \brief Run an attempt (in its own thread). The first attempt with data (or with a definite error) wins.
+ */
+void HedgedFetcher::runAttempt(std::shared_ptr<Hedge> hedge, int attempt, std::size_t index, const std::string &path, std::size_t maxSize,
+                               FetchTimeoutPolicy::Deadline deadline)
+{
+    Endpoint &endpoint = this->endpoints[index];
+    std::string *content;
+    std::atomic<bool> *cancelled;
+    {
+        std::lock_guard<std::mutex> lock(hedge->mutex);
+        content = &hedge->contents[attempt];
+        cancelled = &hedge->cancelled[attempt];
+    }
+    // Only the winner receives data
+    FetchSink sink(*content, maxSize, [hedge](std::size_t, std::size_t total) {
+        std::lock_guard<std::mutex> lock(hedge->mutex);
+        hedge->totalSize = total;
+        hedge->changed.notify_all();
+    });
+    sink.setBufferMutex(hedge->mutex);
+    IPFSSocketClient::FetchOptions options;
+    options.firstByteTimeout = deadline.firstByte;
+    options.totalTimeout = deadline.total;
+    options.timeout = deadline.timeout;
+    options.cancelled = cancelled;
+    options.claim = [hedge, attempt]() {
+        std::lock_guard<std::mutex> lock(hedge->mutex);
+        if (hedge->winner < 0)
+        {
+            hedge->winner = attempt;
+            hedge->decided = std::chrono::steady_clock::now();
+            cancelAttempts(*hedge, attempt);
+            hedge->changed.notify_all();
+        }
+        return hedge->winner == attempt;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::exception_ptr error;
+    try
+    {
+        endpoint.client->cat(path, sink, options);
+        // Empty file
+        if (!sink.hasData())
+            options.claim();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    auto end = std::chrono::steady_clock::now();
+    bool isEndpointFailure = error && isEndpointError(error);
+    bool isWinner;
+    bool isLost;
+    {
+        std::lock_guard<std::mutex> lock(hedge->mutex);
+        // A definite error (eg. not found or too large) is the answer, the other endpoints would give the same
+        if (hedge->winner < 0 && error && !isEndpointFailure)
+        {
+            hedge->winner = attempt;
+            hedge->decided = end;
+            cancelAttempts(*hedge, attempt);
+        }
+        isWinner = hedge->winner == attempt;
+        isLost = !isWinner && (hedge->winner >= 0 || *cancelled);
+        // The cancellation is noticed later (curl checks about once per second while idle)
+        if (!isWinner && hedge->winner >= 0)
+            end = std::min(end, hedge->decided);
+        if (isWinner)
+        {
+            hedge->error = error;
+            hedge->isDone = true;
+        }
+        else if (!isLost)
+        {
+            ++hedge->failed;
+            hedge->error = error;
+        }
+        hedge->changed.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (isEndpointFailure && !isLost)
+    {
+        ++endpoint.failures;
+        ++endpoint.consecutiveFailures;
+        auto retryAfter = std::chrono::milliseconds(1000) * (1 << std::min(endpoint.consecutiveFailures - 1, 6u));
+        endpoint.retryAfter = end + std::min(std::chrono::duration_cast<std::chrono::milliseconds>(retryAfter), MAX_RETRY_AFTER);
+    }
+    else if (isWinner && !error)
+    {
+        ++endpoint.wins;
+        endpoint.consecutiveFailures = 0;
+        endpoint.retryAfter = std::chrono::steady_clock::time_point();
+        this->recordFirstByte(endpoint, std::chrono::duration_cast<std::chrono::milliseconds>((sink.hasData() ? sink.getFirstDataTime() : end) - start));
+    }
+    else if (isLost && !sink.hasData() && end > start)
+    {
+        // Slower than the winner, the time until the winner is known is a lower bound
+        this->recordFirstByte(endpoint, std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+    }
+    --this->runningAttempts;
+    this->attemptEnded.notify_all();
+}
+
+/**
+ * \brief Record a time to first byte (mutex is held)
+ */
+void HedgedFetcher::recordFirstByte(Endpoint &endpoint, std::chrono::milliseconds firstByte)
+{
+    endpoint.firstByte.push_back(firstByte);
+    if (endpoint.firstByte.size() > MAX_SAMPLES)
+        endpoint.firstByte.pop_front();
+    double value = static_cast<double>(firstByte.count());
+    endpoint.averageFirstByte = (endpoint.averageFirstByte < 0.0) ? value : (1.0 - AVERAGE_WEIGHT) * endpoint.averageFirstByte + AVERAGE_WEIGHT * value;
+}
+
+/**
+ * \brief Cancel the attempts (hedge mutex is held)
+ * \param except Attempt that continues, -1 cancels all
+ */
+void HedgedFetcher::cancelAttempts(Hedge &hedge, int except)
+{
+    for (std::size_t i = 0; i < hedge.cancelled.size(); ++i)
+    {
+        if (static_cast<int>(i) != except)
+            hedge.cancelled[i] = true;
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef HEDGED_FETCHER_H
+#define HEDGED_FETCHER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "fetch-sink.h"
+#include "fetch-timeout-policy.h"
+#include "ipfs-socket-client.h"
+
+/**
+ * \class HedgedFetcher
+ * \brief Fetches files from a list of IPFS API endpoints (thread-safe), ordered by health.
+ * The best endpoint is tried first. When it didn't deliver its first byte within its recent 90th percentile,
+ * a hedged request goes to the next endpoint. The first endpoint with data wins, the others are cancelled.
+ * A failing endpoint is skipped for a while (exponential back-off).
+ */
+class HedgedFetcher
+{
+public:
+    /**
+     * \struct EndpointStatus
+     * \brief Health of an endpoint
+     */
+    struct EndpointStatus
+    {
+        std::string name;
+        bool isHealthy;
+        std::chrono::milliseconds averageFirstByte; /*!< Moving average, 0 when unknown */
+        std::chrono::milliseconds hedgeDelay;       /*!< Hedged request after this time without first byte */
+        uint64_t requests;
+        uint64_t wins;
+        uint64_t failures;
+    };
+
+    explicit HedgedFetcher(const std::vector<std::string> &endpoints, const std::string &timeout, std::size_t connections);
+    ~HedgedFetcher();
+    std::size_t getSize() const;
+    void fetch(const std::string &path, FetchSink &sink, const FetchTimeoutPolicy::Deadline &deadline);
+    std::vector<EndpointStatus> getStatus();
+    static std::vector<std::string> parseEndpoints(const std::string &endpoints);
+
+private:
+    /**
+     * \struct Endpoint
+     * \brief API endpoint with its health, the health is guarded by the mutex
+     */
+    struct Endpoint
+    {
+        std::string name;
+        std::unique_ptr<IPFSSocketClient> client;
+        std::deque<std::chrono::milliseconds> firstByte; /*!< Recent times to first byte, most recent last */
+        double averageFirstByte;                         /*!< Moving average in ms, negative when unknown */
+        unsigned int consecutiveFailures;
+        std::chrono::steady_clock::time_point retryAfter; /*!< Unhealthy until */
+        uint64_t requests;
+        uint64_t wins;
+        uint64_t failures;
+    };
+
+    /**
+     * \struct Hedge
+     * \brief Shared state of a hedged fetch and its attempts, guarded by the mutex (except the cancel flags)
+     */
+    struct Hedge
+    {
+        std::mutex mutex;
+        std::condition_variable changed; /*!< Data received, attempt failed or winner done */
+        std::deque<std::string> contents;         /*!< Received data per attempt not yet passed to the caller, only the winner receives data */
+        std::deque<std::atomic<bool>> cancelled;  /*!< Cancel flag per attempt */
+        std::size_t totalSize;
+        int winner; /*!< Attempt with the first data, -1 when undecided */
+        std::chrono::steady_clock::time_point decided; /*!< Time the winner is known */
+        bool isDone;
+        std::size_t failed; /*!< Attempts failed before a winner */
+        std::exception_ptr error;
+    };
+
+    std::vector<Endpoint> endpoints;
+    std::mutex mutex;
+    std::condition_variable attemptEnded;
+    std::set<std::shared_ptr<Hedge>> hedges; /*!< In-flight hedged fetches */
+    std::size_t runningAttempts;
+
+    std::vector<std::size_t> getOrder();
+    std::chrono::milliseconds getHedgeDelay(const Endpoint &endpoint, const FetchTimeoutPolicy::Deadline &deadline) const;
+    void launch(std::shared_ptr<Hedge> hedge, std::size_t endpoint, const std::string &path, std::size_t maxSize, const FetchTimeoutPolicy::Deadline &deadline);
+    void runAttempt(std::shared_ptr<Hedge> hedge, int attempt, std::size_t endpoint, const std::string &path, std::size_t maxSize,
+                    FetchTimeoutPolicy::Deadline deadline);
+    void recordFirstByte(Endpoint &endpoint, std::chrono::milliseconds firstByte);
+    static void cancelAttempts(Hedge &hedge, int except);
+};
+#endif
@@ -0,0 +1,128 @@
+#include "ipfs-client-pool.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Idle connections might be closed by the daemon meanwhile, those clients are not reused
+    const std::chrono::seconds MAX_IDLE_TIME(30);
+} // namespace
+
+IPFSClientPool::Lease::Lease(IPFSClientPool &pool, std::unique_ptr<ipfs::Client> client, bool isReused)
+    : pool(&pool),
+      client(std::move(client)),
+      isReused(isReused),
+      isKept(false),
+      start(std::chrono::steady_clock::now())
+{
+}
+
+IPFSClientPool::Lease::Lease(Lease &&other) noexcept
+    : pool(other.pool),
+      client(std::move(other.client)),
+      isReused(other.isReused),
+      isKept(other.isKept),
+      start(other.start)
+{
+}
+
+/**
+ * \brief Return the client to the pool
+ */
+IPFSClientPool::Lease::~Lease()
+{
+    if (this->client)
+        this->pool->release(std::move(this->client), this->isReused, this->isKept, std::chrono::steady_clock::now() - this->start);
+}
+
+ipfs::Client *IPFSClientPool::Lease::operator->()
+{
+    return this->client.get();
+}
+
+/**
+ * \brief Mark the request as succeeded, the client (and its connection) can be reused
+ */
+void IPFSClientPool::Lease::keep()
+{
+    this->isKept = true;
+}
+
+/**
+ * \brief Create client pool
+ * \param host IPFS host (eg. localhost)
+ * \param port IPFS port number (5001)
+ * \param timeout IPFS time-out (which is a string, eg. "6s" for 6 seconds)
+ * \param size Max. number of idle clients kept in the pool
+ */
+IPFSClientPool::IPFSClientPool(const std::string &host, int port, const std::string &timeout, std::size_t size)
+    : host(host),
+      port(port),
+      timeout(timeout),
+      size(size),
+      metrics()
+{
+}
+
+/**
+ * \brief Check out a client, the most recently used idle client is reused (never blocks, a new client is created when none is idle)
+ */
+IPFSClientPool::Lease IPFSClientPool::acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto now = std::chrono::steady_clock::now();
+        while (!this->idleClients.empty())
+        {
+            IdleClient idle = std::move(this->idleClients.back());
+            this->idleClients.pop_back();
+            if (now - idle.lastUsed < MAX_IDLE_TIME)
+                return Lease(*this, std::move(idle.client), true);
+            this->metrics.discarded++;
+        }
+    }
+    return Lease(*this, std::make_unique<ipfs::Client>(this->host, this->port, this->timeout), false);
+}
+
+/**
+ * \brief Remove the idle clients of which the connection is likely closed (idle for too long)
+ */
+void IPFSClientPool::checkHealth()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto now = std::chrono::steady_clock::now();
+    auto isStale = [&now](const IdleClient &idle) { return now - idle.lastUsed >= MAX_IDLE_TIME; };
+    auto staleBegin = std::remove_if(this->idleClients.begin(), this->idleClients.end(), isStale);
+    this->metrics.discarded += static_cast<uint64_t>(this->idleClients.end() - staleBegin);
+    this->idleClients.erase(staleBegin, this->idleClients.end());
+}
+
+IPFSClientPool::Metrics IPFSClientPool::getMetrics()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->metrics;
+}
+
+void IPFSClientPool::release(std::unique_ptr<ipfs::Client> client, bool isReused, bool isKept, std::chrono::steady_clock::duration elapsed)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!isKept)
+    {
+        // Connection is in an unknown state after a failure
+        this->metrics.discarded++;
+        return;
+    }
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    if (isReused)
+    {
+        this->metrics.reusedRequests++;
+        this->metrics.reusedSeconds += seconds;
+    }
+    else
+    {
+        this->metrics.newRequests++;
+        this->metrics.newSeconds += seconds;
+    }
+    if (this->idleClients.size() < this->size)
+        this->idleClients.push_back(IdleClient{std::move(client), std::chrono::steady_clock::now()});
+}
@@ -0,0 +1,80 @@
+#ifndef IPFS_CLIENT_POOL_H
+#define IPFS_CLIENT_POOL_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ipfs/client.h"
+
+/**
+ * \class IPFSClientPool
+ * \brief Thread-safe pool of IPFS HTTP API clients. Each client keeps its curl handle,
+ * so the HTTP (keep-alive) connection to the daemon is reused by the next request.
+ * Clients are checked out with acquire() and returned when the lease goes out of scope.
+ */
+class IPFSClientPool
+{
+public:
+    /**
+     * \struct Metrics
+     * \brief Request timings, split by reused connections and new connections
+     */
+    struct Metrics
+    {
+        uint64_t reusedRequests;
+        uint64_t newRequests;
+        double reusedSeconds; /*!< Total time of the requests on a reused connection */
+        double newSeconds;    /*!< Total time of the requests on a new connection (including connect) */
+        uint64_t discarded;   /*!< Clients dropped after a failed request or being idle for too long */
+    };
+
+    /**
+     * \class Lease
+     * \brief Checked out client. Call keep() after a successful request, otherwise the client is discarded
+     * (eg. on exceptions or thread cancellation, where the connection state is unknown).
+     */
+    class Lease
+    {
+    public:
+        Lease(IPFSClientPool &pool, std::unique_ptr<ipfs::Client> client, bool isReused);
+        Lease(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+        ~Lease();
+        ipfs::Client *operator->();
+        void keep();
+
+    private:
+        IPFSClientPool *pool;
+        std::unique_ptr<ipfs::Client> client;
+        bool isReused;
+        bool isKept;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    explicit IPFSClientPool(const std::string &host, int port, const std::string &timeout, std::size_t size);
+    Lease acquire();
+    void checkHealth();
+    Metrics getMetrics();
+
+private:
+    struct IdleClient
+    {
+        std::unique_ptr<ipfs::Client> client;
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    std::string host;
+    int port;
+    std::string timeout;
+    std::size_t size; /*!< Max. number of idle clients kept */
+    std::mutex mutex;
+    std::vector<IdleClient> idleClients; /*!< Most recently used last */
+    Metrics metrics;
+
+    void release(std::unique_ptr<ipfs::Client> client, bool isReused, bool isKept, std::chrono::steady_clock::duration elapsed);
+};
+#endif
@@ -0,0 +1,292 @@
+#include "ipfs-daemon-supervisor.h"
+#include "ipfs-process.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <errno.h>
+#include <iostream>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    const std::chrono::milliseconds STARTING_INTERVAL(250); /*!< Fall-back check while the daemon isn't ready (next to inotify) */
+    const std::chrono::milliseconds READY_INTERVAL(1000);   /*!< Check while the daemon is ready (stopped daemon) */
+    const std::chrono::seconds RESTART_BACKOFF(1);
+    const std::chrono::seconds MAX_RESTART_BACKOFF(60);
+    const std::chrono::seconds STABLE_UPTIME(60); /*!< A daemon running this long resets the back-off */
+} // namespace
+
+IPFSDaemonSupervisor::IPFSDaemonSupervisor()
+    : ready(false),
+      stopping(false),
+      wakeUpFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+}
+
+/**
+ * \brief Stop supervising, the daemon keeps running
+ */
+IPFSDaemonSupervisor::~IPFSDaemonSupervisor()
+{
+    this->stopping = true;
+    if (this->wakeUpFd >= 0)
+    {
+        uint64_t value = 1;
+        if (write(this->wakeUpFd, &value, sizeof(value)) < 0)
+        {
+            // ignore, the thread stops at the next check
+        }
+    }
+    if (this->worker.joinable())
+        this->worker.join();
+    if (this->wakeUpFd >= 0)
+        close(this->wakeUpFd);
+}
+
+/**
+ * \brief Start the supervisor thread, which finds or starts the daemon right away
+ */
+void IPFSDaemonSupervisor::start()
+{
+    if (!this->worker.joinable())
+        this->worker = std::thread(&IPFSDaemonSupervisor::run, this);
+}
+
+/**
+ * \brief Set the callback when the daemon is ready, called at once when the daemon is already ready.
+ * After removing the callback (nullptr), it isn't called anymore.
+ */
+void IPFSDaemonSupervisor::setReadyCallback(const ReadyCallback &onReady)
+{
+    std::lock_guard<std::mutex> lock(this->callbackMutex);
+    this->onReady = onReady;
+    if (this->onReady && this->isReady())
+        this->onReady();
+}
+
+/**
+ * \brief Check if the daemon API accepts connections (thread-safe)
+ */
+bool IPFSDaemonSupervisor::isReady()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->ready;
+}
+
+void IPFSDaemonSupervisor::run()
+{
+    std::string repoPath = IPFSProcess::getRepoPath();
+    std::string executable = IPFSProcess::findIPFSBinary();
+    pid_t child = 0; // Daemon started by the browser
+    bool isStartPending = true;
+    std::chrono::steady_clock::time_point startAt = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::time_point startedAt;
+    unsigned int restarts = 0;
+
+    pid_t daemonPID = IPFSProcess::getRunningDaemonPID();
+    // Valid PID?
+    if (daemonPID > 0)
+    {
+        // Terminate a daemon of another installation if needed
+        if (IPFSProcess::shouldProcessTerminated(daemonPID))
+        {
+            std::cout << "INFO: Already running ipfs process will be terminated." << std::endl;
+            if (!IPFSProcess::terminateProcess(daemonPID))
+                std::cerr << "WARNING: Could not terminate the running ipfs process, with PID: " << std::to_string(daemonPID) << std::endl;
+        }
+        else
+        {
+            std::cout << "INFO: Keep using the current running IPFS process, with PID: " << std::to_string(daemonPID) << std::endl;
+        }
+    }
+
+    // The repository is watched once it exists (the first start creates it)
+    int inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    int watch = -1;
+    while (!this->stopping)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (isStartPending && now >= startAt)
+        {
+            isStartPending = false;
+            // Don't start a second daemon on the same repository, use the running one
+            if (IPFSProcess::getRunningDaemonPID() == 0)
+            {
+                if (executable.empty())
+                {
+                    std::cerr << "Error: IPFS Daemon is not found. IPFS will not work!" << std::endl;
+                }
+                else
+                {
+                    child = IPFSProcess::startIPFSDaemon(executable);
+                    startedAt = std::chrono::steady_clock::now();
+                    if (child < 0)
+                    {
+                        std::cerr << "Error: Could not start the IPFS Daemon, using: " << executable << std::endl;
+                        child = 0;
+                    }
+                }
+            }
+        }
+        if (inotifyFd >= 0 && watch < 0)
+            watch = inotify_add_watch(inotifyFd, repoPath.c_str(), IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM);
+
+        std::string address = IPFSProcess::getAPIAddress();
+        if (!this->isReady())
+        {
+            // The API file can be left behind by a crashed daemon, probe the address
+            if (!address.empty() && probe(address))
+            {
+                std::cout << "INFO: IPFS Daemon is ready, API: " << address << std::endl;
+                this->setReady(true);
+            }
+        }
+        else if (address.empty())
+        {
+            // API file is removed during shut-down
+            this->setReady(false);
+        }
+
+        bool isStopped = false;
+        std::string reason = "not running";
+        if (child > 0)
+        {
+            int status = 0;
+            pid_t res = waitpid(child, &status, WNOHANG);
+            isStopped = (res == child || (res < 0 && errno == ECHILD));
+            if (res == child && WIFEXITED(status))
+                reason = "exit code " + std::to_string(WEXITSTATUS(status));
+            else if (res == child && WIFSIGNALED(status))
+                reason = "signal " + std::to_string(WTERMSIG(status));
+        }
+        else if (!isStartPending && !executable.empty())
+        {
+            // Daemon of another process (eg. another browser) is stopped when the repository lock is released, take over
+            isStopped = (IPFSProcess::getRunningDaemonPID() == 0);
+        }
+        if (isStopped)
+        {
+            this->setReady(false);
+            if (child > 0 && std::chrono::steady_clock::now() - startedAt >= STABLE_UPTIME)
+                restarts = 0;
+            child = 0;
+            std::chrono::seconds backoff = std::min(MAX_RESTART_BACKOFF, RESTART_BACKOFF * (1 << std::min(restarts, 6u)));
+            restarts++;
+            std::cerr << "WARNING: IPFS Daemon is stopped (" << reason << "), restart in " << std::to_string(backoff.count()) << " seconds." << std::endl;
+            isStartPending = true;
+            startAt = std::chrono::steady_clock::now() + backoff;
+        }
+
+        std::chrono::milliseconds timeout = this->isReady() ? READY_INTERVAL : STARTING_INTERVAL;
+        if (isStartPending)
+            timeout = std::max(std::chrono::milliseconds(0),
+                               std::min(timeout, std::chrono::duration_cast<std::chrono::milliseconds>(startAt - std::chrono::steady_clock::now())));
+        this->waitForEvent(inotifyFd, timeout);
+    }
+    if (inotifyFd >= 0)
+        close(inotifyFd);
+}
+
+/**
+ * \brief Wait for a change in the repository directory (eg. the API file), a stop or the time-out
+ */
+void IPFSDaemonSupervisor::waitForEvent(int inotifyFd, std::chrono::milliseconds timeout)
+{
+    struct pollfd fds[2] = {{this->wakeUpFd, POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+    if (poll(fds, (inotifyFd >= 0) ? 2 : 1, static_cast<int>(timeout.count())) <= 0)
+        return;
+    // Drain the events, the state is checked again anyway
+    if (inotifyFd >= 0 && (fds[1].revents & POLLIN))
+    {
+        char buffer[4096];
+        while (read(inotifyFd, buffer, sizeof(buffer)) > 0)
+        {
+        }
+    }
+}
+
+void IPFSDaemonSupervisor::setReady(bool ready)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->ready == ready)
+            return;
+        this->ready = ready;
+    }
+    if (ready)
+    {
+        std::lock_guard<std::mutex> lock(this->callbackMutex);
+        if (this->onReady)
+            this->onReady();
+    }
+}
+
+/**
+ * \brief Check if the API address accepts connections
+ * \param address Multiaddress of the API file (eg. "/ip4/127.0.0.1/tcp/5001" or "/unix/run/ipfs.sock")
+ */
+bool IPFSDaemonSupervisor::probe(const std::string &address)
+{
+    std::vector<std::string> parts;
+    std::size_t start = 1;
+    while (start <= address.size())
+    {
+        std::size_t end = address.find('/', start);
+        if (end == std::string::npos)
+            end = address.size();
+        parts.push_back(address.substr(start, end - start));
+        start = end + 1;
+    }
+
+    int fd = -1;
+    if (parts.size() >= 2 && parts[0] == "unix")
+    {
+        std::string path = address.substr(5);
+        struct sockaddr_un socketAddress;
+        memset(&socketAddress, 0, sizeof(socketAddress));
+        if (path.size() >= sizeof(socketAddress.sun_path))
+            return false;
+        socketAddress.sun_family = AF_UNIX;
+        memcpy(socketAddress.sun_path, path.c_str(), path.size());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+        bool isConnected = (connect(fd, reinterpret_cast<struct sockaddr *>(&socketAddress), sizeof(socketAddress)) == 0);
+        close(fd);
+        return isConnected;
+    }
+    if (parts.size() < 4 || parts[2] != "tcp")
+        return false;
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = (parts[0] == "ip4" || parts[0] == "dns4") ? AF_INET : (parts[0] == "ip6" || parts[0] == "dns6") ? AF_INET6 : AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    struct addrinfo *result = nullptr;
+    if (getaddrinfo(parts[1].c_str(), parts[3].c_str(), &hints, &result) != 0)
+        return false;
+    bool isConnected = false;
+    for (struct addrinfo *info = result; info && !isConnected; info = info->ai_next)
+    {
+        fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+        if (fd < 0)
+            continue;
+        // Bounds the connect time
+        struct timeval timeout = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        isConnected = (connect(fd, info->ai_addr, info->ai_addrlen) == 0);
+        close(fd);
+    }
+    freeaddrinfo(result);
+    return isConnected;
+}
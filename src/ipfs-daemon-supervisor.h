@@ -0,0 +1,46 @@
+#ifndef IPFS_DAEMON_SUPERVISOR_H
+#define IPFS_DAEMON_SUPERVISOR_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * \class IPFSDaemonSupervisor
+ * \brief Starts and supervises the IPFS daemon on a background thread. A running daemon is found by the lock and API file
+ * of the repository. The daemon is ready once its API file is written (watched with inotify) and its API address accepts
+ * connections. A daemon that stopped unexpectedly is restarted, with exponential back-off.
+ * The daemon keeps running when the browser exits.
+ */
+class IPFSDaemonSupervisor
+{
+public:
+    /**
+     * \brief Called (on the supervisor thread) when the daemon is ready
+     */
+    typedef std::function<void()> ReadyCallback;
+
+    IPFSDaemonSupervisor();
+    ~IPFSDaemonSupervisor();
+    void start();
+    void setReadyCallback(const ReadyCallback &onReady);
+    bool isReady();
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::mutex callbackMutex; /*!< Locked while the callback runs, so it can be removed safely */
+    ReadyCallback onReady;
+    bool ready;
+    std::atomic<bool> stopping;
+    int wakeUpFd; /*!< Event file descriptor, wakes the supervisor thread */
+
+    void run();
+    void waitForEvent(int inotifyFd, std::chrono::milliseconds timeout);
+    void setReady(bool ready);
+    static bool probe(const std::string &address);
+};
+#endif
@@ -1,11 +1,17 @@
 #include "ipfs-process.h"
 #include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
+#include <spawn.h>
 #include <iostream>
 #include <string.h>
 #include <glibmm/miscutils.h>
 #include <glibmm/fileutils.h>
+#include <glib/gstdio.h>
+
+extern char **environ;
 
 #ifdef LEGACY_CXX
 #include <experimental/filesystem>
@@ -16,90 +22,91 @@ namespace n_fs = ::std::filesystem;
 #endif
 
 /**
- * \brief Start IPFS Daemon in the background via fork() see: main.cc
- * \return exit code
+ * \brief Start the IPFS daemon in the background via posix_spawn(), the output is discarded.
+ * The API only listens on a private Unix domain socket (the socket directory is only accessible by the user),
+ * the address is passed for this run only, the configuration of the repository is not changed.
+ * \param executable Path to the ipfs binary
+ * \return PID of the daemon, -1 on error
  */
-int IPFSProcess::startIPFSDaemon()
+pid_t IPFSProcess::startIPFSDaemon(const std::string &executable)
 {
-    bool startIPFSDaemon = true;
-    pid_t daemonPID = IPFSProcess::getRunningDaemonPID();
-    // Valid PID?
-    if (daemonPID > 0)
+    std::cout << "INFO: Starting IPFS Daemon, using: " << executable << std::endl;
+    std::vector<std::string> arguments{"daemon", "--init", "--migrate"};
+    std::string socketPath = IPFSProcess::getAPISocketPath();
+    if (g_mkdir_with_parents(Glib::path_get_dirname(socketPath).c_str(), 0700) == 0)
     {
-        // Kill any running IPFS daemon processes if needed
-        if (IPFSProcess::shouldProcessTerminated(daemonPID))
-        {
-            std::cout << "INFO: Already running ipfs process will be terminated." << std::endl;
-            int res = std::system("killall -w -q ipfs");
-            if (res != 0)
-            {
-                // ignore
-            }
-        }
-        else
-        {
-            // Keep running, don't start another daemon process
-             std::cout << "INFO: Keep using the current running IPFS process, with PID: " << std::to_string(daemonPID) << std::endl;
-            startIPFSDaemon = false;
-        }
+        // Stale socket of a previous daemon
+        g_unlink(socketPath.c_str());
+        arguments.push_back("--api=/unix" + socketPath);
     }
-
-    if (startIPFSDaemon)
+    else
     {
-        // Find the IPFS binary
-        std::string executable = IPFSProcess::findIPFSBinary();
-        std::cout << "INFO: Starting IPFS Daemon, using: " << executable << std::endl;
-        if (n_fs::exists(executable))
-        {
-            /// open /dev/null for writing
-            int fd = open("/dev/null", O_WRONLY);
-            dup2(fd, 1); // make stdout a copy of fd (> /dev/null)
-            dup2(fd, 2); // ..and same with stderr
-            close(fd);   // close fd
-            // stdout and stderr now write to /dev/null
-
-            // Ready to call exec to start IPFS Daemon
-            const char *exe = executable.c_str();
-            char *proc[] = {strdup(exe), strdup("daemon"), strdup("--init"), strdup("--migrate"), NULL};
-            return execv(exe, proc);
-        }
-        else
-        {
-            std::cerr << "Error: IPFS Daemon is not found. IPFS will not work!" << std::endl;
-            return -1;
-        }
+        std::cerr << "WARNING: Could not create the IPFS API socket directory, fall-back to the configured API address." << std::endl;
     }
-    return 0;
+    return IPFSProcess::spawn(executable, arguments);
 }
 
 /**
- * \brief Retrieve IPFS Daemon PID (zero if non-exists)
- * \return pid_t, 0 if non-exists, -1 on error
+ * \brief Path of the Unix domain socket of the IPFS API (of the daemon started by the browser)
+ * \return Socket path within the user runtime directory
  */
-pid_t IPFSProcess::getRunningDaemonPID()
+std::string IPFSProcess::getAPISocketPath()
 {
-    pid_t pid = 0; // PID of 0 is by definition not possible
-    FILE *cmd_pipe = popen("pidof -s ipfs", "r");
-    if (cmd_pipe != NULL)
-    {
-        char pidbuf[512];
-        memset(pidbuf, 0, sizeof(pidbuf));
-        if (fgets(pidbuf, 512, cmd_pipe) == NULL)
-        {
-            //ignore
-        }
-        pclose(cmd_pipe);
+    return Glib::build_filename(Glib::get_user_runtime_dir(), "libreweb-browser", "ipfs-api.sock");
+}
 
-        if (strlen(pidbuf) > 0)
-        {
-            pid = strtoul(pidbuf, NULL, 10);
-        }
+/**
+ * \brief Path of the IPFS repository, the same as the ipfs binary uses ($IPFS_PATH or ~/.ipfs)
+ */
+std::string IPFSProcess::getRepoPath()
+{
+    std::string repoPath = Glib::getenv("IPFS_PATH");
+    if (repoPath.empty())
+        repoPath = Glib::build_filename(Glib::get_home_dir(), ".ipfs");
+    return repoPath;
+}
+
+/**
+ * \brief Read the API address of the running daemon, the daemon writes it to the repository once the API listens
+ * (and removes it on shut-down)
+ * \return Multiaddress (eg. "/ip4/127.0.0.1/tcp/5001"), empty string when there is no API file
+ */
+std::string IPFSProcess::getAPIAddress()
+{
+    std::string address;
+    try
+    {
+        address = Glib::file_get_contents(Glib::build_filename(IPFSProcess::getRepoPath(), "api"));
     }
-    else
+    catch (const Glib::FileError &error)
     {
-        pid = -1; // on error
+        return "";
     }
-    return pid;
+    std::size_t end = address.find_last_not_of(" \t\r\n");
+    return (end == std::string::npos) ? "" : address.substr(0, end + 1);
+}
+
+/**
+ * \brief Retrieve the PID of the IPFS daemon, the process that holds the lock of the repository
+ * \return pid_t, 0 if non-exists, -1 on error (or the lock owner is unknown)
+ */
+pid_t IPFSProcess::getRunningDaemonPID()
+{
+    std::string lockPath = Glib::build_filename(IPFSProcess::getRepoPath(), "repo.lock");
+    int fd = open(lockPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return (errno == ENOENT) ? 0 : -1;
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    int res = fcntl(fd, F_GETLK, &lock);
+    close(fd);
+    if (res != 0)
+        return -1;
+    if (lock.l_type == F_UNLCK)
+        return 0; // Lock file of a stopped daemon
+    return (lock.l_pid > 0) ? lock.l_pid : -1;
 }
 
 /**
@@ -126,6 +133,29 @@ bool IPFSProcess::shouldProcessTerminated(pid_t pid)
     }
 }
 
+/**
+ * \brief Terminate a process that isn't a child (eg. a daemon of another installation),
+ * waits until the repository lock is released
+ * \return true if terminated, otherwise false
+ */
+bool IPFSProcess::terminateProcess(pid_t pid)
+{
+    const int signals[] = {SIGTERM, SIGKILL};
+    for (int signal : signals)
+    {
+        if (kill(pid, signal) != 0)
+            return (errno == ESRCH);
+        // Graceful shut-down gets 10 seconds, after a kill it should be gone at once
+        for (int i = 0; i < ((signal == SIGTERM) ? 100 : 20); ++i)
+        {
+            if (IPFSProcess::getRunningDaemonPID() != pid)
+                return true;
+            usleep(100000);
+        }
+    }
+    return false;
+}
+
 /**
  * \brief Try to find the binary location of ipfs (IPFS go server)
  * \return full path to the ipfs binary, empty string when not found
@@ -155,4 +185,38 @@ std::string IPFSProcess::findIPFSBinary()
     {
         return "";
     }
-}
\ No newline at end of file
+}
+
+/**
+ * \brief Spawn a process (without forking the browser), stdin/stdout/stderr are redirected to /dev/null
+ * \param executable Path to the binary
+ * \param arguments Command-line arguments
+ * \return PID of the child process, -1 on error
+ */
+pid_t IPFSProcess::spawn(const std::string &executable, const std::vector<std::string> &arguments)
+{
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(executable.c_str()));
+    for (const std::string &argument : arguments)
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    // Signals blocked by the browser threads shouldn't be blocked in the child
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attributes, &mask);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK);
+
+    pid_t pid = -1;
+    int res = posix_spawn(&pid, executable.c_str(), &actions, &attributes, argv.data(), environ);
+    posix_spawnattr_destroy(&attributes);
+    posix_spawn_file_actions_destroy(&actions);
+    return (res == 0) ? pid : -1;
+}
@@ -2,19 +2,26 @@
 #define IPFS_PROCESS_H
 
 #include <string>
+#include <sys/types.h>
+#include <vector>
 
 /**
  * \class IPFSProcess
- * \brief Helper class to start/stop IPFS deamon, all static methods
+ * \brief Helper class to find, start and stop the IPFS deamon, all static methods
  */
 class IPFSProcess
 {
 public:
-    static int startIPFSDaemon();
-
-private:
+    static pid_t startIPFSDaemon(const std::string &executable);
+    static std::string getAPISocketPath();
+    static std::string getRepoPath();
+    static std::string getAPIAddress();
     static pid_t getRunningDaemonPID();
     static bool shouldProcessTerminated(pid_t pid);
+    static bool terminateProcess(pid_t pid);
     static std::string findIPFSBinary();
+
+private:
+    static pid_t spawn(const std::string &executable, const std::vector<std::string> &arguments);
 };
 #endif
\ No newline at end of file
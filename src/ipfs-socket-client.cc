@@ -0,0 +1,337 @@
+#include "ipfs-socket-client.h"
+
+#include <curl/curl.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <strings.h>
+#include <sys/stat.h>
+
+namespace
+{
+    struct HandleDeleter
+    {
+        void operator()(CURL *handle) const
+        {
+            curl_easy_cleanup(handle);
+        }
+    };
+
+    /**
+     * \brief Destinations of a transfer: the content, or the error message for error responses
+     */
+    struct Sinks
+    {
+        CURL *handle;
+        FetchSink *content;
+        FetchSink *error;
+        const IPFSSocketClient::FetchOptions &options;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point lastData;
+        curl_off_t downloaded;
+        std::string timeoutMessage; /*!< Set when the transfer is aborted by a deadline */
+        bool isClaimed;
+    };
+
+    /**
+     * \brief Transfer progress (also called periodically while idle), returning non-zero aborts the transfer
+     * when the sink is aborted, the fetch is cancelled or a deadline is passed
+     */
+    int progressCallback(void *userData, curl_off_t, curl_off_t downloaded, curl_off_t, curl_off_t)
+    {
+        auto sinks = static_cast<Sinks *>(userData);
+        // A stalled transfer doesn't reach the write callback, so the abort is noticed here
+        if (sinks->content->checkAbort() || (sinks->options.cancelled && *sinks->options.cancelled))
+            return 1;
+        auto now = std::chrono::steady_clock::now();
+        const std::chrono::milliseconds &firstByteTimeout = sinks->options.firstByteTimeout;
+        const std::chrono::milliseconds &totalTimeout = sinks->options.totalTimeout;
+        if (downloaded != sinks->downloaded)
+        {
+            sinks->downloaded = downloaded;
+            sinks->lastData = now;
+        }
+        if (firstByteTimeout.count() > 0 && downloaded == 0 && now - sinks->start > firstByteTimeout)
+        {
+            sinks->timeoutMessage = "no data received within " + std::to_string(firstByteTimeout.count()) + " ms";
+            return 1;
+        }
+        // A slow but progressing transfer continues after the total time-out (until the time-out of the daemon)
+        if (totalTimeout.count() > 0 && firstByteTimeout.count() > 0 && now - sinks->start > totalTimeout && now - sinks->lastData > firstByteTimeout)
+        {
+            sinks->timeoutMessage = "transfer stalled after " + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now - sinks->start).count()) + " ms";
+            return 1;
+        }
+        return 0;
+    }
+} // namespace
+
+/**
+ * \brief Create socket client
+ * \param socketPath Path of the Unix domain socket of the IPFS API
+ * \param timeout IPFS time-out (which is a string, eg. "6s" for 6 seconds)
+ * \param size Max. number of idle (keep-alive) connections
+ */
+IPFSSocketClient::IPFSSocketClient(const std::string &socketPath, const std::string &timeout, std::size_t size)
+    : socketPath(socketPath),
+      baseURL("http://localhost"),
+      isTCP(false),
+      timeout(timeout),
+      size(size)
+{
+}
+
+/**
+ * \brief Create TCP client
+ * \param host API host (eg. 192.168.1.10)
+ * \param port API port number (5001)
+ * \param timeout IPFS time-out (which is a string, eg. "6s" for 6 seconds)
+ * \param size Max. number of idle (keep-alive) connections
+ */
+IPFSSocketClient::IPFSSocketClient(const std::string &host, int port, const std::string &timeout, std::size_t size)
+    : baseURL("http://" + host + ":" + std::to_string(port)),
+      isTCP(true),
+      timeout(timeout),
+      size(size)
+{
+}
+
+IPFSSocketClient::~IPFSSocketClient()
+{
+    for (CURL *handle : this->idleHandles)
+        curl_easy_cleanup(handle);
+}
+
+/**
+ * \brief Check if the API socket exists (the daemon is listening on it), a TCP client is always available
+ */
+bool IPFSSocketClient::isAvailable() const
+{
+    if (this->isTCP)
+        return true;
+    struct stat info;
+    return !this->socketPath.empty() && ::stat(this->socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+/**
+ * \brief Fetch file from IPFS network (thread-safe), the body is streamed into the sink
+ * \param path IPFS path
+ * \param sink Destination, the transfer is aborted as soon as the max. size of the sink is exceeded
+ * \param options Deadlines (besides the configured time-out) and cancellation
+ * \throw IPFSSocketClient::ConnectError when the socket can't be connected
+ * \throw std::runtime_error when the request failed (same messages as the ipfs::Client)
+ */
+void IPFSSocketClient::cat(const std::string &path, FetchSink &sink, const FetchOptions &options)
+{
+    this->perform("cat", {{"arg", path}}, sink, (options.timeout.count() > 0) ? std::to_string(options.timeout.count()) + "ms" : this->timeout, options);
+}
+
+/**
+ * \brief Do an API request with a small (JSON) response (thread-safe)
+ * \param command API command (eg. "name/resolve")
+ * \param arguments Query arguments, values are escaped
+ * \param timeout Time-out of the request in the daemon (0 is the configured time-out)
+ * \throw IPFSSocketClient::ConnectError when the socket can't be connected
+ * \throw std::runtime_error when the request failed (same messages as the ipfs::Client)
+ * \return Response body
+ */
+std::string IPFSSocketClient::request(const std::string &command, const Arguments &arguments, std::chrono::milliseconds timeout)
+{
+    std::string response;
+    FetchSink sink(response, 1024 * 1024);
+    this->perform(command, arguments, sink, (timeout.count() > 0) ? std::to_string(timeout.count()) + "ms" : this->timeout, FetchOptions());
+    return response;
+}
+
+/**
+ * \brief Do an API request with a streamed response of one JSON object per line (thread-safe), eg. "ls" with stream=true.
+ * The lines are passed as they are received, so the caller can stop before the whole response is sent.
+ * \param command API command
+ * \param arguments Query arguments, values are escaped
+ * \param onLine Called for every line (on this thread), returning false aborts the transfer
+ * \throw IPFSSocketClient::ConnectError when the socket can't be connected
+ * \throw std::runtime_error when the request failed, or the exception thrown by the callback
+ */
+void IPFSSocketClient::requestLines(const std::string &command, const Arguments &arguments, const LineCallback &onLine)
+{
+    std::string buffer;
+    bool isStopped = false;
+    std::exception_ptr error;
+    auto passLines = [&](bool isEnd) {
+        std::size_t begin = 0;
+        std::size_t end;
+        while (!isStopped && begin < buffer.size())
+        {
+            end = buffer.find('\n', begin);
+            if (end == std::string::npos && !isEnd)
+                break;
+            if (end == std::string::npos)
+                end = buffer.size();
+            try
+            {
+                if (end > begin && !onLine(buffer.substr(begin, end - begin)))
+                    isStopped = true;
+            }
+            // Not catch (...): the thread cancellation (forced unwind) of the request thread needs to pass
+            catch (const std::exception &)
+            {
+                error = std::current_exception();
+                isStopped = true;
+            }
+            begin = end + 1;
+        }
+        buffer.erase(0, std::min(begin, buffer.size()));
+    };
+    // The received lines are taken out of the buffer, so the response size isn't limited
+    FetchSink sink(buffer, 0, [&](std::size_t, std::size_t) {
+        passLines(false);
+        if (isStopped)
+            sink.abort();
+    });
+    try
+    {
+        this->perform(command, arguments, sink, this->timeout, FetchOptions());
+    }
+    catch (const ConnectError &)
+    {
+        throw;
+    }
+    catch (const std::runtime_error &)
+    {
+        // Aborted by the callback
+        if (!isStopped)
+            throw;
+    }
+    if (error)
+        std::rethrow_exception(error);
+    passLines(true);
+    if (error)
+        std::rethrow_exception(error);
+}
+
+/**
+ * \brief Do an API request (POST), the time-out is added to the arguments.
+ * The first byte and total time-outs are enforced by the client, the time-out argument by the daemon.
+ */
+void IPFSSocketClient::perform(const std::string &command, const Arguments &arguments, FetchSink &sink, const std::string &timeout, const FetchOptions &options)
+{
+    // Handle is cleaned-up on errors (or thread cancellation), the connection state is unknown
+    std::unique_ptr<CURL, HandleDeleter> handle(this->acquireHandle());
+    if (!handle)
+        throw std::runtime_error("Could not create curl handle");
+    std::string url = this->baseURL + "/api/v0/" + command + "?timeout=" + timeout;
+    for (const auto &argument : arguments)
+    {
+        char *escaped = curl_easy_escape(handle.get(), argument.second.c_str(), static_cast<int>(argument.second.size()));
+        url += "&" + argument.first + "=" + escaped;
+        curl_free(escaped);
+    }
+
+    // Error responses are small, they are kept apart from the content
+    std::string errorResponse;
+    FetchSink errorSink(errorResponse, 64 * 1024);
+    auto start = std::chrono::steady_clock::now();
+    Sinks sinks{handle.get(), &sink, &errorSink, options, start, start, 0, "", false};
+
+    char errorBuffer[CURL_ERROR_SIZE] = {0};
+    curl_easy_setopt(handle.get(), CURLOPT_UNIX_SOCKET_PATH, this->socketPath.empty() ? nullptr : this->socketPath.c_str());
+    curl_easy_setopt(handle.get(), CURLOPT_URL, url.c_str());
+    curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDS, "");
+    curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDSIZE, 0L);
+    curl_easy_setopt(handle.get(), CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle.get(), CURLOPT_WRITEFUNCTION, &IPFSSocketClient::writeCallback);
+    curl_easy_setopt(handle.get(), CURLOPT_WRITEDATA, &sinks);
+    curl_easy_setopt(handle.get(), CURLOPT_HEADERFUNCTION, &IPFSSocketClient::headerCallback);
+    curl_easy_setopt(handle.get(), CURLOPT_HEADERDATA, &sinks);
+    // The progress callback is always enabled, the sink can be aborted at any time (eg. by the fetch coalescer)
+    curl_easy_setopt(handle.get(), CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(handle.get(), CURLOPT_XFERINFOFUNCTION, &progressCallback);
+    curl_easy_setopt(handle.get(), CURLOPT_XFERINFODATA, &sinks);
+    curl_easy_setopt(handle.get(), CURLOPT_ERRORBUFFER, errorBuffer);
+    CURLcode result = curl_easy_perform(handle.get());
+    curl_easy_setopt(handle.get(), CURLOPT_ERRORBUFFER, nullptr);
+    if (sink.isAborted() || (options.cancelled && *options.cancelled))
+        throw std::runtime_error("Transfer is aborted");
+    if (sink.isTooLarge())
+        throw std::runtime_error("File is too large, the maximum size is " + std::to_string(sink.getMaxSize() / (1024 * 1024)) + " MB");
+    if (!sinks.timeoutMessage.empty())
+        throw std::runtime_error("Timeout was reached: " + sinks.timeoutMessage);
+    if (result != CURLE_OK)
+    {
+        std::string message = std::string(curl_easy_strerror(result)) + ": " + errorBuffer;
+        if (result == CURLE_COULDNT_CONNECT)
+            throw ConnectError(message);
+        throw std::runtime_error(message);
+    }
+    long statusCode = 0;
+    curl_easy_getinfo(handle.get(), CURLINFO_RESPONSE_CODE, &statusCode);
+    this->releaseHandle(handle.release());
+    if (statusCode != 200)
+        throw std::runtime_error("HTTP request failed with status code " + std::to_string(statusCode) + ". Response body:\n" + errorResponse);
+}
+
+CURL *IPFSSocketClient::acquireHandle()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (!this->idleHandles.empty())
+        {
+            CURL *handle = this->idleHandles.back();
+            this->idleHandles.pop_back();
+            return handle;
+        }
+    }
+    return curl_easy_init();
+}
+
+void IPFSSocketClient::releaseHandle(CURL *handle)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->idleHandles.size() < this->size)
+        {
+            this->idleHandles.push_back(handle);
+            return;
+        }
+    }
+    curl_easy_cleanup(handle);
+}
+
+/**
+ * \brief Body data, returning less than the received size aborts the transfer
+ */
+std::size_t IPFSSocketClient::writeCallback(char *data, std::size_t size, std::size_t count, void *userData)
+{
+    auto sinks = static_cast<Sinks *>(userData);
+    long statusCode = 0;
+    curl_easy_getinfo(sinks->handle, CURLINFO_RESPONSE_CODE, &statusCode);
+    FetchSink *sink = (statusCode == 200) ? sinks->content : sinks->error;
+    if (statusCode == 200 && !sinks->isClaimed && sinks->options.claim)
+    {
+        if (!sinks->options.claim())
+            return 0;
+        sinks->isClaimed = true;
+    }
+    return sink->append(data, size * count) ? size * count : 0;
+}
+
+/**
+ * \brief Header line, the content size is known upfront via the X-Content-Length header
+ */
+std::size_t IPFSSocketClient::headerCallback(char *data, std::size_t size, std::size_t count, void *userData)
+{
+    static const char CONTENT_LENGTH[] = "X-Content-Length:";
+    const std::size_t length = size * count;
+    const std::size_t prefixLength = sizeof(CONTENT_LENGTH) - 1;
+    if (length > prefixLength && strncasecmp(data, CONTENT_LENGTH, prefixLength) == 0)
+    {
+        std::string value(data + prefixLength, length - prefixLength);
+        auto sinks = static_cast<Sinks *>(userData);
+        if (!sinks->content->setTotalSize(std::strtoull(value.c_str(), nullptr, 10)))
+            return 0;
+    }
+    return length;
+}
+
@@ -0,0 +1,80 @@
+#ifndef IPFS_SOCKET_CLIENT_H
+#define IPFS_SOCKET_CLIENT_H
+
+#include "fetch-sink.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef void CURL;
+
+/**
+ * \class IPFSSocketClient
+ * \brief Minimal IPFS HTTP API client over a Unix domain socket, used for the daemon started by the browser.
+ * Avoids the loopback TCP overhead and the API is not reachable via the network stack.
+ * Can also connect via TCP, for API endpoints of other daemons (transfers can be aborted, unlike the ipfs::Client).
+ * Curl handles are pooled (thread-safe), so the socket connection is kept alive between requests.
+ */
+class IPFSSocketClient
+{
+public:
+    /**
+     * \class ConnectError
+     * \brief Could not connect to the socket, the caller can fall back to TCP
+     */
+    class ConnectError : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * \struct FetchOptions
+     * \brief Optional deadlines and cancellation of a fetch
+     */
+    struct FetchOptions
+    {
+        std::chrono::milliseconds firstByteTimeout{0}; /*!< Abort when no data is received within this time (0 is disabled) */
+        std::chrono::milliseconds totalTimeout{0};     /*!< After this time, abort when the transfer stalls for the first byte time-out (0 is disabled) */
+        std::chrono::milliseconds timeout{0};          /*!< Time-out of the request in the daemon (0 is the configured time-out) */
+        const std::atomic<bool> *cancelled = nullptr;  /*!< Set by another thread to abort the transfer */
+        std::function<bool()> claim;                   /*!< Called before the first content is written to the sink, false aborts the transfer */
+    };
+
+    typedef std::vector<std::pair<std::string, std::string>> Arguments;
+
+    /**
+     * \brief Line callback of a streamed response, returning false stops the request
+     */
+    typedef std::function<bool(const std::string &line)> LineCallback;
+
+    explicit IPFSSocketClient(const std::string &socketPath, const std::string &timeout, std::size_t size);
+    explicit IPFSSocketClient(const std::string &host, int port, const std::string &timeout, std::size_t size);
+    ~IPFSSocketClient();
+    bool isAvailable() const;
+    void cat(const std::string &path, FetchSink &sink, const FetchOptions &options);
+    std::string request(const std::string &command, const Arguments &arguments, std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+    void requestLines(const std::string &command, const Arguments &arguments, const LineCallback &onLine);
+
+private:
+    std::string socketPath; /*!< Empty for TCP */
+    std::string baseURL;
+    bool isTCP;
+    std::string timeout;
+    std::size_t size; /*!< Max. number of idle curl handles kept */
+    std::mutex mutex;
+    std::vector<CURL *> idleHandles;
+
+    void perform(const std::string &command, const Arguments &arguments, FetchSink &sink, const std::string &timeout, const FetchOptions &options);
+    CURL *acquireHandle();
+    void releaseHandle(CURL *handle);
+    static std::size_t writeCallback(char *data, std::size_t size, std::size_t count, void *userData);
+    static std::size_t headerCallback(char *data, std::size_t size, std::size_t count, void *userData);
+};
+#endif
@@ -0,0 +1,182 @@
+#include "ipfs-status-monitor.h"
+#include "ipfs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+    const std::chrono::seconds FOREGROUND_INTERVAL(3);
+    const std::chrono::seconds BACKGROUND_INTERVAL(15);
+    const std::chrono::seconds MAX_BACKOFF_INTERVAL(60); /*!< Max. interval while the daemon is down */
+    const std::size_t BANDWIDTH_HISTORY_SIZE = 40;
+} // namespace
+
+/**
+ * \brief Create status monitor, call start() to begin polling
+ * \param ipfs IPFS calls
+ * \param onUpdate Callback after each refresh (on the monitor thread), eg. to dispatch to the GUI thread
+ */
+IPFSStatusMonitor::IPFSStatusMonitor(IPFS &ipfs, const UpdateCallback &onUpdate)
+    : ipfs(ipfs),
+      onUpdate(onUpdate),
+      stopping(false),
+      isForeground(true),
+      wakeUp(false),
+      nextSample(0)
+{
+    this->samples.reserve(BANDWIDTH_HISTORY_SIZE);
+}
+
+/**
+ * \brief Stop polling, waits for the running refresh (if any)
+ */
+IPFSStatusMonitor::~IPFSStatusMonitor()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->condition.notify_all();
+    if (this->worker.joinable())
+        this->worker.join();
+}
+
+/**
+ * \brief Start the monitor thread, the first refresh is done immediately
+ */
+void IPFSStatusMonitor::start()
+{
+    if (!this->worker.joinable())
+        this->worker = std::thread(&IPFSStatusMonitor::run, this);
+}
+
+/**
+ * \brief Window is shown and focused (polling at normal rate) or in the background (slow polling).
+ * Coming to the foreground refreshes right away, unless the daemon is down.
+ */
+void IPFSStatusMonitor::setForeground(bool isForeground)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (isForeground && !this->isForeground && this->status && this->status->isDaemonRunning)
+            this->wakeUp = true;
+        this->isForeground = isForeground;
+    }
+    this->condition.notify_all();
+}
+
+/**
+ * \brief Refresh right away (eg. the daemon just started), instead of waiting for the next poll or back-off
+ */
+void IPFSStatusMonitor::refreshNow()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->wakeUp = true;
+    }
+    this->condition.notify_all();
+}
+
+/**
+ * \brief Latest status snapshot (thread-safe)
+ * \return Status, or nullptr before the first refresh is finished
+ */
+std::shared_ptr<const IPFSStatusMonitor::Status> IPFSStatusMonitor::getStatus()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->status;
+}
+
+void IPFSStatusMonitor::run()
+{
+    unsigned int failures = 0;
+    std::string version;
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping)
+    {
+        // A wake-up during the refresh causes another refresh
+        this->wakeUp = false;
+        lock.unlock();
+        auto next = std::make_shared<Status>();
+        next->version = version;
+        this->refresh(*next);
+        version = next->version;
+        bool isDaemonRunning = next->isDaemonRunning;
+        lock.lock();
+        this->status = next;
+        lock.unlock();
+        if (this->onUpdate)
+            this->onUpdate();
+        lock.lock();
+
+        std::chrono::seconds interval = this->isForeground ? FOREGROUND_INTERVAL : BACKGROUND_INTERVAL;
+        if (isDaemonRunning)
+        {
+            failures = 0;
+        }
+        else
+        {
+            // Exponential back-off: 3, 6, 12, ... seconds
+            failures = std::min(failures + 1, 8u);
+            interval = std::min(std::max(interval, FOREGROUND_INTERVAL * (1 << (failures - 1))), MAX_BACKOFF_INTERVAL);
+        }
+        this->condition.wait_for(lock, interval, [this] { return this->stopping || this->wakeUp; });
+    }
+}
+
+/**
+ * \brief Gather the status from the daemon (blocking), one Id call per refresh
+ */
+void IPFSStatusMonitor::refresh(Status &next)
+{
+    next.isDaemonRunning = false;
+    next.nrPeers = 0;
+    next.bandwidth = BandwidthSample{0.0, 0.0};
+    try
+    {
+        this->ipfs.getIdentity(next.clientID, next.clientPublicKey);
+        next.isDaemonRunning = true;
+    }
+    catch (const std::runtime_error &error)
+    {
+        // Daemon is not (yet) running
+    }
+    if (next.isDaemonRunning)
+    {
+        if (next.version.empty())
+            next.version = this->ipfs.getVersion();
+        next.nrPeers = this->ipfs.getNrPeers();
+        if (next.nrPeers > 0)
+        {
+            std::map<std::string, float> rates = this->ipfs.getBandwidthRates();
+            if (rates.count("in") > 0 && rates.count("out") > 0)
+                next.bandwidth = BandwidthSample{rates.at("in"), rates.at("out")};
+        }
+    }
+    next.bandwidthHistory = this->addSample(next.bandwidth);
+    next.metrics = this->ipfs.getConnectionMetrics();
+    next.fetchLatency = this->ipfs.getFetchLatencyStats();
+    next.endpoints = this->ipfs.getEndpointStatus();
+}
+
+/**
+ * \brief Add sample to the ring buffer
+ * \return Samples, oldest first
+ */
+std::vector<IPFSStatusMonitor::BandwidthSample> IPFSStatusMonitor::addSample(const BandwidthSample &sample)
+{
+    if (this->samples.size() < BANDWIDTH_HISTORY_SIZE)
+        this->samples.push_back(sample);
+    else
+        this->samples[this->nextSample] = sample;
+    this->nextSample = (this->nextSample + 1) % BANDWIDTH_HISTORY_SIZE;
+
+    std::vector<BandwidthSample> history;
+    history.reserve(this->samples.size());
+    std::size_t oldest = (this->samples.size() < BANDWIDTH_HISTORY_SIZE) ? 0 : this->nextSample;
+    for (std::size_t i = 0; i < this->samples.size(); ++i)
+        history.push_back(this->samples[(oldest + i) % this->samples.size()]);
+    return history;
+}
@@ -0,0 +1,83 @@
+#ifndef IPFS_STATUS_MONITOR_H
+#define IPFS_STATUS_MONITOR_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "fetch-timeout-policy.h"
+#include "hedged-fetcher.h"
+#include "ipfs-client-pool.h"
+
+class IPFS;
+
+/**
+ * \class IPFSStatusMonitor
+ * \brief Polls the IPFS daemon status (peers, bandwidth and identity) on a background thread.
+ * Each refresh publishes an immutable status snapshot. Polling backs off while the daemon is down,
+ * and slows down while the window is in the background.
+ */
+class IPFSStatusMonitor
+{
+public:
+    /**
+     * \struct BandwidthSample
+     * \brief Bandwidth rates in bytes per second
+     */
+    struct BandwidthSample
+    {
+        float rateIn;
+        float rateOut;
+    };
+
+    /**
+     * \struct Status
+     * \brief Status snapshot
+     */
+    struct Status
+    {
+        bool isDaemonRunning;
+        std::size_t nrPeers;
+        BandwidthSample bandwidth;
+        std::vector<BandwidthSample> bandwidthHistory; /*!< Recent samples, oldest first */
+        std::string clientID;
+        std::string clientPublicKey;
+        std::string version;
+        IPFSClientPool::Metrics metrics;
+        std::vector<FetchTimeoutPolicy::Stats> fetchLatency; /*!< Per content source and cache state */
+        std::vector<HedgedFetcher::EndpointStatus> endpoints; /*!< Empty without extra endpoints */
+    };
+
+    /**
+     * \brief Called (on the monitor thread) after each refresh
+     */
+    typedef std::function<void()> UpdateCallback;
+
+    explicit IPFSStatusMonitor(IPFS &ipfs, const UpdateCallback &onUpdate);
+    ~IPFSStatusMonitor();
+    void start();
+    void setForeground(bool isForeground);
+    void refreshNow();
+    std::shared_ptr<const Status> getStatus();
+
+private:
+    IPFS &ipfs;
+    UpdateCallback onUpdate;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    bool isForeground;
+    bool wakeUp;                          /*!< Refresh now (eg. the window is in the foreground again or the daemon is ready) */
+    std::shared_ptr<const Status> status; /*!< Latest snapshot, nullptr before the first refresh */
+    std::vector<BandwidthSample> samples; /*!< Ring buffer (monitor thread) */
+    std::size_t nextSample;
+
+    void run();
+    void refresh(Status &next);
+    std::vector<BandwidthSample> addSample(const BandwidthSample &sample);
+};
+#endif
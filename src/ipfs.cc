@@ -1,17 +1,33 @@
 #include "ipfs.h"
+#include "ipfs-process.h"
+#include "cid.h"
+#include <glibmm/base64.h>
+#include <nlohmann/json.hpp>
+#include <ostream>
 #include <sstream>
+#include <thread>
+
+namespace
+{
+    const std::chrono::seconds NAME_RECORD_TIMEOUT(30); /*!< Record lookups are done in the background, but not forever */
+    const int QUERY_EVENT_VALUE = 5;                    /*!< Type of the routing query event with the value */
+} // namespace
 
 /**
  * \brief IPFS Contructor, connect to IPFS
  * \param host IPFS host (eg. localhost)
  * \param port IPFS port number (5001)
  * \param timeout IPFS time-out (which is a string, eg. "6s" for 6 seconds)
+ * \param connections Max. number of idle (keep-alive) connections kept in the pool
+ * \param endpoints Extra API endpoints for fetching files (eg. "192.168.1.10:5001"), requests are hedged across the daemon and these endpoints
  */
-IPFS::IPFS(const std::string &host, int port, const std::string &timeout)
-    : host(host),
-      port(port),
-      timeout(timeout),
-      client(this->host, this->port, this->timeout) {}
+IPFS::IPFS(const std::string &host, int port, const std::string &timeout, std::size_t connections, const std::vector<std::string> &endpoints)
+    : pool(host, port, timeout, connections),
+      // The API socket is only used for the local daemon, remote daemons use TCP
+      socketClient((host == "localhost" || host == "127.0.0.1") ? IPFSProcess::getAPISocketPath() : "", timeout, connections),
+      timeoutPolicy(timeout),
+      hedgedFetcher(getEndpoints(host, port, endpoints), timeout, connections),
+      hasRoutingCommand(true) {}
 
 /**
  * \brief Get the number of IPFS peers
@@ -22,7 +38,12 @@ std::size_t IPFS::getNrPeers()
     try
     {
         ipfs::Json peers;
-        client.SwarmPeers(&peers);
+        if (!requestViaSocket("swarm/peers", peers))
+        {
+            auto client = pool.acquire();
+            client->SwarmPeers(&peers);
+            client.keep();
+        }
         return peers["Peers"].size();
     }
     catch (const std::runtime_error &error)
@@ -33,41 +54,22 @@ std::size_t IPFS::getNrPeers()
 }
 
 /**
- * \brief Retrieve your IPFS client ID
- * \return ID
+ * \brief Retrieve your IPFS client ID and Public Key (one request)
+ * \param id Client ID
+ * \param publicKey Public Key
+ * \throw std::runtime_error when the daemon can't be reached
  */
-std::string const IPFS::getClientID()
+void IPFS::getIdentity(std::string &id, std::string &publicKey)
 {
-    try
+    ipfs::Json identity;
+    if (!requestViaSocket("id", identity))
     {
-        ipfs::Json id;
-        client.Id(&id);
-        return id["ID"];
+        auto client = pool.acquire();
+        client->Id(&identity);
+        client.keep();
     }
-    catch (const std::runtime_error &error)
-    {
-        // ignore connection issues
-    }
-    return "";
-}
-
-/**
- * \brief Retrieve your IPFS Public Key
- * \return Public Key
- */
-std::string const IPFS::getClientPublicKey()
-{
-    try
-    {
-        ipfs::Json id;
-        client.Id(&id);
-        return id["PublicKey"];
-    }
-    catch (const std::runtime_error &error)
-    {
-        // ignore connection issues
-    }
-    return "";
+    id = identity["ID"].get<std::string>();
+    publicKey = identity["PublicKey"].get<std::string>();
 }
 
 /**
@@ -79,7 +81,12 @@ std::string const IPFS::getVersion()
     try
     {
         ipfs::Json version;
-        client.Version(&version);
+        if (!requestViaSocket("version", version))
+        {
+            auto client = pool.acquire();
+            client->Version(&version);
+            client.keep();
+        }
         return version["Version"];
     }
     catch (const std::runtime_error &error)
@@ -99,7 +106,12 @@ std::map<std::string, float> IPFS::getBandwidthRates()
     try
     {
         ipfs::Json bandwidth_info;
-        client.StatsBw(&bandwidth_info);
+        if (!requestViaSocket("stats/bw", bandwidth_info))
+        {
+            auto client = pool.acquire();
+            client->StatsBw(&bandwidth_info);
+            client.keep();
+        }
         float in = bandwidth_info["RateIn"];
         float out = bandwidth_info["RateOut"];
         bandwidthRates.insert(std::pair<std::string, float>("in", in));
@@ -113,22 +125,300 @@ std::map<std::string, float> IPFS::getBandwidthRates()
 }
 
 /**
- * \brief Fetch file from IFPS network (create a new client object each time - which is thread-safe), static method
+ * \brief Fetch file from IFPS network (thread-safe), the content is streamed into the sink without extra copies.
+ * The deadlines adapt to the recent latencies of the source and cache state, transient failures are retried.
  * \param path File path
- * \throw std::runtime_error when there is a connection-time/something goes wrong while trying to get the file
- * \return content as string
+ * \param sink Destination buffer, with optional max. size and progress callback
+ * \param cacheState If all blocks are local, eg. from the pre-flight getFileStat(). Checked via the socket when unknown.
+ * \throw std::runtime_error when there is a connection-time/something goes wrong while trying to get the file,
+ * or when the file exceeds the max. size
+ */
+void IPFS::fetch(const std::string &path, FetchSink &sink, FetchTimeoutPolicy::CacheState cacheState)
+{
+    if (hedgedFetcher.getSize() > 1)
+    {
+        fetchWithRetry(FetchTimeoutPolicy::SOURCE_ENDPOINTS, FetchTimeoutPolicy::CACHE_UNKNOWN, sink,
+                       [this, &path, &sink](const FetchTimeoutPolicy::Deadline &deadline) { hedgedFetcher.fetch(path, sink, deadline); });
+        return;
+    }
+    if (socketClient.isAvailable())
+    {
+        try
+        {
+            if (cacheState == FetchTimeoutPolicy::CACHE_UNKNOWN)
+                cacheState = getCacheState(path);
+            fetchWithRetry(FetchTimeoutPolicy::SOURCE_SOCKET, cacheState, sink,
+                           [this, &path, &sink](const FetchTimeoutPolicy::Deadline &deadline)
+                           {
+                               IPFSSocketClient::FetchOptions options;
+                               options.firstByteTimeout = deadline.firstByte;
+                               options.totalTimeout = deadline.total;
+                               options.timeout = deadline.timeout;
+                               socketClient.cat(path, sink, options);
+                           });
+            return;
+        }
+        catch (const IPFSSocketClient::ConnectError &)
+        {
+            // Fall-back to TCP
+        }
+    }
+    // The time-out of the TCP clients is fixed (the max. time-out), only the retries apply
+    fetchWithRetry(FetchTimeoutPolicy::SOURCE_TCP, FetchTimeoutPolicy::CACHE_UNKNOWN, sink,
+                   [this, &path, &sink](const FetchTimeoutPolicy::Deadline &)
+                   {
+                       auto client = pool.acquire();
+                       std::ostream contents(&sink);
+                       // Data beyond the max. size (or after abort) is dropped by the sink, the transfer can't be aborted via ipfs::Client
+                       client->FilesGet(path, &contents);
+                       client.keep();
+                       if (sink.isAborted())
+                           throw std::runtime_error("Transfer is aborted");
+                       if (sink.isTooLarge())
+                           throw std::runtime_error("File is too large, the maximum size is " + std::to_string(sink.getMaxSize() / (1024 * 1024)) + " MB");
+                   });
+}
+
+/**
+ * \brief Resolve an IPNS name (key or DNSLink domain) via the daemon (thread-safe)
+ * \param path IPNS path, eg. "/ipns/example.com/index.md"
+ * \param isRecursive Resolve until an IPFS path, otherwise only one step is resolved (eg. DNSLink to IPNS key).
+ * A remote daemon (via the TCP client) always resolves recursively.
+ * \throw std::runtime_error when the name can't be resolved
+ * \return Resolved path (with the remainder of the path)
+ */
+std::string IPFS::resolveName(const std::string &path, bool isRecursive)
+{
+    if (socketClient.isAvailable())
+    {
+        try
+        {
+            std::string response = socketClient.request("name/resolve", {{"arg", path}, {"recursive", isRecursive ? "true" : "false"}});
+            return nlohmann::json::parse(response).at("Path").get<std::string>();
+        }
+        catch (const IPFSSocketClient::ConnectError &)
+        {
+            // Fall-back to TCP
+        }
+        catch (const nlohmann::json::exception &error)
+        {
+            throw std::runtime_error("Unexpected IPFS response: " + std::string(error.what()));
+        }
+    }
+    std::string resolved;
+    auto client = pool.acquire();
+    client->NameResolve(path, &resolved);
+    client.keep();
+    return resolved;
+}
+
+/**
+ * \brief List the entries of a directory (thread-safe), the entries are streamed in the order of the directory.
+ * The type and size of the entries are not resolved (the daemon would fetch every entry): a raw block is a file,
+ * other entries are of unknown type. The TCP client (used for remote daemons) lists the whole directory, resolved.
+ * \param path IPFS path of the directory
+ * \param onEntry Called for every entry, returning false stops the listing (eg. when a page is complete)
+ * \throw std::runtime_error when the directory can't be listed
+ */
+void IPFS::listDirectory(const std::string &path, const DirectoryCallback &onEntry)
+{
+    // UnixFS type 1 is a directory and 2 is a file, 0 is unknown when not resolved
+    auto getEntryType = [](int type) { return (type == 1) ? ENTRY_DIRECTORY : ((type == 2) ? ENTRY_FILE : ENTRY_UNKNOWN); };
+    if (socketClient.isAvailable())
+    {
+        try
+        {
+            socketClient.requestLines("ls", {{"arg", path}, {"stream", "true"}, {"resolve-type", "false"}, {"size", "false"}},
+                                      [&onEntry, &getEntryType](const std::string &line) {
+                                          for (const auto &object : nlohmann::json::parse(line).at("Objects"))
+                                          {
+                                              for (const auto &link : object.at("Links"))
+                                              {
+                                                  if (!onEntry(DirectoryEntry{link.at("Name").get<std::string>(), link.at("Hash").get<std::string>(),
+                                                                              link.value("Size", uint64_t(0)), getEntryType(link.value("Type", 0))}))
+                                                      return false;
+                                              }
+                                          }
+                                          return true;
+                                      });
+            return;
+        }
+        catch (const IPFSSocketClient::ConnectError &)
+        {
+            // Fall-back to TCP
+        }
+        catch (const nlohmann::json::exception &error)
+        {
+            throw std::runtime_error("Unexpected IPFS response: " + std::string(error.what()));
+        }
+    }
+    ipfs::Json result;
+    auto client = pool.acquire();
+    client->FilesLs(path, &result);
+    client.keep();
+    try
+    {
+        for (const auto &object : result.at("Objects"))
+        {
+            for (const auto &link : object.at("Links"))
+            {
+                if (!onEntry(DirectoryEntry{link.at("Name").get<std::string>(), link.at("Hash").get<std::string>(),
+                                            link.value("Size", uint64_t(0)), getEntryType(link.value("Type", 0))}))
+                    return;
+            }
+        }
+    }
+    catch (const nlohmann::json::exception &error)
+    {
+        throw std::runtime_error("Unexpected IPFS response: " + std::string(error.what()));
+    }
+}
+
+/**
+ * \brief Get the size and type of a file or directory, without fetching its content (thread-safe)
+ * \param path IPFS path, eg. "/ipfs/<cid>/video.mp4"
+ * \param stat Size and type
+ * \param isCacheChecked Also check if all blocks are local (the local blocks of a directory are walked), eg. before a fetch
+ * \throw std::runtime_error when the path can't be resolved
+ * \return False when not available, the TCP client (used for remote daemons) has no stat request
+ */
+bool IPFS::getFileStat(const std::string &path, FileStat &stat, bool isCacheChecked)
+{
+    if (!socketClient.isAvailable())
+        return false;
+    try
+    {
+        std::string response;
+        bool isOffline = true;
+        try
+        {
+            // Local content is found without waiting for the network, with-local tells if all blocks are local
+            IPFSSocketClient::Arguments arguments{{"arg", path}, {"offline", "true"}};
+            if (isCacheChecked)
+                arguments.emplace_back("with-local", "true");
+            response = socketClient.request("files/stat", arguments);
+        }
+        catch (const IPFSSocketClient::ConnectError &)
+        {
+            throw;
+        }
+        catch (const std::runtime_error &)
+        {
+            // Not local, the network lookup gets the time to first byte deadline of cold content.
+            // The fetch itself retries when the lookup is slow.
+            FetchTimeoutPolicy::Deadline deadline = timeoutPolicy.getDeadline(FetchTimeoutPolicy::SOURCE_SOCKET, FetchTimeoutPolicy::CACHE_NETWORK, 0);
+            isOffline = false;
+            try
+            {
+                response = socketClient.request("files/stat", {{"arg", path}}, deadline.firstByte);
+            }
+            catch (const IPFSSocketClient::ConnectError &)
+            {
+                throw;
+            }
+            catch (const std::runtime_error &error)
+            {
+                if (!FetchTimeoutPolicy::isTransient(error.what()))
+                    throw;
+                return false;
+            }
+        }
+        auto result = nlohmann::json::parse(response);
+        stat.cid = result.at("Hash").get<std::string>();
+        stat.isDirectory = result.value("Type", "") == "directory";
+        stat.size = stat.isDirectory ? 0 : result.value("Size", uint64_t(0));
+        stat.cacheState = FetchTimeoutPolicy::CACHE_UNKNOWN;
+        if (isCacheChecked)
+            stat.cacheState = (isOffline && result.value("Local", false)) ? FetchTimeoutPolicy::CACHE_LOCAL : FetchTimeoutPolicy::CACHE_NETWORK;
+        return true;
+    }
+    catch (const IPFSSocketClient::ConnectError &)
+    {
+        return false;
+    }
+    catch (const nlohmann::json::exception &error)
+    {
+        throw std::runtime_error("Unexpected IPFS response: " + std::string(error.what()));
+    }
+}
+
+/**
+ * \brief Get the TTL of the IPNS record of a key, which is how long the record may be cached (thread-safe).
+ * This is a routing (DHT) query, which can take a while: it's meant to be called off the critical path.
+ * \param key IPNS key (eg. "k51...")
+ * \return TTL in seconds, 0 when unknown (the record isn't available via the local daemon, or has no TTL)
  */
-std::string const IPFS::fetch(const std::string &path)
+uint64_t IPFS::getNameRecordTTL(const std::string &key)
 {
-    // Create new client each time for thread-safety
-    ipfs::Client client(this->host, this->port, this->timeout);
-    std::stringstream contents;
-    client.FilesGet(path, &contents);
-    return contents.str();
+    if (!socketClient.isAvailable())
+        return 0;
+    std::string record;
+    try
+    {
+        // routing/get replaces dht/get in newer daemons, the bundled go-ipfs only knows dht/get (unknown commands are 404)
+        bool isRoutingCommand = hasRoutingCommand;
+        std::string response;
+        try
+        {
+            response = socketClient.request(isRoutingCommand ? "routing/get" : "dht/get", {{"arg", "/ipns/" + key}}, NAME_RECORD_TIMEOUT);
+        }
+        catch (const std::runtime_error &error)
+        {
+            if (std::string(error.what()).rfind("HTTP request failed with status code 404", 0) != 0)
+                throw;
+            hasRoutingCommand = !isRoutingCommand;
+            response = socketClient.request(isRoutingCommand ? "dht/get" : "routing/get", {{"arg", "/ipns/" + key}}, NAME_RECORD_TIMEOUT);
+        }
+        // Query events, one per line (dht/get also streams the peers it queried)
+        std::istringstream events(response);
+        std::string line;
+        while (record.empty() && std::getline(events, line))
+        {
+            if (line.empty())
+                continue;
+            auto event = nlohmann::json::parse(line);
+            if (event.value("Type", 0) == QUERY_EVENT_VALUE)
+                record = Glib::Base64::decode(event.value("Extra", ""));
+        }
+    }
+    catch (const std::exception &)
+    {
+        return 0;
+    }
+    // IpnsEntry (protobuf): ttl is field 6 (varint, nanoseconds), the other fields are skipped
+    std::size_t pos = 0;
+    uint64_t tag;
+    while (CID::readVarint(record, pos, tag))
+    {
+        uint64_t value;
+        switch (tag & 0x07)
+        {
+        case 0:
+            if (!CID::readVarint(record, pos, value))
+                return 0;
+            if ((tag >> 3) == 6)
+                return value / 1000000000;
+            break;
+        case 1:
+            pos += 8;
+            break;
+        case 2:
+            if (!CID::readVarint(record, pos, value))
+                return 0;
+            pos += value;
+            break;
+        case 5:
+            pos += 4;
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 0;
 }
 
 /**
- * \brief Add a file to IPFS network (not thread-safe)
+ * \brief Add a file to IPFS network (thread-safe)
  * \param path File path where the file could be stored in IPFS (like puting a file inside a directory within IPFS)
  * \param content Content that needs to be written to the IPFS network
  * \throw std::runtime_error when there is a connection-time/something goes wrong while trying to get the file
@@ -137,8 +427,10 @@ std::string const IPFS::fetch(const std::string &path)
 std::string const IPFS::add(const std::string &path, const std::string &content)
 {
     ipfs::Json result;
+    auto client = pool.acquire();
     // Publish a single file
-    client.FilesAdd({{path, ipfs::http::FileUpload::Type::kFileContents, content}}, &result);
+    client->FilesAdd({{path, ipfs::http::FileUpload::Type::kFileContents, content}}, &result);
+    client.keep();
     if (result.is_array())
     {
         for (const auto &files : result.items())
@@ -149,3 +441,149 @@ std::string const IPFS::add(const std::string &path, const std::string &content)
     // something is wrong, fallback
     return "";
 }
+
+/**
+ * \brief Request timings of reused and new connections, stale idle connections are removed
+ * \return Connection metrics
+ */
+IPFSClientPool::Metrics IPFS::getConnectionMetrics()
+{
+    pool.checkHealth();
+    return pool.getMetrics();
+}
+
+/**
+ * \brief Fetch latency statistics and the current deadlines, per content source and cache state
+ */
+std::vector<FetchTimeoutPolicy::Stats> IPFS::getFetchLatencyStats()
+{
+    return timeoutPolicy.getStats();
+}
+
+/**
+ * \brief Health of the API endpoints, empty without extra endpoints
+ */
+std::vector<HedgedFetcher::EndpointStatus> IPFS::getEndpointStatus()
+{
+    if (hedgedFetcher.getSize() < 2)
+        return {};
+    return hedgedFetcher.getStatus();
+}
+
+/**
+ * \brief Max. time-out of a fetch, the configured time-out
+ */
+std::chrono::milliseconds IPFS::getMaxTimeout() const
+{
+    return timeoutPolicy.getMaxTimeout();
+}
+
+/**
+ * \brief Check if all blocks of the content are in the local blockstore, without network lookups
+ * \throw IPFSSocketClient::ConnectError when the socket can't be connected
+ */
+FetchTimeoutPolicy::CacheState IPFS::getCacheState(const std::string &path)
+{
+    try
+    {
+        std::string response = socketClient.request("files/stat", {{"arg", path}, {"offline", "true"}, {"with-local", "true"}});
+        return nlohmann::json::parse(response).value("Local", false) ? FetchTimeoutPolicy::CACHE_LOCAL : FetchTimeoutPolicy::CACHE_NETWORK;
+    }
+    catch (const IPFSSocketClient::ConnectError &)
+    {
+        throw;
+    }
+    catch (const std::exception &error)
+    {
+        // The root block isn't local either
+        return FetchTimeoutPolicy::CACHE_NETWORK;
+    }
+}
+
+/**
+ * \brief Do a transfer with the deadlines of the timeout policy, the latencies are recorded.
+ * A transient failure is retried (after a jittered backoff), as long as no data is received.
+ * All attempts together are bounded by the max. time-out: the deadlines of an attempt are capped by the remaining time,
+ * which is also the time-out of the request in the daemon.
+ * \param transfer Transfer attempt, gets the deadlines
+ */
+void IPFS::fetchWithRetry(FetchTimeoutPolicy::Source source, FetchTimeoutPolicy::CacheState cacheState, FetchSink &sink,
+                          const std::function<void(const FetchTimeoutPolicy::Deadline &)> &transfer)
+{
+    auto begin = std::chrono::steady_clock::now();
+    std::chrono::milliseconds budget = timeoutPolicy.getMaxTimeout();
+    for (int attempt = 0;; ++attempt)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::milliseconds remaining = budget - std::chrono::duration_cast<std::chrono::milliseconds>(start - begin);
+        FetchTimeoutPolicy::Deadline deadline = timeoutPolicy.getDeadline(source, cacheState, attempt);
+        deadline.firstByte = std::min(deadline.firstByte, remaining);
+        deadline.total = std::min(deadline.total, remaining);
+        deadline.timeout = remaining;
+        // The attempt gets all of the remaining time, a next attempt would have no time left
+        bool isLastAttempt = attempt + 1 >= FetchTimeoutPolicy::MAX_ATTEMPTS || deadline.firstByte >= remaining;
+        try
+        {
+            transfer(deadline);
+        }
+        catch (const IPFSSocketClient::ConnectError &)
+        {
+            throw;
+        }
+        catch (const std::runtime_error &error)
+        {
+            if (!FetchTimeoutPolicy::isTransient(error.what()))
+                throw;
+            timeoutPolicy.recordTimeout(source, cacheState);
+            if (sink.hasData() || sink.isAborted() || isLastAttempt)
+                throw;
+            std::chrono::milliseconds backoff = timeoutPolicy.getBackoff(attempt);
+            if (std::chrono::steady_clock::now() + backoff >= begin + budget)
+                throw;
+            std::this_thread::sleep_for(backoff);
+            continue;
+        }
+        auto end = std::chrono::steady_clock::now();
+        auto firstByte = sink.hasData() ? sink.getFirstDataTime() : end;
+        timeoutPolicy.recordSuccess(source, cacheState, std::chrono::duration_cast<std::chrono::milliseconds>(firstByte - start),
+                                    std::chrono::duration_cast<std::chrono::milliseconds>(end - start));
+        return;
+    }
+}
+
+/**
+ * \brief Request via the API socket of the local daemon, the daemon started by the browser only listens on the socket
+ * \param command API command (eg. "id")
+ * \param[out] result Parsed response
+ * \throw std::runtime_error when the request failed
+ * \return False when the socket isn't available, the request is done via TCP instead
+ */
+bool IPFS::requestViaSocket(const std::string &command, ipfs::Json &result)
+{
+    if (!socketClient.isAvailable())
+        return false;
+    try
+    {
+        result = nlohmann::json::parse(socketClient.request(command, {}));
+        return true;
+    }
+    catch (const IPFSSocketClient::ConnectError &)
+    {
+        return false;
+    }
+    catch (const nlohmann::json::exception &error)
+    {
+        throw std::runtime_error("Unexpected IPFS response: " + std::string(error.what()));
+    }
+}
+
+/**
+ * \brief Endpoints of the hedged fetcher: the daemon (via the API socket when local) followed by the extra endpoints
+ */
+std::vector<std::string> IPFS::getEndpoints(const std::string &host, int port, const std::vector<std::string> &endpoints)
+{
+    std::string socketPath = (host == "localhost" || host == "127.0.0.1") ? IPFSProcess::getAPISocketPath() : "";
+    std::vector<std::string> list{socketPath.empty() ? host + ":" + std::to_string(port) : "unix:" + socketPath};
+    list.insert(list.end(), endpoints.begin(), endpoints.end());
+    return list;
+}
@@ -1,29 +1,92 @@
 #ifndef IPFS_H
 #define IPFS_H
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <string>
-#include "ipfs/client.h"
+#include <map>
+#include <vector>
+#include "fetch-sink.h"
+#include "fetch-timeout-policy.h"
+#include "hedged-fetcher.h"
+#include "ipfs-client-pool.h"
+#include "ipfs-socket-client.h"
 
 /**
  * \class IPFS
- * \brief Start IPFS connection and contain IPFS related calls
+ * \brief Start IPFS connection and contain IPFS related calls (thread-safe, using a pool of clients)
  */
 class IPFS
 {
 public:
-    explicit IPFS(const std::string &host, int port, const std::string &timeout);
+    /**
+     * \brief Type of a directory entry, unknown when it's not resolved (the entry isn't fetched while listing)
+     */
+    enum EntryType
+    {
+        ENTRY_UNKNOWN,
+        ENTRY_FILE,
+        ENTRY_DIRECTORY
+    };
+
+    /**
+     * \struct DirectoryEntry
+     * \brief Link of a directory
+     */
+    struct DirectoryEntry
+    {
+        std::string name;
+        std::string cid;
+        uint64_t size; /*!< File size in bytes (0 if unknown) */
+        EntryType type;
+    };
+
+    /**
+     * \brief Directory entry callback, returning false stops the listing
+     */
+    typedef std::function<bool(const DirectoryEntry &entry)> DirectoryCallback;
+
+    /**
+     * \struct FileStat
+     * \brief Size and type of a file or directory
+     */
+    struct FileStat
+    {
+        std::string cid;
+        uint64_t size; /*!< File size in bytes (0 for a directory) */
+        bool isDirectory;
+        FetchTimeoutPolicy::CacheState cacheState; /*!< If all blocks are local, unknown unless it's checked */
+    };
+
+    explicit IPFS(const std::string &host, int port, const std::string &timeout, std::size_t connections = 4,
+                  const std::vector<std::string> &endpoints = {});
     std::size_t getNrPeers();
-    std::string const getClientID();
-    std::string const getClientPublicKey();
+    void getIdentity(std::string &id, std::string &publicKey);
     std::string const getVersion();
     std::map<std::string, float> getBandwidthRates();
-    std::string const fetch(const std::string &path);
+    void fetch(const std::string &path, FetchSink &sink, FetchTimeoutPolicy::CacheState cacheState = FetchTimeoutPolicy::CACHE_UNKNOWN);
+    std::string resolveName(const std::string &path, bool isRecursive);
+    void listDirectory(const std::string &path, const DirectoryCallback &onEntry);
+    bool getFileStat(const std::string &path, FileStat &stat, bool isCacheChecked = false);
+    uint64_t getNameRecordTTL(const std::string &key);
     std::string const add(const std::string &path, const std::string &content);
+    IPFSClientPool::Metrics getConnectionMetrics();
+    std::vector<FetchTimeoutPolicy::Stats> getFetchLatencyStats();
+    std::vector<HedgedFetcher::EndpointStatus> getEndpointStatus();
+    std::chrono::milliseconds getMaxTimeout() const;
 
 private:
-    std::string host;
-    int port;
-    std::string timeout;
-    ipfs::Client client;
+    IPFSClientPool pool;
+    IPFSSocketClient socketClient; /*!< Unix domain socket to the local daemon, for fetching files */
+    FetchTimeoutPolicy timeoutPolicy;
+    HedgedFetcher hedgedFetcher; /*!< The daemon and the extra API endpoints, only used with extra endpoints */
+    std::atomic<bool> hasRoutingCommand; /*!< The daemon knows routing/get (newer daemons), else dht/get is used */
+
+    FetchTimeoutPolicy::CacheState getCacheState(const std::string &path);
+    bool requestViaSocket(const std::string &command, ipfs::Json &result);
+    static std::vector<std::string> getEndpoints(const std::string &host, int port, const std::vector<std::string> &endpoints);
+    void fetchWithRetry(FetchTimeoutPolicy::Source source, FetchTimeoutPolicy::CacheState cacheState, FetchSink &sink,
+                        const std::function<void(const FetchTimeoutPolicy::Deadline &)> &transfer);
 };
 #endif
\ No newline at end of file
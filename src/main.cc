@@ -1,9 +1,8 @@
-#include "mainwindow.h"
-#include "ipfs-process.h"
+#include "browser-application.h"
 #include "project_config.h"
 #include "option-group.h"
 
-#include <gtkmm/application.h>
+#include <curl/curl.h>
 #include <iomanip>
 #include <iostream>
 
@@ -17,10 +16,6 @@ int main(int argc, char *argv[])
     OptionGroup group;
     context.set_main_group(group);
 
-    // Create the GTK application
-    auto app = Gtk::Application::create();
-    app->set_flags(Gio::ApplicationFlags::APPLICATION_NON_UNIQUE);
-    
     try
     {
         // Parse the content
@@ -37,26 +32,17 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    pid_t child_pid = fork();
-    if (child_pid == 0)
+    // Initialize libcurl before any thread starts, the curl handles are created on several threads (not thread-safe when done lazily)
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
     {
-        // Run by child process
-        return IPFSProcess::startIPFSDaemon();
+        std::cerr << "ERROR: Could not initialize libcurl" << std::endl;
+        exit(EXIT_FAILURE);
     }
-    else if (child_pid > 0)
-    {
-        // Run the GTK window in the parent process (child_pid is the PID of child process)
-        MainWindow window(group.m_timeout);
-        int exitCode = app->run(window);
 
-        // TODO: If we have multiple browsers running, maybe don't kill the IPFS daemon child process yet..?
-        // For now, let's don't kill the IPFS process
-        //kill(child_pid, SIGTERM);
-        return exitCode;
-    }
-    else // PID < 0, error
-    {
-        printf("ERROR: fork failed.\n");
-        return EXIT_FAILURE;
-    }
+    // A running browser opens a new window (or the given URLs) instead, the daemon is supervised by the first browser
+    auto app = BrowserApplication::create(group.m_timeout, group.m_connections, group.m_maxSize, group.m_endpoints);
+    int status = app->run(argc, argv);
+    app.reset();
+    curl_global_cleanup();
+    return status;
 }
@@ -3,11 +3,17 @@
 #include "project_config.h"
 #include "md-parser.h"
 #include "menu.h"
+#include "progressive-renderer.h"
 #include "file.h"
+#include "ipfs-process.h"
+#include "cid.h"
+#include <gtkmm/application.h>
 #include <gtkmm/menuitem.h>
 #include <gtkmm/image.h>
+#include <gtkmm/expander.h>
+#include <gtkmm/checkbutton.h>
 #include <giomm/file.h>
-#include <gtkmm/cssprovider.h>
+#include <giomm/contenttype.h>
 #include <glibmm/fileutils.h>
 #include <glibmm/miscutils.h>
 #include <glibmm/main.h>
@@ -18,15 +24,22 @@
 #include <pthread.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 
-MainWindow::MainWindow(const std::string &timeout)
+/**
+ * \brief Create a browser window
+ * \param context State shared with the other windows
+ * \param path Page to open, empty for the home page
+ */
+MainWindow::MainWindow(BrowserContext &context, const std::string &path)
     : m_accelGroup(Gtk::AccelGroup::create()),
       m_settings(),
       m_menu(m_accelGroup),
       m_draw_main(*this),
       m_draw_secondary(*this),
       m_about(*this),
+      m_outlineTreeStore(Gtk::TreeStore::create(m_outlineColumns)),
       m_vbox(Gtk::ORIENTATION_VERTICAL, 0),
       m_hboxBrowserToolbar(Gtk::ORIENTATION_HORIZONTAL, 0),
       m_hboxStandardEditorToolbar(Gtk::ORIENTATION_HORIZONTAL, 0),
@@ -34,6 +47,8 @@ MainWindow::MainWindow(const std::string &timeout)
       m_hboxBottom(Gtk::ORIENTATION_HORIZONTAL, 0),
       m_hboxStatus(Gtk::ORIENTATION_VERTICAL),
       m_searchMatchCase("Match _Case", true),
+      m_searchRegex("_Regex", true),
+      m_replaceAllButton("Replace _All", true),
       m_statusPopover(m_statusButton),
       m_copyIDButton("Copy your ID"),
       m_copyPublicKeyButton("Copy Public Key"),
@@ -42,12 +57,41 @@ MainWindow::MainWindow(const std::string &timeout)
       m_useCurrentGTKIconTheme(false), // Use our built-in icon theme or the GTK icons
       m_iconSize(18),
       m_requestThread(nullptr),
+      m_publishThread(nullptr),
+      m_downloadThread(nullptr),
+      isDirectoryPage(false),
+      maxFileSize(context.getMaxFileSize()),
+      downloadProgressPending(false),
+      downloadCancelled(false),
+      fetchReceived(0),
+      fetchTotal(0),
+      fetchProgressPending(false),
       currentHistoryIndex(0),
+      backForwardCache(10, 64 * 1024 * 1024),
+      isPageRendered(false),
+      pendingScrollOffset(-1),
+      searchResultOutdated(false),
+      searchSelectPending(false),
+      scrollSyncTickId(0),
+      scrollSyncFromEditor(true),
+      isSyncingScroll(false),
+      isPreviewScrollLeader(false),
+      previewRendersPending(0),
       m_waitPageVisible(false),
-      ipfsHost("localhost"),
-      ipfsPort(5001),
-      ipfsTimeout(timeout),
-      ipfs(ipfsHost, ipfsPort, ipfsTimeout) // Create IPFS object
+      context(context),
+      ipfsHost(context.getHost()),
+      ipfsPort(context.getPort()),
+      ipfsTimeout(context.getTimeout()),
+      ipfs(context.getIPFS()),
+      fetchCoalescer(context.getFetchCoalescer()),
+      nameResolver(context.getNameResolver()),
+      directoryIndex(context.getDirectoryIndex()),
+      statusMonitor(context.getStatusMonitor()),
+      contentCache(context.getContentCache()),
+      renderCache(context.getRenderCache()),
+      prefetcher(context.getPrefetcher()),
+      // The API socket is only used for the local daemon, remote daemons use TCP
+      sitePublisher(ipfsHost, ipfsPort, (ipfsHost == "localhost") ? IPFSProcess::getAPISocketPath() : "", 3)
 {
     set_title(m_appName);
     set_default_size(1000, 800);
@@ -84,13 +128,13 @@ MainWindow::MainWindow(const std::string &timeout)
     m_statusPopover.add(m_hboxStatus);
     m_statusPopover.show_all_children();
 
-    // Timeouts
-    this->statusTimerHandler = Glib::signal_timeout().connect(sigc::mem_fun(this, &MainWindow::update_connection_status), 3000);
-
     // Window signals
     this->signal_delete_event().connect(sigc::mem_fun(this, &MainWindow::delete_window));
+    this->property_is_active().signal_changed().connect(sigc::mem_fun(this, &MainWindow::on_active_changed));
+    this->signal_window_state_event().connect(sigc::mem_fun(this, &MainWindow::on_window_state_changed));
 
     // Menu & toolbar signals
+    m_menu.new_window.connect(sigc::mem_fun(this, &MainWindow::new_window));                                         /*!< Menu item for new window */
     m_menu.new_doc.connect(sigc::mem_fun(this, &MainWindow::new_doc));                                               /*!< Menu item for new document */
     m_menu.open.connect(sigc::mem_fun(this, &MainWindow::open));                                                     /*!< Menu item for opening existing document */
     m_menu.open_edit.connect(sigc::mem_fun(this, &MainWindow::open_and_edit));                                       /*!< Menu item for opening & editing existing document */
@@ -98,7 +142,8 @@ MainWindow::MainWindow(const std::string &timeout)
     m_menu.save.connect(sigc::mem_fun(this, &MainWindow::save));                                                     /*!< Menu item for save document */
     m_menu.save_as.connect(sigc::mem_fun(this, &MainWindow::save_as));                                               /*!< Menu item for save document as */
     m_menu.publish.connect(sigc::mem_fun(this, &MainWindow::publish));                                               /*!< Menu item for publishing */
-    m_menu.quit.connect(sigc::mem_fun(this, &MainWindow::hide));                                                     /*!< hide main window and therefor closes the app */
+    m_menu.publish_folder.connect(sigc::mem_fun(this, &MainWindow::publish_folder));                                 /*!< Menu item for publishing a site folder */
+    m_menu.quit.connect(sigc::mem_fun(this, &MainWindow::quit));                                                     /*!< hide all windows and therefor closes the app */
     m_menu.undo.connect(sigc::mem_fun(m_draw_main, &Draw::undo));                                                    /*!< Menu item for undo text */
     m_menu.redo.connect(sigc::mem_fun(m_draw_main, &Draw::redo));                                                    /*!< Menu item for redo text */
     m_menu.cut.connect(sigc::mem_fun(this, &MainWindow::cut));                                                       /*!< Menu item for cut text */
@@ -113,6 +158,7 @@ MainWindow::MainWindow(const std::string &timeout)
     m_menu.reload.connect(sigc::mem_fun(this, &MainWindow::refresh));                                                /*!< Menu item for reloading the page */
     m_menu.home.connect(sigc::mem_fun(this, &MainWindow::go_home));                                                  /*!< Menu item for home page */
     m_menu.source_code.connect(sigc::mem_fun(this, &MainWindow::show_source_code_dialog));                           /*!< Source code dialog */
+    m_menu.outline.connect(sigc::mem_fun(this, &MainWindow::toggle_outline));                                        /*!< Show/hide document outline */
     m_sourceCodeDialog.signal_response().connect(sigc::mem_fun(m_sourceCodeDialog, &SourceCodeDialog::hide_dialog)); /*!< Close source code dialog */
     m_menu.about.connect(sigc::mem_fun(m_about, &About::show_about));                                                /*!< Display about dialog */
     m_draw_main.source_code.connect(sigc::mem_fun(this, &MainWindow::show_source_code_dialog));                      /*!< Open source code dialog */
@@ -124,7 +170,27 @@ MainWindow::MainWindow(const std::string &timeout)
     m_homeButton.signal_clicked().connect(sigc::mem_fun(this, &MainWindow::go_home));                                /*!< Button for home page */
     m_statusButton.signal_clicked().connect(sigc::mem_fun(this, &MainWindow::show_status));                          /*!< Button for IPFS status */
     m_searchEntry.signal_activate().connect(sigc::mem_fun(this, &MainWindow::on_search));                            /*!< Execute the text search */
+    m_searchEntry.signal_search_changed().connect(sigc::mem_fun(this, &MainWindow::on_search_changed));              /*!< Search while typing */
+    m_searchMatchCase.signal_toggled().connect(sigc::mem_fun(this, &MainWindow::on_search_changed));                 /*!< Search again with(out) case folding */
+    m_searchRegex.signal_toggled().connect(sigc::mem_fun(this, &MainWindow::on_search_changed));                     /*!< Search again with(out) regex */
     m_searchReplaceEntry.signal_activate().connect(sigc::mem_fun(this, &MainWindow::on_replace));                    /*!< Execute the text replace */
+    m_replaceAllButton.signal_clicked().connect(sigc::mem_fun(this, &MainWindow::on_replace_all));                   /*!< Replace all matches */
+    m_hboxBottom.signal_hide().connect(sigc::mem_fun(this, &MainWindow::on_search_hide));                            /*!< Remove the search highlighting */
+    m_draw_main.get_buffer()->signal_changed().connect(sigc::mem_fun(this, &MainWindow::on_search_buffer_changed));  /*!< Search results are outdated */
+    textSearch.signal_finished.connect(sigc::mem_fun(this, &MainWindow::on_search_finished));                        /*!< Search results are ready */
+    fetchProgressDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_fetch_progress));                            /*!< Show the download progress */
+    statusDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_status_changed));                                   /*!< Show the IPFS status */
+    daemonReadyDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_daemon_ready));                                /*!< Retry the waiting request */
+    nameResolutionDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_name_resolution));                          /*!< Show the resolution chain */
+    publishProgressDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_publish_progress));                        /*!< Show the upload progress */
+    publishFinishedDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_publish_finished));                        /*!< Show the published CID(s) */
+    downloadProgressDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_download_progress));                      /*!< Show the save to disk progress */
+    downloadFinishedDispatcher.connect(sigc::mem_fun(this, &MainWindow::on_download_finished));                      /*!< Show the saved file */
+    m_draw_secondary.document_rendered.connect(sigc::mem_fun(this, &MainWindow::on_preview_rendered));               /*!< Preview is updated */
+    m_draw_main.document_rendered.connect(sigc::mem_fun(this, &MainWindow::on_main_rendered));                       /*!< Page is drawn */
+    m_draw_main.link_hovered.connect(sigc::mem_fun(this, &MainWindow::on_link_hovered));                             /*!< Prefetch hovered link */
+    m_scrolledWindowMain.get_vadjustment()->signal_value_changed().connect(sigc::mem_fun(this, &MainWindow::on_main_scrolled)); /*!< Prefetch visible links */
+    m_outlineTreeView.signal_row_activated().connect(sigc::mem_fun(this, &MainWindow::on_outline_row_activated));    /*!< Jump to heading */
 
     m_vbox.pack_start(m_menu, false, false, 0);
 
@@ -155,87 +221,87 @@ MainWindow::MainWindow(const std::string &timeout)
     try
     {
         // Add icons to the editor buttons
-        m_openIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("open_folder", "folders"), m_iconSize, m_iconSize));
+        m_openIcon.set(this->context.getIcon(this->getIconImageFromTheme("open_folder", "folders"), m_iconSize, m_iconSize));
         m_openButton.set_tooltip_text("Open document (Ctrl+O)");
         m_openButton.add(m_openIcon);
         m_openButton.set_relief(Gtk::RELIEF_NONE);
-        m_saveIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("floppy_disk", "basic"), m_iconSize, m_iconSize));
+        m_saveIcon.set(this->context.getIcon(this->getIconImageFromTheme("floppy_disk", "basic"), m_iconSize, m_iconSize));
         m_saveButton.set_tooltip_text("Save document (Ctrl+S)");
         m_saveButton.add(m_saveIcon);
         m_saveButton.set_relief(Gtk::RELIEF_NONE);
-        m_publishIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("upload", "basic"), m_iconSize, m_iconSize));
+        m_publishIcon.set(this->context.getIcon(this->getIconImageFromTheme("upload", "basic"), m_iconSize, m_iconSize));
         m_publishButton.set_tooltip_text("Publish document... (Ctrl+P)");
         m_publishButton.add(m_publishIcon);
         m_publishButton.set_relief(Gtk::RELIEF_NONE);
-        m_cutIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("cut", "editor"), m_iconSize, m_iconSize));
+        m_cutIcon.set(this->context.getIcon(this->getIconImageFromTheme("cut", "editor"), m_iconSize, m_iconSize));
         m_cutButton.set_tooltip_text("Cut (Ctrl+X)");
         m_cutButton.add(m_cutIcon);
         m_cutButton.set_relief(Gtk::RELIEF_NONE);
-        m_copyIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("copy", "editor"), m_iconSize, m_iconSize));
+        m_copyIcon.set(this->context.getIcon(this->getIconImageFromTheme("copy", "editor"), m_iconSize, m_iconSize));
         m_copyButton.set_tooltip_text("Copy (Ctrl+C)");
         m_copyButton.add(m_copyIcon);
         m_copyButton.set_relief(Gtk::RELIEF_NONE);
-        m_pasteIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("clipboard", "editor"), m_iconSize, m_iconSize));
+        m_pasteIcon.set(this->context.getIcon(this->getIconImageFromTheme("clipboard", "editor"), m_iconSize, m_iconSize));
         m_pasteButton.set_tooltip_text("Paste (Ctrl+V)");
         m_pasteButton.add(m_pasteIcon);
         m_pasteButton.set_relief(Gtk::RELIEF_NONE);
-        m_undoIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("undo", "editor"), m_iconSize, m_iconSize));
+        m_undoIcon.set(this->context.getIcon(this->getIconImageFromTheme("undo", "editor"), m_iconSize, m_iconSize));
         m_undoButton.set_tooltip_text("Undo text (Ctrl+Z)");
         m_undoButton.add(m_undoIcon);
         m_undoButton.set_relief(Gtk::RELIEF_NONE);
-        m_redoIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("redo", "editor"), m_iconSize, m_iconSize));
+        m_redoIcon.set(this->context.getIcon(this->getIconImageFromTheme("redo", "editor"), m_iconSize, m_iconSize));
         m_redoButton.set_tooltip_text("Redo text (Ctrl+Y)");
         m_redoButton.add(m_redoIcon);
         m_redoButton.set_relief(Gtk::RELIEF_NONE);
-        m_boldIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("bold", "editor"), m_iconSize, m_iconSize));
+        m_boldIcon.set(this->context.getIcon(this->getIconImageFromTheme("bold", "editor"), m_iconSize, m_iconSize));
         m_boldButton.set_tooltip_text("Add bold text");
         m_boldButton.add(m_boldIcon);
         m_boldButton.set_relief(Gtk::RELIEF_NONE);
-        m_italicIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("italic", "editor"), m_iconSize, m_iconSize));
+        m_italicIcon.set(this->context.getIcon(this->getIconImageFromTheme("italic", "editor"), m_iconSize, m_iconSize));
         m_italicButton.set_tooltip_text("Add italic text");
         m_italicButton.add(m_italicIcon);
         m_italicButton.set_relief(Gtk::RELIEF_NONE);
-        m_strikethroughIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("strikethrough", "editor"), m_iconSize, m_iconSize));
+        m_strikethroughIcon.set(this->context.getIcon(this->getIconImageFromTheme("strikethrough", "editor"), m_iconSize, m_iconSize));
         m_strikethroughButton.set_tooltip_text("Add strikethrough text");
         m_strikethroughButton.add(m_strikethroughIcon);
         m_strikethroughButton.set_relief(Gtk::RELIEF_NONE);
-        m_superIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("superscript", "editor"), m_iconSize, m_iconSize));
+        m_superIcon.set(this->context.getIcon(this->getIconImageFromTheme("superscript", "editor"), m_iconSize, m_iconSize));
         m_superButton.set_tooltip_text("Add superscript text");
         m_superButton.add(m_superIcon);
         m_superButton.set_relief(Gtk::RELIEF_NONE);
-        m_subIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("subscript", "editor"), m_iconSize, m_iconSize));
+        m_subIcon.set(this->context.getIcon(this->getIconImageFromTheme("subscript", "editor"), m_iconSize, m_iconSize));
         m_subButton.set_tooltip_text("Add subscript text");
         m_subButton.add(m_subIcon);
         m_subButton.set_relief(Gtk::RELIEF_NONE);
-        m_linkIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("link", "editor"), m_iconSize, m_iconSize));
+        m_linkIcon.set(this->context.getIcon(this->getIconImageFromTheme("link", "editor"), m_iconSize, m_iconSize));
         m_linkButton.set_tooltip_text("Add a link");
         m_linkButton.add(m_linkIcon);
         m_linkButton.set_relief(Gtk::RELIEF_NONE);
-        m_imageIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("shapes", "editor"), m_iconSize, m_iconSize));
+        m_imageIcon.set(this->context.getIcon(this->getIconImageFromTheme("shapes", "editor"), m_iconSize, m_iconSize));
         m_imageButton.set_tooltip_text("Add an image");
         m_imageButton.add(m_imageIcon);
         m_imageButton.set_relief(Gtk::RELIEF_NONE);
-        m_emojiIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("smile", "smiley"), m_iconSize, m_iconSize));
+        m_emojiIcon.set(this->context.getIcon(this->getIconImageFromTheme("smile", "smiley"), m_iconSize, m_iconSize));
         m_emojiButton.set_tooltip_text("Insert emoji");
         m_emojiButton.add(m_emojiIcon);
         m_emojiButton.set_relief(Gtk::RELIEF_NONE);
-        m_quoteIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("quote", "editor"), m_iconSize, m_iconSize));
+        m_quoteIcon.set(this->context.getIcon(this->getIconImageFromTheme("quote", "editor"), m_iconSize, m_iconSize));
         m_quoteButton.set_tooltip_text("Insert a quote");
         m_quoteButton.add(m_quoteIcon);
         m_quoteButton.set_relief(Gtk::RELIEF_NONE);
-        m_codeIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("code", "editor"), m_iconSize, m_iconSize));
+        m_codeIcon.set(this->context.getIcon(this->getIconImageFromTheme("code", "editor"), m_iconSize, m_iconSize));
         m_codeButton.set_tooltip_text("Insert code");
         m_codeButton.add(m_codeIcon);
         m_codeButton.set_relief(Gtk::RELIEF_NONE);
-        m_bulletListIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("bullet_list", "editor"), m_iconSize, m_iconSize));
+        m_bulletListIcon.set(this->context.getIcon(this->getIconImageFromTheme("bullet_list", "editor"), m_iconSize, m_iconSize));
         m_bulletListButton.set_tooltip_text("Add a bullet list");
         m_bulletListButton.add(m_bulletListIcon);
         m_bulletListButton.set_relief(Gtk::RELIEF_NONE);
-        m_numberedListIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("number_list", "editor"), m_iconSize, m_iconSize));
+        m_numberedListIcon.set(this->context.getIcon(this->getIconImageFromTheme("number_list", "editor"), m_iconSize, m_iconSize));
         m_numberedListButton.set_tooltip_text("Add a numbered list");
         m_numberedListButton.add(m_numberedListIcon);
         m_numberedListButton.set_relief(Gtk::RELIEF_NONE);
-        m_hightlightIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("highlighter", "editor"), m_iconSize, m_iconSize));
+        m_hightlightIcon.set(this->context.getIcon(this->getIconImageFromTheme("highlighter", "editor"), m_iconSize, m_iconSize));
         m_highlightButton.set_tooltip_text("Add highlight text");
         m_highlightButton.add(m_hightlightIcon);
         m_highlightButton.set_relief(Gtk::RELIEF_NONE);
@@ -271,6 +337,8 @@ MainWindow::MainWindow(const std::string &timeout)
     m_highlightButton.set_can_focus(false);
     // And match case button
     m_searchMatchCase.set_can_focus(false);
+    m_searchRegex.set_can_focus(false);
+    m_replaceAllButton.set_can_focus(false);
 
     // Populate the heading comboboxtext
     m_headingsComboBox.append("", "Select Heading");
@@ -298,8 +366,8 @@ MainWindow::MainWindow(const std::string &timeout)
     // Add icons to the toolbar buttons
     try
     {
-        m_statusOfflineIcon = Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("network_disconnected", "network"), m_iconSize, m_iconSize);
-        m_statusOnlineIcon = Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("network_connected", "network"), m_iconSize, m_iconSize);
+        m_statusOfflineIcon = this->context.getIcon(this->getIconImageFromTheme("network_disconnected", "network"), m_iconSize, m_iconSize);
+        m_statusOnlineIcon = this->context.getIcon(this->getIconImageFromTheme("network_connected", "network"), m_iconSize, m_iconSize);
 
         if (m_useCurrentGTKIconTheme)
         {
@@ -311,10 +379,10 @@ MainWindow::MainWindow(const std::string &timeout)
         }
         else
         {
-            m_backIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("right_arrow_1", "arrows"), m_iconSize, m_iconSize)->flip());
-            m_forwardIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("right_arrow_1", "arrows"), m_iconSize, m_iconSize));
-            m_refreshIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("reload_centered", "arrows"), m_iconSize * 1.13, m_iconSize));
-            m_homeIcon.set(Gdk::Pixbuf::create_from_file(this->getIconImageFromTheme("home", "basic"), m_iconSize, m_iconSize));
+            m_backIcon.set(this->context.getIcon(this->getIconImageFromTheme("right_arrow_1", "arrows"), m_iconSize, m_iconSize)->flip());
+            m_forwardIcon.set(this->context.getIcon(this->getIconImageFromTheme("right_arrow_1", "arrows"), m_iconSize, m_iconSize));
+            m_refreshIcon.set(this->context.getIcon(this->getIconImageFromTheme("reload_centered", "arrows"), m_iconSize * 1.13, m_iconSize));
+            m_homeIcon.set(this->context.getIcon(this->getIconImageFromTheme("home", "basic"), m_iconSize, m_iconSize));
             m_statusIcon.set(m_statusOfflineIcon); // fall-back
         }
         m_backButton.add(m_backIcon);
@@ -328,17 +396,6 @@ MainWindow::MainWindow(const std::string &timeout)
         std::cerr << "ERROR: Toolbar icons could not be loaded: " << error.what() << std::endl;
     }
 
-    // Add spinning CSS class to refresh icon
-    auto cssProvider = Gtk::CssProvider::create();
-    auto screen = Gdk::Screen::get_default();
-    std::string spinningCSS = "@keyframes spin {  to { -gtk-icon-transform: rotate(1turn); }} .spinning { animation-name: spin;  animation-duration: 1s;  animation-timing-function: linear;  animation-iteration-count: infinite;}";
-    if (!cssProvider->load_from_data(spinningCSS))
-    {
-        std::cerr << "ERROR: CSS parsing went wrong." << std::endl;
-    }
-    auto refreshIconStyle = m_refreshIcon.get_style_context();
-    refreshIconStyle->add_provider_for_screen(screen, cssProvider, GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-
     // Add tooltips to the toolbar buttons
     m_backButton.set_tooltip_text("Go back one page (Alt+Left arrow)");
     m_forwardButton.set_tooltip_text("Go forward one page (Alt+Right arrow)");
@@ -411,12 +468,26 @@ MainWindow::MainWindow(const std::string &timeout)
     m_hboxBottom.pack_start(m_exitBottomButton, false, false, 10);
     m_hboxBottom.pack_start(m_searchEntry, false, false, 10);
     m_hboxBottom.pack_start(m_searchReplaceEntry, false, false, 10);
+    m_hboxBottom.pack_start(m_replaceAllButton, false, false, 0);
     m_hboxBottom.pack_start(m_searchMatchCase, false, false, 10);
+    m_hboxBottom.pack_start(m_searchRegex, false, false, 0);
+    m_hboxBottom.pack_start(m_searchMatchesLabel, false, false, 10);
 
     m_paned.pack1(m_scrolledWindowMain, true, false);
     m_paned.pack2(m_scrolledWindowSecondary, true, true);
 
-    m_vbox.pack_start(m_paned, true, true, 0);
+    // Document outline on the left
+    m_outlineTreeView.set_model(m_outlineTreeStore);
+    m_outlineTreeView.append_column("Outline", m_outlineColumns.text);
+    m_outlineTreeView.set_headers_visible(false);
+    m_outlineTreeView.set_activate_on_single_click(true);
+    m_scrolledWindowOutline.add(m_outlineTreeView);
+    m_scrolledWindowOutline.set_policy(Gtk::POLICY_AUTOMATIC, Gtk::POLICY_AUTOMATIC);
+    m_scrolledWindowOutline.set_size_request(200, -1);
+    m_panedOutline.pack1(m_scrolledWindowOutline, false, false);
+    m_panedOutline.pack2(m_paned, true, false);
+
+    m_vbox.pack_start(m_panedOutline, true, true, 0);
     m_vbox.pack_end(m_hboxBottom, false, true, 6);
 
     add(m_vbox);
@@ -424,25 +495,55 @@ MainWindow::MainWindow(const std::string &timeout)
     // Hide by default the bottom box + replace entry, editor box & secondary text view
     m_hboxBottom.hide();
     m_searchReplaceEntry.hide();
+    m_replaceAllButton.hide();
     m_hboxStandardEditorToolbar.hide();
     m_hboxFormattingEditorToolbar.hide();
     m_scrolledWindowSecondary.hide();
+    m_scrolledWindowOutline.hide();
 
     // Grap focus to input field by default
     m_addressBar.grab_focus();
 
-    // First time manually trigger the status update once,
-    // timer will do the updates later
-    this->update_connection_status();
+    // Receive the background notifications, show the current IPFS status at once
+    this->context.addWindow(this);
+    this->on_status_changed();
 
+    if (!path.empty())
+    {
+        doRequest(path);
+    }
+    // Offer to recover an unsaved document (eg. after a crash), instead of showing the homepage
+    else if (this->findUnsavedDocument())
+    {
+        Glib::signal_idle().connect_once(sigc::mem_fun(this, &MainWindow::recover_autosave));
+    }
+    else
+    {
 // Show homepage if debugging is disabled
 #ifdef NDEBUG
-    go_home();
+        go_home();
 #else
-    std::cout << "INFO: Running as Debug mode, opening test.md." << std::endl;
-    // Load test file when developing
-    doRequest("file://../../test.md");
+        std::cout << "INFO: Running as Debug mode, opening test.md." << std::endl;
+        // Load test file when developing
+        doRequest("file://../../test.md");
 #endif
+    }
+}
+
+/**
+ * \brief The window is closed, its threads are stopped (the shared state stays for the other windows)
+ */
+MainWindow::~MainWindow()
+{
+    this->context.removeWindow(this);
+    this->hoverTimerHandler.disconnect();
+    this->visibleLinksTimerHandler.disconnect();
+    this->prefetcher.cancel(this);
+    this->stopRequestThread();
+    this->sitePublisher.cancel();
+    this->stopPublishThread();
+    this->downloadCancelled = true;
+    this->stopDownloadThread();
 }
 
 /**
@@ -454,6 +555,109 @@ MainWindow::MainWindow(const std::string &timeout)
  * \param isParseContext If true the content received will be parsed and displayed as markdown syntax (default: true), set to false if you want to editor the content
  */
 void MainWindow::doRequest(const std::string &path, bool isSetAddressBar, bool isHistoryRequest, bool isDisableEditor, bool isParseContent)
+{
+    std::string pagePath = path;
+    std::string fragment;
+    std::size_t hashPos = path.find('#');
+    if (hashPos != std::string::npos)
+    {
+        pagePath = path.substr(0, hashPos);
+        fragment = path.substr(hashPos + 1);
+    }
+    // Save link of a file that isn't shown as page (eg. a video)
+    if (pagePath.rfind("about:save?", 0) == 0)
+    {
+        this->save_to_disk(pagePath.substr(11));
+        return;
+    }
+    // Links to a heading of the current page only jump to the heading, without fetching or drawing the page again
+    if (!fragment.empty() && pagePath.empty() && this->isEditorEnabled())
+    {
+        this->scrollToFragment(m_draw_secondary, fragment);
+        return;
+    }
+    if (!fragment.empty() && !this->isEditorEnabled() && (pagePath.empty() || pagePath == this->currentPagePath))
+    {
+        this->scrollToFragment(m_draw_main, fragment);
+        this->postDoRequest(this->currentPagePath + "#" + fragment, isSetAddressBar, isHistoryRequest, false);
+        return;
+    }
+
+    // Keep the page we are leaving, for back/forward navigation
+    if (!isHistoryRequest && !path.empty())
+        this->storeBackForwardPage();
+    // Prefetches of the page we are leaving are no longer needed (a fetch of the requested page continues)
+    this->hoverTimerHandler.disconnect();
+    this->visibleLinksTimerHandler.disconnect();
+    this->prefetcher.cancel(this);
+    this->stopRequestThread();
+
+    if (m_requestThread == nullptr)
+    {
+        this->isPageRendered = false;
+        this->pendingScrollOffset = -1;
+        // Show spinning icon
+        m_refreshIcon.get_style_context()->add_class("spinning");
+        // Start thread
+        this->pendingFragment = fragment;
+        if (!pagePath.empty())
+        {
+            this->currentPagePath = pagePath;
+            this->isDirectoryPage = false;
+        }
+        m_requestThread = new std::thread(&MainWindow::processRequest, this, pagePath, isParseContent);
+        this->postDoRequest(path, isSetAddressBar, isHistoryRequest, isDisableEditor);
+    }
+}
+
+/**
+ * \brief Resolve a link relative to the current page, eg. "chapter2.md" on "ipfs://<cid>/book/chapter1.md"
+ * is "ipfs://<cid>/book/chapter2.md", and "/about.md" is relative to the root of the site (CID or IPNS name).
+ * Absolute links (with a scheme, CID or IPFS path) are returned as-is.
+ * \param link Link URL, optionally with #fragment
+ * \return Resolved link
+ */
+std::string MainWindow::resolveLink(const std::string &link) const
+{
+    if (link.empty() || link[0] == '#' || link.find("://") != std::string::npos || link.rfind("about:", 0) == 0 ||
+        link.rfind("/ipfs/", 0) == 0 || link.rfind("/ipns/", 0) == 0 || CID::isValid(link.substr(0, link.find_first_of("/?#"))))
+        return link;
+    // Split the current page path in the scheme, the root (CID, IPNS name or file system root) and the path within
+    std::string base = this->currentPagePath.substr(0, this->currentPagePath.find('?'));
+    std::string scheme;
+    std::size_t schemeEnd = base.find("://");
+    if (schemeEnd != std::string::npos)
+    {
+        scheme = base.substr(0, schemeEnd + 3);
+        base.erase(0, schemeEnd + 3);
+    }
+    std::size_t rootEnd = 0;
+    if (scheme == "ipfs://" || scheme == "ipns://" || (scheme.empty() && isValidIPFSPath(base)))
+        rootEnd = base.find('/', (base.rfind("/ipfs/", 0) == 0 || base.rfind("/ipns/", 0) == 0) ? 6 : 0);
+    else if (scheme != "file://")
+        return link; // Eg. about:home
+    if (rootEnd == std::string::npos)
+    {
+        // A bare CID or name is the root directory
+        rootEnd = base.size();
+        base += '/';
+    }
+    std::string resolved;
+    if (link[0] == '?')
+        resolved = base + link; // Same page (eg. other page of a directory listing)
+    else if (link[0] == '/')
+        resolved = base.substr(0, rootEnd) + link;
+    else if (this->isDirectoryPage || base.back() == '/')
+        resolved = base + (base.back() == '/' ? "" : "/") + link;
+    else
+        resolved = base.substr(0, base.rfind('/') + 1) + link;
+    return scheme + resolved.substr(0, rootEnd) + normalizePath(resolved.substr(rootEnd));
+}
+
+/**
+ * \brief Cancel the running request (if any)
+ */
+void MainWindow::stopRequestThread()
 {
     if (m_requestThread)
     {
@@ -465,17 +669,166 @@ void MainWindow::doRequest(const std::string &path, bool isSetAddressBar, bool i
             m_requestThread = nullptr;
         }
     }
+}
 
-    if (m_requestThread == nullptr)
+/**
+ * \brief Run a publish job in the publish thread, the progress is shown in a dialog (with cancel button)
+ * \param job Publish job, called in the publish thread
+ */
+void MainWindow::startPublish(const std::function<SitePublisher::Result(const SitePublisher::ProgressCallback &)> &job)
+{
+    if (m_publishThread)
+        return; // Already publishing
+    this->publishSent = 0;
+    this->publishTotal = 0;
+    m_publishProgressBar.set_fraction(0.0);
+    m_publishProgressDialog.reset(new Gtk::MessageDialog(*this, "Publishing to IPFS...", false, Gtk::MESSAGE_INFO, Gtk::BUTTONS_CANCEL));
+    m_publishProgressDialog->get_content_area()->pack_end(m_publishProgressBar);
+    m_publishProgressDialog->signal_response().connect(sigc::mem_fun(this, &MainWindow::on_publish_progress_response));
+    m_publishProgressDialog->show_all();
+
+    m_publishThread = new std::thread([this, job]() {
+        try
+        {
+            this->publishResult = job([this](uint64_t sent, uint64_t total) {
+                this->publishSent = sent;
+                this->publishTotal = total;
+                this->publishProgressDispatcher.emit();
+            });
+            this->publishError.clear();
+        }
+        catch (const std::runtime_error &error)
+        {
+            this->publishError = error.what();
+        }
+        this->publishFinishedDispatcher.emit();
+    });
+}
+
+/**
+ * \brief Wait for the publish thread (after it is finished or cancelled)
+ */
+void MainWindow::stopPublishThread()
+{
+    if (m_publishThread)
     {
-        // Show spinning icon
-        m_refreshIcon.get_style_context()->add_class("spinning");
-        // Start thread
-        m_requestThread = new std::thread(&MainWindow::processRequest, this, path, isParseContent);
-        this->postDoRequest(path, isSetAddressBar, isHistoryRequest, isDisableEditor);
+        if (m_publishThread->joinable())
+            m_publishThread->join();
+        delete m_publishThread;
+        m_publishThread = nullptr;
+    }
+}
+
+/**
+ * \brief Save an IPFS file to disk in the download thread, the file is streamed to disk (not kept in memory).
+ * The progress is shown in a dialog (with cancel button).
+ * \param path IPFS path
+ * \param filePath Destination file
+ */
+void MainWindow::startDownload(const std::string &path, const std::string &filePath)
+{
+    if (m_downloadThread)
+        return; // Already downloading
+    this->downloadReceived = 0;
+    this->downloadTotal = 0;
+    this->downloadCancelled = false;
+    this->downloadFilePath = filePath;
+    m_downloadProgressBar.set_fraction(0.0);
+    m_downloadProgressDialog.reset(new Gtk::MessageDialog(*this, "Saving to disk...", false, Gtk::MESSAGE_INFO, Gtk::BUTTONS_CANCEL));
+    m_downloadProgressDialog->set_secondary_text(filePath);
+    m_downloadProgressDialog->get_content_area()->pack_end(m_downloadProgressBar);
+    m_downloadProgressDialog->signal_response().connect(sigc::mem_fun(this, &MainWindow::on_download_progress_response));
+    m_downloadProgressDialog->show_all();
+
+    m_downloadThread = new std::thread([this, path, filePath]() {
+        try
+        {
+            std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw std::runtime_error("Could not open file: " + filePath);
+            std::string unused;
+            FetchSink sink(unused, 0, [this, &sink](std::size_t received, std::size_t total) {
+                if (this->downloadCancelled)
+                    sink.abort();
+                this->downloadReceived = received;
+                this->downloadTotal = total;
+                if (!this->downloadProgressPending.exchange(true))
+                    this->downloadProgressDispatcher.emit();
+            });
+            sink.setStream(file);
+            this->ipfs.fetch(path, sink);
+            file.close();
+            if (!file)
+                throw std::runtime_error("Could not write file: " + filePath);
+            this->downloadError.clear();
+        }
+        catch (const std::runtime_error &error)
+        {
+            this->downloadError = error.what();
+        }
+        this->downloadFinishedDispatcher.emit();
+    });
+}
+
+/**
+ * \brief Wait for the download thread (after it is finished or cancelled)
+ */
+void MainWindow::stopDownloadThread()
+{
+    if (m_downloadThread)
+    {
+        if (m_downloadThread->joinable())
+            m_downloadThread->join();
+        delete m_downloadThread;
+        m_downloadThread = nullptr;
     }
 }
 
+/**
+ * \brief Store the current page (rendered form and scroll position) in the back/forward cache, under the current history index
+ */
+void MainWindow::storeBackForwardPage()
+{
+    if (!this->isPageRendered || this->isEditorEnabled() || currentHistoryIndex >= history.size())
+        return;
+    auto page = std::make_shared<BackForwardCache::Page>();
+    page->path = history.at(currentHistoryIndex);
+    page->pagePath = this->currentPagePath;
+    page->isDirectoryPage = this->isDirectoryPage;
+    page->content = this->currentContent;
+    m_draw_main.captureDocument(page->document);
+    Gdk::Rectangle visibleRect;
+    Gtk::TextBuffer::iterator topIter;
+    m_draw_main.get_visible_rect(visibleRect);
+    m_draw_main.get_iter_at_location(topIter, visibleRect.get_x(), visibleRect.get_y());
+    page->scrollOffset = topIter.get_offset();
+    this->backForwardCache.put(currentHistoryIndex, page);
+}
+
+/**
+ * \brief Show the page of the current history index from the back/forward cache, without fetching or parsing
+ * \return False when the page is not cached
+ */
+bool MainWindow::restoreBackForwardPage()
+{
+    auto page = this->backForwardCache.get(currentHistoryIndex);
+    if (!page || page->path != history.at(currentHistoryIndex) || this->isEditorEnabled())
+        return false;
+    this->stopRequestThread();
+    m_refreshIcon.get_style_context()->remove_class("spinning");
+    m_waitPageVisible = false;
+    this->currentPagePath = page->pagePath;
+    this->isDirectoryPage = page->isDirectoryPage;
+    this->currentContent = page->content;
+    this->requestPath = page->pagePath;
+    this->pendingFragment.clear();
+    this->pendingScrollOffset = page->scrollOffset;
+    this->isPageRendered = false;
+    m_draw_main.restoreDocument(page->document);
+    this->postDoRequest(page->path, true, true, true);
+    return true;
+}
+
 /**
  * \brief Called when Window is closed
  */
@@ -486,26 +839,82 @@ bool MainWindow::delete_window(GdkEventAny *any_event __attribute__((unused)))
     m_settings->set_int("height", this->get_height());
     m_settings->set_boolean("maximized", this->is_maximized());
     m_settings->set_int("position-divider", this->m_paned.get_position());
+    // Write the last edits, the journal is kept so the unsaved document is recovered next time
+    this->autosave.stop(false);
+    // Abort publishing, the publish thread uses the window
+    this->sitePublisher.cancel();
+    this->stopPublishThread();
+    this->downloadCancelled = true;
+    this->stopDownloadThread();
     // Fullscreen will be availible with gtkmm-4.0
     //m_settings->set_boolean("fullscreen", this->is_fullscreen());
     return false;
 }
 
 /**
- * \brief Timeout slot: Update the IPFS connection status every x seconds
+ * \brief Notify that a new IPFS status snapshot is available (thread-safe), from the status monitor
+ */
+void MainWindow::notifyStatusChanged()
+{
+    this->statusDispatcher.emit();
+}
+
+/**
+ * \brief Notify that the resolution of an IPNS name changed (thread-safe), from the name resolver
+ * \param path Name path (eg. /ipns/example.com)
+ */
+void MainWindow::notifyNameRefreshed(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->nameResolutionMutex);
+        this->refreshedNamePath = path;
+    }
+    this->nameResolutionDispatcher.emit();
+}
+
+/**
+ * \brief Notify that the IPFS daemon is ready (thread-safe), eg. from the daemon supervisor
+ */
+void MainWindow::notifyDaemonReady()
+{
+    this->daemonReadyDispatcher.emit();
+}
+
+/**
+ * \brief Signal handler when the IPFS daemon is ready, the status is updated and
+ * the request waiting for the daemon is retried at once (instead of at the next status poll)
  */
-bool MainWindow::update_connection_status()
+void MainWindow::on_daemon_ready()
 {
-    // Try to set the client ID & Public key and version
-    if (this->clientID.empty())
-        this->clientID = ipfs.getClientID();
-    if (this->clientPublicKey.empty())
-        this->clientPublicKey = ipfs.getClientPublicKey();
-    if (this->ipfsVersion.empty())
-        this->ipfsVersion = ipfs.getVersion();
+    this->statusMonitor.refreshNow();
+    if (m_waitPageVisible)
+        this->refresh();
+}
 
-    std::size_t nrPeers = ipfs.getNrPeers();
-    if (nrPeers > 0)
+/**
+ * \brief Signal handler when a new IPFS status snapshot is available (from the status monitor thread)
+ */
+void MainWindow::on_status_changed()
+{
+    std::shared_ptr<const IPFSStatusMonitor::Status> status = statusMonitor.getStatus();
+    if (!status)
+        return;
+    // Keep the client ID & Public key and version, for copying
+    if (!status->clientID.empty())
+        this->clientID = status->clientID;
+    if (!status->clientPublicKey.empty())
+        this->clientPublicKey = status->clientPublicKey;
+    if (!status->version.empty())
+        this->ipfsVersion = status->version;
+    this->prefetcher.setBandwidthRate(status->bandwidth.rateIn);
+    std::string resolution;
+    {
+        std::lock_guard<std::mutex> lock(this->nameResolutionMutex);
+        if (!this->nameResolutionStatus.empty())
+            resolution = "\n\n" + this->nameResolutionStatus;
+    }
+
+    if (status->nrPeers > 0)
     {
         if (m_useCurrentGTKIconTheme)
         {
@@ -520,16 +929,24 @@ bool MainWindow::update_connection_status()
         if (m_waitPageVisible)
             this->refresh();
 
-        std::map<std::string, float> rates = ipfs.getBandwidthRates();
         char buf[32];
-        std::string in = std::string(buf, std::snprintf(buf, sizeof buf, "%.1f", rates.at("in") / 1000.0));
-        std::string out = std::string(buf, std::snprintf(buf, sizeof buf, "%.1f", rates.at("out") / 1000.0));
+        std::string in = std::string(buf, std::snprintf(buf, sizeof buf, "%.1f", status->bandwidth.rateIn / 1000.0));
+        std::string out = std::string(buf, std::snprintf(buf, sizeof buf, "%.1f", status->bandwidth.rateOut / 1000.0));
+
+        // Average request time on reused (keep-alive) and new connections
+        const IPFSClientPool::Metrics &metrics = status->metrics;
+        double reusedAverage = (metrics.reusedRequests > 0) ? (metrics.reusedSeconds * 1000.0 / metrics.reusedRequests) : 0.0;
+        double newAverage = (metrics.newRequests > 0) ? (metrics.newSeconds * 1000.0 / metrics.newRequests) : 0.0;
+        std::string reused = std::string(buf, std::snprintf(buf, sizeof buf, "%.1f", reusedAverage));
+        std::string created = std::string(buf, std::snprintf(buf, sizeof buf, "%.1f", newAverage));
 
         // And also update text
-        m_statusLabel.set_text("IPFS Network Stats:\n\nConnected peers: " + std::to_string(nrPeers) +
-                               "\nRate in:    " + in + " kB/s" +
-                               "\nRate out: " + out + " kB/s" +
-                               "\n\nIPFS version: " + this->ipfsVersion);
+        m_statusLabel.set_text("IPFS Network Stats:\n\nConnected peers: " + std::to_string(status->nrPeers) +
+                               "\nRate in:    " + in + " kB/s  " + getSparkline(status->bandwidthHistory, true) +
+                               "\nRate out: " + out + " kB/s  " + getSparkline(status->bandwidthHistory, false) +
+                               "\n\nRequests (reused connection): " + std::to_string(metrics.reusedRequests) + ", avg. " + reused + " ms" +
+                               "\nRequests (new connection): " + std::to_string(metrics.newRequests) + ", avg. " + created + " ms" +
+                               getFetchLatencyText(status->fetchLatency) + getEndpointText(status->endpoints) + "\n\nIPFS version: " + this->ipfsVersion + resolution);
     }
     else
     {
@@ -541,11 +958,196 @@ bool MainWindow::update_connection_status()
         {
             m_statusIcon.set(m_statusOfflineIcon);
         }
-        m_statusLabel.set_text("Disconnected!");
+        m_statusLabel.set_text("Disconnected!" + resolution);
     }
+}
 
-    // Keep going (never disconnect the timer)
-    return true;
+/**
+ * \brief Signal handler when the window becomes (in)active
+ */
+void MainWindow::on_active_changed()
+{
+    this->updateStatusForeground();
+}
+
+/**
+ * \brief Signal handler when the window is (de)iconified
+ */
+bool MainWindow::on_window_state_changed(GdkEventWindowState *window_state_event __attribute__((unused)))
+{
+    this->updateStatusForeground();
+    return false;
+}
+
+/**
+ * \brief Poll the IPFS status at the normal rate when the window is focused, slow down otherwise
+ */
+void MainWindow::updateStatusForeground()
+{
+    Glib::RefPtr<Gdk::Window> window = this->get_window();
+    bool isIconified = window && (window->get_state() & Gdk::WINDOW_STATE_ICONIFIED);
+    statusMonitor.setForeground(this->is_visible() && this->is_active() && !isIconified);
+}
+
+/**
+ * \brief Signal handler when the pointer moves onto a link (or leaves a link), prefetch when it stays on the link
+ */
+void MainWindow::on_link_hovered(const std::string &url)
+{
+    this->hoveredLink = url;
+    this->hoverTimerHandler.disconnect();
+    if (!url.empty())
+        this->hoverTimerHandler = Glib::signal_timeout().connect(sigc::mem_fun(this, &MainWindow::on_hover_timeout), 100);
+}
+
+/**
+ * \brief Timeout slot: The pointer is still on the link
+ */
+bool MainWindow::on_hover_timeout()
+{
+    this->prefetchLink(this->hoveredLink, PagePrefetcher::PRIORITY_HIGH);
+    return false;
+}
+
+/**
+ * \brief Signal handler when the main text view is scrolled, prefetch the visible links once scrolling stops
+ */
+void MainWindow::on_main_scrolled()
+{
+    if (this->isPageRendered && !this->isEditorEnabled())
+    {
+        this->visibleLinksTimerHandler.disconnect();
+        this->visibleLinksTimerHandler = Glib::signal_timeout().connect(sigc::mem_fun(this, &MainWindow::on_visible_links_timeout), 300);
+    }
+}
+
+/**
+ * \brief Timeout slot: Prefetch the links in the viewport (low priority)
+ */
+bool MainWindow::on_visible_links_timeout()
+{
+    if (!this->isEditorEnabled())
+    {
+        for (const std::string &url : m_draw_main.getVisibleLinks())
+            this->prefetchLink(url, PagePrefetcher::PRIORITY_LOW);
+    }
+    return false;
+}
+
+/**
+ * \brief Prefetch the page of a link, only immutable IPFS content (CIDs) is prefetched
+ * \param url Link URL
+ * \param priority Prefetch priority
+ */
+void MainWindow::prefetchLink(const std::string &url, PagePrefetcher::Priority priority)
+{
+    std::string path = url.substr(0, url.find('#'));
+    if (path.empty())
+        return;
+    path = this->resolveLink(path);
+    std::string currentPath = this->currentPagePath;
+    if (path.rfind("ipfs://", 0) == 0)
+        path.erase(0, 7);
+    else if (path.find("://") != std::string::npos || path.rfind("about:", 0) == 0)
+        return;
+    if (currentPath.rfind("ipfs://", 0) == 0)
+        currentPath.erase(0, 7);
+    std::string key = getContentCacheKey(path);
+    if (!key.empty() && key != getContentCacheKey(currentPath))
+        this->prefetcher.prefetch(key, path, priority, this);
+}
+
+/**
+ * \brief Bandwidth history as a small text graph (using block characters)
+ * \param samples Bandwidth samples, oldest first
+ * \param isIncoming Incoming rates, or outgoing rates
+ * \return Graph text
+ */
+std::string MainWindow::getSparkline(const std::vector<IPFSStatusMonitor::BandwidthSample> &samples, bool isIncoming)
+{
+    std::vector<double> rates;
+    for (const auto &sample : samples)
+        rates.push_back(isIncoming ? sample.rateIn : sample.rateOut);
+    return getBars(rates);
+}
+
+/**
+ * \brief Values as block characters, scaled to the peak value
+ * \return Graph text
+ */
+std::string MainWindow::getBars(const std::vector<double> &values)
+{
+    static const char *const BARS[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+    double peak = 0.0;
+    for (double value : values)
+        peak = std::max(peak, value);
+    std::string bars;
+    for (double value : values)
+    {
+        int level = (peak > 0.0) ? static_cast<int>(value / peak * 7.0 + 0.5) : 0;
+        bars += BARS[level];
+    }
+    return bars;
+}
+
+/**
+ * \brief Fetch latencies and the current (adaptive) time-outs, with a histogram of the total fetch times
+ * \param stats Latency statistics, per content source and cache state
+ * \return Status text, empty when nothing is fetched yet
+ */
+std::string MainWindow::getFetchLatencyText(const std::vector<FetchTimeoutPolicy::Stats> &stats)
+{
+    std::string text;
+    for (const auto &entry : stats)
+    {
+        std::string name = "Daemon via TCP";
+        if (entry.source == FetchTimeoutPolicy::SOURCE_ENDPOINTS)
+            name = "Multiple endpoints";
+        else if (entry.source == FetchTimeoutPolicy::SOURCE_SOCKET)
+            name = (entry.cacheState == FetchTimeoutPolicy::CACHE_LOCAL) ? "Local daemon, cached" : "Local daemon, from network";
+        std::vector<double> histogram(entry.histogram.begin(), entry.histogram.end());
+        const auto &limits = FetchTimeoutPolicy::getBucketLimits();
+        text += "\n" + name + " (" + std::to_string(entry.samples) + " fetches, " + std::to_string(entry.timeouts) + " time-outs):" +
+                "\n    First byte: " + formatDuration(entry.firstByteMedian) + " / " + formatDuration(entry.firstBytePercentile95) +
+                ", time-out " + formatDuration(entry.deadline.firstByte) +
+                "\n    Total: " + formatDuration(entry.totalMedian) + " / " + formatDuration(entry.totalPercentile95) +
+                ", time-out " + formatDuration(entry.deadline.total) +
+                "\n    " + formatDuration(limits.front()) + " " + getBars(histogram) + " " + formatDuration(limits.back()) + "+";
+    }
+    if (text.empty())
+        return text;
+    return "\n\nFetch latency (median / 95th percentile):" + text;
+}
+
+/**
+ * \brief Health of the API endpoints, in the configured order
+ * \param endpoints Endpoint status, empty without extra endpoints
+ * \return Status text, empty without extra endpoints
+ */
+std::string MainWindow::getEndpointText(const std::vector<HedgedFetcher::EndpointStatus> &endpoints)
+{
+    std::string text;
+    for (const auto &endpoint : endpoints)
+    {
+        std::string firstByte = (endpoint.averageFirstByte.count() > 0) ? formatDuration(endpoint.averageFirstByte) : "unknown";
+        text += "\n" + std::string(endpoint.isHealthy ? "✔ " : "✘ ") + endpoint.name + ": first byte " + firstByte +
+                ", hedge after " + formatDuration(endpoint.hedgeDelay) + "\n    " + std::to_string(endpoint.requests) + " requests, " +
+                std::to_string(endpoint.wins) + " won, " + std::to_string(endpoint.failures) + " failed";
+    }
+    if (text.empty())
+        return text;
+    return "\n\nAPI endpoints:" + text;
+}
+
+/**
+ * \brief Duration as text, in milliseconds or seconds (eg. "350 ms" or "2.5 s")
+ */
+std::string MainWindow::formatDuration(std::chrono::milliseconds duration)
+{
+    if (duration.count() < 1000)
+        return std::to_string(duration.count()) + " ms";
+    char buf[32];
+    return std::string(buf, std::snprintf(buf, sizeof buf, "%.1f s", duration.count() / 1000.0));
 }
 
 /***
@@ -698,6 +1300,32 @@ void MainWindow::selectAll()
     }
 }
 
+/**
+ * \brief Trigger when user selected 'new window' from menu item, the window shares the state of this window
+ */
+void MainWindow::new_window()
+{
+    Glib::RefPtr<Gtk::Application> application = this->get_application();
+    if (application)
+        application->activate();
+}
+
+/**
+ * \brief Trigger when user selected 'quit' from menu item, all windows are closed
+ */
+void MainWindow::quit()
+{
+    Glib::RefPtr<Gtk::Application> application = this->get_application();
+    if (!application)
+    {
+        this->hide();
+        return;
+    }
+    // Closed windows are deleted, which is not a problem for the copied list
+    for (Gtk::Window *window : application->get_windows())
+        window->hide();
+}
+
 /**
  * \brief Trigger when user selected 'new document' from menu item
  */
@@ -823,6 +1451,7 @@ void MainWindow::on_open_edit_dialog_response(int response_id, Gtk::FileChooserD
         this->set_title(fileName + " - " + m_appName);
         // Set current file path for saving feature
         this->currentFileSavedPath = filePath;
+        this->autosave.setFilePath(filePath);
         break;
     }
     case Gtk::ResponseType::RESPONSE_CANCEL:
@@ -867,6 +1496,8 @@ void MainWindow::save()
             try
             {
                 File::write(currentFileSavedPath, this->currentContent);
+                // The journal only needs to contain the saved state
+                this->autosave.compact(this->currentContent, true);
             }
             catch (std::ios_base::failure &error)
             {
@@ -941,6 +1572,8 @@ void MainWindow::on_save_as_dialog_response(int response_id, Gtk::FileChooserDia
             {
                 // Set/update the current file saved path variable (used for the 'save' feature)
                 this->currentFileSavedPath = filePath;
+                this->autosave.setFilePath(filePath);
+                this->autosave.compact(this->currentContent, true);
                 // And also update the address bar with the current file path
                 this->m_addressBar.set_text("file://" + filePath);
                 // Set title
@@ -967,6 +1600,26 @@ void MainWindow::on_save_as_dialog_response(int response_id, Gtk::FileChooserDia
     delete dialog;
 }
 
+/**
+ * \brief Signal handler for a new name resolution of the current page (from the request thread),
+ * or a refreshed name (from the resolver thread): the page is reloaded when its name now resolves to other content
+ */
+void MainWindow::on_name_resolution()
+{
+    std::string namePath;
+    {
+        std::lock_guard<std::mutex> lock(this->nameResolutionMutex);
+        namePath.swap(this->refreshedNamePath);
+    }
+    if (!namePath.empty())
+    {
+        std::string currentPath = (this->requestPath.rfind("ipns://", 0) == 0) ? "/ipns/" + this->requestPath.substr(7) : this->requestPath;
+        if (currentPath == namePath || currentPath.rfind(namePath + "/", 0) == 0)
+            this->refresh();
+    }
+    this->on_status_changed();
+}
+
 /**
  * \brief Triggered when user selected the 'Publish...' menu item or publish button in the toolbar
  */
@@ -985,85 +1638,235 @@ void MainWindow::publish()
     // Continue ...
     if (result == Gtk::RESPONSE_YES)
     {
-        std::string path = "new_file.md";
+        std::string name = "new_file.md";
         // Retrieve filename from saved file (if present)
         if (!currentFileSavedPath.empty())
         {
-            path = currentFileSavedPath;
-        }
-        else
-        {
-            // TODO: path is not defined yet. however, this may change anyway once we try to build more complex websites,
-            // needing to use directory structures.
-        }
-        // TODO:  should we run this within a seperate thread? Looks fine until now without threading.
-
-        // Add content to IPFS!
-        try
-        {
-            std::string cid = ipfs.add(path, this->currentContent);
-            // TODO: Give pop-up or some other indication the data is stored in IPFS...
-            if (!cid.empty())
-            {
-                m_contentPublishedDialog.reset(new Gtk::MessageDialog(*this, "File is successfully added to IPFS!"));
-                m_contentPublishedDialog->set_secondary_text("The content is now available on the decentralized web, via:");
-                // Add custom label
-                Gtk::Label *label = Gtk::manage(new Gtk::Label("ipfs://" + cid));
-                label->set_selectable(true);
-                Gtk::Box *box = m_contentPublishedDialog->get_content_area();
-                box->pack_end(*label);
-
-                m_contentPublishedDialog->set_modal(true);
-
-                // m_contentPublishedDialog->set_hide_on_close(true); available in gtk-4.0
-                m_contentPublishedDialog->signal_response().connect(
-                    sigc::hide(sigc::mem_fun(*m_contentPublishedDialog, &Gtk::Widget::hide)));
-                m_contentPublishedDialog->show_all();
-            }
-            else
-            {
-                m_contentPublishedDialog.reset(new Gtk::MessageDialog(*this, "File failed to be added added to IPFS", false,
-                                                                      Gtk::MESSAGE_ERROR));
-                m_contentPublishedDialog->set_modal(true);
-                // m_contentPublishedDialog->set_hide_on_close(true); available in gtk-4.0
-                m_contentPublishedDialog->signal_response().connect(
-                    sigc::hide(sigc::mem_fun(*m_contentPublishedDialog, &Gtk::Widget::hide)));
-                m_contentPublishedDialog->show();
-            }
-        }
-        catch (const std::runtime_error &error)
-        {
-            m_contentPublishedDialog.reset(new Gtk::MessageDialog(*this, "File could not be added to IPFS", false,
-                                                                  Gtk::MESSAGE_ERROR));
-            m_contentPublishedDialog->set_secondary_text("Error message: " + std::string(error.what()));
-            m_contentPublishedDialog->set_modal(true);
-            // m_contentPublishedDialog->set_hide_on_close(true); available in gtk-4.0
-            m_contentPublishedDialog->signal_response().connect(
-                sigc::hide(sigc::mem_fun(*m_contentPublishedDialog, &Gtk::Widget::hide)));
-            m_contentPublishedDialog->show();
+            name = File::getFilename(currentFileSavedPath);
         }
+        // The publish thread gets its own copy, the document can be edited meanwhile
+        std::string content = this->currentContent;
+        CID::Chunker chunker = m_settings->get_boolean("content-defined-chunking") ? CID::CHUNKER_BUZHASH : CID::CHUNKER_FIXED;
+        this->startPublish([this, name, content, chunker](const SitePublisher::ProgressCallback &progress) {
+            return this->sitePublisher.publishContent(name, content, chunker, progress);
+        });
     }
 }
 
 /**
- * \brief Post-processing request actions
- * \param path File path (on disk or IPFS) that needs to be processed
- * \param isSetAddressBar If true change update the address bar with the file path
- * \param isHistoryRequest Set to true if this is an history request call: back/forward
- * \param isDisableEditor If true the editor will be disabled if needed
+ * \brief Triggered when user selected the 'Publish Folder...' menu item
  */
-void MainWindow::postDoRequest(const std::string &path, bool isSetAddressBar, bool isHistoryRequest, bool isDisableEditor)
+void MainWindow::publish_folder()
 {
-    if (isSetAddressBar)
-        m_addressBar.set_text(path);
-
-    if (isDisableEditor && isEditorEnabled())
-        this->disableEdit();
+    auto dialog = new Gtk::FileChooserDialog("Publish Folder", Gtk::FILE_CHOOSER_ACTION_SELECT_FOLDER);
+    dialog->set_transient_for(*this);
+    dialog->set_modal(true);
+    dialog->signal_response().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::on_publish_folder_dialog_response), dialog));
+    dialog->add_button("_Cancel", Gtk::ResponseType::RESPONSE_CANCEL);
+    dialog->add_button("_Publish", Gtk::ResponseType::RESPONSE_OK);
+    // Also used when publishing a single document
+    Gtk::CheckButton *chunkingButton = Gtk::manage(new Gtk::CheckButton("Content-defined chunking (deduplicates revisions)"));
+    chunkingButton->set_tooltip_text("Split files by their content, a revision of a document reuses the unchanged blocks of the earlier revision");
+    m_settings->bind("content-defined-chunking", chunkingButton->property_active());
+    chunkingButton->show();
+    dialog->set_extra_widget(*chunkingButton);
+    dialog->show();
+}
 
-    // Do not insert history back/forward calls into the history (again)
-    if (!isHistoryRequest)
+/**
+ * \brief Signal response when 'publish folder' dialog is closed
+ */
+void MainWindow::on_publish_folder_dialog_response(int response_id, Gtk::FileChooserDialog *dialog)
+{
+    if (response_id == Gtk::ResponseType::RESPONSE_OK)
     {
-        if (history.size() == 0)
+        std::string directory = dialog->get_file()->get_path();
+        CID::Chunker chunker = m_settings->get_boolean("content-defined-chunking") ? CID::CHUNKER_BUZHASH : CID::CHUNKER_FIXED;
+        this->startPublish([this, directory, chunker](const SitePublisher::ProgressCallback &progress) {
+            return this->sitePublisher.publish(directory, chunker, progress);
+        });
+    }
+    delete dialog;
+}
+
+/**
+ * \brief Signal handler for the upload progress (from the publish thread)
+ */
+void MainWindow::on_publish_progress()
+{
+    uint64_t total = this->publishTotal;
+    if (total > 0)
+        m_publishProgressBar.set_fraction(std::min(1.0, static_cast<double>(this->publishSent) / total));
+    else
+        m_publishProgressBar.pulse();
+}
+
+/**
+ * \brief Signal response of the publish progress dialog (cancel)
+ */
+void MainWindow::on_publish_progress_response(int response_id __attribute__((unused)))
+{
+    this->sitePublisher.cancel();
+    m_publishProgressDialog->set_response_sensitive(Gtk::RESPONSE_CANCEL, false);
+}
+
+/**
+ * \brief Signal handler when the publish thread is finished, show the CID(s)
+ */
+void MainWindow::on_publish_finished()
+{
+    this->stopPublishThread();
+    m_publishProgressDialog.reset();
+    if (!this->publishError.empty())
+    {
+        if (this->publishError == "Publishing is cancelled")
+            return;
+        m_contentPublishedDialog.reset(new Gtk::MessageDialog(*this, "File could not be added to IPFS", false,
+                                                              Gtk::MESSAGE_ERROR));
+        m_contentPublishedDialog->set_secondary_text("Error message: " + this->publishError);
+        m_contentPublishedDialog->set_modal(true);
+        // m_contentPublishedDialog->set_hide_on_close(true); available in gtk-4.0
+        m_contentPublishedDialog->signal_response().connect(
+            sigc::hide(sigc::mem_fun(*m_contentPublishedDialog, &Gtk::Widget::hide)));
+        m_contentPublishedDialog->show();
+        return;
+    }
+
+    bool isDirectory = this->publishResult.files.size() > 1 || this->publishResult.files.front().cid != this->publishResult.rootCID;
+    m_contentPublishedDialog.reset(new Gtk::MessageDialog(*this, isDirectory ? "Folder is successfully added to IPFS!" : "File is successfully added to IPFS!"));
+    const SitePublisher::BlockReport &blocks = this->publishResult.blocks;
+    m_contentPublishedDialog->set_secondary_text("Blocks: " + std::to_string(blocks.newBlocks) + " new (" + std::to_string(blocks.newBytes / 1024) + " KiB), " +
+                                                 std::to_string(blocks.reusedBlocks) + " reused (" + std::to_string(blocks.reusedBytes / 1024) + " KiB).\n\n" +
+                                                 "The content is now available on the decentralized web, via:");
+    // Add custom label
+    Gtk::Label *label = Gtk::manage(new Gtk::Label("ipfs://" + this->publishResult.rootCID));
+    label->set_selectable(true);
+    Gtk::Box *box = m_contentPublishedDialog->get_content_area();
+    if (isDirectory)
+    {
+        // Manifest: CID of each file
+        std::string manifest;
+        for (const SitePublisher::File &file : this->publishResult.files)
+            manifest += file.path + "  ipfs://" + file.cid + "\n";
+        Gtk::TextView *manifestView = Gtk::manage(new Gtk::TextView());
+        manifestView->set_editable(false);
+        manifestView->get_buffer()->set_text(manifest);
+        Gtk::ScrolledWindow *scrolledWindow = Gtk::manage(new Gtk::ScrolledWindow());
+        scrolledWindow->set_size_request(-1, 160);
+        scrolledWindow->add(*manifestView);
+        Gtk::Expander *expander = Gtk::manage(new Gtk::Expander("Files (" + std::to_string(this->publishResult.files.size()) + ")"));
+        expander->add(*scrolledWindow);
+        box->pack_end(*expander);
+    }
+    box->pack_end(*label);
+
+    m_contentPublishedDialog->set_modal(true);
+
+    // m_contentPublishedDialog->set_hide_on_close(true); available in gtk-4.0
+    m_contentPublishedDialog->signal_response().connect(
+        sigc::hide(sigc::mem_fun(*m_contentPublishedDialog, &Gtk::Widget::hide)));
+    m_contentPublishedDialog->show_all();
+}
+
+/**
+ * \brief Triggered when the save link of a file that isn't shown as page is clicked
+ * \param path IPFS path of the file
+ */
+void MainWindow::save_to_disk(const std::string &path)
+{
+    auto dialog = new Gtk::FileChooserDialog("Save to Disk", Gtk::FILE_CHOOSER_ACTION_SAVE);
+    dialog->set_transient_for(*this);
+    dialog->set_modal(true);
+    dialog->set_do_overwrite_confirmation(true);
+    dialog->signal_response().connect(sigc::bind(sigc::mem_fun(*this, &MainWindow::on_save_to_disk_dialog_response), dialog, path));
+    dialog->add_button("_Cancel", Gtk::ResponseType::RESPONSE_CANCEL);
+    dialog->add_button("_Save", Gtk::ResponseType::RESPONSE_OK);
+    // Name within the directory, or else the CID
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    dialog->set_current_name(name.empty() ? "download" : name);
+    dialog->show();
+}
+
+/**
+ * \brief Signal response when 'save to disk' dialog is closed
+ */
+void MainWindow::on_save_to_disk_dialog_response(int response_id, Gtk::FileChooserDialog *dialog, const std::string &path)
+{
+    if (response_id == Gtk::ResponseType::RESPONSE_OK)
+        this->startDownload(path, dialog->get_file()->get_path());
+    delete dialog;
+}
+
+/**
+ * \brief Signal handler for the save to disk progress (from the download thread)
+ */
+void MainWindow::on_download_progress()
+{
+    this->downloadProgressPending = false;
+    uint64_t total = this->downloadTotal;
+    if (total > 0)
+        m_downloadProgressBar.set_fraction(std::min(1.0, static_cast<double>(this->downloadReceived) / total));
+    else
+        m_downloadProgressBar.pulse();
+    m_downloadProgressBar.set_text(Glib::format_size(this->downloadReceived));
+    m_downloadProgressBar.set_show_text(true);
+}
+
+/**
+ * \brief Signal response of the save to disk progress dialog (cancel)
+ */
+void MainWindow::on_download_progress_response(int response_id __attribute__((unused)))
+{
+    this->downloadCancelled = true;
+    m_downloadProgressDialog->set_response_sensitive(Gtk::RESPONSE_CANCEL, false);
+}
+
+/**
+ * \brief Signal handler when the download thread is finished, an incomplete file is removed
+ */
+void MainWindow::on_download_finished()
+{
+    this->stopDownloadThread();
+    m_downloadProgressDialog.reset();
+    if (!this->downloadError.empty())
+        std::remove(this->downloadFilePath.c_str());
+    if (this->downloadCancelled)
+        return;
+    if (this->downloadError.empty())
+    {
+        m_downloadFinishedDialog.reset(new Gtk::MessageDialog(*this, "File is saved to disk"));
+        m_downloadFinishedDialog->set_secondary_text(this->downloadFilePath + " (" + Glib::format_size(this->downloadReceived) + ")");
+    }
+    else
+    {
+        m_downloadFinishedDialog.reset(new Gtk::MessageDialog(*this, "File could not be saved to disk", false, Gtk::MESSAGE_ERROR));
+        m_downloadFinishedDialog->set_secondary_text("Error message: " + this->downloadError);
+    }
+    m_downloadFinishedDialog->set_modal(true);
+    m_downloadFinishedDialog->signal_response().connect(
+        sigc::hide(sigc::mem_fun(*m_downloadFinishedDialog, &Gtk::Widget::hide)));
+    m_downloadFinishedDialog->show();
+}
+
+/**
+ * \brief Post-processing request actions
+ * \param path File path (on disk or IPFS) that needs to be processed
+ * \param isSetAddressBar If true change update the address bar with the file path
+ * \param isHistoryRequest Set to true if this is an history request call: back/forward
+ * \param isDisableEditor If true the editor will be disabled if needed
+ */
+void MainWindow::postDoRequest(const std::string &path, bool isSetAddressBar, bool isHistoryRequest, bool isDisableEditor)
+{
+    if (isSetAddressBar)
+        m_addressBar.set_text(path);
+
+    if (isDisableEditor && isEditorEnabled())
+        this->disableEdit();
+
+    // Do not insert history back/forward calls into the history (again)
+    if (!isHistoryRequest)
+    {
+        if (history.size() == 0)
         {
             history.push_back(path);
             currentHistoryIndex = history.size() - 1;
@@ -1118,37 +1921,113 @@ void MainWindow::copy_client_public_key()
 }
 
 /**
- * Trigger when pressed enter in the search entry
+ * Trigger when pressed enter in the search entry, select the next match
  */
 void MainWindow::on_search()
 {
-    // Forward search, find and select
-    std::string text = m_searchEntry.get_text();
-    auto buffer = m_draw_main.get_buffer();
-    Gtk::TextBuffer::iterator iter = buffer->get_iter_at_mark(buffer->get_mark("insert"));
-    Gtk::TextBuffer::iterator start, end;
-    bool matchCase = m_searchMatchCase.get_active();
-    Gtk::TextSearchFlags flags = Gtk::TextSearchFlags::TEXT_SEARCH_TEXT_ONLY;
-    if (!matchCase)
+    if (this->searchResult && !this->searchResultOutdated)
     {
-        flags |= Gtk::TextSearchFlags::TEXT_SEARCH_CASE_INSENSITIVE;
+        this->selectNextMatch();
     }
-    if (iter.forward_search(text, flags, start, end))
+    else
     {
-        buffer->select_range(end, start);
-        m_draw_main.scroll_to(start);
+        // Select the next match as soon as the (new) results are in
+        this->searchSelectPending = true;
+        this->startSearch();
+    }
+}
+
+/**
+ * Triggered when the search text or search options are changed, search while typing
+ */
+void MainWindow::on_search_changed()
+{
+    this->searchSelectPending = false;
+    this->startSearch();
+}
+
+/**
+ * Triggered (on the GUI thread) when data of the requested file is received, show the progress in the address bar
+ */
+void MainWindow::on_fetch_progress()
+{
+    this->fetchProgressPending = false;
+    std::size_t received = this->fetchReceived;
+    std::size_t total = this->fetchTotal;
+    if (received == 0)
+        m_addressBar.set_progress_fraction(0.0);
+    else if (total > 0)
+        m_addressBar.set_progress_fraction(std::min(1.0, static_cast<double>(received) / total));
+    else
+        m_addressBar.progress_pulse();
+}
+
+/**
+ * Triggered (on the GUI thread) when the search worker is finished
+ */
+void MainWindow::on_search_finished()
+{
+    auto result = this->textSearch.getResult();
+    // Outdated result, a newer search is running or will be started (the buffer changed meanwhile)
+    if (!result || this->searchResultOutdated)
+        return;
+    this->searchResult = result;
+    this->highlightMatches();
+    if (!result->error.empty())
+    {
+        m_searchMatchesLabel.set_text(result->error);
+    }
+    else if (result->pattern.empty())
+    {
+        m_searchMatchesLabel.set_text("");
+    }
+    else if (result->matches.empty())
+    {
+        m_searchMatchesLabel.set_text("No matches");
+    }
+    else if (this->searchSelectPending)
+    {
+        this->selectNextMatch();
     }
     else
     {
-        buffer->place_cursor(buffer->begin());
-        // Try another search directly from the top
-        Gtk::TextBuffer::iterator secondIter = buffer->get_iter_at_mark(buffer->get_mark("insert"));
-        if (secondIter.forward_search(text, flags, start, end))
-        {
-            buffer->select_range(end, start);
-            m_draw_main.scroll_to(start);
-        }
+        m_searchMatchesLabel.set_text(std::to_string(result->matches.size()) + (result->matches.size() == 1 ? " match" : " matches"));
     }
+    this->searchSelectPending = false;
+}
+
+/**
+ * Triggered when the main text buffer changed, the match offsets are no longer valid
+ */
+void MainWindow::on_search_buffer_changed()
+{
+    this->searchResultOutdated = true;
+    // Search again when the user stops typing (or the page is loaded)
+    if (m_hboxBottom.is_visible() && !m_searchEntry.get_text().empty() && !this->searchTimerHandler.connected())
+        this->searchTimerHandler = Glib::signal_timeout().connect(sigc::mem_fun(this, &MainWindow::on_search_timeout), 300);
+}
+
+/**
+ * Timeout after the buffer changed
+ * \return False to stop the timer
+ */
+bool MainWindow::on_search_timeout()
+{
+    this->startSearch();
+    return false;
+}
+
+/**
+ * Triggered when the search bar gets hidden
+ */
+void MainWindow::on_search_hide()
+{
+    this->searchTimerHandler.disconnect();
+    this->textSearch.cancel();
+    this->clearSearchHighlights();
+    this->searchResult.reset();
+    this->searchSelectPending = false;
+    m_searchMatchesLabel.set_text("");
 }
 
 /**
@@ -1174,6 +2053,69 @@ void MainWindow::on_replace()
     }
 }
 
+/**
+ * Trigger when user pressed the replace all button.
+ * The new document is build in one pass and set as a single user action, so it can be undone in one step.
+ */
+void MainWindow::on_replace_all()
+{
+    std::string pattern = m_searchEntry.get_text();
+    if (!m_draw_main.get_editable() || pattern.empty())
+        return;
+
+    bool matchCase = m_searchMatchCase.get_active();
+    bool isRegex = m_searchRegex.get_active();
+    auto result = this->searchResult;
+    // Re-use the search results when still valid, otherwise search directly
+    std::shared_ptr<const std::string> text;
+    std::vector<TextSearch::Match> matches;
+    if (result && !this->searchResultOutdated && result->error.empty() && result->pattern == pattern &&
+        result->matchCase == matchCase && result->isRegex == isRegex)
+    {
+        text = result->text;
+        matches = result->matches;
+    }
+    else
+    {
+        auto buffer = m_draw_main.get_buffer();
+        text = std::make_shared<const std::string>(buffer->get_slice(buffer->begin(), buffer->end(), true).raw());
+        try
+        {
+            matches = TextSearch::findAll(*text, pattern, matchCase, isRegex);
+        }
+        catch (const TextSearch::RegexError &error)
+        {
+            m_searchMatchesLabel.set_text(error.what());
+            return;
+        }
+    }
+    if (matches.empty())
+    {
+        m_searchMatchesLabel.set_text("No matches");
+        return;
+    }
+
+    std::string newText;
+    try
+    {
+        newText = TextSearch::replaceAll(*text, matches, pattern, m_searchReplaceEntry.get_text(), matchCase, isRegex);
+    }
+    catch (const TextSearch::RegexError &error)
+    {
+        m_searchMatchesLabel.set_text(error.what());
+        return;
+    }
+    auto buffer = m_draw_main.get_buffer();
+    int cursorOffset = buffer->get_insert()->get_iter().get_offset();
+    buffer->begin_user_action();
+    buffer->set_text(newText);
+    buffer->end_user_action();
+    buffer->place_cursor(buffer->get_iter_at_offset(cursorOffset));
+    this->clearSearchHighlights();
+    this->searchResult.reset();
+    m_searchMatchesLabel.set_text("Replaced " + std::to_string(matches.size()) + (matches.size() == 1 ? " match" : " matches"));
+}
+
 /**
  * Triggers when pressed enter in the address bar
  */
@@ -1196,10 +2138,12 @@ void MainWindow::show_search(bool replace)
             m_hboxBottom.hide();
             m_addressBar.grab_focus();
             m_searchReplaceEntry.hide();
+            m_replaceAllButton.hide();
         }
         else
         {
             m_searchReplaceEntry.hide();
+            m_replaceAllButton.hide();
         }
     }
     else if (m_hboxBottom.is_visible())
@@ -1207,12 +2151,14 @@ void MainWindow::show_search(bool replace)
         if (replace)
         {
             m_searchReplaceEntry.show();
+            m_replaceAllButton.show();
         }
         else
         {
             m_hboxBottom.hide();
             m_addressBar.grab_focus();
             m_searchReplaceEntry.hide();
+            m_replaceAllButton.hide();
         }
     }
     else
@@ -1222,11 +2168,15 @@ void MainWindow::show_search(bool replace)
         if (replace)
         {
             m_searchReplaceEntry.show();
+            m_replaceAllButton.show();
         }
         else
         {
             m_searchReplaceEntry.hide();
+            m_replaceAllButton.hide();
         }
+        // Highlight the matches of the previous search again
+        this->startSearch();
     }
 }
 
@@ -1234,8 +2184,10 @@ void MainWindow::back()
 {
     if (currentHistoryIndex > 0)
     {
+        this->storeBackForwardPage();
         currentHistoryIndex--;
-        doRequest(history.at(currentHistoryIndex), true, true);
+        if (!this->restoreBackForwardPage())
+            doRequest(history.at(currentHistoryIndex), true, true);
     }
 }
 
@@ -1243,8 +2195,10 @@ void MainWindow::forward()
 {
     if (currentHistoryIndex < history.size() - 1)
     {
+        this->storeBackForwardPage();
         currentHistoryIndex++;
-        doRequest(history.at(currentHistoryIndex), true, true);
+        if (!this->restoreBackForwardPage())
+            doRequest(history.at(currentHistoryIndex), true, true);
     }
 }
 
@@ -1304,12 +2258,33 @@ void MainWindow::enableEdit()
     this->m_draw_main.setViewSourceMenuItem(false);
     // Connect changed signal
     this->textChangedSignalHandler = m_draw_main.get_buffer().get()->signal_changed().connect(sigc::mem_fun(this, &MainWindow::editor_changed_text));
+    // Let the editor and preview follow each other
+    this->editorScrolledSignalHandler = m_scrolledWindowMain.get_vadjustment()->signal_value_changed().connect(sigc::mem_fun(this, &MainWindow::on_editor_scrolled));
+    this->previewScrolledSignalHandler = m_scrolledWindowSecondary.get_vadjustment()->signal_value_changed().connect(sigc::mem_fun(this, &MainWindow::on_preview_scrolled));
+    // Explicit user input decides which view leads, the scroll position also changes when a view is drawn again
+    this->isPreviewScrollLeader = false;
+    auto editorInput = sigc::mem_fun(this, &MainWindow::on_editor_input);
+    auto previewInput = sigc::mem_fun(this, &MainWindow::on_preview_input);
+    this->scrollInputSignalHandlers = {
+        m_scrolledWindowMain.signal_scroll_event().connect(sigc::hide(editorInput), false),
+        m_draw_main.signal_key_press_event().connect(sigc::hide(editorInput), false),
+        m_draw_main.signal_button_press_event().connect(sigc::hide(editorInput), false),
+        m_scrolledWindowMain.get_vscrollbar()->signal_change_value().connect(sigc::hide(sigc::hide(editorInput)), false),
+        m_scrolledWindowSecondary.signal_scroll_event().connect(sigc::hide(previewInput), false),
+        m_draw_secondary.signal_key_press_event().connect(sigc::hide(previewInput), false),
+        m_draw_secondary.signal_button_press_event().connect(sigc::hide(previewInput), false),
+        m_scrolledWindowSecondary.get_vscrollbar()->signal_change_value().connect(sigc::hide(sigc::hide(previewInput)), false)};
     // Enable publish menu item
     this->m_menu.setPublishMenuSensitive(true);
     // Disable edit menu item (you are already editing)
     this->m_menu.setEditMenuSensitive(false);
     // Just to be sure, disable the spinning animation
     this->m_refreshIcon.get_style_context()->remove_class("spinning");
+    // Autosave every edit to the journal
+    this->autosave.start(m_draw_main.getText(), this->currentFileSavedPath);
+    this->autosaveInsertSignalHandler = m_draw_main.get_buffer()->signal_insert().connect(sigc::mem_fun(this, &MainWindow::on_editor_insert), false);
+    this->autosaveEraseSignalHandler = m_draw_main.get_buffer()->signal_erase().connect(sigc::mem_fun(this, &MainWindow::on_editor_erase), false);
+    this->autosaveTimerHandler = Glib::signal_timeout().connect_seconds(sigc::mem_fun(this, &MainWindow::on_autosave_timeout), 30);
 }
 
 void MainWindow::disableEdit()
@@ -1321,6 +2296,22 @@ void MainWindow::disableEdit()
         this->m_scrolledWindowSecondary.hide();
         // Disconnect text changed signal
         this->textChangedSignalHandler.disconnect();
+        // Stop autosave, the document is closed
+        this->autosaveInsertSignalHandler.disconnect();
+        this->autosaveEraseSignalHandler.disconnect();
+        this->autosaveTimerHandler.disconnect();
+        this->autosave.stop(true);
+        // Stop scroll synchronization
+        this->editorScrolledSignalHandler.disconnect();
+        this->previewScrolledSignalHandler.disconnect();
+        for (sigc::connection &handler : this->scrollInputSignalHandlers)
+            handler.disconnect();
+        this->scrollInputSignalHandlers.clear();
+        if (this->scrollSyncTickId != 0)
+        {
+            m_paned.remove_tick_callback(this->scrollSyncTickId);
+            this->scrollSyncTickId = 0;
+        }
         // Show "view source" menu item again
         this->m_draw_main.setViewSourceMenuItem(true);
         this->m_draw_secondary.clearText();
@@ -1385,6 +2376,12 @@ void MainWindow::processRequest(const std::string &path, bool isParseContent)
             finalRequestPath.erase(0, 7);
             fetchFromIPFS(isParseContent);
         }
+        else if (requestPath.rfind("ipns://", 0) == 0)
+        {
+            // IPNS key or DNSLink domain
+            finalRequestPath = "/ipns/" + requestPath.substr(7);
+            fetchFromIPFS(isParseContent);
+        }
         else if ((requestPath.length() == 46) && (requestPath.rfind("Qm", 0) == 0))
         {
             // CIDv0
@@ -1414,24 +2411,163 @@ void MainWindow::processRequest(const std::string &path, bool isParseContent)
  */
 void MainWindow::fetchFromIPFS(bool isParseContent)
 {
+    // Invalid addresses are rejected without a round trip to the IPFS daemon
+    if (!isValidIPFSPath(finalRequestPath))
+    {
+        std::string message = "The address '" + finalRequestPath + "' doesn't start with a valid content identifier (CID).";
+        m_draw_main.showMessage("🔍 Invalid IPFS address", message + "\n\nPlease check the address for typos.");
+        m_refreshIcon.get_style_context()->remove_class("spinning");
+        return;
+    }
+    std::string ipfsPath = finalRequestPath;
+    // Path with the names within the directory (before it's resolved to a CID), eg. to save the file
+    std::string savePath;
+    std::string cacheKey;
+    std::string contentType;
+    uint64_t fileSize = 0;
+    // Known from the pre-flight stat, the fetch doesn't check it again
+    FetchTimeoutPolicy::CacheState cacheState = FetchTimeoutPolicy::CACHE_UNKNOWN;
     try
     {
-        this->currentContent = ipfs.fetch(finalRequestPath);
+        std::string resolutionStatus;
+        if (ipfsPath.rfind("/ipns/", 0) == 0)
+        {
+            // A cached resolution is used right away, also when it's expired (it's refreshed in the background)
+            NameResolver::Resolution resolution = nameResolver.resolve(ipfsPath);
+            ipfsPath = resolution.path;
+            resolutionStatus = "Name resolution:";
+            for (const std::string &step : resolution.chain)
+                resolutionStatus += "\n→ " + step;
+            resolutionStatus += "\nTTL: " + std::to_string(resolution.ttl.count()) + " s" + (resolution.isStale ? " (expired, refreshing...)" : "");
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->nameResolutionMutex);
+            this->nameResolutionStatus = resolutionStatus;
+        }
+        this->nameResolutionDispatcher.emit();
+        // Page number of a directory listing, eg. "?page=2"
+        std::size_t listingPage = 1;
+        std::size_t queryPos = ipfsPath.find('?');
+        if (queryPos != std::string::npos)
+        {
+            std::string query = ipfsPath.substr(queryPos + 1);
+            if (query.rfind("page=", 0) == 0)
+                listingPage = std::strtoul(query.c_str() + 5, nullptr, 10);
+            ipfsPath.erase(queryPos);
+        }
+        savePath = ipfsPath;
+        // Immutable content is served from the cache, also when the IPFS daemon is not (yet) running
+        cacheKey = getContentCacheKey(ipfsPath);
+        bool isRendered = false;
+        cmark_node *prefetchedDocument = nullptr;
+        if (!cacheKey.empty() && prefetcher.take(cacheKey, this->currentContent, prefetchedDocument))
+        {
+            // Fetched & parsed ahead (hovered or visible link)
+            contentCache.put(cacheKey, this->currentContent);
+        }
+        else if (!resolveDirectoryPath(ipfsPath, cacheKey, listingPage) && (cacheKey.empty() || !getCachedContent(cacheKey, this->currentContent)))
+        {
+            // Pre-flight: a large file (eg. a video) isn't downloaded into memory, a directory is shown by its index page
+            IPFS::FileStat fileStat;
+            if (ipfs.getFileStat(cacheKey.empty() ? ipfsPath : "/ipfs/" + cacheKey, fileStat, true))
+            {
+                if (fileStat.isDirectory && loadDirectory(cacheKey))
+                {
+                    this->fetchFromIPFS(isParseContent);
+                    return;
+                }
+                fileSize = fileStat.size;
+                cacheState = fileStat.cacheState;
+                if (fileSize > this->maxFileSize)
+                    throw std::runtime_error("File is too large, the maximum size is " + std::to_string(this->maxFileSize / (1024 * 1024)) + " MB");
+            }
+            // Stream directly into the current content buffer, the page is already drawn while downloading.
+            // The first received data tells the content type, the transfer of binary content (eg. an archive) is aborted.
+            bool isText = true;
+            ProgressiveRenderer progressiveRenderer(m_draw_main, this->currentContent);
+            FetchSink sink(this->currentContent, this->maxFileSize, [this, &sink, &progressiveRenderer, &contentType, &isText, &savePath, isParseContent](std::size_t received, std::size_t total) {
+                if (contentType.empty())
+                {
+                    contentType = File::sniffContentType(savePath, this->currentContent);
+                    isText = Gio::content_type_is_a(contentType, "text/plain");
+                }
+                if (!isText)
+                {
+                    sink.abort();
+                    return;
+                }
+                this->fetchReceived = received;
+                this->fetchTotal = total;
+                if (!this->fetchProgressPending.exchange(true))
+                    this->fetchProgressDispatcher.emit();
+                if (isParseContent)
+                    progressiveRenderer.update();
+            });
+            try
+            {
+                fetchCoalescer.fetch(cacheKey.empty() ? ipfsPath : cacheKey, ipfsPath, sink, cacheState);
+            }
+            catch (const std::runtime_error &)
+            {
+                if (isText)
+                    throw;
+            }
+            if (!isText)
+                throw std::runtime_error("Content is not text: " + contentType);
+            if (!cacheKey.empty())
+                contentCache.put(cacheKey, this->currentContent);
+            bool isWhole;
+            if (isParseContent && progressiveRenderer.finish(isWhole))
+            {
+                // Parts parsed on their own aren't stored, on the next visit the page is rendered at once (from the content cache)
+                if (isWhole)
+                    m_draw_main.cacheDocument(renderCache, m_draw_main.getRenderCacheKey(this->currentContent));
+                isRendered = true;
+            }
+        }
+        // Only text is parsed (prefetched and cached content is checked here)
+        if (contentType.empty())
+            contentType = File::sniffContentType(savePath, this->currentContent);
+        if (!Gio::content_type_is_a(contentType, "text/plain"))
+        {
+            if (prefetchedDocument != nullptr)
+                cmark_node_free(prefetchedDocument);
+            throw std::runtime_error("Content is not text: " + contentType);
+        }
         if (isParseContent)
         {
-            cmark_node *doc = Parser::parseContent(this->currentContent);
-            m_draw_main.processDocument(doc);
-            cmark_node_free(doc);
+            if (!isRendered)
+                this->renderContent(prefetchedDocument);
         }
         else
         {
+            if (prefetchedDocument != nullptr)
+                cmark_node_free(prefetchedDocument);
             // directly set the plain content
             m_draw_main.setText(this->currentContent);
         }
     }
     catch (const std::runtime_error &error)
     {
+        // Drop the partially received content
+        this->currentContent.clear();
         std::string errorMessage = std::string(error.what());
+        // A CID that turns out to be a directory is listed (the listing is cached), then the directory is shown
+        if (errorMessage.find("is a directory") != std::string::npos)
+        {
+            try
+            {
+                if (loadDirectory(cacheKey))
+                {
+                    this->fetchFromIPFS(isParseContent);
+                    return;
+                }
+            }
+            catch (const std::runtime_error &listingError)
+            {
+                errorMessage = std::string(listingError.what());
+            }
+        }
         std::cerr << "ERROR: IPFS request failed, with message: " << errorMessage << std::endl;
         if (errorMessage.starts_with("HTTP request failed with status code"))
         {
@@ -1441,10 +2577,19 @@ void MainWindow::fetchFromIPFS(bool isParseContent)
             std::string message = content.value("Message", "");
             if (message.starts_with("context deadline exceeded"))
             {
-                message += ". Time-out is set to: " + this->ipfsTimeout;
+                message += ". Time-out adapts to recent fetches, up to: " + this->ipfsTimeout;
             }
             m_draw_main.showMessage("🎂 We're having trouble finding this site.", "Message: " + message + ".\n\nYou could try to reload or increase the time-out.");
         }
+        else if (errorMessage.starts_with("Timeout was reached"))
+        {
+            std::string message = errorMessage + ". Time-out adapts to recent fetches, up to: " + this->ipfsTimeout;
+            m_draw_main.showMessage("🎂 We're having trouble finding this site.", "Message: " + message + ".\n\nYou could try to reload or increase the time-out.");
+        }
+        else if (errorMessage.starts_with("File is too large") || errorMessage.starts_with("Content is not text"))
+        {
+            this->showDownloadPage(savePath, fileSize, contentType);
+        }
         else if (errorMessage.starts_with("Couldn't connect to server: Failed to connect to localhost"))
         {
             m_draw_main.showMessage("⌛ Please wait...", "IPFS daemon is still spinnng-up, page will automatically refresh...");
@@ -1455,10 +2600,129 @@ void MainWindow::fetchFromIPFS(bool isParseContent)
             m_draw_main.showMessage("❌ Something went wrong", "Error message: " + std::string(error.what()));
         }
     }
+    // Hide the progress
+    this->fetchReceived = 0;
+    this->fetchProgressDispatcher.emit();
     // Stop spinning
     m_refreshIcon.get_style_context()->remove_class("spinning");
 }
 
+/**
+ * \brief Helper method for fetchFromIPFS(), resolve a path within a directory (site) with the cached directory listings,
+ * so the file is fetched (and cached) by its own CID. A directory is shown by its index page (index.md or README.md),
+ * else a listing page is created as current content.
+ * \param ipfsPath IPFS path, changed to the path of the file CID when resolved
+ * \param cacheKey Content cache key, changed to the file CID when resolved
+ * \param listingPage Page number of the listing page
+ * \throw std::runtime_error when a directory can't be listed
+ * \return True if a listing page is created
+ */
+bool MainWindow::resolveDirectoryPath(std::string &ipfsPath, std::string &cacheKey, std::size_t listingPage)
+{
+    IPFS::DirectoryEntry target;
+    if (cacheKey.empty() || !directoryIndex.resolve(cacheKey, target))
+        return false;
+    if (target.type == IPFS::ENTRY_DIRECTORY)
+    {
+        // Relative links of the index or listing page are relative to the directory itself
+        this->isDirectoryPage = true;
+        IPFS::DirectoryEntry indexPage;
+        if (!directoryIndex.findIndexPage(target.cid, indexPage))
+        {
+            this->currentContent = directoryIndex.createListingPage("/ipfs/" + cacheKey, target.cid, listingPage);
+            return true;
+        }
+        target = indexPage;
+    }
+    ipfsPath = "/ipfs/" + target.cid;
+    cacheKey = target.cid;
+    return false;
+}
+
+/**
+ * \brief Helper method for fetchFromIPFS(), list a CID that turned out to be a directory (the listing is cached)
+ * \param cid CID
+ * \throw std::runtime_error when the directory can't be listed
+ * \return True if the CID is a known directory now
+ */
+bool MainWindow::loadDirectory(const std::string &cid)
+{
+    if (cid.empty() || cid.find('/') != std::string::npos)
+        return false;
+    IPFS::DirectoryEntry directory;
+    std::vector<IPFS::DirectoryEntry> listing;
+    directoryIndex.getListing(cid, 1, listing);
+    return directoryIndex.resolve(cid, directory);
+}
+
+/**
+ * \brief Helper method for fetchFromIPFS(), show a file that isn't a page (too large or not text), with a link to save it to disk
+ * \param path IPFS path of the file
+ * \param size File size in bytes (0 if unknown)
+ * \param contentType Sniffed content type (empty if unknown)
+ */
+void MainWindow::showDownloadPage(const std::string &path, uint64_t size, const std::string &contentType)
+{
+    std::string info;
+    if (!contentType.empty())
+        info += "Type: " + Gio::content_type_get_description(contentType) + " (" + contentType + ")\n";
+    if (size > 0)
+        info += "Size: " + Glib::format_size(size) + "\n";
+    if (contentType.empty() || Gio::content_type_is_a(contentType, "text/plain"))
+    {
+        info += "\nThe maximum size of a page is " + std::to_string(this->maxFileSize / (1024 * 1024)) +
+                " MB, you could increase the maximum size with the --max-size option. Or save the file to disk instead.";
+        m_draw_main.showDownloadMessage("📦 File is too large", info, "about:save?" + path);
+    }
+    else
+    {
+        info += "\nOnly text (markdown) is shown as page, you can save the file to disk instead.";
+        m_draw_main.showDownloadMessage("📦 This file isn't a page", info, "about:save?" + path);
+    }
+}
+
+/**
+ * \brief Helper method for fetchFromIPFS(), get content from the content cache.
+ * A cached CID is verified against its content once per session (eg. a corrupt disk cache),
+ * content that can't have the CID is removed from the cache. Content that can't be verified locally is kept
+ * (eg. other import settings), as are paths within a directory.
+ * \param key Content cache key
+ * \param content Cached content
+ * \return True if the content is cached (and not found to be corrupt)
+ */
+bool MainWindow::getCachedContent(const std::string &key, std::string &content)
+{
+    if (!contentCache.get(key, content))
+        return false;
+    if (key.find('/') != std::string::npos || !verifiedCacheKeys.insert(key).second || CID::verify(key, content) != CID::VERIFY_MISMATCH)
+        return true;
+    std::cerr << "WARNING: Cached content doesn't match CID " << key << ", fetching it again." << std::endl;
+    contentCache.remove(key);
+    content.clear();
+    return false;
+}
+
+/**
+ * \brief Helper method for fetchFromIPFS() and openFromDisk(), display the current content as markdown.
+ * Content that was rendered before is restored from the render cache, without parsing it again.
+ * \param document Parsed current content (optional, eg. prefetched), freed by this method
+ */
+void MainWindow::renderContent(cmark_node *document)
+{
+    std::string renderKey = m_draw_main.getRenderCacheKey(this->currentContent);
+    std::string rendered;
+    if (renderCache.get(renderKey, rendered) && m_draw_main.loadDocument(rendered))
+    {
+        if (document != nullptr)
+            cmark_node_free(document);
+        return;
+    }
+    cmark_node *doc = (document != nullptr) ? document : Parser::parseContent(this->currentContent);
+    m_draw_main.processDocument(doc);
+    cmark_node_free(doc);
+    m_draw_main.cacheDocument(renderCache, renderKey);
+}
+
 /**
  * \brief Helper method for processRequest(), display markdown file from disk.
  * Runs in a seperate thread.
@@ -1472,9 +2736,7 @@ void MainWindow::openFromDisk(bool isParseContent)
         this->currentContent = File::read(finalRequestPath);
         if (isParseContent)
         {
-            cmark_node *doc = Parser::parseContent(this->currentContent);
-            m_draw_main.processDocument(doc);
-            cmark_node_free(doc);
+            this->renderContent();
         }
         else
         {
@@ -1496,6 +2758,306 @@ void MainWindow::openFromDisk(bool isParseContent)
     m_refreshIcon.get_style_context()->remove_class("spinning");
 }
 
+/**
+ * \brief Search the main text view in the background, using a snapshot of the buffer
+ */
+void MainWindow::startSearch()
+{
+    this->searchTimerHandler.disconnect();
+    auto buffer = m_draw_main.get_buffer();
+    auto text = std::make_shared<const std::string>(buffer->get_slice(buffer->begin(), buffer->end(), true).raw());
+    this->searchResultOutdated = false;
+    this->textSearch.search(text, m_searchEntry.get_text(), m_searchMatchCase.get_active(), m_searchRegex.get_active());
+}
+
+/**
+ * \brief Select the first match after the cursor (wraps around to the top) and update the match counter
+ */
+void MainWindow::selectNextMatch()
+{
+    if (!this->searchResult || this->searchResult->matches.empty())
+        return;
+    const auto &matches = this->searchResult->matches;
+    auto buffer = m_draw_main.get_buffer();
+    int cursorOffset = std::max(buffer->get_insert()->get_iter().get_offset(), buffer->get_selection_bound()->get_iter().get_offset());
+    auto match = std::lower_bound(matches.begin(), matches.end(), cursorOffset, [](const TextSearch::Match &m, int offset) {
+        return m.offset < offset;
+    });
+    if (match == matches.end())
+        match = matches.begin();
+    Gtk::TextBuffer::iterator start = buffer->get_iter_at_offset(match->offset);
+    Gtk::TextBuffer::iterator end = buffer->get_iter_at_offset(match->offset + match->chars);
+    buffer->select_range(end, start);
+    m_draw_main.scroll_to(start);
+    m_searchMatchesLabel.set_text(std::to_string(match - matches.begin() + 1) + " of " + std::to_string(matches.size()));
+}
+
+/**
+ * \brief Highlight all the matches of the search result, using a single text tag
+ */
+void MainWindow::highlightMatches()
+{
+    this->clearSearchHighlights();
+    auto buffer = m_draw_main.get_buffer();
+    auto tag = buffer->get_tag_table()->lookup("search-match");
+    if (!tag)
+    {
+        tag = buffer->create_tag("search-match");
+        tag->property_background() = "#fcaf3e";
+    }
+    for (const TextSearch::Match &match : this->searchResult->matches)
+    {
+        buffer->apply_tag(tag, buffer->get_iter_at_offset(match.offset), buffer->get_iter_at_offset(match.offset + match.chars));
+    }
+}
+
+/**
+ * \brief Remove the search highlighting from the main text view
+ */
+void MainWindow::clearSearchHighlights()
+{
+    auto buffer = m_draw_main.get_buffer();
+    auto tag = buffer->get_tag_table()->lookup("search-match");
+    if (tag)
+        buffer->remove_tag(tag, buffer->begin(), buffer->end());
+}
+
+/**
+ * \brief Synchronize the other view on the next frame, multiple scroll changes within a frame result in a single update
+ * \param fromEditor True when the preview should follow the editor, false for the other way around
+ */
+void MainWindow::scheduleScrollSync(bool fromEditor)
+{
+    if (this->isSyncingScroll || !this->isEditorEnabled())
+        return;
+    this->scrollSyncFromEditor = fromEditor;
+    if (this->scrollSyncTickId == 0)
+        this->scrollSyncTickId = m_paned.add_tick_callback(sigc::mem_fun(this, &MainWindow::on_scroll_sync_tick));
+}
+
+/**
+ * \brief Scroll the preview to the rendered position of the top-most visible editor line
+ */
+void MainWindow::syncPreviewToEditor()
+{
+    const SourceMap &sourceMap = m_draw_secondary.getSourceMap();
+    if (sourceMap.empty())
+        return;
+    // Source line at the top of the editor, including the fraction that is scrolled out of view
+    Gdk::Rectangle visibleRect;
+    m_draw_main.get_visible_rect(visibleRect);
+    Gtk::TextBuffer::iterator iter;
+    int lineTop, lineY, lineHeight;
+    m_draw_main.get_line_at_y(iter, visibleRect.get_y(), lineTop);
+    m_draw_main.get_line_yrange(iter, lineY, lineHeight);
+    double line = iter.get_line();
+    if (lineHeight > 0)
+        line += static_cast<double>(visibleRect.get_y() - lineY) / lineHeight;
+
+    auto previewBuffer = m_draw_secondary.get_buffer();
+    Gdk::Rectangle location;
+    m_draw_secondary.get_iter_location(previewBuffer->get_iter_at_offset(static_cast<int>(sourceMap.offsetForLine(line))), location);
+    this->isSyncingScroll = true;
+    m_scrolledWindowSecondary.get_vadjustment()->set_value(location.get_y());
+    this->isSyncingScroll = false;
+}
+
+/**
+ * \brief Scroll the editor to the source line of the top-most visible preview position
+ */
+void MainWindow::syncEditorToPreview()
+{
+    const SourceMap &sourceMap = m_draw_secondary.getSourceMap();
+    if (sourceMap.empty())
+        return;
+    Gdk::Rectangle visibleRect;
+    m_draw_secondary.get_visible_rect(visibleRect);
+    Gtk::TextBuffer::iterator iter;
+    m_draw_secondary.get_iter_at_location(iter, visibleRect.get_x(), visibleRect.get_y());
+    double line = sourceMap.lineForOffset(iter.get_offset());
+
+    // Top of the source line plus the fraction within the line
+    int lineY, lineHeight;
+    m_draw_main.get_line_yrange(m_draw_main.get_buffer()->get_iter_at_line(static_cast<int>(line)), lineY, lineHeight);
+    double y = lineY + (line - static_cast<int>(line)) * lineHeight;
+    this->isSyncingScroll = true;
+    m_scrolledWindowMain.get_vadjustment()->set_value(y);
+    this->isSyncingScroll = false;
+}
+
+/**
+ * \brief Update the outline with the headings of the current document.
+ * When only the texts or positions changed (eg. while typing in the editor), the existing rows are updated in place,
+ * keeping the expanded state and selection.
+ */
+void MainWindow::updateOutline()
+{
+    Draw &draw = this->isEditorEnabled() ? m_draw_secondary : m_draw_main;
+    const auto &headings = draw.getHeadingIndex().getHeadings();
+
+    bool sameStructure = (headings.size() == this->outlineLevels.size());
+    for (std::size_t i = 0; sameStructure && i < headings.size(); ++i)
+        sameStructure = (headings[i].level == this->outlineLevels[i]);
+
+    if (sameStructure)
+    {
+        for (std::size_t i = 0; i < headings.size(); ++i)
+        {
+            auto row = *this->outlineRows[i];
+            Glib::ustring text = row[m_outlineColumns.text];
+            if (text.raw() != headings[i].text)
+                row[m_outlineColumns.text] = headings[i].text;
+            row[m_outlineColumns.offset] = headings[i].offset;
+            row[m_outlineColumns.line] = headings[i].line;
+        }
+        return;
+    }
+
+    // Build the tree again, headings are nested below the previous heading of a higher level
+    m_outlineTreeStore->clear();
+    this->outlineLevels.clear();
+    this->outlineRows.clear();
+    std::vector<std::pair<int, Gtk::TreeModel::iterator>> parents;
+    for (const auto &heading : headings)
+    {
+        while (!parents.empty() && parents.back().first >= heading.level)
+            parents.pop_back();
+        auto iter = parents.empty() ? m_outlineTreeStore->append() : m_outlineTreeStore->append(parents.back().second->children());
+        auto row = *iter;
+        row[m_outlineColumns.text] = heading.text;
+        row[m_outlineColumns.offset] = heading.offset;
+        row[m_outlineColumns.line] = heading.line;
+        parents.emplace_back(heading.level, iter);
+        this->outlineLevels.push_back(heading.level);
+        this->outlineRows.push_back(iter);
+    }
+    m_outlineTreeView.expand_all();
+}
+
+/**
+ * \brief Jump to the heading of a #fragment
+ * \param draw Text view containing the document
+ * \param fragment Fragment (without '#')
+ * \return True when the heading is found
+ */
+bool MainWindow::scrollToFragment(Draw &draw, const std::string &fragment)
+{
+    const HeadingIndex::Heading *heading = draw.getHeadingIndex().find(fragment);
+    if (heading == nullptr)
+    {
+        std::cerr << "WARNING: Heading #" << fragment << " not found." << std::endl;
+        return false;
+    }
+    auto buffer = draw.get_buffer();
+    buffer->place_cursor(buffer->get_iter_at_offset(heading->offset));
+    // Scrolling to a mark waits for the layout, the page might just be drawn
+    draw.scroll_to(buffer->get_insert(), 0.0, 0.0, 0.0);
+    return true;
+}
+
+/**
+ * \brief Find the newest autosave journal with unsaved changes.
+ * Journals without changes (compared to the saved file) are removed.
+ * \return True when an unsaved document is found (stored in autosaveRecovery)
+ */
+bool MainWindow::findUnsavedDocument()
+{
+    for (const std::string &journalPath : AutosaveJournal::findJournals())
+    {
+        AutosaveJournal::Recovery recovery;
+        bool hasChanges = AutosaveJournal::recover(journalPath, recovery) && !recovery.isSaved;
+        if (hasChanges && recovery.filePath.empty())
+        {
+            hasChanges = !recovery.text.empty();
+        }
+        else if (hasChanges)
+        {
+            try
+            {
+                hasChanges = (File::read(recovery.filePath) != recovery.text);
+            }
+            catch (const std::runtime_error &)
+            {
+                // Saved file is gone, keep the recovered document
+            }
+        }
+        if (hasChanges)
+        {
+            this->autosaveRecovery = recovery;
+            return true;
+        }
+        AutosaveJournal::remove(journalPath);
+    }
+    return false;
+}
+
+/**
+ * \brief Cache key of an IPFS path, only paths starting with a CID are immutable (and can be cached)
+ * \param path IPFS path (without ipfs:// scheme)
+ * \return Normalized path or empty string when the content should not be cached
+ */
+std::string MainWindow::getContentCacheKey(const std::string &path)
+{
+    std::string key = path;
+    if (key.rfind("/ipfs/", 0) == 0)
+        key.erase(0, 6);
+    while (!key.empty() && key.back() == '/')
+        key.pop_back();
+    return CID::isValid(key.substr(0, key.find('/'))) ? key : std::string();
+}
+
+/**
+ * \brief Check the syntax of an IPFS path, which should start with a CID (IPNS names are resolved by the daemon)
+ * \param path IPFS path (without ipfs:// scheme), eg. "/ipfs/<cid>/index.md" or "<cid>"
+ * \return True if the path is valid
+ */
+bool MainWindow::isValidIPFSPath(const std::string &path)
+{
+    std::string cidPath = path;
+    if (cidPath.rfind("/ipns/", 0) == 0)
+        return true;
+    if (cidPath.rfind("/ipfs/", 0) == 0)
+        cidPath.erase(0, 6);
+    return CID::isValid(cidPath.substr(0, cidPath.find('/')));
+}
+
+/**
+ * \brief Remove the "." and ".." segments of a path (the path can't go above its root)
+ * \param path Path, eg. "/book/../about.md#team"
+ * \return Normalized path, eg. "/about.md#team"
+ */
+std::string MainWindow::normalizePath(const std::string &path)
+{
+    std::size_t suffixPos = path.find_first_of("?#");
+    std::string suffix = (suffixPos == std::string::npos) ? "" : path.substr(suffixPos);
+    std::vector<std::string> segments;
+    bool isDirectory = false;
+    std::size_t pos = 0;
+    std::size_t end = std::min(suffixPos, path.size());
+    while (pos < end)
+    {
+        std::size_t next = std::min(path.find('/', pos), end);
+        std::string segment = path.substr(pos, next - pos);
+        isDirectory = (next < end || segment.empty() || segment == "." || segment == "..");
+        if (segment == "..")
+        {
+            if (!segments.empty())
+                segments.pop_back();
+        }
+        else if (!segment.empty() && segment != ".")
+        {
+            segments.push_back(segment);
+        }
+        pos = next + 1;
+    }
+    std::string normalized;
+    for (const std::string &segment : segments)
+        normalized += "/" + segment;
+    if (isDirectory || normalized.empty())
+        normalized += "/";
+    return normalized + suffix;
+}
+
 /**
  * Retrieve image path from icon theme location
  * @param iconName Icon name (.svg is added default)
@@ -1539,10 +3101,199 @@ void MainWindow::editor_changed_text()
     std::cout << "Markdown:\n" << md << std::endl;*/
 
     // Show the document as a preview on the right side text-view panel
+    this->previewRendersPending++;
     m_draw_secondary.processDocument(doc);
     cmark_node_free(doc);
 }
 
+/**
+ * Triggered when the editor is scrolled, the preview follows
+ */
+void MainWindow::on_editor_scrolled()
+{
+    this->scheduleScrollSync(true);
+}
+
+/**
+ * Triggered when the preview is scrolled, the editor follows.
+ * Only when the user scrolls the preview (see on_preview_input()), not when the preview changes because it's drawn again.
+ */
+void MainWindow::on_preview_scrolled()
+{
+    if (this->isPreviewScrollLeader && this->previewRendersPending == 0)
+        this->scheduleScrollSync(false);
+}
+
+/**
+ * Triggered by user input on the editor (scrolling, keys, clicks or the scrollbar), the preview follows the editor again
+ * \return False to continue with the default handlers
+ */
+bool MainWindow::on_editor_input()
+{
+    this->isPreviewScrollLeader = false;
+    return false;
+}
+
+/**
+ * Triggered by user input on the preview (scrolling, keys, clicks or the scrollbar), the editor follows the preview
+ * \return False to continue with the default handlers
+ */
+bool MainWindow::on_preview_input()
+{
+    this->isPreviewScrollLeader = true;
+    return false;
+}
+
+/**
+ * Triggered when the preview is drawn again, restore the scroll position from the editor
+ */
+void MainWindow::on_preview_rendered()
+{
+    if (this->previewRendersPending > 0)
+        this->previewRendersPending--;
+    if (this->previewRendersPending == 0)
+        this->scheduleScrollSync(true);
+    if (this->isEditorEnabled())
+        this->updateOutline();
+}
+
+/**
+ * Triggered when a page is drawn in the main text view, update the outline and jump to the requested #fragment
+ */
+void MainWindow::on_main_rendered()
+{
+    if (this->isEditorEnabled())
+        return;
+    this->isPageRendered = true;
+    this->updateOutline();
+    this->visibleLinksTimerHandler.disconnect();
+    this->on_visible_links_timeout();
+    if (!this->pendingFragment.empty())
+    {
+        this->scrollToFragment(m_draw_main, this->pendingFragment);
+        this->pendingFragment.clear();
+    }
+    else if (this->pendingScrollOffset >= 0)
+    {
+        // Scroll position of a page from the back/forward cache
+        auto buffer = m_draw_main.get_buffer();
+        buffer->place_cursor(buffer->get_iter_at_offset(this->pendingScrollOffset));
+        m_draw_main.scroll_to(buffer->get_insert(), 0.0, 0.0, 0.0);
+        this->pendingScrollOffset = -1;
+    }
+}
+
+/**
+ * Triggered before text is inserted in the editor, journal the edit
+ */
+void MainWindow::on_editor_insert(const Gtk::TextBuffer::iterator &pos, const Glib::ustring &text, int bytes __attribute__((unused)))
+{
+    this->autosave.insert(pos.get_offset(), text.raw());
+}
+
+/**
+ * Triggered before text is removed from the editor, journal the edit
+ */
+void MainWindow::on_editor_erase(const Gtk::TextBuffer::iterator &range_start, const Gtk::TextBuffer::iterator &range_end)
+{
+    this->autosave.erase(range_start.get_offset(), range_end.get_offset() - range_start.get_offset());
+}
+
+/**
+ * Timeout slot: Compact the autosave journal when it grew too large
+ * \return True to keep the timer running
+ */
+bool MainWindow::on_autosave_timeout()
+{
+    if (this->autosave.needsCompaction())
+        this->autosave.compact(m_draw_main.getText(), false);
+    return true;
+}
+
+/**
+ * Ask the user to recover the unsaved document, found during startup
+ */
+void MainWindow::recover_autosave()
+{
+    Gtk::MessageDialog dialog(*this, "Recover unsaved document?", false, Gtk::MESSAGE_QUESTION, Gtk::BUTTONS_YES_NO, true);
+    std::string name = this->autosaveRecovery.filePath.empty() ? "Untitled" : File::getFilename(this->autosaveRecovery.filePath);
+    dialog.set_secondary_text("The document \"" + name + "\" was not saved when the browser closed.");
+    int response = dialog.run();
+    dialog.hide();
+    if (response == Gtk::RESPONSE_YES)
+    {
+        this->enableEdit();
+        this->currentFileSavedPath = this->autosaveRecovery.filePath;
+        this->autosave.setFilePath(this->currentFileSavedPath);
+        this->m_addressBar.set_text(this->currentFileSavedPath.empty() ? "file://unsaved" : "file://" + this->currentFileSavedPath);
+        this->set_title(name + " * - " + m_appName);
+        m_draw_main.get_buffer()->set_text(this->autosaveRecovery.text);
+    }
+    else
+    {
+        go_home();
+    }
+    // The recovered content is in the new journal now
+    AutosaveJournal::remove(this->autosaveRecovery.journalPath);
+    this->autosaveRecovery = AutosaveJournal::Recovery();
+}
+
+/**
+ * Show/hide the document outline
+ */
+void MainWindow::toggle_outline()
+{
+    if (m_scrolledWindowOutline.is_visible())
+    {
+        m_scrolledWindowOutline.hide();
+    }
+    else
+    {
+        this->updateOutline();
+        m_scrolledWindowOutline.show();
+    }
+}
+
+/**
+ * Triggered when a heading in the outline is clicked, jump to the heading
+ */
+void MainWindow::on_outline_row_activated(const Gtk::TreeModel::Path &path, Gtk::TreeViewColumn *column __attribute__((unused)))
+{
+    auto iter = m_outlineTreeStore->get_iter(path);
+    if (!iter)
+        return;
+    int line = (*iter)[m_outlineColumns.line];
+    int offset = (*iter)[m_outlineColumns.offset];
+    if (this->isEditorEnabled())
+    {
+        // Move the editor to the markdown source line, the preview follows
+        auto buffer = m_draw_main.get_buffer();
+        buffer->place_cursor(buffer->get_iter_at_line(line));
+        m_draw_main.scroll_to(buffer->get_insert(), 0.0, 0.0, 0.0);
+        m_draw_main.grab_focus();
+    }
+    else
+    {
+        auto buffer = m_draw_main.get_buffer();
+        buffer->place_cursor(buffer->get_iter_at_offset(offset));
+        m_draw_main.scroll_to(buffer->get_insert(), 0.0, 0.0, 0.0);
+    }
+}
+
+/**
+ * Synchronize the scroll position on the next frame (once)
+ * \return False to remove the tick callback
+ */
+bool MainWindow::on_scroll_sync_tick(const Glib::RefPtr<Gdk::FrameClock> &frameClock __attribute__((unused)))
+{
+    this->scrollSyncTickId = 0;
+    if (this->scrollSyncFromEditor)
+        this->syncPreviewToEditor();
+    else
+        this->syncEditorToPreview();
+    return false;
+}
+
 /**
  * Show source code dialog window with the current content
  */
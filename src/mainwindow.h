@@ -5,7 +5,11 @@
 #include "about.h"
 #include "source-code-dialog.h"
 #include "draw.h"
-#include "ipfs.h"
+#include "browser-context.h"
+#include "site-publisher.h"
+#include "text-search.h"
+#include "autosave-journal.h"
+#include "back-forward-cache.h"
 
 #include <gtkmm/window.h>
 #include <gtkmm/box.h>
@@ -17,11 +21,19 @@
 #include <gtkmm/popover.h>
 #include <gtkmm/filechooserdialog.h>
 #include <gtkmm/messagedialog.h>
+#include <gtkmm/progressbar.h>
 #include <gtkmm/entry.h>
 #include <gtkmm/searchbar.h>
 #include <gtkmm/searchentry.h>
 #include <gtkmm/paned.h>
+#include <gtkmm/treeview.h>
+#include <gtkmm/treestore.h>
 #include <giomm/settings.h>
+#include <glibmm/dispatcher.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <set>
 #include <thread>
 
 /**
@@ -31,18 +43,33 @@
 class MainWindow : public Gtk::Window
 {
 public:
-    explicit MainWindow(const std::string &timeout);
+    explicit MainWindow(BrowserContext &context, const std::string &path = std::string());
+    ~MainWindow();
     void doRequest(const std::string &path = std::string(), bool isSetAddressBar = true, bool isHistoryRequest = false, bool isDisableEditor = true, bool isParseContent = true);
+    std::string resolveLink(const std::string &link) const;
+    void notifyStatusChanged();
+    void notifyNameRefreshed(const std::string &path);
+    void notifyDaemonReady();
 
 protected:
     // Signal handlers
     bool delete_window(GdkEventAny* any_event);
-    bool update_connection_status();
+    void on_status_changed();
+    void on_daemon_ready();
+    void on_name_resolution();
+    void on_link_hovered(const std::string &url);
+    bool on_hover_timeout();
+    void on_main_scrolled();
+    bool on_visible_links_timeout();
+    void on_active_changed();
+    bool on_window_state_changed(GdkEventWindowState *window_state_event);
     void cut();
     void copy();
     void paste();
     void del();
     void selectAll();
+    void new_window();
+    void quit();
     void new_doc();
     void open();
     void open_and_edit();
@@ -53,13 +80,30 @@ protected:
     void save_as();
     void on_save_as_dialog_response(int response_id, Gtk::FileChooserDialog* dialog);
     void publish();
+    void publish_folder();
+    void on_publish_folder_dialog_response(int response_id, Gtk::FileChooserDialog *dialog);
+    void on_publish_progress();
+    void on_publish_progress_response(int response_id);
+    void on_publish_finished();
+    void save_to_disk(const std::string &path);
+    void on_save_to_disk_dialog_response(int response_id, Gtk::FileChooserDialog *dialog, const std::string &path);
+    void on_download_progress();
+    void on_download_progress_response(int response_id);
+    void on_download_finished();
     void go_home();
     void show_status();
     void copy_client_id();
     void copy_client_public_key();
     void address_bar_activate();
+    void on_fetch_progress();
     void on_search();
+    void on_search_changed();
+    void on_search_finished();
+    void on_search_buffer_changed();
+    bool on_search_timeout();
+    void on_search_hide();
     void on_replace();
+    void on_replace_all();
     void show_search(bool replace);
     void back();
     void forward();
@@ -68,6 +112,19 @@ protected:
     void show_about();
     void hide_about(int response);
     void editor_changed_text();
+    void on_editor_scrolled();
+    void on_preview_scrolled();
+    bool on_editor_input();
+    bool on_preview_input();
+    void on_preview_rendered();
+    void on_main_rendered();
+    void on_editor_insert(const Gtk::TextBuffer::iterator &pos, const Glib::ustring &text, int bytes);
+    void on_editor_erase(const Gtk::TextBuffer::iterator &range_start, const Gtk::TextBuffer::iterator &range_end);
+    bool on_autosave_timeout();
+    void recover_autosave();
+    void toggle_outline();
+    void on_outline_row_activated(const Gtk::TreeModel::Path &path, Gtk::TreeViewColumn *column);
+    bool on_scroll_sync_tick(const Glib::RefPtr<Gdk::FrameClock> &frameClock);
     void show_source_code_dialog();
     void get_heading();
     void insert_emoji();
@@ -75,6 +132,24 @@ protected:
     Glib::RefPtr<Gtk::AccelGroup> m_accelGroup; /*!< Accelerator group, used for keyboard shortcut bindings */
     Glib::RefPtr<Gio::Settings> m_settings; /*!< Settings to store our preferences, even during restarts */
 
+    /**
+     * \class OutlineColumns
+     * \brief Columns of the document outline (headings)
+     */
+    class OutlineColumns : public Gtk::TreeModel::ColumnRecord
+    {
+    public:
+        OutlineColumns()
+        {
+            add(text);
+            add(offset);
+            add(line);
+        }
+        Gtk::TreeModelColumn<Glib::ustring> text;
+        Gtk::TreeModelColumn<int> offset; /*!< Offset in the rendered document */
+        Gtk::TreeModelColumn<int> line;   /*!< Line in the markdown source */
+    };
+
     // Child widgets
     Menu m_menu;
     Draw m_draw_main;
@@ -82,6 +157,11 @@ protected:
     SourceCodeDialog m_sourceCodeDialog;
     About m_about;
     Gtk::HPaned m_paned;
+    Gtk::HPaned m_panedOutline;
+    Gtk::ScrolledWindow m_scrolledWindowOutline;
+    Gtk::TreeView m_outlineTreeView;
+    OutlineColumns m_outlineColumns;
+    Glib::RefPtr<Gtk::TreeStore> m_outlineTreeStore;
     Gtk::SearchBar m_search;
     Gtk::SearchBar m_searchReplace;
     Gtk::SearchEntry m_searchEntry;
@@ -94,6 +174,9 @@ protected:
     Gtk::Box m_hboxStatus;
     Gtk::Entry m_addressBar;
     Gtk::ToggleButton m_searchMatchCase;
+    Gtk::ToggleButton m_searchRegex;
+    Gtk::Label m_searchMatchesLabel;
+    Gtk::Button m_replaceAllButton;
     Gtk::Button m_backButton;
     Gtk::Button m_forwardButton;
     Gtk::Button m_refreshButton;
@@ -154,6 +237,11 @@ protected:
     Gtk::Button m_copyPublicKeyButton;
     Gtk::Label m_statusLabel;
     std::unique_ptr<Gtk::MessageDialog> m_contentPublishedDialog;
+    std::unique_ptr<Gtk::MessageDialog> m_publishProgressDialog;
+    Gtk::ProgressBar m_publishProgressBar;
+    std::unique_ptr<Gtk::MessageDialog> m_downloadProgressDialog;
+    std::unique_ptr<Gtk::MessageDialog> m_downloadFinishedDialog;
+    Gtk::ProgressBar m_downloadProgressBar;
     Gtk::ScrolledWindow m_scrolledWindowMain;
     Gtk::ScrolledWindow m_scrolledWindowSecondary;
     Gtk::Button m_exitBottomButton;
@@ -168,22 +256,87 @@ private:
     bool m_useCurrentGTKIconTheme;
     int m_iconSize;
     std::thread *m_requestThread;
+    std::thread *m_publishThread;
+    std::thread *m_downloadThread;
+    std::string currentPagePath; /*!< Request path of the current page, without #fragment (GUI thread only) */
+    std::atomic<bool> isDirectoryPage; /*!< The current page is the index or listing page of a directory (base of relative links) */
+    std::string pendingFragment; /*!< #fragment to jump to, once the page is drawn */
     std::string requestPath;
     std::string finalRequestPath;
     std::string currentContent;
+    std::size_t maxFileSize;                   /*!< Max. size of a fetched file in bytes */
+    Glib::Dispatcher fetchProgressDispatcher;  /*!< Fetch progress (from the request thread) */
+    Glib::Dispatcher statusDispatcher;         /*!< New IPFS status (from the status monitor thread) */
+    Glib::Dispatcher daemonReadyDispatcher;    /*!< IPFS daemon is ready (from the daemon supervisor thread) */
+    Glib::Dispatcher nameResolutionDispatcher; /*!< Name resolved (request thread) or refreshed (resolver thread) */
+    Glib::Dispatcher publishProgressDispatcher; /*!< Upload progress (from the publish thread) */
+    Glib::Dispatcher publishFinishedDispatcher; /*!< Publish thread is finished */
+    std::atomic<uint64_t> publishSent;
+    std::atomic<uint64_t> publishTotal;
+    SitePublisher::Result publishResult; /*!< Written by the publish thread, read after it is finished */
+    std::string publishError;
+    Glib::Dispatcher downloadProgressDispatcher; /*!< Save to disk progress (from the download thread) */
+    Glib::Dispatcher downloadFinishedDispatcher; /*!< Download thread is finished */
+    std::atomic<uint64_t> downloadReceived;
+    std::atomic<uint64_t> downloadTotal;
+    std::atomic<bool> downloadProgressPending;
+    std::atomic<bool> downloadCancelled;
+    std::string downloadFilePath;
+    std::string downloadError; /*!< Written by the download thread, read after it is finished */
+    std::mutex nameResolutionMutex;
+    std::string nameResolutionStatus; /*!< Resolution chain of the current page, shown in the status area */
+    std::string refreshedNamePath;    /*!< IPNS name of which the resolution changed */
+    std::atomic<std::size_t> fetchReceived;    /*!< Bytes received, 0 when the fetch is finished */
+    std::atomic<std::size_t> fetchTotal;       /*!< Expected size, 0 if unknown */
+    std::atomic<bool> fetchProgressPending;    /*!< Progress update is dispatched, but not yet shown */
     std::string currentFileSavedPath;
     std::size_t currentHistoryIndex;
     std::vector<std::string> history;
+    BackForwardCache backForwardCache;
+    bool isPageRendered;     /*!< The current page is completely drawn (and can be stored in the back/forward cache) */
+    int pendingScrollOffset; /*!< Character offset to scroll to once the page is drawn, -1 if none */
     sigc::connection textChangedSignalHandler;
-    sigc::connection statusTimerHandler;
+    sigc::connection searchTimerHandler;
+    TextSearch textSearch;
+    std::shared_ptr<const TextSearch::Result> searchResult; /*!< Matches shown (highlighted) in the main text view */
+    bool searchResultOutdated;                              /*!< The buffer has changed since the search snapshot */
+    bool searchSelectPending;                               /*!< Select the next match once the running search is finished */
+    sigc::connection editorScrolledSignalHandler;
+    sigc::connection previewScrolledSignalHandler;
+    guint scrollSyncTickId;      /*!< Pending tick callback, scroll updates are coalesced per frame */
+    bool scrollSyncFromEditor;   /*!< Direction of the pending scroll synchronization */
+    bool isSyncingScroll;        /*!< Ignore the scroll changes caused by the synchronization itself */
+    bool isPreviewScrollLeader;  /*!< The last scroll input of the user was on the preview, the editor follows */
+    std::vector<sigc::connection> scrollInputSignalHandlers; /*!< User input on both views, decides the scroll leader */
+    int previewRendersPending;   /*!< Preview documents being drawn (the preview scroll position is not stable) */
+    std::vector<int> outlineLevels;                   /*!< Heading levels shown in the outline */
+    std::vector<Gtk::TreeModel::iterator> outlineRows; /*!< Outline rows, in document order */
+    AutosaveJournal autosave;
+    AutosaveJournal::Recovery autosaveRecovery; /*!< Unsaved document found during startup */
+    sigc::connection autosaveInsertSignalHandler;
+    sigc::connection autosaveEraseSignalHandler;
+    sigc::connection autosaveTimerHandler;
     bool m_waitPageVisible;
+    BrowserContext &context; /*!< State shared with the other windows */
     std::string ipfsVersion;
     std::string clientID;
     std::string clientPublicKey;
     std::string ipfsHost;
     int ipfsPort;
     std::string ipfsTimeout;
-    IPFS ipfs;
+    IPFS &ipfs;
+    FetchCoalescer &fetchCoalescer; /*!< Shares in-flight fetches of the same content (of all windows) */
+    NameResolver &nameResolver;
+    DirectoryIndex &directoryIndex;
+    IPFSStatusMonitor &statusMonitor;
+    ContentCache &contentCache; /*!< Cache of immutable IPFS content (memory and disk) */
+    ContentCache &renderCache;  /*!< Cache of rendered documents, keyed by content hash */
+    std::set<std::string> verifiedCacheKeys; /*!< Cached CIDs checked against their content this session (request thread) */
+    PagePrefetcher &prefetcher; /*!< Linked pages fetched ahead */
+    SitePublisher sitePublisher;
+    std::string hoveredLink;
+    sigc::connection hoverTimerHandler;
+    sigc::connection visibleLinksTimerHandler;
 
     bool isInstalled();
     void enableEdit();
@@ -191,8 +344,40 @@ private:
     bool isEditorEnabled();
     void postDoRequest(const std::string &path, bool isSetAddressBar, bool isHistoryRequest, bool isDisableEditor);
     void processRequest(const std::string &path, bool isParseContent);
+    void stopRequestThread();
+    void startPublish(const std::function<SitePublisher::Result(const SitePublisher::ProgressCallback &)> &job);
+    void stopPublishThread();
+    void startDownload(const std::string &path, const std::string &filePath);
+    void stopDownloadThread();
+    void storeBackForwardPage();
+    bool restoreBackForwardPage();
     void fetchFromIPFS(bool isParseContent);
     void openFromDisk(bool isParseContent);
+    void renderContent(cmark_node *document = nullptr);
+    bool resolveDirectoryPath(std::string &ipfsPath, std::string &cacheKey, std::size_t listingPage);
+    bool loadDirectory(const std::string &cid);
+    void showDownloadPage(const std::string &path, uint64_t size, const std::string &contentType);
+    bool getCachedContent(const std::string &key, std::string &content);
+    void startSearch();
+    void selectNextMatch();
+    void highlightMatches();
+    void clearSearchHighlights();
+    void scheduleScrollSync(bool fromEditor);
+    void syncPreviewToEditor();
+    void syncEditorToPreview();
+    void updateOutline();
+    bool scrollToFragment(Draw &draw, const std::string &fragment);
+    bool findUnsavedDocument();
+    void updateStatusForeground();
+    void prefetchLink(const std::string &url, PagePrefetcher::Priority priority);
+    static std::string getContentCacheKey(const std::string &path);
+    static bool isValidIPFSPath(const std::string &path);
+    static std::string normalizePath(const std::string &path);
+    static std::string getSparkline(const std::vector<IPFSStatusMonitor::BandwidthSample> &samples, bool isIncoming);
+    static std::string getBars(const std::vector<double> &values);
+    static std::string getFetchLatencyText(const std::vector<FetchTimeoutPolicy::Stats> &stats);
+    static std::string getEndpointText(const std::vector<HedgedFetcher::EndpointStatus> &endpoints);
+    static std::string formatDuration(std::chrono::milliseconds duration);
     std::string getIconImageFromTheme(const std::string &iconName, const std::string &typeofIcon);
 };
 
@@ -0,0 +1,480 @@
+#include "md-lexer.h"
+
+#include <algorithm>
+#include <cctype>
+
+/**
+ * \brief Start lexing a single line of markdown source: the block-level markers are lexed at once,
+ * the inline content is lexed by lex()
+ * \param line Line content (without the line-break), needs to be kept alive until the line is lexed completely
+ * \param state Lexer state at the start of this line (result of the previous line)
+ * \param tokens Output tokens (cleared first), offsets are in bytes relative to the line
+ * \return Lexer state at the start of the next line
+ */
+MarkdownLexer::LineState MarkdownLexer::start(std::string_view line, LineState state, std::vector<Token> &tokens)
+{
+    this->line = line;
+    this->tokens = &tokens;
+    tokens.clear();
+    spans.clear();
+    firstNonBlank = line.find_first_not_of(" \t");
+    angleClose = 0;
+    codeSpanMisses.clear();
+    delimiterMisses.clear();
+    isBracketsMatched = false;
+    closingBrackets.clear();
+    closingParens.clear();
+
+    std::size_t pos = skipIndent(0);
+    char fenceChar = 0;
+    std::size_t fenceLength = 0;
+
+    // Inside fenced code block, only look for the closing fence
+    if (state.fenceLength > 0)
+    {
+        tokens.push_back({TOKEN_CODE_BLOCK, 0, line.size()});
+        if (isFence(pos, fenceChar, fenceLength) && fenceChar == state.fenceChar && fenceLength >= state.fenceLength &&
+            line.find_first_not_of(" \t", pos + fenceLength) == std::string_view::npos)
+        {
+            return LineState();
+        }
+        return state;
+    }
+
+    if (isFence(pos, fenceChar, fenceLength))
+    {
+        // Info string of a backtick fence can't contain a backtick
+        if (fenceChar != '`' || line.find('`', pos + fenceLength) == std::string_view::npos)
+        {
+            tokens.push_back({TOKEN_CODE_BLOCK, 0, line.size()});
+            LineState newState;
+            newState.fenceChar = fenceChar;
+            newState.fenceLength = static_cast<uint8_t>(std::min<std::size_t>(fenceLength, 255));
+            return newState;
+        }
+    }
+
+    lexBlock(pos);
+    return LineState();
+}
+
+/**
+ * \brief Lex the inline content of the line started by start()
+ * \param tokens Output tokens (appended)
+ * \param maxLength Lex about this many bytes, the next call continues where this one stopped
+ * \return true if the line is lexed completely
+ */
+bool MarkdownLexer::lex(std::vector<Token> &tokens, std::size_t maxLength)
+{
+    this->tokens = &tokens;
+    std::size_t length = 0;
+    while (!spans.empty() && length < maxLength)
+    {
+        // Lexing a token can add spans (eg. the text of a link), keep the index instead of a reference
+        const std::size_t index = spans.size() - 1;
+        const std::size_t pos = spans[index].pos;
+        if (pos >= spans[index].end)
+        {
+            spans.pop_back();
+            continue;
+        }
+        const std::size_t next = lexInline(pos, spans[index].end);
+        spans[index].pos = next;
+        length += next - pos;
+    }
+    return spans.empty();
+}
+
+/**
+ * \brief Skip up to three spaces of indentation
+ * \return New position
+ */
+std::size_t MarkdownLexer::skipIndent(std::size_t pos) const
+{
+    std::size_t spaces = 0;
+    while (pos < line.size() && line[pos] == ' ' && spaces < 3)
+    {
+        ++pos;
+        ++spaces;
+    }
+    return pos;
+}
+
+/**
+ * \brief Check for a code fence (three or more backticks or tildes)
+ */
+bool MarkdownLexer::isFence(std::size_t pos, char &fenceChar, std::size_t &fenceLength) const
+{
+    if (pos >= line.size() || (line[pos] != '`' && line[pos] != '~'))
+        return false;
+
+    fenceChar = line[pos];
+    fenceLength = 0;
+    while (pos + fenceLength < line.size() && line[pos + fenceLength] == fenceChar)
+        ++fenceLength;
+    return fenceLength >= 3;
+}
+
+/**
+ * \brief Check for thematic break (eg. '***', '- - -' or '___')
+ */
+bool MarkdownLexer::isThematicBreak(std::size_t pos) const
+{
+    if (pos >= line.size())
+        return false;
+
+    char breakChar = line[pos];
+    if (breakChar != '-' && breakChar != '*' && breakChar != '_')
+        return false;
+
+    std::size_t count = 0;
+    for (std::size_t i = pos; i < line.size(); ++i)
+    {
+        if (line[i] == breakChar)
+            ++count;
+        else if (line[i] != ' ' && line[i] != '\t')
+            return false;
+    }
+    return count >= 3;
+}
+
+/**
+ * \brief Length of the bullet ('-', '+', '*') or ordered list ('1.', '2)') marker
+ * \return marker length in bytes, zero if there is no list marker
+ */
+std::size_t MarkdownLexer::listMarkerLength(std::size_t pos) const
+{
+    const std::size_t size = line.size();
+    std::size_t end = pos;
+    if (pos < size && (line[pos] == '-' || line[pos] == '+' || line[pos] == '*'))
+    {
+        end = pos + 1;
+    }
+    else
+    {
+        while (end < size && (end - pos) < 9 && line[end] >= '0' && line[end] <= '9')
+            ++end;
+        if (end == pos || end >= size || (line[end] != '.' && line[end] != ')'))
+            return 0;
+        ++end;
+    }
+    // Marker needs to be followed by whitespace or the end of the line
+    if (end < size && line[end] != ' ' && line[end] != '\t')
+        return 0;
+    return end - pos;
+}
+
+/**
+ * \brief Lex the block-level markers (quotes, headings, breaks and list items), the inline content is added to the spans
+ */
+void MarkdownLexer::lexBlock(std::size_t pos)
+{
+    const std::size_t size = line.size();
+
+    // List items can contain other blocks (eg. '- > quote')
+    while (true)
+    {
+        // Block quote markers (can be nested)
+        std::size_t quoteStart = pos;
+        while (pos < size && line[pos] == '>')
+        {
+            ++pos;
+            if (pos < size && line[pos] == ' ')
+                ++pos;
+            pos = skipIndent(pos);
+        }
+        if (pos > quoteStart)
+        {
+            tokens->push_back({TOKEN_QUOTE, quoteStart, size});
+            tokens->push_back({TOKEN_MARKER, quoteStart, pos});
+        }
+        if (pos >= size)
+            return;
+
+        // ATX heading
+        if (line[pos] == '#')
+        {
+            std::size_t hashes = 0;
+            while (pos + hashes < size && line[pos + hashes] == '#')
+                ++hashes;
+            if (hashes <= 6 && (pos + hashes == size || line[pos + hashes] == ' ' || line[pos + hashes] == '\t'))
+            {
+                tokens->push_back({TOKEN_HEADING, pos, size});
+                tokens->push_back({TOKEN_MARKER, pos, pos + hashes});
+                spans.push_back({pos + hashes, size});
+                return;
+            }
+        }
+
+        if (isThematicBreak(pos))
+        {
+            tokens->push_back({TOKEN_THEMATIC_BREAK, pos, size});
+            return;
+        }
+
+        // Nested list items can be indented further
+        std::size_t itemPos = std::min(line.find_first_not_of(" \t", pos), size);
+        std::size_t markerLength = listMarkerLength(itemPos);
+        if (markerLength == 0)
+            break;
+        tokens->push_back({TOKEN_LIST_MARKER, itemPos, itemPos + markerLength});
+        pos = itemPos + markerLength;
+        while (pos < size && (line[pos] == ' ' || line[pos] == '\t'))
+            ++pos;
+    }
+    spans.push_back({pos, size});
+}
+
+/**
+ * \brief Lex a single inline element (code span, emphasis or link) at pos, the content of the element is added to the spans
+ * \return Position after the element
+ */
+std::size_t MarkdownLexer::lexInline(std::size_t pos, std::size_t end)
+{
+    switch (line[pos])
+    {
+    case '\\':
+        // Escaped character
+        return pos + 2;
+    case '`':
+    {
+        bool isClosed;
+        std::size_t next = skipCodeSpan(pos, end, isClosed);
+        if (isClosed)
+            tokens->push_back({TOKEN_CODE, pos, next});
+        return next;
+    }
+    case '*':
+    case '_':
+    case '~':
+        return lexDelimiter(pos, end);
+    case '!':
+        if (pos + 1 < end && line[pos + 1] == '[')
+            return lexLink(pos, end);
+        return pos + 1;
+    case '[':
+        return lexLink(pos, end);
+    case '<':
+    {
+        // Autolink, eg. <https://libreweb.org>, the next '>' is searched once for all '<' in front of it
+        if (angleClose <= pos)
+            angleClose = line.find('>', pos);
+        if (angleClose < end)
+        {
+            std::string_view inner = line.substr(pos + 1, angleClose - pos - 1);
+            if (!inner.empty() && inner.find_first_of(" <") == std::string_view::npos &&
+                (inner.find(':') != std::string_view::npos || inner.find('@') != std::string_view::npos))
+            {
+                tokens->push_back({TOKEN_LINK_URL, pos, angleClose + 1});
+                return angleClose + 1;
+            }
+        }
+        return pos + 1;
+    }
+    default:
+        return pos + 1;
+    }
+}
+
+/**
+ * \brief Skip inline code span, the closing backtick run needs to have the same length
+ * \param isClosed Set to true if the code span is closed
+ * \return Position after the code span (or after the opening run if not closed)
+ */
+std::size_t MarkdownLexer::skipCodeSpan(std::size_t pos, std::size_t end, bool &isClosed)
+{
+    isClosed = false;
+    std::size_t run = 0;
+    while (pos + run < end && line[pos + run] == '`')
+        ++run;
+
+    const std::size_t contentBegin = pos + run;
+    Miss &miss = codeSpanMisses[run];
+    if (contentBegin >= miss.begin && end <= miss.end)
+        return contentBegin;
+
+    std::size_t search = contentBegin;
+    while (search < end)
+    {
+        std::size_t close = line.find('`', search);
+        if (close == std::string_view::npos || close >= end)
+            break;
+        std::size_t closeRun = 0;
+        while (close + closeRun < end && line[close + closeRun] == '`')
+            ++closeRun;
+        if (closeRun == run)
+        {
+            isClosed = true;
+            return close + closeRun;
+        }
+        search = close + closeRun;
+    }
+    miss = {contentBegin, end};
+    return contentBegin;
+}
+
+/**
+ * \brief Lex emphasis ('*', '_'), strong ('**', '__') and strikethrough ('~~') delimiters
+ * \return Position after the closing delimiter (or after the opening run if not closed)
+ */
+std::size_t MarkdownLexer::lexDelimiter(std::size_t pos, std::size_t end)
+{
+    const char delimiter = line[pos];
+    std::size_t run = 0;
+    while (pos + run < end && line[pos + run] == delimiter)
+        ++run;
+
+    // Opening run needs to be left-flanking
+    if (pos + run >= end || line[pos + run] == ' ' || line[pos + run] == '\t')
+        return pos + run;
+    // Strikethrough is always a double tilde
+    if (delimiter == '~' && run != 2)
+        return pos + run;
+    // No intra-word emphasis for underscores
+    if (delimiter == '_' && pos > 0 && std::isalnum(static_cast<unsigned char>(line[pos - 1])))
+        return pos + run;
+
+    const std::size_t innerBegin = pos + run;
+    Miss &miss = delimiterMisses[{delimiter, run}];
+    if (innerBegin >= miss.begin && end <= miss.end)
+        return innerBegin;
+
+    std::size_t search = innerBegin;
+    while (search < end)
+    {
+        if (line[search] == '\\')
+        {
+            search += 2;
+            continue;
+        }
+        if (line[search] == '`')
+        {
+            // Delimiters inside code spans do not count
+            bool isClosed;
+            search = skipCodeSpan(search, end, isClosed);
+            continue;
+        }
+        if (line[search] != delimiter)
+        {
+            ++search;
+            continue;
+        }
+        std::size_t closeRun = 0;
+        while (search + closeRun < end && line[search + closeRun] == delimiter)
+            ++closeRun;
+        // Closing run needs to be right-flanking and of the same length
+        if (closeRun == run && line[search - 1] != ' ' && line[search - 1] != '\t')
+        {
+            tokens->push_back({TOKEN_MARKER, pos, innerBegin});
+            if (delimiter == '~')
+            {
+                tokens->push_back({TOKEN_STRIKETHROUGH, innerBegin, search});
+            }
+            else
+            {
+                if (run >= 2)
+                    tokens->push_back({TOKEN_STRONG, innerBegin, search});
+                if (run != 2)
+                    tokens->push_back({TOKEN_EMPHASIS, innerBegin, search});
+            }
+            tokens->push_back({TOKEN_MARKER, search, search + closeRun});
+            spans.push_back({innerBegin, search});
+            return search + closeRun;
+        }
+        search += closeRun;
+    }
+    miss = {innerBegin, end};
+    return innerBegin;
+}
+
+/**
+ * \brief Lex links and images: [text](url), ![alt](url), [text][ref] and reference definitions [ref]: url
+ * \return Position after the link (or after the opening bracket if it's not a link)
+ */
+std::size_t MarkdownLexer::lexLink(std::size_t pos, std::size_t end)
+{
+    const std::size_t begin = pos;
+    if (line[pos] == '!')
+        ++pos;
+
+    std::size_t close = findClosing(closingBrackets, pos);
+    if (close >= end)
+        return pos + 1;
+
+    std::size_t next = close + 1;
+    std::size_t urlEnd = std::string_view::npos;
+    if (next < end && line[next] == '(')
+    {
+        std::size_t closeParen = findClosing(closingParens, next);
+        if (closeParen < end)
+            urlEnd = closeParen + 1;
+    }
+    else if (next < end && line[next] == '[')
+    {
+        std::size_t refClose = line.find(']', next);
+        if (refClose < end)
+            urlEnd = refClose + 1;
+    }
+    else if (next < end && line[next] == ':' && begin == firstNonBlank)
+    {
+        // Link reference definition
+        urlEnd = end;
+    }
+
+    if (urlEnd == std::string_view::npos)
+        return pos + 1;
+
+    tokens->push_back({TOKEN_LINK_TEXT, begin, close + 1});
+    tokens->push_back({TOKEN_LINK_URL, next, urlEnd});
+    spans.push_back({pos + 1, close});
+    return urlEnd;
+}
+
+/**
+ * \brief Position of the bracket or parenthesis that closes the one at open. All of them are matched in a single pass
+ * over the line (on first use), instead of searching the rest of the line for each opening bracket.
+ * \param closing Closing brackets or closing parentheses
+ * \return Position of the closing one or npos if it isn't closed
+ */
+std::size_t MarkdownLexer::findClosing(std::unordered_map<std::size_t, std::size_t> &closing, std::size_t open)
+{
+    if (!isBracketsMatched)
+    {
+        std::vector<std::size_t> openBrackets;
+        std::vector<std::size_t> openParens;
+        for (std::size_t i = 0; i < line.size(); ++i)
+        {
+            switch (line[i])
+            {
+            case '\\':
+                ++i;
+                break;
+            case '[':
+                openBrackets.push_back(i);
+                break;
+            case ']':
+                if (!openBrackets.empty())
+                {
+                    closingBrackets[openBrackets.back()] = i;
+                    openBrackets.pop_back();
+                }
+                break;
+            case '(':
+                openParens.push_back(i);
+                break;
+            case ')':
+                if (!openParens.empty())
+                {
+                    closingParens[openParens.back()] = i;
+                    openParens.pop_back();
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        isBracketsMatched = true;
+    }
+    auto it = closing.find(open);
+    return (it != closing.end()) ? it->second : std::string_view::npos;
+}
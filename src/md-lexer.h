@@ -0,0 +1,107 @@
+#ifndef MD_LEXER_H
+#define MD_LEXER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * \class MarkdownLexer
+ * \brief Line-based markdown source lexer, used for syntax highlighting in the editor.
+ * Each line is lexed on its own, only the (fenced code) state is carried over to the next line.
+ * The inline content of a line is lexed in steps (see lex()), so a very long line can be spread over several idle slices.
+ */
+class MarkdownLexer
+{
+public:
+    enum TokenType
+    {
+        TOKEN_HEADING = 0,
+        TOKEN_QUOTE,
+        TOKEN_EMPHASIS,
+        TOKEN_STRONG,
+        TOKEN_STRIKETHROUGH,
+        TOKEN_LINK_TEXT,
+        TOKEN_LINK_URL,
+        TOKEN_LIST_MARKER,
+        TOKEN_THEMATIC_BREAK,
+        TOKEN_MARKER,
+        TOKEN_CODE,
+        TOKEN_CODE_BLOCK,
+        TOKEN_COUNT
+    };
+
+    /**
+     * \struct Token
+     * \brief Highlighted range within a single line (byte offsets)
+     */
+    struct Token
+    {
+        TokenType type;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    /**
+     * \struct LineState
+     * \brief Lexer state at the start of a line (non-zero fence length means: inside a fenced code block)
+     */
+    struct LineState
+    {
+        char fenceChar = 0;
+        uint8_t fenceLength = 0;
+
+        bool operator==(const LineState &other) const = default;
+    };
+
+    LineState start(std::string_view line, LineState state, std::vector<Token> &tokens);
+    bool lex(std::vector<Token> &tokens, std::size_t maxLength);
+
+private:
+    /**
+     * \struct Span
+     * \brief Inline range of the line that is still to be lexed
+     */
+    struct Span
+    {
+        std::size_t pos;
+        std::size_t end;
+    };
+
+    /**
+     * \struct Miss
+     * \brief Range that was searched for a closing run without success, a later search within it fails as well
+     */
+    struct Miss
+    {
+        std::size_t begin = 0;
+        std::size_t end = 0;
+    };
+
+    std::string_view line;
+    std::vector<Token> *tokens = nullptr;
+    std::vector<Span> spans;                                     /*!< Inline ranges to lex, the last one first */
+    std::size_t firstNonBlank = 0;                               /*!< Start of a link reference definition */
+    std::size_t angleClose = 0;                                  /*!< Next '>' (for autolinks) */
+    std::map<std::size_t, Miss> codeSpanMisses;                  /*!< Per backtick run length */
+    std::map<std::pair<char, std::size_t>, Miss> delimiterMisses; /*!< Per delimiter character and run length */
+    bool isBracketsMatched = false;
+    std::unordered_map<std::size_t, std::size_t> closingBrackets; /*!< Position of '[' -> position of the matching ']' */
+    std::unordered_map<std::size_t, std::size_t> closingParens;   /*!< Position of '(' -> position of the matching ')' */
+
+    std::size_t skipIndent(std::size_t pos) const;
+    bool isFence(std::size_t pos, char &fenceChar, std::size_t &fenceLength) const;
+    bool isThematicBreak(std::size_t pos) const;
+    std::size_t listMarkerLength(std::size_t pos) const;
+    void lexBlock(std::size_t pos);
+    std::size_t lexInline(std::size_t pos, std::size_t end);
+    std::size_t skipCodeSpan(std::size_t pos, std::size_t end, bool &isClosed);
+    std::size_t lexDelimiter(std::size_t pos, std::size_t end);
+    std::size_t lexLink(std::size_t pos, std::size_t end);
+    std::size_t findClosing(std::unordered_map<std::size_t, std::size_t> &closing, std::size_t open);
+};
+#endif
@@ -31,24 +31,34 @@ Parser &Parser::getInstance()
  */
 cmark_node *Parser::parseContent(const std::string &content)
 {
-    const char *data = content.c_str();
+    // Modified version of cmark_parse_document() in blocks.c
+    cmark_parser *parser = createParser();
+    cmark_node *document;
+
+    // Parse the buffer in-place, the size is already known
+    cmark_parser_feed(parser, content.data(), content.size());
+    document = cmark_parser_finish(parser);
+    cmark_parser_free(parser);
+    return document;
+}
 
+/**
+ * Create a parser with the markdown extensions attached, eg. for feeding the content in chunks.
+ * Note: Do not forgot to execute: cmark_parser_free(parser); when you are done with the parser.
+ * @return Parser
+ */
+cmark_parser *Parser::createParser()
+{
     cmark_gfm_core_extensions_ensure_registered();
 
-    // Modified version of cmark_parse_document() in blocks.c
     cmark_parser *parser = cmark_parser_new(OPTIONS);
-    cmark_node *document;
     // Add extensions
     addMarkdownExtension(parser, "strikethrough");
     addMarkdownExtension(parser, "highlight");
     addMarkdownExtension(parser, "superscript");
     addMarkdownExtension(parser, "subscript");
     //addMarkdownExtension(parser, "table");
-
-    cmark_parser_feed(parser, data, strlen(data));
-    document = cmark_parser_finish(parser);
-    cmark_parser_free(parser);
-    return document;
+    return parser;
 }
 
 /**
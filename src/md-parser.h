@@ -16,6 +16,7 @@ public:
     // Singleton
     static Parser &getInstance();
     static cmark_node *parseContent(const std::string &content);
+    static cmark_parser *createParser();
     static std::string const renderHTML(cmark_node *node);
     static std::string const renderMarkdown(cmark_node *node);
 
@@ -7,6 +7,9 @@ Menu::Menu(const Glib::RefPtr<Gtk::AccelGroup> &accelgroup)
       m_help("_Help", true)
 {
     // File sub-menu
+    auto newWindowMenuItem = createMenuItem("New _Window");
+    newWindowMenuItem->add_accelerator("activate", accelgroup, GDK_KEY_N, Gdk::ModifierType::CONTROL_MASK | Gdk::ModifierType::SHIFT_MASK, Gtk::AccelFlags::ACCEL_VISIBLE);
+    newWindowMenuItem->signal_activate().connect(new_window);
     auto newDocumentMenuItem = createMenuItem("_New Document");
     newDocumentMenuItem->add_accelerator("activate", accelgroup, GDK_KEY_N, Gdk::ModifierType::CONTROL_MASK, Gtk::AccelFlags::ACCEL_VISIBLE);
     newDocumentMenuItem->signal_activate().connect(new_doc);
@@ -29,6 +32,8 @@ Menu::Menu(const Glib::RefPtr<Gtk::AccelGroup> &accelgroup)
     publishMenuItem->set_sensitive(false); // disable
     publishMenuItem->add_accelerator("activate", accelgroup, GDK_KEY_P, Gdk::ModifierType::CONTROL_MASK, Gtk::AccelFlags::ACCEL_VISIBLE);
     publishMenuItem->signal_activate().connect(publish);
+    auto publishFolderMenuItem = createMenuItem("Publish _Folder...");
+    publishFolderMenuItem->signal_activate().connect(publish_folder);
     auto quitMenuItem = createMenuItem("_Quit");
     quitMenuItem->add_accelerator("activate", accelgroup, GDK_KEY_Q, Gdk::ModifierType::CONTROL_MASK, Gtk::AccelFlags::ACCEL_VISIBLE);
     quitMenuItem->signal_activate().connect(quit);
@@ -79,12 +84,16 @@ Menu::Menu(const Glib::RefPtr<Gtk::AccelGroup> &accelgroup)
     homePageMenuItem->signal_activate().connect(home);
     auto sourceCodeMenuItem = createMenuItem("View _Source");
     sourceCodeMenuItem->signal_activate().connect(source_code);
+    auto outlineMenuItem = createMenuItem("Document _Outline");
+    outlineMenuItem->add_accelerator("activate", accelgroup, GDK_KEY_F9, Gdk::ModifierType(0), Gtk::AccelFlags::ACCEL_VISIBLE);
+    outlineMenuItem->signal_activate().connect(outline);
 
     // Help subm-enu
     auto aboutMenuItem = createMenuItem("_About");
     aboutMenuItem->signal_activate().connect(about);
 
     // Add items to sub-menus
+    m_fileSubmenu.append(*newWindowMenuItem);
     m_fileSubmenu.append(*newDocumentMenuItem);
     m_fileSubmenu.append(*openMenuItem);
     m_fileSubmenu.append(*openEditMenuItem);
@@ -94,6 +103,7 @@ Menu::Menu(const Glib::RefPtr<Gtk::AccelGroup> &accelgroup)
     m_fileSubmenu.append(*saveAsMenuItem);
     m_fileSubmenu.append(m_separator2);
     m_fileSubmenu.append(*publishMenuItem);
+    m_fileSubmenu.append(*publishFolderMenuItem);
     m_fileSubmenu.append(m_separator3);
     m_fileSubmenu.append(*quitMenuItem);
     m_editSubmenu.append(*undoMenuItem);
@@ -114,6 +124,7 @@ Menu::Menu(const Glib::RefPtr<Gtk::AccelGroup> &accelgroup)
     m_viewSubmenu.append(*homePageMenuItem);
     m_viewSubmenu.append(m_separator7);
     m_viewSubmenu.append(*sourceCodeMenuItem);
+    m_viewSubmenu.append(*outlineMenuItem);
     m_helpSubmenu.append(*aboutMenuItem);
 
     // Add sub-menus to menus
@@ -14,6 +14,7 @@
 class Menu : public Gtk::MenuBar
 {
 public:
+    sigc::signal<void> new_window;
     sigc::signal<void> new_doc;
     sigc::signal<void> open;
     sigc::signal<void> open_edit;
@@ -21,6 +22,7 @@ public:
     sigc::signal<void> save;
     sigc::signal<void> save_as;
     sigc::signal<void> publish;
+    sigc::signal<void> publish_folder;
     sigc::signal<void> quit;
     sigc::signal<void> undo;
     sigc::signal<void> redo;
@@ -36,6 +38,7 @@ public:
     sigc::signal<void> reload;
     sigc::signal<void> home;
     sigc::signal<void> source_code;
+    sigc::signal<void> outline;
     sigc::signal<void> about;
 
     explicit Menu(const Glib::RefPtr<Gtk::AccelGroup> &accelgroup);
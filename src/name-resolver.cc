@@ -0,0 +1,256 @@
+#include "name-resolver.h"
+#include "ipfs.h"
+
+#include <algorithm>
+#include <arpa/nameser.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <resolv.h>
+#include <stdexcept>
+
+namespace
+{
+    const std::chrono::seconds DEFAULT_IPNS_TTL(60); /*!< Records without TTL (or not available locally) */
+    const std::chrono::seconds DNSLINK_TTL(300);     /*!< DNSLink records of which the DNS TTL is unknown, a common DNS TTL */
+    const std::chrono::seconds MIN_TTL(10);
+    const std::chrono::seconds MAX_TTL(24 * 60 * 60);
+    const std::chrono::seconds MAX_STALE(7 * 24 * 60 * 60); /*!< Older resolutions are resolved again before use */
+    const std::size_t MAX_ENTRIES = 256;
+    const int MAX_STEPS = 8; /*!< Max. IPNS indirections (eg. DNSLink to key to key) */
+
+    /**
+     * \brief Get the DNS TTL of the DNSLink record of a domain via the system resolver, the daemon doesn't expose it
+     * \return TTL in seconds, 0 when unknown
+     */
+    uint32_t getDNSLinkTTL(const std::string &domain)
+    {
+        unsigned char answer[4 * NS_PACKETSZ];
+        // Same lookup order as the daemon: _dnslink.<domain>, else the domain itself
+        for (const std::string &name : {"_dnslink." + domain, domain})
+        {
+            ns_msg message;
+            int length = res_query(name.c_str(), ns_c_in, ns_t_txt, answer, sizeof(answer));
+            if (length < 0 || ns_initparse(answer, std::min<int>(length, sizeof(answer)), &message) < 0)
+                continue;
+            for (int i = 0; i < ns_msg_count(message, ns_s_an); ++i)
+            {
+                ns_rr record;
+                if (ns_parserr(&message, ns_s_an, i, &record) < 0 || ns_rr_type(record) != ns_t_txt || ns_rr_rdlen(record) < 1)
+                    continue;
+                // TXT data: length-prefixed character strings, a DNSLink record starts with "dnslink="
+                std::string text(reinterpret_cast<const char *>(ns_rr_rdata(record)) + 1,
+                                 std::min<std::size_t>(ns_rr_rdata(record)[0], ns_rr_rdlen(record) - 1));
+                if (text.rfind("dnslink=", 0) == 0)
+                    return ns_rr_ttl(record);
+            }
+        }
+        return 0;
+    }
+} // namespace
+
+/**
+ * \brief Create resolver and start the refresh thread
+ * \param ipfs IPFS daemon connection
+ * \param changed Called when a refreshed resolution differs (eg. a new version of the site is published)
+ */
+NameResolver::NameResolver(IPFS &ipfs, const ChangedCallback &changed)
+    : ipfs(ipfs),
+      changed(changed),
+      stopping(false),
+      refreshThread(&NameResolver::runRefresh, this)
+{
+}
+
+NameResolver::~NameResolver()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        this->refreshQueue.clear();
+        this->ttlQueue.clear();
+    }
+    this->condition.notify_all();
+    this->refreshThread.join();
+}
+
+/**
+ * \brief Resolve IPNS path (blocking when the name isn't cached)
+ * \param path IPNS path, eg. "/ipns/example.com/index.md"
+ * \throw std::runtime_error when the name can't be resolved
+ * \return Resolution, the remainder of the path is appended to the resolved path
+ */
+NameResolver::Resolution NameResolver::resolve(const std::string &path)
+{
+    // Names are cached, not every path within a site
+    std::size_t end = path.find('/', 6);
+    std::string namePath = path.substr(0, end);
+    std::string remainder = (end == std::string::npos) ? "" : path.substr(end);
+    Resolution resolution;
+    bool isCached = false;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->cache.find(namePath);
+        if (it != this->cache.end())
+        {
+            auto age = std::chrono::steady_clock::now() - it->second.resolved;
+            if (age < it->second.ttl + MAX_STALE)
+            {
+                resolution = it->second;
+                isCached = true;
+                if (age >= it->second.ttl)
+                {
+                    resolution.isStale = true;
+                    if (!it->second.isStale)
+                    {
+                        it->second.isStale = true; // Refresh is queued
+                        this->refreshQueue.push_back(namePath);
+                        this->condition.notify_one();
+                    }
+                }
+            }
+        }
+    }
+    if (!isCached)
+    {
+        // The record TTLs are routing/DNS queries of their own, they aren't waited for
+        resolution = this->resolveChain(namePath, false);
+        this->store(namePath, resolution);
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->ttlQueue.push_back(namePath);
+        this->condition.notify_one();
+    }
+    resolution.path += remainder;
+    return resolution;
+}
+
+void NameResolver::runRefresh()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->condition.wait(lock, [this] { return this->stopping || !this->refreshQueue.empty() || !this->ttlQueue.empty(); });
+        if (this->stopping)
+            break;
+        // Refreshes first, a stale resolution is shown until then
+        if (this->refreshQueue.empty())
+        {
+            std::string namePath = this->ttlQueue.front();
+            this->ttlQueue.pop_front();
+            lock.unlock();
+            this->updateTTL(namePath);
+            lock.lock();
+            continue;
+        }
+        std::string namePath = this->refreshQueue.front();
+        this->refreshQueue.pop_front();
+        lock.unlock();
+        try
+        {
+            Resolution resolution = this->resolveChain(namePath, true);
+            std::string previousPath;
+            {
+                std::lock_guard<std::mutex> cacheLock(this->mutex);
+                auto it = this->cache.find(namePath);
+                if (it != this->cache.end())
+                    previousPath = it->second.path;
+            }
+            this->store(namePath, resolution);
+            if (!previousPath.empty() && previousPath != resolution.path && this->changed)
+                this->changed(namePath);
+        }
+        catch (const std::runtime_error &error)
+        {
+            // The stale resolution is kept, the next request tries again
+            std::cerr << "WARNING: Could not refresh " << namePath << ": " << error.what() << std::endl;
+            std::lock_guard<std::mutex> cacheLock(this->mutex);
+            auto it = this->cache.find(namePath);
+            if (it != this->cache.end())
+                it->second.isStale = false;
+        }
+        lock.lock();
+    }
+}
+
+/**
+ * \brief Look up the TTLs of the steps of a cached resolution, which has the default TTLs
+ * \param namePath IPNS path of the name, eg. "/ipns/example.com"
+ */
+void NameResolver::updateTTL(const std::string &namePath)
+{
+    std::vector<std::string> chain;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->cache.find(namePath);
+        if (it == this->cache.end())
+            return;
+        chain = it->second.chain;
+    }
+    std::chrono::seconds ttl = MAX_TTL;
+    for (const std::string &step : chain)
+    {
+        if (step.rfind("/ipns/", 0) == 0)
+            ttl = std::min(ttl, this->getTTL(step.substr(6, step.find('/', 6) - 6), true));
+    }
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = this->cache.find(namePath);
+    // Unless it's resolved again meanwhile
+    if (it != this->cache.end() && it->second.chain == chain)
+        it->second.ttl = ttl;
+}
+
+/**
+ * \brief Resolve name step by step, until an IPFS path
+ * \param namePath IPNS path of the name, eg. "/ipns/example.com"
+ * \param isTTLResolved Look up the record TTLs, else the default TTLs are used
+ */
+NameResolver::Resolution NameResolver::resolveChain(const std::string &namePath, bool isTTLResolved)
+{
+    Resolution resolution{std::string(), {namePath}, MAX_TTL, std::chrono::steady_clock::time_point(), false};
+    std::string current = namePath;
+    for (int step = 0; current.rfind("/ipns/", 0) == 0; ++step)
+    {
+        if (step >= MAX_STEPS)
+            throw std::runtime_error("Too many IPNS indirections for " + namePath);
+        std::string name = current.substr(6, current.find('/', 6) - 6);
+        resolution.ttl = std::min(resolution.ttl, this->getTTL(name, isTTLResolved));
+        current = this->ipfs.resolveName(current, false);
+        resolution.chain.push_back(current);
+    }
+    if (current.rfind("/ipfs/", 0) != 0)
+        throw std::runtime_error("Name " + namePath + " is not resolved to an IPFS path, but to: " + current);
+    resolution.path = current;
+    resolution.resolved = std::chrono::steady_clock::now();
+    return resolution;
+}
+
+/**
+ * \brief Get the TTL of a resolution step
+ * \param name DNSLink domain or IPNS key
+ * \param isResolved Look up the TTL of the record (DNS or routing query), else the default TTL
+ */
+std::chrono::seconds NameResolver::getTTL(const std::string &name, bool isResolved)
+{
+    bool isDNSLink = name.find('.') != std::string::npos;
+    std::chrono::seconds ttl(0);
+    if (isResolved)
+        ttl = std::chrono::seconds(isDNSLink ? getDNSLinkTTL(name) : this->ipfs.getNameRecordTTL(name));
+    if (ttl.count() == 0)
+        return isDNSLink ? DNSLINK_TTL : DEFAULT_IPNS_TTL;
+    return std::clamp(ttl, MIN_TTL, MAX_TTL);
+}
+
+/**
+ * \brief Store resolution, the oldest resolution is removed when the cache is full
+ */
+void NameResolver::store(const std::string &namePath, const Resolution &resolution)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->cache[namePath] = resolution;
+    if (this->cache.size() > MAX_ENTRIES)
+    {
+        auto oldest = std::min_element(this->cache.begin(), this->cache.end(), [](const auto &a, const auto &b) {
+            return a.second.resolved < b.second.resolved;
+        });
+        this->cache.erase(oldest);
+    }
+}
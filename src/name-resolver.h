@@ -0,0 +1,65 @@
+#ifndef NAME_RESOLVER_H
+#define NAME_RESOLVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class IPFS;
+
+/**
+ * \class NameResolver
+ * \brief Resolves IPNS names (keys and DNSLink domains) to IPFS paths via the daemon, with a cache that honours
+ * the record TTLs (thread-safe). An expired resolution is still returned right away (stale-while-revalidate),
+ * while it is refreshed in the background. The TTLs of a new resolution are looked up in the background as well,
+ * until then a default TTL is used.
+ */
+class NameResolver
+{
+public:
+    /**
+     * \struct Resolution
+     * \brief Resolved name
+     */
+    struct Resolution
+    {
+        std::string path;               /*!< IPFS path, eg. "/ipfs/<cid>/index.md" */
+        std::vector<std::string> chain; /*!< Each resolution step, from the IPNS path to the IPFS path */
+        std::chrono::seconds ttl;       /*!< Shortest TTL of the steps */
+        std::chrono::steady_clock::time_point resolved;
+        bool isStale;                   /*!< Expired, a refresh is running */
+    };
+
+    /**
+     * \brief Called (from the refresh thread) when a refreshed resolution differs from the cached resolution
+     */
+    typedef std::function<void(const std::string &path)> ChangedCallback;
+
+    explicit NameResolver(IPFS &ipfs, const ChangedCallback &changed);
+    ~NameResolver();
+    Resolution resolve(const std::string &path);
+
+private:
+    IPFS &ipfs;
+    ChangedCallback changed;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::map<std::string, Resolution> cache; /*!< Keyed by IPNS path */
+    std::deque<std::string> refreshQueue;
+    std::deque<std::string> ttlQueue; /*!< New resolutions, which still have the default TTL */
+    bool stopping;
+    std::thread refreshThread;
+
+    void runRefresh();
+    Resolution resolveChain(const std::string &path, bool isTTLResolved);
+    std::chrono::seconds getTTL(const std::string &name, bool isResolved);
+    void updateTTL(const std::string &namePath);
+    void store(const std::string &path, const Resolution &resolution);
+};
+#endif
@@ -1,12 +1,12 @@
 #include "option-group.h"
 
 OptionGroup::OptionGroup()
-    : Glib::OptionGroup("main_group", "Options", "Options"), m_timeout("120s"), m_version(false)
+    : Glib::OptionGroup("main_group", "Options", "Options"), m_timeout("120s"), m_connections(4), m_maxSize(64), m_version(false)
 {
     Glib::OptionEntry entry1;
     entry1.set_long_name("timeout");
     entry1.set_short_name('t');
-    entry1.set_description("Change IPFS time-out for getting files (default: 120s)");
+    entry1.set_description("Change max. IPFS time-out for getting files, time-outs adapt to recent fetches (default: 120s)");
     add_entry(entry1, m_timeout);
 
     Glib::OptionEntry entry2;
@@ -14,6 +14,24 @@ OptionGroup::OptionGroup()
     entry2.set_short_name('v');
     entry2.set_description("Show version");
     add_entry(entry2, m_version);
+
+    Glib::OptionEntry entry3;
+    entry3.set_long_name("connections");
+    entry3.set_short_name('c');
+    entry3.set_description("Number of kept-alive connections to the IPFS daemon (default: 4)");
+    add_entry(entry3, m_connections);
+
+    Glib::OptionEntry entry4;
+    entry4.set_long_name("max-size");
+    entry4.set_short_name('m');
+    entry4.set_description("Maximum size of a fetched file in MB (default: 64)");
+    add_entry(entry4, m_maxSize);
+
+    Glib::OptionEntry entry5;
+    entry5.set_long_name("endpoints");
+    entry5.set_short_name('e');
+    entry5.set_description("Extra IPFS API endpoints for getting files, comma-separated (eg. 192.168.1.10:5001). Slow requests are hedged to the next endpoint");
+    add_entry(entry5, m_endpoints);
 }
 
 bool OptionGroup::on_pre_parse(Glib::OptionContext &context, Glib::OptionGroup &group)
@@ -20,6 +20,9 @@ public:
   void on_error(Glib::OptionContext &context, Glib::OptionGroup &group) override;
 
   Glib::ustring m_timeout;
+  int m_connections;
+  int m_maxSize;
+  Glib::ustring m_endpoints;
   bool m_version;
 };
 
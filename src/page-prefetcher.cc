@@ -0,0 +1,244 @@
+#include "page-prefetcher.h"
+#include "content-cache.h"
+#include "fetch-coalescer.h"
+#include "fetch-sink.h"
+#include "file.h"
+#include "md-parser.h"
+
+#include <algorithm>
+#include <giomm/contenttype.h>
+#include <stdexcept>
+
+namespace
+{
+    const std::size_t WORKERS = 2;                          /*!< Max. concurrent prefetches */
+    const std::size_t MAX_QUEUE_SIZE = 16;                  /*!< Oldest low priority requests are dropped */
+    const std::size_t MAX_PAGES = 16;                       /*!< Ready pages in the store */
+    const std::size_t MAX_PAGES_SIZE = 16 * 1024 * 1024;    /*!< Content bytes of the ready pages */
+    const float MAX_LOW_PRIORITY_RATE_IN = 1000.0 * 1000.0; /*!< Bandwidth (bytes/s) above which viewport links are skipped */
+} // namespace
+
+/**
+ * \brief Create prefetcher and start the worker threads
+ * \param fetcher Fetches are shared with regular requests, a click on a link being prefetched joins its transfer
+ * \param contentCache Cached content is not prefetched
+ * \param maxPageSize Max. page size in bytes
+ */
+PagePrefetcher::PagePrefetcher(FetchCoalescer &fetcher, ContentCache &contentCache, std::size_t maxPageSize)
+    : fetcher(fetcher),
+      contentCache(contentCache),
+      maxPageSize(maxPageSize),
+      stopping(false),
+      pagesSize(0),
+      rateIn(0.0)
+{
+    for (std::size_t i = 0; i < WORKERS; ++i)
+        this->workers.emplace_back(&PagePrefetcher::run, this);
+}
+
+PagePrefetcher::~PagePrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        this->queue.clear();
+        for (auto &transfer : this->transfers)
+            transfer.second.sink->abort();
+    }
+    this->condition.notify_all();
+    for (std::thread &worker : this->workers)
+        worker.join();
+    for (Page &page : this->pages)
+        freePage(page);
+}
+
+/**
+ * \brief Queue a page, nothing happens when the page is already queued, running or ready
+ * \param key Content cache key (immutable content only)
+ * \param path IPFS path
+ * \param priority High priority (hover) runs first, a running low priority fetch is aborted when all workers are busy
+ * \param owner Window requesting the page, see cancel()
+ */
+void PagePrefetcher::prefetch(const std::string &key, const std::string &path, Priority priority, const void *owner)
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (priority == PRIORITY_LOW && this->rateIn > MAX_LOW_PRIORITY_RATE_IN)
+            return;
+        auto queued = std::find_if(this->queue.begin(), this->queue.end(), [&key](const Request &request) { return request.key == key; });
+        std::set<const void *> owners{owner};
+        if (queued != this->queue.end())
+        {
+            queued->owners.insert(owner);
+            if (priority == PRIORITY_LOW || queued->priority == PRIORITY_HIGH)
+                return;
+            // Hovered now, move to the front
+            owners = std::move(queued->owners);
+            this->queue.erase(queued);
+        }
+        else if (this->isReady(key))
+        {
+            return;
+        }
+        else
+        {
+            auto running = this->transfers.find(key);
+            if (running != this->transfers.end())
+            {
+                running->second.owners.insert(owner);
+                return;
+            }
+        }
+        if (priority == PRIORITY_HIGH)
+        {
+            this->queue.push_front(Request{key, path, priority, std::move(owners)});
+            if (this->transfers.size() >= WORKERS)
+            {
+                auto low = std::find_if(this->transfers.begin(), this->transfers.end(), [](const std::pair<const std::string, Transfer> &transfer) {
+                    return transfer.second.priority == PRIORITY_LOW;
+                });
+                if (low != this->transfers.end())
+                    low->second.sink->abort();
+            }
+        }
+        else
+        {
+            this->queue.push_back(Request{key, path, priority, std::move(owners)});
+        }
+        while (this->queue.size() > MAX_QUEUE_SIZE)
+            this->queue.pop_back();
+    }
+    this->condition.notify_one();
+}
+
+/**
+ * \brief Cancel the queued and running prefetches of a window (eg. on navigation), the ready pages are kept.
+ * Prefetches also requested by another window continue.
+ * \param owner Window
+ */
+void PagePrefetcher::cancel(const void *owner)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    for (auto it = this->queue.begin(); it != this->queue.end();)
+    {
+        it->owners.erase(owner);
+        if (it->owners.empty())
+            it = this->queue.erase(it);
+        else
+            ++it;
+    }
+    for (auto &transfer : this->transfers)
+    {
+        if (transfer.second.owners.erase(owner) > 0 && transfer.second.owners.empty())
+            transfer.second.sink->abort();
+    }
+}
+
+/**
+ * \brief Update the current incoming bandwidth
+ * \param rateIn Bytes per second
+ */
+void PagePrefetcher::setBandwidthRate(float rateIn)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->rateIn = rateIn;
+}
+
+/**
+ * \brief Take a ready page out of the store
+ * \param key Content cache key
+ * \param content Page content
+ * \param document Parsed content, the caller frees the document (cmark_node_free)
+ * \return True if the page was ready
+ */
+bool PagePrefetcher::take(const std::string &key, std::string &content, cmark_node *&document)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    auto it = std::find_if(this->pages.begin(), this->pages.end(), [&key](const Page &page) { return page.key == key; });
+    if (it == this->pages.end())
+        return false;
+    content = std::move(it->content);
+    document = it->document;
+    this->pagesSize -= content.size();
+    this->pages.erase(it);
+    return true;
+}
+
+void PagePrefetcher::run()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->condition.wait(lock, [this] { return this->stopping || !this->queue.empty(); });
+        if (this->stopping)
+            break;
+        Request request = this->queue.front();
+        this->queue.pop_front();
+        if (request.priority == PRIORITY_LOW && this->rateIn > MAX_LOW_PRIORITY_RATE_IN)
+            continue;
+        Page page{request.key, std::string(), nullptr};
+        // Only text is prefetched, the transfer of other content (eg. an image or a video) is aborted after the first data
+        bool isText = true;
+        std::string contentType;
+        FetchSink sink(page.content, this->maxPageSize, [&sink, &page, &request, &contentType, &isText](std::size_t, std::size_t) {
+            if (contentType.empty() && !page.content.empty())
+            {
+                contentType = File::sniffContentType(request.path, page.content);
+                isText = Gio::content_type_is_a(contentType, "text/plain");
+            }
+            if (!isText)
+                sink.abort();
+        });
+        this->transfers[request.key] = Transfer{&sink, request.priority, std::move(request.owners)};
+        lock.unlock();
+        try
+        {
+            if (!this->contentCache.contains(request.key))
+            {
+                this->fetcher.fetch(request.key, request.path, sink);
+                if (contentType.empty())
+                    isText = Gio::content_type_is_a(File::sniffContentType(request.path, page.content), "text/plain");
+                if (isText)
+                    page.document = Parser::parseContent(page.content);
+            }
+        }
+        catch (const std::runtime_error &error)
+        {
+            // Not available, too large, not text or cancelled
+        }
+        lock.lock();
+        this->transfers.erase(request.key);
+        if (page.document != nullptr)
+            this->storePage(std::move(page));
+    }
+}
+
+/**
+ * \brief Check if the page is ready (in the store)
+ */
+bool PagePrefetcher::isReady(const std::string &key) const
+{
+    return std::any_of(this->pages.begin(), this->pages.end(), [&key](const Page &page) { return page.key == key; });
+}
+
+/**
+ * \brief Add page to the store, the oldest pages are removed when the store is full
+ */
+void PagePrefetcher::storePage(Page &&page)
+{
+    this->pagesSize += page.content.size();
+    this->pages.push_front(std::move(page));
+    while (this->pages.size() > 1 && (this->pages.size() > MAX_PAGES || this->pagesSize > MAX_PAGES_SIZE))
+    {
+        this->pagesSize -= this->pages.back().content.size();
+        freePage(this->pages.back());
+        this->pages.pop_back();
+    }
+}
+
+void PagePrefetcher::freePage(Page &page)
+{
+    if (page.document != nullptr)
+        cmark_node_free(page.document);
+    page.document = nullptr;
+}
@@ -0,0 +1,83 @@
+#ifndef PAGE_PREFETCHER_H
+#define PAGE_PREFETCHER_H
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cmark-gfm.h>
+
+class ContentCache;
+class FetchCoalescer;
+class FetchSink;
+
+/**
+ * \class PagePrefetcher
+ * \brief Fetches and parses linked IPFS pages in the background (thread-safe), before they are clicked.
+ * Hovered links have high priority, links in the viewport low priority. Low priority requests are skipped
+ * while the bandwidth is in use. The ready pages are kept in a bounded memory store.
+ * The prefetcher is shared by the windows, each request has the windows that want it as owners.
+ */
+class PagePrefetcher
+{
+public:
+    enum Priority
+    {
+        PRIORITY_LOW = 0,
+        PRIORITY_HIGH
+    };
+
+    explicit PagePrefetcher(FetchCoalescer &fetcher, ContentCache &contentCache, std::size_t maxPageSize);
+    ~PagePrefetcher();
+    void prefetch(const std::string &key, const std::string &path, Priority priority, const void *owner);
+    void cancel(const void *owner);
+    void setBandwidthRate(float rateIn);
+    bool take(const std::string &key, std::string &content, cmark_node *&document);
+
+private:
+    struct Request
+    {
+        std::string key;
+        std::string path;
+        Priority priority;
+        std::set<const void *> owners; /*!< Windows that requested the page */
+    };
+
+    struct Transfer
+    {
+        FetchSink *sink;
+        Priority priority;
+        std::set<const void *> owners; /*!< Aborted when no window wants the page anymore */
+    };
+
+    struct Page
+    {
+        std::string key;
+        std::string content;
+        cmark_node *document; /*!< Parsed content, owned by the store */
+    };
+
+    FetchCoalescer &fetcher;
+    ContentCache &contentCache;
+    std::size_t maxPageSize; /*!< Larger pages are not prefetched */
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping;
+    std::deque<Request> queue;                 /*!< High priority requests first */
+    std::map<std::string, Transfer> transfers; /*!< Running fetches by key */
+    std::list<Page> pages;                     /*!< Ready pages, most recently added first */
+    std::size_t pagesSize;
+    float rateIn; /*!< Current incoming bandwidth (bytes/s) */
+
+    void run();
+    bool isReady(const std::string &key) const;
+    void storePage(Page &&page);
+    static void freePage(Page &page);
+};
+#endif
@@ -0,0 +1,150 @@
+#include "progressive-renderer.h"
+#include "draw.h"
+#include "md-parser.h"
+#include "map.h"
+#include "node.h"
+#include "parser.h"
+
+#include <algorithm>
+
+namespace
+{
+    // The tail part is drawn again at most every interval, it might be large (eg. a long list)
+    const std::chrono::milliseconds TAIL_UPDATE_INTERVAL(250);
+} // namespace
+
+/**
+ * \brief Create progressive renderer
+ * \param draw Text view to draw the document in
+ * \param content Buffer the document is received in (only appended to, by the thread calling update())
+ */
+ProgressiveRenderer::ProgressiveRenderer(Draw &draw, const std::string &content)
+    : draw(draw),
+      content(content),
+      parser(Parser::createParser()),
+      fedSize(0),
+      lineStarts(1, 0),
+      renderedEnd(0),
+      renderedLine(0),
+      isStarted(false),
+      lastTailUpdate(std::chrono::steady_clock::now())
+{
+}
+
+ProgressiveRenderer::~ProgressiveRenderer()
+{
+    cmark_parser_free(this->parser);
+}
+
+/**
+ * \brief Process the newly received data, draw the settled blocks and (periodically) the unfinished tail
+ */
+void ProgressiveRenderer::update()
+{
+    if (this->content.size() <= this->fedSize)
+        return;
+    this->feed();
+
+    int settledLine = this->getSettledLine();
+    if (settledLine > this->renderedLine && static_cast<std::size_t>(settledLine) < this->lineStarts.size())
+        this->renderPart(this->lineStarts[settledLine], false);
+
+    auto now = std::chrono::steady_clock::now();
+    if (this->content.size() > this->renderedEnd && now - this->lastTailUpdate >= TAIL_UPDATE_INTERVAL)
+    {
+        this->renderPart(this->content.size(), true);
+        this->lastTailUpdate = now;
+    }
+}
+
+/**
+ * \brief Complete the document after the download is finished. Each part was parsed on its own, so a reference link
+ * in one part doesn't find its definition in another part: when the document has link reference definitions, the parser
+ * (which has seen all the data) finishes the whole document and it replaces the parts. Otherwise the remaining part is drawn.
+ * \param[out] isWhole Set to true when the whole document is drawn from a single parse (it can be stored in the render cache)
+ * \return False when nothing is drawn yet (the document can be processed at once)
+ */
+bool ProgressiveRenderer::finish(bool &isWhole)
+{
+    isWhole = false;
+    if (!this->isStarted)
+        return false;
+    this->feed();
+    if (this->hasReferenceDefinitions())
+    {
+        cmark_node *doc = cmark_parser_finish(this->parser);
+        this->draw.processDocument(doc);
+        cmark_node_free(doc);
+        isWhole = true;
+        return true;
+    }
+    if (this->content.size() > this->renderedEnd)
+        this->renderPart(this->content.size(), false);
+    this->draw.endDocument();
+    return true;
+}
+
+/**
+ * \brief Feed the newly received data into the parser
+ */
+void ProgressiveRenderer::feed()
+{
+    for (std::size_t i = this->fedSize; i < this->content.size(); ++i)
+    {
+        if (this->content[i] == '\n')
+            this->lineStarts.push_back(i + 1);
+    }
+    cmark_parser_feed(this->parser, this->content.data() + this->fedSize, this->content.size() - this->fedSize);
+    this->fedSize = this->content.size();
+}
+
+/**
+ * \brief Source line (one-based) where the last closed top-level block ends, only the last block can be open
+ */
+int ProgressiveRenderer::getSettledLine() const
+{
+    for (cmark_node *child = cmark_node_last_child(this->parser->root); child != nullptr; child = cmark_node_previous(child))
+    {
+        if ((child->flags & CMARK_NODE__OPEN) == 0)
+            return child->end_line;
+    }
+    return 0;
+}
+
+/**
+ * \brief Check for link reference definitions ('[label]: url'): the ones of closed paragraphs are in the reference map,
+ * the open paragraph and the unfinished last line are resolved when the parser finishes (might be a definition when it starts with '[')
+ */
+bool ProgressiveRenderer::hasReferenceDefinitions() const
+{
+    if (this->parser->refmap != nullptr && this->parser->refmap->refs != nullptr)
+        return true;
+    const cmark_node *current = this->parser->current;
+    if (current != nullptr && current->type == CMARK_NODE_PARAGRAPH && current->content.size > 0 && current->content.ptr[0] == '[')
+        return true;
+    const cmark_strbuf &lastLine = this->parser->linebuf;
+    return std::find(lastLine.ptr, lastLine.ptr + lastLine.size, '[') != lastLine.ptr + lastLine.size;
+}
+
+/**
+ * \brief Parse and draw the content from the end of the settled part
+ * \param end End of the part (byte offset)
+ * \param isTail Unfinished part, replaced by the next part
+ */
+void ProgressiveRenderer::renderPart(std::size_t end, bool isTail)
+{
+    if (!this->isStarted)
+    {
+        this->draw.beginDocument();
+        this->isStarted = true;
+    }
+    cmark_node *doc = Parser::parseContent(this->content.substr(this->renderedEnd, end - this->renderedEnd));
+    this->draw.appendDocument(doc, this->renderedLine, isTail);
+    cmark_node_free(doc);
+    if (!isTail)
+    {
+        this->renderedEnd = end;
+        auto line = std::upper_bound(this->lineStarts.begin(), this->lineStarts.end(), end);
+        this->renderedLine = static_cast<int>(line - this->lineStarts.begin()) - 1;
+    }
+}
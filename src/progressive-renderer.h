@@ -0,0 +1,43 @@
+#ifndef PROGRESSIVE_RENDERER_H
+#define PROGRESSIVE_RENDERER_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmark-gfm.h>
+
+class Draw;
+
+/**
+ * \class ProgressiveRenderer
+ * \brief Draws a markdown document while it's still being downloaded.
+ * The received data is fed into a cmark parser, to find the top-level blocks that are complete (closed).
+ * Each new settled part is parsed and appended to Draw, the unfinished remainder is drawn as tail part
+ * (replaced on the next update). When a link reference definition can be used across parts, the whole document is
+ * drawn again from the complete parse at the end.
+ */
+class ProgressiveRenderer
+{
+public:
+    explicit ProgressiveRenderer(Draw &draw, const std::string &content);
+    ~ProgressiveRenderer();
+    void update();
+    bool finish(bool &isWhole);
+
+private:
+    Draw &draw;
+    const std::string &content; /*!< Buffer being filled by the fetch */
+    cmark_parser *parser;
+    std::size_t fedSize;
+    std::vector<std::size_t> lineStarts; /*!< Byte offset of each (received) line */
+    std::size_t renderedEnd;             /*!< End of the settled part that is drawn */
+    int renderedLine;                    /*!< Source line of renderedEnd */
+    bool isStarted;
+    std::chrono::steady_clock::time_point lastTailUpdate;
+
+    void feed();
+    int getSettledLine() const;
+    bool hasReferenceDefinitions() const;
+    void renderPart(std::size_t end, bool isTail);
+};
+#endif
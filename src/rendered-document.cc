@@ -0,0 +1,433 @@
+#include "rendered-document.h"
+
+#include <cstring>
+
+namespace
+{
+    const char MAGIC[4] = {'L', 'W', 'R', 'D'};
+
+    void writeVarint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void writeSigned(std::string &out, int64_t value)
+    {
+        // Zigzag encoding, keeps small negative numbers small
+        writeVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void writeString(std::string &out, const std::string &value)
+    {
+        writeVarint(out, value.size());
+        out.append(value);
+    }
+
+    /**
+     * \brief Bounds-checked reader, any read past the end sets the failed flag
+     */
+    struct Reader
+    {
+        const std::string &data;
+        std::size_t pos;
+        bool failed;
+
+        uint64_t varint()
+        {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                if (pos >= data.size())
+                    break;
+                uint8_t byte = static_cast<uint8_t>(data[pos++]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                    return value;
+            }
+            failed = true;
+            return 0;
+        }
+
+        int64_t signedVarint()
+        {
+            uint64_t value = varint();
+            return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+        }
+
+        int integer()
+        {
+            uint64_t value = varint();
+            if (value > INT32_MAX)
+                failed = true;
+            return static_cast<int>(value);
+        }
+
+        std::string string()
+        {
+            uint64_t size = varint();
+            if (failed || size > data.size() - pos)
+            {
+                failed = true;
+                return std::string();
+            }
+            std::string value = data.substr(pos, size);
+            pos += size;
+            return value;
+        }
+
+        double real()
+        {
+            double value = 0;
+            if (data.size() - pos < sizeof(double))
+            {
+                failed = true;
+                return value;
+            }
+            std::memcpy(&value, data.data() + pos, sizeof(double));
+            pos += sizeof(double);
+            return value;
+        }
+    };
+} // namespace
+
+bool RenderedDocument::Style::operator==(const Style &other) const
+{
+    return font == other.font && foreground == other.foreground && background == other.background && url == other.url &&
+           strikethrough == other.strikethrough && underline == other.underline && rise == other.rise &&
+           isRiseSet == other.isRiseSet && scale == other.scale;
+}
+
+/**
+ * \brief Capture the rendered document from the text buffer (GTK thread).
+ * The style runs are taken from the anonymous tags, named tags (eg. search highlights) are not part of the document.
+ */
+void RenderedDocument::capture(GtkTextBuffer *buffer, const SourceMap &sourceMap, const HeadingIndex &headingIndex)
+{
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(buffer, &start, &end);
+    gchar *slice = gtk_text_buffer_get_slice(buffer, &start, &end, TRUE);
+    this->text = slice;
+    g_free(slice);
+
+    this->styles.clear();
+    this->runs.clear();
+    GtkTextIter iter = start;
+    int offset = 0;
+    while (!gtk_text_iter_is_end(&iter))
+    {
+        GtkTextIter next = iter;
+        gtk_text_iter_forward_to_tag_toggle(&next, NULL);
+        int nextOffset = gtk_text_iter_get_offset(&next);
+        if (nextOffset <= offset)
+            break;
+
+        // Tags are sorted by priority (lowest first), higher priority tags override
+        Style style{};
+        style.strikethrough = -1;
+        style.underline = -1;
+        bool hasStyle = false;
+        GSList *tags = gtk_text_iter_get_tags(&iter);
+        for (GSList *item = tags; item != NULL; item = item->next)
+        {
+            GtkTextTag *tag = GTK_TEXT_TAG(item->data);
+            gchar *name = NULL;
+            g_object_get(tag, "name", &name, NULL);
+            if (name != NULL)
+            {
+                g_free(name);
+                continue;
+            }
+            style = tagStyle(tag, style);
+            hasStyle = true;
+        }
+        g_slist_free(tags);
+
+        if (hasStyle)
+        {
+            uint32_t styleIndex = this->addStyle(style);
+            if (!this->runs.empty() && this->runs.back().style == styleIndex &&
+                this->runs.back().offset + this->runs.back().length == offset)
+                this->runs.back().length += nextOffset - offset;
+            else
+                this->runs.push_back(Run{offset, nextOffset - offset, styleIndex});
+        }
+        iter = next;
+        offset = nextOffset;
+    }
+
+    this->sourceLines = sourceMap.getLines();
+    this->sourceOffsets = sourceMap.getOffsets();
+    this->headings = headingIndex.getHeadings();
+}
+
+/**
+ * \brief Insert the document at the end of the text buffer, and restore the source map and heading index (GTK thread)
+ */
+void RenderedDocument::apply(GtkTextBuffer *buffer, SourceMap &sourceMap, HeadingIndex &headingIndex) const
+{
+    GtkTextIter iter;
+    const int base = gtk_text_buffer_get_char_count(buffer);
+    gtk_text_buffer_get_end_iter(buffer, &iter);
+    gtk_text_buffer_insert(buffer, &iter, this->text.data(), static_cast<gint>(this->text.size()));
+
+    // One tag per unique style
+    std::vector<GtkTextTag *> tags;
+    tags.reserve(this->styles.size());
+    for (const Style &style : this->styles)
+    {
+        GtkTextTag *tag = gtk_text_buffer_create_tag(buffer, NULL, NULL);
+        if (!style.font.empty())
+            g_object_set(tag, "font", style.font.c_str(), NULL);
+        if (!style.foreground.empty())
+            g_object_set(tag, "foreground", style.foreground.c_str(), NULL);
+        if (!style.background.empty())
+            g_object_set(tag, "background", style.background.c_str(), NULL);
+        if (style.strikethrough >= 0)
+            g_object_set(tag, "strikethrough", style.strikethrough != 0, NULL);
+        if (style.underline >= 0)
+            g_object_set(tag, "underline", style.underline, NULL);
+        if (style.isRiseSet)
+            g_object_set(tag, "rise", style.rise, NULL);
+        if (style.scale > 0)
+            g_object_set(tag, "scale", style.scale, NULL);
+        if (!style.url.empty())
+            g_object_set_data_full(G_OBJECT(tag), "url", g_strdup(style.url.c_str()), g_free);
+        tags.push_back(tag);
+    }
+    GtkTextIter runStart, runEnd;
+    for (const Run &run : this->runs)
+    {
+        gtk_text_buffer_get_iter_at_offset(buffer, &runStart, base + run.offset);
+        gtk_text_buffer_get_iter_at_offset(buffer, &runEnd, base + run.offset + run.length);
+        gtk_text_buffer_apply_tag(buffer, tags[run.style], &runStart, &runEnd);
+    }
+
+    for (std::size_t i = 0; i < this->sourceLines.size(); ++i)
+        sourceMap.add(this->sourceLines[i], base + this->sourceOffsets[i]);
+    for (const HeadingIndex::Heading &heading : this->headings)
+        headingIndex.add(heading.level, heading.text, base + heading.offset, heading.line);
+}
+
+/**
+ * \brief Serialize into the binary format, offsets are delta encoded
+ */
+std::string RenderedDocument::serialize() const
+{
+    std::string out;
+    out.reserve(this->text.size() + this->runs.size() * 4 + 256);
+    out.append(MAGIC, sizeof(MAGIC));
+    writeVarint(out, VERSION);
+    writeString(out, this->text);
+
+    writeVarint(out, this->styles.size());
+    for (const Style &style : this->styles)
+    {
+        writeString(out, style.font);
+        writeString(out, style.foreground);
+        writeString(out, style.background);
+        writeString(out, style.url);
+        writeSigned(out, style.strikethrough);
+        writeSigned(out, style.underline);
+        writeVarint(out, style.isRiseSet);
+        writeSigned(out, style.rise);
+        out.append(reinterpret_cast<const char *>(&style.scale), sizeof(double));
+    }
+
+    writeVarint(out, this->runs.size());
+    int last = 0;
+    for (const Run &run : this->runs)
+    {
+        writeVarint(out, run.offset - last);
+        writeVarint(out, run.length);
+        writeVarint(out, run.style);
+        last = run.offset + run.length;
+    }
+
+    writeVarint(out, this->sourceLines.size());
+    int lastLine = 0, lastOffset = 0;
+    for (std::size_t i = 0; i < this->sourceLines.size(); ++i)
+    {
+        writeSigned(out, this->sourceLines[i] - lastLine);
+        writeSigned(out, this->sourceOffsets[i] - lastOffset);
+        lastLine = this->sourceLines[i];
+        lastOffset = this->sourceOffsets[i];
+    }
+
+    writeVarint(out, this->headings.size());
+    for (const HeadingIndex::Heading &heading : this->headings)
+    {
+        writeVarint(out, heading.level);
+        writeString(out, heading.text);
+        writeVarint(out, heading.offset);
+        writeVarint(out, heading.line);
+    }
+    return out;
+}
+
+/**
+ * \brief Deserialize from the binary format (any thread)
+ * \return False when the data is invalid or written by another version
+ */
+bool RenderedDocument::deserialize(const std::string &data)
+{
+    if (data.size() < sizeof(MAGIC) || data.compare(0, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0)
+        return false;
+    Reader reader{data, sizeof(MAGIC), false};
+    if (reader.varint() != VERSION)
+        return false;
+    this->text = reader.string();
+    if (reader.failed || !g_utf8_validate(this->text.data(), this->text.size(), NULL))
+        return false;
+    const int textLength = static_cast<int>(g_utf8_strlen(this->text.data(), this->text.size()));
+
+    uint64_t count = reader.varint();
+    this->styles.clear();
+    for (uint64_t i = 0; i < count && !reader.failed; ++i)
+    {
+        Style style{};
+        style.font = reader.string();
+        style.foreground = reader.string();
+        style.background = reader.string();
+        style.url = reader.string();
+        style.strikethrough = static_cast<int>(reader.signedVarint());
+        style.underline = static_cast<int>(reader.signedVarint());
+        style.isRiseSet = reader.varint() != 0;
+        style.rise = static_cast<int>(reader.signedVarint());
+        style.scale = reader.real();
+        this->styles.push_back(style);
+    }
+
+    count = reader.varint();
+    this->runs.clear();
+    int last = 0;
+    for (uint64_t i = 0; i < count && !reader.failed; ++i)
+    {
+        Run run;
+        run.offset = last + reader.integer();
+        run.length = reader.integer();
+        run.style = static_cast<uint32_t>(reader.varint());
+        if (run.style >= this->styles.size() || run.offset > textLength || run.length > textLength - run.offset)
+            return false;
+        last = run.offset + run.length;
+        this->runs.push_back(run);
+    }
+
+    count = reader.varint();
+    this->sourceLines.clear();
+    this->sourceOffsets.clear();
+    int lastLine = 0, lastOffset = 0;
+    for (uint64_t i = 0; i < count && !reader.failed; ++i)
+    {
+        lastLine += static_cast<int>(reader.signedVarint());
+        lastOffset += static_cast<int>(reader.signedVarint());
+        this->sourceLines.push_back(lastLine);
+        this->sourceOffsets.push_back(lastOffset);
+    }
+
+    count = reader.varint();
+    this->headings.clear();
+    for (uint64_t i = 0; i < count && !reader.failed; ++i)
+    {
+        HeadingIndex::Heading heading;
+        heading.level = reader.integer();
+        heading.text = reader.string();
+        heading.offset = reader.integer();
+        heading.line = reader.integer();
+        this->headings.push_back(heading);
+    }
+    return !reader.failed && reader.pos == data.size();
+}
+
+uint32_t RenderedDocument::addStyle(const Style &style)
+{
+    for (std::size_t i = 0; i < this->styles.size(); ++i)
+    {
+        if (this->styles[i] == style)
+            return static_cast<uint32_t>(i);
+    }
+    this->styles.push_back(style);
+    return static_cast<uint32_t>(this->styles.size() - 1);
+}
+
+/**
+ * \brief Merge the (set) properties of the tag on top of the base style
+ */
+RenderedDocument::Style RenderedDocument::tagStyle(GtkTextTag *tag, const Style &base)
+{
+    Style style = base;
+    gboolean isSet = FALSE;
+
+    PangoFontDescription *font = NULL;
+    g_object_get(tag, "font-desc", &font, NULL);
+    if (font != NULL)
+    {
+        if (pango_font_description_get_set_fields(font) != 0)
+        {
+            PangoFontDescription *merged = style.font.empty() ? pango_font_description_new() : pango_font_description_from_string(style.font.c_str());
+            pango_font_description_merge(merged, font, TRUE);
+            gchar *fontString = pango_font_description_to_string(merged);
+            style.font = fontString;
+            g_free(fontString);
+            pango_font_description_free(merged);
+        }
+        pango_font_description_free(font);
+    }
+    g_object_get(tag, "foreground-set", &isSet, NULL);
+    if (isSet)
+    {
+        GdkRGBA *color = NULL;
+        g_object_get(tag, "foreground-rgba", &color, NULL);
+        if (color != NULL)
+        {
+            gchar *colorString = gdk_rgba_to_string(color);
+            style.foreground = colorString;
+            g_free(colorString);
+            gdk_rgba_free(color);
+        }
+    }
+    g_object_get(tag, "background-set", &isSet, NULL);
+    if (isSet)
+    {
+        GdkRGBA *color = NULL;
+        g_object_get(tag, "background-rgba", &color, NULL);
+        if (color != NULL)
+        {
+            gchar *colorString = gdk_rgba_to_string(color);
+            style.background = colorString;
+            g_free(colorString);
+            gdk_rgba_free(color);
+        }
+    }
+    g_object_get(tag, "strikethrough-set", &isSet, NULL);
+    if (isSet)
+    {
+        gboolean strikethrough = FALSE;
+        g_object_get(tag, "strikethrough", &strikethrough, NULL);
+        style.strikethrough = strikethrough ? 1 : 0;
+    }
+    g_object_get(tag, "underline-set", &isSet, NULL);
+    if (isSet)
+    {
+        PangoUnderline underline = PANGO_UNDERLINE_NONE;
+        g_object_get(tag, "underline", &underline, NULL);
+        style.underline = static_cast<int>(underline);
+    }
+    g_object_get(tag, "rise-set", &isSet, NULL);
+    if (isSet)
+    {
+        g_object_get(tag, "rise", &style.rise, NULL);
+        style.isRiseSet = true;
+    }
+    g_object_get(tag, "scale-set", &isSet, NULL);
+    if (isSet)
+        g_object_get(tag, "scale", &style.scale, NULL);
+    const char *url = static_cast<const char *>(g_object_get_data(G_OBJECT(tag), "url"));
+    if (url != NULL)
+        style.url = url;
+    return style;
+}
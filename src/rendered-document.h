@@ -0,0 +1,69 @@
+#ifndef RENDERED_DOCUMENT_H
+#define RENDERED_DOCUMENT_H
+
+#include "source-map.h"
+#include "heading-index.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gtk/gtk.h>
+
+/**
+ * \class RenderedDocument
+ * \brief Rendered output of a markdown document: the plain text, the style (tag) runs including links,
+ * the source map and the headings. Serialized into a compact binary format (variable-length integers),
+ * so a page can be restored into the text buffer without parsing and processing the markdown again.
+ */
+class RenderedDocument
+{
+public:
+    static const uint32_t VERSION = 1; /*!< Increase when the rendering (Draw) or the format changes */
+
+    /**
+     * \struct Style
+     * \brief Text tag properties, empty/unset fields are not applied
+     */
+    struct Style
+    {
+        std::string font;
+        std::string foreground;
+        std::string background;
+        std::string url;
+        int strikethrough; /*!< -1 = not set */
+        int underline;     /*!< -1 = not set */
+        int rise;
+        bool isRiseSet;
+        double scale; /*!< 0 = not set */
+
+        bool operator==(const Style &other) const;
+    };
+
+    /**
+     * \struct Run
+     * \brief Character range with a single style
+     */
+    struct Run
+    {
+        int offset;
+        int length;
+        uint32_t style;
+    };
+
+    std::string text;
+    std::vector<Style> styles;
+    std::vector<Run> runs;
+    std::vector<int> sourceLines;
+    std::vector<int> sourceOffsets;
+    std::vector<HeadingIndex::Heading> headings;
+
+    void capture(GtkTextBuffer *buffer, const SourceMap &sourceMap, const HeadingIndex &headingIndex);
+    void apply(GtkTextBuffer *buffer, SourceMap &sourceMap, HeadingIndex &headingIndex) const;
+    std::string serialize() const;
+    bool deserialize(const std::string &data);
+
+private:
+    uint32_t addStyle(const Style &style);
+    static Style tagStyle(GtkTextTag *tag, const Style &base);
+};
+#endif
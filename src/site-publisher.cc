@@ -0,0 +1,797 @@
+#include "site-publisher.h"
+#include "cid.h"
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <glib.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#ifdef LEGACY_CXX
+#include <experimental/filesystem>
+namespace n_fs = ::std::experimental::filesystem;
+#else
+#include <filesystem>
+namespace n_fs = ::std::filesystem;
+#endif
+
+namespace
+{
+    const std::size_t MAX_BATCH_FILES = 32;
+    const uint64_t MAX_BATCH_SIZE = 8 * 1024 * 1024;
+    const char *const SITE_EXTENSIONS[] = {".md", ".markdown", ".png", ".jpg", ".jpeg", ".gif", ".svg", ".webp"};
+
+    struct HandleDeleter
+    {
+        void operator()(CURL *handle) const
+        {
+            curl_easy_cleanup(handle);
+        }
+    };
+
+    struct MimeDeleter
+    {
+        void operator()(curl_mime *form) const
+        {
+            curl_mime_free(form);
+        }
+    };
+
+    /**
+     * \brief Upload progress of a single batch request
+     */
+    struct UploadProgress
+    {
+        std::atomic<uint64_t> *sent; /*!< Bytes uploaded by all batches */
+        uint64_t total;
+        curl_off_t batchSent;
+        const std::atomic<bool> *cancelled;
+        const std::atomic<bool> *failed; /*!< Another batch failed */
+        const SitePublisher::ProgressCallback *callback;
+    };
+
+    /**
+     * \brief Returning non-zero aborts the transfer
+     */
+    int progressCallback(void *userData, curl_off_t, curl_off_t, curl_off_t, curl_off_t uploaded)
+    {
+        auto progress = static_cast<UploadProgress *>(userData);
+        if (*progress->cancelled || *progress->failed)
+            return 1;
+        if (uploaded > progress->batchSent)
+        {
+            uint64_t sent = (*progress->sent += static_cast<uint64_t>(uploaded - progress->batchSent));
+            progress->batchSent = uploaded;
+            if (*progress->callback)
+                (*progress->callback)(std::min(sent, progress->total), progress->total);
+        }
+        return 0;
+    }
+
+    std::size_t writeCallback(char *data, std::size_t size, std::size_t count, void *userData)
+    {
+        static_cast<std::string *>(userData)->append(data, size * count);
+        return size * count;
+    }
+
+    /**
+     * \brief Part of a CAR stream: bytes in memory, followed by a range of the content
+     */
+    struct CARPiece
+    {
+        std::string data;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    /**
+     * \brief CAR file uploaded via a read callback, the raw leaves are read from the file (or the content)
+     * while uploading, so the CAR isn't built in memory
+     */
+    struct CARStream
+    {
+        std::vector<CARPiece> pieces;
+        std::string localPath;
+        const std::string *content; /*!< Content in memory, instead of the file */
+        std::ifstream file;         /*!< Opened on the first read */
+        std::size_t piece;          /*!< Current piece */
+        uint64_t position;          /*!< Position within the current piece */
+
+        bool read(uint64_t offset, char *buffer, std::size_t size)
+        {
+            if (this->content != nullptr)
+            {
+                if (offset + size > this->content->size())
+                    return false;
+                std::memcpy(buffer, this->content->data() + offset, size);
+                return true;
+            }
+            if (!this->file.is_open())
+                this->file.open(this->localPath, std::ios::binary);
+            this->file.clear();
+            this->file.seekg(static_cast<std::streamoff>(offset));
+            this->file.read(buffer, static_cast<std::streamsize>(size));
+            return this->file.gcount() == static_cast<std::streamsize>(size);
+        }
+    };
+
+    std::size_t readCARCallback(char *buffer, std::size_t size, std::size_t count, void *userData)
+    {
+        auto stream = static_cast<CARStream *>(userData);
+        std::size_t capacity = size * count;
+        std::size_t written = 0;
+        while (written < capacity && stream->piece < stream->pieces.size())
+        {
+            const CARPiece &piece = stream->pieces[stream->piece];
+            std::size_t length;
+            if (stream->position < piece.data.size())
+            {
+                length = std::min<uint64_t>(capacity - written, piece.data.size() - stream->position);
+                std::memcpy(buffer + written, piece.data.data() + stream->position, length);
+            }
+            else if (stream->position < piece.data.size() + piece.size)
+            {
+                uint64_t rangePosition = stream->position - piece.data.size();
+                length = std::min<uint64_t>(capacity - written, piece.size - rangePosition);
+                // The file changed since the CIDs are computed
+                if (!stream->read(piece.offset + rangePosition, buffer + written, length))
+                    return CURL_READFUNC_ABORT;
+            }
+            else
+            {
+                stream->piece++;
+                stream->position = 0;
+                continue;
+            }
+            written += length;
+            stream->position += length;
+        }
+        return written;
+    }
+
+    /**
+     * \brief Rewind the stream (eg. when the request is sent again)
+     */
+    int seekCARCallback(void *userData, curl_off_t offset, int origin)
+    {
+        auto stream = static_cast<CARStream *>(userData);
+        if (origin != SEEK_SET || offset < 0)
+            return CURL_SEEKFUNC_CANTSEEK;
+        uint64_t remaining = static_cast<uint64_t>(offset);
+        for (stream->piece = 0; stream->piece < stream->pieces.size(); stream->piece++)
+        {
+            uint64_t length = stream->pieces[stream->piece].data.size() + stream->pieces[stream->piece].size;
+            if (remaining < length)
+                break;
+            remaining -= length;
+        }
+        if (stream->piece == stream->pieces.size() && remaining > 0)
+            return CURL_SEEKFUNC_FAIL;
+        stream->position = remaining;
+        return CURL_SEEKFUNC_OK;
+    }
+
+    void freeCARCallback(void *userData)
+    {
+        delete static_cast<CARStream *>(userData);
+    }
+} // namespace
+
+/**
+ * \brief Create site publisher
+ * \param host IPFS host (eg. localhost)
+ * \param port IPFS API port number (5001)
+ * \param socketPath Path of the API Unix domain socket, empty to always use TCP
+ * \param parallel Max. number of concurrent upload requests
+ */
+SitePublisher::SitePublisher(const std::string &host, int port, const std::string &socketPath, std::size_t parallel)
+    : host(host),
+      port(port),
+      socketPath(socketPath),
+      parallel(std::max<std::size_t>(parallel, 1)),
+      cancelled(false)
+{
+}
+
+/**
+ * \brief Publish the site folder (blocking)
+ * \param directory Local site folder
+ * \param chunker Fixed-size chunks (the daemon's default) or content-defined chunks
+ * \param progress Optional progress callback (called from the upload threads)
+ * \throw std::runtime_error when publishing failed or is cancelled
+ * \return Root CID and manifest
+ */
+SitePublisher::Result SitePublisher::publish(const std::string &directory, CID::Chunker chunker, const ProgressCallback &progress)
+{
+    this->cancelled = false;
+    Result result;
+    result.files = listFiles(directory);
+    if (result.files.empty())
+        throw std::runtime_error("No markdown or image files found in " + directory);
+
+    // Compute the CIDs locally, files that are already pinned or published before are not uploaded again
+    CID::Options options = CID::getDefaultOptions(1, chunker);
+    std::set<std::string> pinned = this->getPinnedCIDs();
+    std::vector<std::string> localCIDs(result.files.size());
+    std::vector<Blocks> fileBlocks(result.files.size());
+    std::vector<CARSections> carSections(result.files.size()); /*!< Content-defined chunks: the DAG to import */
+    std::vector<bool> isSkipped(result.files.size(), false);
+    std::vector<std::size_t> uploads;
+    for (std::size_t i = 0; i < result.files.size(); ++i)
+    {
+        if (this->cancelled)
+            throw std::runtime_error("Publishing is cancelled");
+        localCIDs[i] = computeFileCID(result.files[i].localPath, options, fileBlocks[i], (chunker != CID::CHUNKER_FIXED) ? &carSections[i] : nullptr);
+        if (pinned.count(localCIDs[i]) > 0 || this->publishedCIDs.count(localCIDs[i]) > 0)
+        {
+            result.files[i].cid = localCIDs[i];
+            isSkipped[i] = true;
+            CARSections().swap(carSections[i]);
+        }
+        else
+        {
+            uploads.push_back(i);
+        }
+    }
+    result.blocks = this->getBlockReport(fileBlocks, isSkipped);
+
+    // Batches of small files, large files get a batch of their own
+    std::vector<std::vector<std::size_t>> batches;
+    uint64_t batchSize = 0;
+    uint64_t total = 0;
+    for (std::size_t i : uploads)
+    {
+        if (batches.empty() || batches.back().size() >= MAX_BATCH_FILES || batchSize + result.files[i].size > MAX_BATCH_SIZE)
+        {
+            batches.emplace_back();
+            batchSize = 0;
+        }
+        batches.back().push_back(i);
+        batchSize += result.files[i].size;
+        total += result.files[i].size;
+    }
+
+    // Upload the batches in parallel
+    std::atomic<std::size_t> nextBatch(0);
+    std::atomic<uint64_t> sent(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < std::min(this->parallel, batches.size()); ++i)
+    {
+        workers.emplace_back([&]() {
+            std::size_t index;
+            while (!failed && (index = nextBatch++) < batches.size())
+            {
+                try
+                {
+                    this->addBatch(result.files, batches[index], options, localCIDs, carSections, sent, total, failed, progress);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+    if (this->cancelled)
+        throw std::runtime_error("Publishing is cancelled");
+    if (error)
+        std::rethrow_exception(error);
+    for (std::size_t i : uploads)
+    {
+        if (result.files[i].cid != localCIDs[i])
+            std::cerr << "WARNING: Local CID " << localCIDs[i] << " of " << result.files[i].path << " differs from the IPFS daemon: " << result.files[i].cid << std::endl;
+        this->publishedCIDs.insert(result.files[i].cid);
+    }
+    for (const Blocks &blocks : fileBlocks)
+    {
+        for (const auto &block : blocks)
+            this->publishedBlocks.insert(block.first);
+    }
+
+    // Assemble the directory in MFS (in a temporary directory), pin the root and remove the MFS copy
+    std::string mfsRoot = "/.libreweb-publish-" + std::to_string(getpid()) + "-" +
+                          std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+    try
+    {
+        std::set<std::string> directories{""};
+        for (const File &file : result.files)
+        {
+            for (std::size_t pos = file.path.find('/'); pos != std::string::npos; pos = file.path.find('/', pos + 1))
+                directories.insert("/" + file.path.substr(0, pos));
+        }
+        for (const std::string &dir : directories)
+            this->request("files/mkdir", {{"arg", mfsRoot + dir}, {"parents", "true"}, {"cid-version", "1"}});
+        for (const File &file : result.files)
+        {
+            if (this->cancelled)
+                throw std::runtime_error("Publishing is cancelled");
+            this->request("files/cp", {{"arg", "/ipfs/" + file.cid}, {"arg", mfsRoot + "/" + file.path}});
+        }
+        result.rootCID = getJSONValue(this->request("files/stat", {{"arg", mfsRoot}, {"hash", "true"}}), "Hash");
+        this->request("pin/add", {{"arg", result.rootCID}});
+    }
+    catch (const std::runtime_error &)
+    {
+        try
+        {
+            this->request("files/rm", {{"arg", mfsRoot}, {"recursive", "true"}});
+        }
+        catch (const std::runtime_error &)
+        {
+            // ignore, the directory might not exist
+        }
+        throw;
+    }
+    this->request("files/rm", {{"arg", mfsRoot}, {"recursive", "true"}});
+    return result;
+}
+
+/**
+ * \brief Publish a single document (blocking)
+ * \param name File name
+ * \param content Document content
+ * \param chunker Fixed-size chunks (the daemon's default) or content-defined chunks
+ * \param progress Optional progress callback
+ * \throw std::runtime_error when publishing failed or is cancelled
+ * \return CID of the document (as root CID) and manifest
+ */
+SitePublisher::Result SitePublisher::publishContent(const std::string &name, const std::string &content, CID::Chunker chunker,
+                                                    const ProgressCallback &progress)
+{
+    this->cancelled = false;
+    Result result;
+    CID::Options options = CID::getDefaultOptions(1, chunker);
+    std::vector<Blocks> fileBlocks(1);
+    CARSections sections;
+    std::string localCID = computeCID(content.data(), content.size(), options, fileBlocks.front(), (chunker != CID::CHUNKER_FIXED) ? &sections : nullptr);
+    bool isUnchanged = this->publishedCIDs.count(localCID) > 0;
+    result.blocks = this->getBlockReport(fileBlocks, {isUnchanged});
+    if (isUnchanged)
+    {
+        result.rootCID = localCID;
+        result.files.push_back(File{name, "", content.size(), localCID});
+        return result;
+    }
+    std::unique_ptr<CURL, HandleDeleter> handle(curl_easy_init());
+    if (!handle)
+        throw std::runtime_error("Could not create curl handle");
+    std::unique_ptr<curl_mime, MimeDeleter> form(curl_mime_init(handle.get()));
+    if (chunker == CID::CHUNKER_FIXED)
+    {
+        curl_mimepart *part = curl_mime_addpart(form.get());
+        curl_mime_name(part, "file");
+        curl_mime_filename(part, name.c_str());
+        curl_mime_type(part, "application/octet-stream");
+        curl_mime_data(part, content.data(), content.size());
+    }
+    else
+    {
+        addCARPart(form.get(), name, localCID, sections, "", &content);
+    }
+
+    std::atomic<uint64_t> sent(0);
+    std::atomic<bool> failed(false);
+    UploadProgress uploadProgress{&sent, content.size(), 0, &this->cancelled, &failed, &progress};
+    if (chunker == CID::CHUNKER_FIXED)
+    {
+        std::string response = this->request("add", {{"pin", "true"}, {"cid-version", "1"}, {"progress", "false"}}, form.get(), &uploadProgress);
+        result.rootCID = getJSONValue(response, "Hash");
+    }
+    else
+    {
+        if (this->importCAR(form.get(), &uploadProgress).count(localCID) == 0)
+            throw std::runtime_error("Document is not imported: " + localCID);
+        result.rootCID = localCID;
+    }
+    this->publishedCIDs.insert(result.rootCID);
+    for (const auto &block : fileBlocks.front())
+        this->publishedBlocks.insert(block.first);
+    result.files.push_back(File{name, "", content.size(), result.rootCID});
+    return result;
+}
+
+/**
+ * \brief Cancel the running publish (thread-safe), running uploads are aborted
+ */
+void SitePublisher::cancel()
+{
+    this->cancelled = true;
+}
+
+/**
+ * \brief List the site files (markdown and images) in the folder and its sub-folders, hidden files are skipped
+ * \param directory Local site folder
+ * \return Files, sorted by path
+ */
+std::vector<SitePublisher::File> SitePublisher::listFiles(const std::string &directory)
+{
+    std::vector<File> files;
+    std::string rootPath = directory;
+    while (rootPath.size() > 1 && rootPath.back() == '/')
+        rootPath.pop_back();
+    n_fs::path root(rootPath);
+    for (auto it = n_fs::recursive_directory_iterator(root); it != n_fs::recursive_directory_iterator(); ++it)
+    {
+        std::string name = it->path().filename().string();
+        if (name.empty() || name[0] == '.')
+        {
+            if (n_fs::is_directory(it->path()))
+                it.disable_recursion_pending();
+            continue;
+        }
+        if (!n_fs::is_regular_file(it->path()))
+            continue;
+        std::string extension = it->path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (std::find(std::begin(SITE_EXTENSIONS), std::end(SITE_EXTENSIONS), extension) == std::end(SITE_EXTENSIONS))
+            continue;
+        File file;
+        file.path = it->path().generic_string().substr(root.generic_string().size() + 1);
+        file.localPath = it->path().string();
+        file.size = static_cast<uint64_t>(n_fs::file_size(it->path()));
+        files.push_back(file);
+    }
+    std::sort(files.begin(), files.end(), [](const File &a, const File &b) { return a.path < b.path; });
+    return files;
+}
+
+/**
+ * \brief Upload a batch of files in one multipart request, the file bodies are streamed from disk
+ * \param localCIDs CID of each file, computed before
+ * \param carSections DAG of each file (content-defined chunks), computed before
+ */
+void SitePublisher::addBatch(std::vector<File> &files, const std::vector<std::size_t> &batch, const CID::Options &options,
+                             const std::vector<std::string> &localCIDs, const std::vector<CARSections> &carSections,
+                             std::atomic<uint64_t> &sent, uint64_t total, const std::atomic<bool> &failed, const ProgressCallback &progress)
+{
+    std::unique_ptr<CURL, HandleDeleter> handle(curl_easy_init());
+    if (!handle)
+        throw std::runtime_error("Could not create curl handle");
+    std::unique_ptr<curl_mime, MimeDeleter> form(curl_mime_init(handle.get()));
+    UploadProgress uploadProgress{&sent, total, 0, &this->cancelled, &failed, &progress};
+    if (options.chunker != CID::CHUNKER_FIXED)
+    {
+        // The daemon can't chunk the same way, the DAG computed before is imported (one CAR per file, streamed from disk)
+        for (std::size_t index : batch)
+            addCARPart(form.get(), std::to_string(index), localCIDs[index], carSections[index], files[index].localPath, nullptr);
+        std::set<std::string> imported = this->importCAR(form.get(), &uploadProgress);
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            if (imported.count(localCIDs[batch[i]]) == 0)
+                throw std::runtime_error("File is not imported: " + files[batch[i]].path);
+            files[batch[i]].cid = localCIDs[batch[i]];
+        }
+        return;
+    }
+    for (std::size_t index : batch)
+    {
+        curl_mimepart *part = curl_mime_addpart(form.get());
+        curl_mime_name(part, "file");
+        // The index is used as name, the response is matched on it
+        curl_mime_filename(part, std::to_string(index).c_str());
+        curl_mime_type(part, "application/octet-stream");
+        if (curl_mime_filedata(part, files[index].localPath.c_str()) != CURLE_OK)
+            throw std::runtime_error("Could not read file: " + files[index].localPath);
+    }
+    std::string response = this->request("add", {{"pin", "true"}, {"cid-version", "1"}, {"progress", "false"}}, form.get(), &uploadProgress);
+
+    // One JSON object per line
+    std::istringstream lines(response);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.empty())
+            continue;
+        std::string name = getJSONValue(line, "Name");
+        std::size_t index = std::stoul(name);
+        if (index < files.size() && std::find(batch.begin(), batch.end(), index) != batch.end())
+            files[index].cid = getJSONValue(line, "Hash");
+    }
+    for (std::size_t index : batch)
+    {
+        if (files[index].cid.empty())
+            throw std::runtime_error("No CID received for: " + files[index].path);
+    }
+}
+
+/**
+ * \brief Import CAR files and pin their roots
+ * \param form Multipart form with the CAR files
+ * \param progressData Upload progress (UploadProgress)
+ * \throw std::runtime_error when importing or pinning failed
+ * \return Imported root CIDs
+ */
+std::set<std::string> SitePublisher::importCAR(curl_mime *form, void *progressData)
+{
+    std::string response = this->request("dag/import", {{"pin-roots", "true"}}, form, progressData);
+    std::set<std::string> roots;
+    std::istringstream lines(response);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        if (line.empty())
+            continue;
+        try
+        {
+            auto content = nlohmann::json::parse(line);
+            if (!content.contains("Root"))
+                continue; // Statistics
+            std::string pinError = content["Root"].value("PinErrorMsg", "");
+            if (!pinError.empty())
+                throw std::runtime_error("Could not pin imported file: " + pinError);
+            roots.insert(content["Root"].at("Cid").at("/").get<std::string>());
+        }
+        catch (const nlohmann::json::exception &error)
+        {
+            throw std::runtime_error("Unexpected IPFS response: " + line);
+        }
+    }
+    return roots;
+}
+
+/**
+ * \brief Block-level diff of the files against the blocks of earlier publishes
+ * \param files Blocks of each file
+ * \param isReused Files of which all blocks are reused (already pinned or published)
+ */
+SitePublisher::BlockReport SitePublisher::getBlockReport(const std::vector<Blocks> &files, const std::vector<bool> &isReused)
+{
+    BlockReport report{0, 0, 0, 0};
+    std::set<std::string> seen;
+    for (std::size_t i = 0; i < files.size(); ++i)
+    {
+        for (const auto &block : files[i])
+        {
+            if (seen.insert(block.first).second && !isReused[i] && this->publishedBlocks.count(block.first) == 0)
+            {
+                ++report.newBlocks;
+                report.newBytes += block.second;
+            }
+            else
+            {
+                ++report.reusedBlocks;
+                report.reusedBytes += block.second;
+            }
+        }
+    }
+    return report;
+}
+
+/**
+ * \brief Get the recursively pinned CIDs of the daemon (as CIDv1, base32)
+ */
+std::set<std::string> SitePublisher::getPinnedCIDs()
+{
+    std::string response = this->request("pin/ls", {{"type", "recursive"}, {"cid-base", "base32"}});
+    std::set<std::string> cids;
+    try
+    {
+        // The parsed response must outlive the loop, items() only refers to it
+        nlohmann::json content = nlohmann::json::parse(response);
+        for (const auto &pin : content.at("Keys").items())
+            cids.insert(pin.key());
+    }
+    catch (const nlohmann::json::exception &error)
+    {
+        throw std::runtime_error("Unexpected IPFS response: " + response);
+    }
+    return cids;
+}
+
+/**
+ * \brief Do an API request (POST)
+ * \param command API command (eg. "files/stat")
+ * \param arguments Query arguments, values are escaped
+ * \param form Optional multipart form
+ * \param progressData Optional upload progress (UploadProgress), the transfer is aborted when cancelled
+ * \throw std::runtime_error when the request failed (same messages as the ipfs::Client)
+ * \return Response body
+ */
+std::string SitePublisher::request(const std::string &command, const Arguments &arguments, curl_mime *form, void *progressData)
+{
+    std::unique_ptr<CURL, HandleDeleter> handle(curl_easy_init());
+    if (!handle)
+        throw std::runtime_error("Could not create curl handle");
+    bool isSocket = this->isSocketAvailable();
+    std::string url = (isSocket ? std::string("http://localhost") : "http://" + this->host + ":" + std::to_string(this->port)) + "/api/v0/" + command;
+    char separator = '?';
+    for (const auto &argument : arguments)
+    {
+        char *escaped = curl_easy_escape(handle.get(), argument.second.c_str(), static_cast<int>(argument.second.size()));
+        url += separator + argument.first + "=" + escaped;
+        curl_free(escaped);
+        separator = '&';
+    }
+
+    std::string response;
+    char errorBuffer[CURL_ERROR_SIZE] = {0};
+    if (isSocket)
+        curl_easy_setopt(handle.get(), CURLOPT_UNIX_SOCKET_PATH, this->socketPath.c_str());
+    curl_easy_setopt(handle.get(), CURLOPT_URL, url.c_str());
+    if (form != nullptr)
+    {
+        curl_easy_setopt(handle.get(), CURLOPT_MIMEPOST, form);
+    }
+    else
+    {
+        curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDS, "");
+        curl_easy_setopt(handle.get(), CURLOPT_POSTFIELDSIZE, 0L);
+    }
+    if (progressData != nullptr)
+    {
+        curl_easy_setopt(handle.get(), CURLOPT_XFERINFOFUNCTION, &progressCallback);
+        curl_easy_setopt(handle.get(), CURLOPT_XFERINFODATA, progressData);
+        curl_easy_setopt(handle.get(), CURLOPT_NOPROGRESS, 0L);
+    }
+    curl_easy_setopt(handle.get(), CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle.get(), CURLOPT_WRITEFUNCTION, &writeCallback);
+    curl_easy_setopt(handle.get(), CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(handle.get(), CURLOPT_ERRORBUFFER, errorBuffer);
+    CURLcode result = curl_easy_perform(handle.get());
+    if (result == CURLE_ABORTED_BY_CALLBACK && this->cancelled)
+        throw std::runtime_error("Publishing is cancelled");
+    if (result != CURLE_OK)
+        throw std::runtime_error(std::string(curl_easy_strerror(result)) + ": " + errorBuffer);
+    long statusCode = 0;
+    curl_easy_getinfo(handle.get(), CURLINFO_RESPONSE_CODE, &statusCode);
+    if (statusCode != 200)
+        throw std::runtime_error("HTTP request failed with status code " + std::to_string(statusCode) + ". Response body:\n" + response);
+    return response;
+}
+
+/**
+ * \brief Check if the API socket exists, the local daemon is reached via its Unix domain socket when available
+ */
+bool SitePublisher::isSocketAvailable() const
+{
+    struct stat info;
+    return !this->socketPath.empty() && ::stat(this->socketPath.c_str(), &info) == 0 && S_ISSOCK(info.st_mode);
+}
+
+/**
+ * \brief Compute the CID of the content
+ * \param[out] blocks Binary CID and size of each block
+ * \param[out] sections Optional, the CAR sections of the DAG, raw leaves are referenced by their offset in the content
+ */
+std::string SitePublisher::computeCID(const char *data, std::size_t size, const CID::Options &options, Blocks &blocks, CARSections *sections)
+{
+    std::mutex blocksMutex;
+    return CID::compute(data, size, options, [&](const std::string &cid, std::string_view block) {
+        std::lock_guard<std::mutex> lock(blocksMutex);
+        blocks.emplace_back(cid, block.size());
+        if (sections == nullptr)
+            return;
+        CARSection section{"", 0, 0};
+        CID::appendVarint(section.header, cid.size() + block.size());
+        section.header += cid;
+        std::less_equal<const char *> isBefore;
+        if (!block.empty() && isBefore(data, block.data()) && isBefore(block.data() + block.size(), data + size))
+        {
+            section.offset = static_cast<uint64_t>(block.data() - data);
+            section.size = block.size();
+        }
+        else
+        {
+            section.header += block;
+        }
+        sections->push_back(std::move(section));
+    });
+}
+
+/**
+ * \brief Compute the CID of a file on disk, the file is memory mapped instead of read into memory
+ * \throw std::runtime_error when the file can't be opened
+ */
+std::string SitePublisher::computeFileCID(const std::string &path, const CID::Options &options, Blocks &blocks, CARSections *sections)
+{
+    GError *error = nullptr;
+    GMappedFile *file = g_mapped_file_new(path.c_str(), FALSE, &error);
+    if (file == nullptr)
+    {
+        std::string message = error != nullptr ? error->message : "unknown error";
+        g_clear_error(&error);
+        throw std::runtime_error("Couldn't open file " + path + ": " + message);
+    }
+    try
+    {
+        std::string cid = computeCID(g_mapped_file_get_contents(file), g_mapped_file_get_length(file), options, blocks, sections);
+        g_mapped_file_unref(file);
+        return cid;
+    }
+    catch (...)
+    {
+        g_mapped_file_unref(file);
+        throw;
+    }
+}
+
+/**
+ * \brief Add a CAR file to the form, streamed while uploading: the raw leaves are read from the file or the content
+ * \param form Multipart form
+ * \param name File name of the part
+ * \param rootCID Root CID (CIDv1)
+ * \param sections CAR sections from computeCID()
+ * \param localPath File on disk, used when the content is not given
+ * \param content Optional content in memory, must outlive the upload
+ */
+void SitePublisher::addCARPart(curl_mime *form, const std::string &name, const std::string &rootCID, const CARSections &sections,
+                               const std::string &localPath, const std::string *content)
+{
+    auto stream = new CARStream{{}, localPath, content, std::ifstream(), 0, 0};
+    stream->pieces.reserve(sections.size() + 1);
+    stream->pieces.push_back(CARPiece{createCARHeader(rootCID), 0, 0});
+    curl_off_t size = static_cast<curl_off_t>(stream->pieces.front().data.size());
+    for (const CARSection &section : sections)
+    {
+        stream->pieces.push_back(CARPiece{section.header, section.offset, section.size});
+        size += static_cast<curl_off_t>(section.header.size() + section.size);
+    }
+    curl_mimepart *part = curl_mime_addpart(form);
+    curl_mime_name(part, "file");
+    curl_mime_filename(part, name.c_str());
+    curl_mime_type(part, "application/vnd.ipld.car");
+    curl_mime_data_cb(part, size, &readCARCallback, &seekCARCallback, &freeCARCallback, stream);
+}
+
+/**
+ * \brief Create the header of a CARv1 file, which is followed by the block sections
+ * \param rootCID Root CID (CIDv1)
+ */
+std::string SitePublisher::createCARHeader(const std::string &rootCID)
+{
+    std::string cid;
+    if (!CID::decode(rootCID, cid))
+        throw std::runtime_error("Invalid CID: " + rootCID);
+    // DAG-CBOR header: {"roots": [CID], "version": 1}, CIDs are tag 42 byte strings with a 0x00 prefix
+    std::string header = "\xa2\x65roots\x81\xd8\x2a";
+    std::size_t length = cid.size() + 1;
+    if (length < 24)
+        header += static_cast<char>(0x40 + length);
+    else
+    {
+        header += '\x58';
+        header += static_cast<char>(length);
+    }
+    header += '\0';
+    header += cid;
+    header += "\x67version\x01";
+    std::string car;
+    CID::appendVarint(car, header.size());
+    car += header;
+    return car;
+}
+
+/**
+ * \brief Get a string value of a JSON response
+ * \throw std::runtime_error when the response is invalid
+ */
+std::string SitePublisher::getJSONValue(const std::string &response, const std::string &name)
+{
+    try
+    {
+        return nlohmann::json::parse(response).at(name).get<std::string>();
+    }
+    catch (const nlohmann::json::exception &error)
+    {
+        throw std::runtime_error("Unexpected IPFS response: " + response);
+    }
+}
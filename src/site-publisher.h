@@ -0,0 +1,114 @@
+#ifndef SITE_PUBLISHER_H
+#define SITE_PUBLISHER_H
+
+#include "cid.h"
+
+#include <atomic>
+#include <cstdint>
+#include <curl/curl.h>
+#include <functional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * \class SitePublisher
+ * \brief Publishes a local site folder (markdown and images) as one IPFS directory, or a single document
+ * (blocking, cancellable from another thread). The files are streamed from disk and uploaded in parallel batches,
+ * the directory is assembled in the daemon's MFS and pinned. The CIDs are computed locally first,
+ * files that are already pinned or published before are not uploaded again.
+ * With content-defined chunking the DAG is built locally and imported as CAR (content archive), so a revision
+ * of a document reuses the unchanged blocks of the earlier revision.
+ */
+class SitePublisher
+{
+public:
+    /**
+     * \struct File
+     * \brief Published file
+     */
+    struct File
+    {
+        std::string path;      /*!< Path within the site, '/' separated */
+        std::string localPath; /*!< Path on disk */
+        uint64_t size;
+        std::string cid; /*!< Set after publishing */
+    };
+
+    /**
+     * \struct BlockReport
+     * \brief Block-level diff: new blocks vs blocks reused from earlier publishes (or pinned files)
+     */
+    struct BlockReport
+    {
+        uint64_t newBlocks;
+        uint64_t newBytes;
+        uint64_t reusedBlocks;
+        uint64_t reusedBytes;
+    };
+
+    /**
+     * \struct Result
+     * \brief Root directory CID and the CID of each file (manifest)
+     */
+    struct Result
+    {
+        std::string rootCID;
+        std::vector<File> files;
+        BlockReport blocks;
+    };
+
+    /**
+     * \brief Progress callback, with the uploaded and total number of bytes (called from the upload threads)
+     */
+    typedef std::function<void(uint64_t sent, uint64_t total)> ProgressCallback;
+
+    explicit SitePublisher(const std::string &host, int port, const std::string &socketPath, std::size_t parallel);
+    Result publish(const std::string &directory, CID::Chunker chunker, const ProgressCallback &progress = nullptr);
+    Result publishContent(const std::string &name, const std::string &content, CID::Chunker chunker, const ProgressCallback &progress = nullptr);
+    void cancel();
+    static std::vector<File> listFiles(const std::string &directory);
+
+private:
+    typedef std::vector<std::pair<std::string, std::string>> Arguments;
+    typedef std::vector<std::pair<std::string, uint64_t>> Blocks; /*!< Binary CID and size of each block */
+
+    /**
+     * \struct CARSection
+     * \brief Block section of a CAR file. A raw leaf is read from the content during the upload,
+     * other blocks (DAG nodes) are small and kept.
+     */
+    struct CARSection
+    {
+        std::string header; /*!< Section length and binary CID, followed by the kept block */
+        uint64_t offset;    /*!< Offset of the raw leaf within the content */
+        uint64_t size;      /*!< Size of the raw leaf, 0 for a kept block */
+    };
+    typedef std::vector<CARSection> CARSections;
+
+    std::string host;
+    int port;
+    std::string socketPath; /*!< API socket of the local daemon, TCP is used when not available */
+    std::size_t parallel;   /*!< Max. number of concurrent uploads */
+    std::atomic<bool> cancelled;
+    std::set<std::string> publishedCIDs;   /*!< CIDs uploaded by earlier publishes (publish thread) */
+    std::set<std::string> publishedBlocks; /*!< Binary block CIDs of earlier publishes (publish thread) */
+
+    void addBatch(std::vector<File> &files, const std::vector<std::size_t> &batch, const CID::Options &options,
+                  const std::vector<std::string> &localCIDs, const std::vector<CARSections> &carSections,
+                  std::atomic<uint64_t> &sent, uint64_t total, const std::atomic<bool> &failed, const ProgressCallback &progress);
+    std::set<std::string> importCAR(curl_mime *form, void *progressData);
+    BlockReport getBlockReport(const std::vector<Blocks> &files, const std::vector<bool> &isReused);
+    std::set<std::string> getPinnedCIDs();
+    std::string request(const std::string &command, const Arguments &arguments, curl_mime *form = nullptr,
+                        void *progressData = nullptr);
+    bool isSocketAvailable() const;
+    static std::string computeCID(const char *data, std::size_t size, const CID::Options &options, Blocks &blocks, CARSections *sections);
+    static std::string computeFileCID(const std::string &path, const CID::Options &options, Blocks &blocks, CARSections *sections);
+    static void addCARPart(curl_mime *form, const std::string &name, const std::string &rootCID, const CARSections &sections,
+                           const std::string &localPath, const std::string *content);
+    static std::string createCARHeader(const std::string &rootCID);
+    static std::string getJSONValue(const std::string &response, const std::string &name);
+};
+#endif
@@ -0,0 +1,91 @@
+#include "source-map.h"
+
+#include <algorithm>
+
+/**
+ * \brief Remove all entries (new document)
+ */
+void SourceMap::clear()
+{
+    this->lines.clear();
+    this->offsets.clear();
+}
+
+/**
+ * \brief Add the position of a source line in the rendered document.
+ * Entries that would break the ordering (eg. the end of a nested block) are skipped.
+ * \param line Zero-based source line
+ * \param offset Character offset in the rendered text buffer
+ */
+void SourceMap::add(int line, int offset)
+{
+    if (!this->lines.empty() && (line < this->lines.back() || offset < this->offsets.back()))
+        return;
+    this->lines.push_back(line);
+    this->offsets.push_back(offset);
+}
+
+/**
+ * \brief Remove the entries after the first count entries (eg. re-rendered part of the document)
+ */
+void SourceMap::truncate(std::size_t count)
+{
+    if (count < this->lines.size())
+    {
+        this->lines.resize(count);
+        this->offsets.resize(count);
+    }
+}
+
+bool SourceMap::empty() const
+{
+    return this->lines.empty();
+}
+
+const std::vector<int> &SourceMap::getLines() const
+{
+    return this->lines;
+}
+
+const std::vector<int> &SourceMap::getOffsets() const
+{
+    return this->offsets;
+}
+
+/**
+ * \brief Find the rendered position of a source line
+ * \param line Zero-based source line, the fractional part is the position within the line
+ * \return Character offset in the rendered text buffer (fractional)
+ */
+double SourceMap::offsetForLine(double line) const
+{
+    return interpolate(this->lines, this->offsets, line);
+}
+
+/**
+ * \brief Find the source line of a rendered position
+ * \param offset Character offset in the rendered text buffer
+ * \return Zero-based source line (fractional)
+ */
+double SourceMap::lineForOffset(double offset) const
+{
+    return interpolate(this->offsets, this->lines, offset);
+}
+
+/**
+ * \brief Binary search the key and interpolate linearly between the surrounding entries
+ */
+double SourceMap::interpolate(const std::vector<int> &keys, const std::vector<int> &values, double key)
+{
+    if (keys.empty())
+        return 0.0;
+    auto upper = std::upper_bound(keys.begin(), keys.end(), key);
+    if (upper == keys.begin())
+        return values.front();
+    if (upper == keys.end())
+        return values.back();
+    std::size_t index = upper - keys.begin();
+    double key0 = keys[index - 1], key1 = keys[index];
+    double value0 = values[index - 1], value1 = values[index];
+    return value0 + (key - key0) * (value1 - value0) / (key1 - key0);
+}
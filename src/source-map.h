@@ -0,0 +1,30 @@
+#ifndef SOURCE_MAP_H
+#define SOURCE_MAP_H
+
+#include <vector>
+
+/**
+ * \class SourceMap
+ * \brief Maps markdown source lines to character offsets in the rendered text buffer (and back).
+ * Entries are added in render order and kept monotonic in both directions,
+ * so both lookups are a binary search followed by a linear interpolation between the two surrounding entries.
+ */
+class SourceMap
+{
+public:
+    void clear();
+    void add(int line, int offset);
+    void truncate(std::size_t count);
+    bool empty() const;
+    double offsetForLine(double line) const;
+    double lineForOffset(double offset) const;
+    const std::vector<int> &getLines() const;
+    const std::vector<int> &getOffsets() const;
+
+private:
+    std::vector<int> lines;   /*!< Source lines (zero-based), sorted */
+    std::vector<int> offsets; /*!< Rendered buffer offsets, sorted */
+
+    static double interpolate(const std::vector<int> &keys, const std::vector<int> &values, double key);
+};
+#endif
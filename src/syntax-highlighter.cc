@@ -0,0 +1,351 @@
+#include "syntax-highlighter.h"
+
+#include <glibmm/main.h>
+#include <algorithm>
+
+static const gint64 IDLE_TIME_BUDGET = 4000;         // Max. time spent per idle slice, in microseconds
+static const std::size_t LEX_STEP_LENGTH = 16 * 1024; // Bytes of a line lexed between checks of the time budget
+
+static const char *TAG_NAMES[MarkdownLexer::TOKEN_COUNT] = {
+    "md-heading",
+    "md-quote",
+    "md-emphasis",
+    "md-strong",
+    "md-strikethrough",
+    "md-link-text",
+    "md-link-url",
+    "md-list-marker",
+    "md-thematic-break",
+    "md-marker",
+    "md-code",
+    "md-code-block"};
+
+SyntaxHighlighter::SyntaxHighlighter(Gtk::TextView &textView)
+    : textView(textView),
+      lexedLine(-1),
+      cursorIndex(0)
+{
+}
+
+SyntaxHighlighter::~SyntaxHighlighter()
+{
+    this->disable();
+}
+
+/**
+ * \brief Start highlighting the current text view buffer (marks the whole document as dirty)
+ */
+void SyntaxHighlighter::enable()
+{
+    this->disable();
+    buffer = textView.get_buffer();
+    this->createTags();
+
+    int lineCount = buffer->get_line_count();
+    lineStates.assign(lineCount, MarkdownLexer::LineState());
+    dirtyLines.clear();
+    this->markDirty(0, lineCount - 1);
+
+    // Connect before the default handler, the iterators still point to the unchanged text
+    this->insertTextSignalHandler = buffer->signal_insert().connect(sigc::mem_fun(this, &SyntaxHighlighter::on_insert), false);
+    this->deleteTextSignalHandler = buffer->signal_erase().connect(sigc::mem_fun(this, &SyntaxHighlighter::on_delete), false);
+    this->scheduleUpdate();
+}
+
+/**
+ * \brief Stop highlighting (the already applied tags are kept)
+ */
+void SyntaxHighlighter::disable()
+{
+    this->insertTextSignalHandler.disconnect();
+    this->deleteTextSignalHandler.disconnect();
+    this->idleHandler.disconnect();
+    lineStates.clear();
+    dirtyLines.clear();
+    lexedLine = -1;
+    lexedText.clear();
+}
+
+/**
+ * \brief Create the highlight tags in the buffer tag table (once per buffer).
+ * Tags created later have a higher priority, so markers and code win over the surrounding style.
+ */
+void SyntaxHighlighter::createTags()
+{
+    auto tagTable = buffer->get_tag_table();
+    if (tagTable->lookup(TAG_NAMES[0]))
+    {
+        for (int i = 0; i < MarkdownLexer::TOKEN_COUNT; ++i)
+            tags[i] = tagTable->lookup(TAG_NAMES[i]);
+        return;
+    }
+
+    tags[MarkdownLexer::TOKEN_HEADING] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_HEADING]);
+    tags[MarkdownLexer::TOKEN_HEADING]->property_weight() = Pango::WEIGHT_BOLD;
+    tags[MarkdownLexer::TOKEN_HEADING]->property_foreground() = "#1a5fb4";
+    tags[MarkdownLexer::TOKEN_QUOTE] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_QUOTE]);
+    tags[MarkdownLexer::TOKEN_QUOTE]->property_foreground() = "blue";
+    tags[MarkdownLexer::TOKEN_EMPHASIS] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_EMPHASIS]);
+    tags[MarkdownLexer::TOKEN_EMPHASIS]->property_style() = Pango::STYLE_ITALIC;
+    tags[MarkdownLexer::TOKEN_STRONG] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_STRONG]);
+    tags[MarkdownLexer::TOKEN_STRONG]->property_weight() = Pango::WEIGHT_BOLD;
+    tags[MarkdownLexer::TOKEN_STRIKETHROUGH] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_STRIKETHROUGH]);
+    tags[MarkdownLexer::TOKEN_STRIKETHROUGH]->property_strikethrough() = true;
+    tags[MarkdownLexer::TOKEN_LINK_TEXT] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_LINK_TEXT]);
+    tags[MarkdownLexer::TOKEN_LINK_TEXT]->property_foreground() = "#569cd6";
+    tags[MarkdownLexer::TOKEN_LINK_URL] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_LINK_URL]);
+    tags[MarkdownLexer::TOKEN_LINK_URL]->property_foreground() = "#808080";
+    tags[MarkdownLexer::TOKEN_LINK_URL]->property_underline() = Pango::UNDERLINE_SINGLE;
+    tags[MarkdownLexer::TOKEN_LIST_MARKER] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_LIST_MARKER]);
+    tags[MarkdownLexer::TOKEN_LIST_MARKER]->property_weight() = Pango::WEIGHT_BOLD;
+    tags[MarkdownLexer::TOKEN_LIST_MARKER]->property_foreground() = "#c061cb";
+    tags[MarkdownLexer::TOKEN_THEMATIC_BREAK] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_THEMATIC_BREAK]);
+    tags[MarkdownLexer::TOKEN_THEMATIC_BREAK]->property_weight() = Pango::WEIGHT_BOLD;
+    tags[MarkdownLexer::TOKEN_THEMATIC_BREAK]->property_foreground() = "#808080";
+    tags[MarkdownLexer::TOKEN_MARKER] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_MARKER]);
+    tags[MarkdownLexer::TOKEN_MARKER]->property_foreground() = "#808080";
+    tags[MarkdownLexer::TOKEN_CODE] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_CODE]);
+    tags[MarkdownLexer::TOKEN_CODE]->property_foreground() = "#323232";
+    tags[MarkdownLexer::TOKEN_CODE]->property_background() = "#e0e0e0";
+    tags[MarkdownLexer::TOKEN_CODE_BLOCK] = buffer->create_tag(TAG_NAMES[MarkdownLexer::TOKEN_CODE_BLOCK]);
+    tags[MarkdownLexer::TOKEN_CODE_BLOCK]->property_foreground() = "#323232";
+    tags[MarkdownLexer::TOKEN_CODE_BLOCK]->property_paragraph_background() = "#e0e0e0";
+}
+
+/**
+ * \brief Triggered before text gets inserted: add the new lines and mark them dirty
+ */
+void SyntaxHighlighter::on_insert(const Gtk::TextBuffer::iterator &pos, const Glib::ustring &text, int bytes __attribute__((unused)))
+{
+    this->abandonLine();
+    int line = pos.get_line();
+    int newLines = std::count(text.raw().begin(), text.raw().end(), '\n');
+    if (newLines > 0)
+    {
+        lineStates.insert(lineStates.begin() + line + 1, newLines, MarkdownLexer::LineState());
+        this->shiftLines(line, newLines);
+    }
+    this->markDirty(line, line + newLines);
+    this->scheduleUpdate();
+}
+
+/**
+ * \brief Triggered before text gets deleted: remove the deleted lines and mark the joined line dirty
+ */
+void SyntaxHighlighter::on_delete(const Gtk::TextBuffer::iterator &range_start, const Gtk::TextBuffer::iterator &range_end)
+{
+    this->abandonLine();
+    int firstLine = range_start.get_line();
+    int lastLine = range_end.get_line();
+    if (lastLine > firstLine)
+    {
+        lineStates.erase(lineStates.begin() + firstLine + 1, lineStates.begin() + lastLine + 1);
+        this->shiftLines(firstLine, firstLine - lastLine);
+    }
+    this->markDirty(firstLine, firstLine);
+    this->scheduleUpdate();
+}
+
+/**
+ * \brief Idle slot: finish the line of the previous slice, highlight dirty lines (visible lines first), until the time budget is used
+ * \return true if there are dirty lines left (keep the idle handler)
+ */
+bool SyntaxHighlighter::process_dirty_lines()
+{
+    const gint64 deadline = g_get_monotonic_time() + IDLE_TIME_BUDGET;
+    const int lineCount = buffer->get_line_count();
+    // Should not happen (eg. '\r' line endings), resync by highlighting everything again
+    if (static_cast<int>(lineStates.size()) != lineCount)
+    {
+        lineStates.assign(lineCount, MarkdownLexer::LineState());
+        dirtyLines.clear();
+        lexedLine = -1;
+        this->markDirty(0, lineCount - 1);
+    }
+    if (lexedLine >= 0 && !this->continueLine(deadline))
+        return true;
+
+    // Determine the visible lines
+    Gdk::Rectangle visibleRect;
+    Gtk::TextBuffer::iterator topIter, bottomIter;
+    int lineTop;
+    textView.get_visible_rect(visibleRect);
+    textView.get_line_at_y(topIter, visibleRect.get_y(), lineTop);
+    textView.get_line_at_y(bottomIter, visibleRect.get_y() + visibleRect.get_height(), lineTop);
+    const int firstVisible = topIter.get_line();
+    const int lastVisible = bottomIter.get_line();
+
+    while (!dirtyLines.empty())
+    {
+        // Prefer dirty lines within the visible area
+        int line = dirtyLines.begin()->first;
+        auto it = dirtyLines.upper_bound(firstVisible);
+        if (it != dirtyLines.begin() && std::prev(it)->second >= firstVisible)
+            line = firstVisible;
+        else if (it != dirtyLines.end() && it->first <= lastVisible)
+            line = it->first;
+        line = this->takeDirtyLine(line);
+
+        if (line < lineCount && !this->highlightLine(line, deadline))
+            return true;
+        if (g_get_monotonic_time() >= deadline)
+            break;
+    }
+    return !dirtyLines.empty();
+}
+
+/**
+ * \brief Lex a single line and apply the tags. When the state at the start of next line changed,
+ * the next line is marked dirty as well (eg. opening or closing a code fence).
+ * \return true if the line is done, false if the rest is left for the next slice
+ */
+bool SyntaxHighlighter::highlightLine(int line, gint64 deadline)
+{
+    Gtk::TextBuffer::iterator start = buffer->get_iter_at_line(line);
+    Gtk::TextBuffer::iterator end = start;
+    if (!end.ends_line())
+        end.forward_to_line_end();
+    lexedText = buffer->get_text(start, end, true);
+    lexedLine = line;
+    cursor = start;
+    cursorIndex = 0;
+
+    MarkdownLexer::LineState nextState = lexer.start(lexedText, lineStates[line], tokens);
+    for (const auto &tag : tags)
+        buffer->remove_tag(tag, start, end);
+
+    // Forward state propagation
+    int nextLine = line + 1;
+    if (nextLine < static_cast<int>(lineStates.size()) && !(lineStates[nextLine] == nextState))
+    {
+        lineStates[nextLine] = nextState;
+        this->markDirty(nextLine, nextLine);
+    }
+    return this->continueLine(deadline);
+}
+
+/**
+ * \brief Lex the inline content of the current line in steps and apply the tags, until the line is done or the time budget is used.
+ * The lexer and the cursor are kept for the next slice, any change of the text abandons the line (see abandonLine()).
+ * \return true if the line is done
+ */
+bool SyntaxHighlighter::continueLine(gint64 deadline)
+{
+    bool isDone;
+    do
+    {
+        isDone = lexer.lex(tokens, LEX_STEP_LENGTH);
+        // Apply in order of position, the cursor only moves forward
+        std::sort(tokens.begin(), tokens.end(), [](const MarkdownLexer::Token &a, const MarkdownLexer::Token &b) { return a.begin < b.begin; });
+        for (const auto &token : tokens)
+        {
+            Gtk::TextBuffer::iterator tokenStart = this->getIterAtIndex(token.begin);
+            Gtk::TextBuffer::iterator tokenEnd = tokenStart;
+            tokenEnd.forward_chars(g_utf8_strlen(lexedText.data() + token.begin, token.end - token.begin));
+            buffer->apply_tag(tags[token.type], tokenStart, tokenEnd);
+        }
+        tokens.clear();
+    } while (!isDone && g_get_monotonic_time() < deadline);
+
+    if (isDone)
+    {
+        lexedLine = -1;
+        lexedText.clear();
+        lexedText.shrink_to_fit();
+    }
+    return isDone;
+}
+
+/**
+ * \brief The text changes: mark the partly highlighted line dirty again, it's started over
+ */
+void SyntaxHighlighter::abandonLine()
+{
+    if (lexedLine < 0)
+        return;
+    this->markDirty(lexedLine, lexedLine);
+    lexedLine = -1;
+}
+
+/**
+ * \brief Iterator at the byte index of the current line, moved forward from the cursor.
+ * Setting the line index searches from the start of the line, which gets slow in a long line with many tags.
+ */
+Gtk::TextBuffer::iterator SyntaxHighlighter::getIterAtIndex(std::size_t index)
+{
+    if (index < cursorIndex)
+        cursor.set_line_index(index);
+    else
+        cursor.forward_chars(g_utf8_strlen(lexedText.data() + cursorIndex, index - cursorIndex));
+    cursorIndex = index;
+    return cursor;
+}
+
+/**
+ * \brief Add line range (inclusive) to the dirty lines, merging adjacent ranges
+ */
+void SyntaxHighlighter::markDirty(int firstLine, int lastLine)
+{
+    if (lastLine < firstLine)
+        return;
+
+    auto it = dirtyLines.upper_bound(firstLine);
+    if (it != dirtyLines.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->second >= firstLine - 1)
+        {
+            firstLine = prev->first;
+            lastLine = std::max(lastLine, prev->second);
+            it = dirtyLines.erase(prev);
+        }
+    }
+    while (it != dirtyLines.end() && it->first <= lastLine + 1)
+    {
+        lastLine = std::max(lastLine, it->second);
+        it = dirtyLines.erase(it);
+    }
+    dirtyLines[firstLine] = lastLine;
+}
+
+/**
+ * \brief Move the dirty line ranges after the given line, when lines are inserted (positive delta) or removed
+ */
+void SyntaxHighlighter::shiftLines(int afterLine, int delta)
+{
+    std::map<int, int> ranges;
+    ranges.swap(dirtyLines);
+    for (const auto &[firstLine, lastLine] : ranges)
+    {
+        int newFirst = (firstLine > afterLine) ? std::max(afterLine, firstLine + delta) : firstLine;
+        int newLast = (lastLine > afterLine) ? std::max(afterLine, lastLine + delta) : lastLine;
+        this->markDirty(newFirst, newLast);
+    }
+}
+
+/**
+ * \brief Remove a single line from the dirty line ranges
+ * \param line Line that is part of a dirty range
+ * \return The line number
+ */
+int SyntaxHighlighter::takeDirtyLine(int line)
+{
+    auto it = std::prev(dirtyLines.upper_bound(line));
+    int firstLine = it->first;
+    int lastLine = it->second;
+    dirtyLines.erase(it);
+    if (firstLine < line)
+        dirtyLines[firstLine] = line - 1;
+    if (lastLine > line)
+        dirtyLines[line + 1] = lastLine;
+    return line;
+}
+
+/**
+ * \brief Make sure the idle handler is running
+ */
+void SyntaxHighlighter::scheduleUpdate()
+{
+    if (!this->idleHandler.connected())
+        this->idleHandler = Glib::signal_idle().connect(sigc::mem_fun(this, &SyntaxHighlighter::process_dirty_lines));
+}
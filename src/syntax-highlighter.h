@@ -0,0 +1,55 @@
+#ifndef SYNTAX_HIGHLIGHTER_H
+#define SYNTAX_HIGHLIGHTER_H
+
+#include "md-lexer.h"
+
+#include <gtkmm/textview.h>
+#include <gtkmm/texttag.h>
+#include <map>
+#include <vector>
+
+/**
+ * \class SyntaxHighlighter
+ * \brief Incremental markdown source highlighting of a text view (used in editor mode).
+ * Only dirty lines are lexed again, a changed (fenced code) state is propagated to the following lines.
+ * The work is done on idle, in time-bounded slices, so typing is not delayed even in huge documents.
+ * A very long line is lexed in steps, over several slices when needed.
+ */
+class SyntaxHighlighter
+{
+public:
+    explicit SyntaxHighlighter(Gtk::TextView &textView);
+    ~SyntaxHighlighter();
+    void enable();
+    void disable();
+
+private:
+    Gtk::TextView &textView;
+    Glib::RefPtr<Gtk::TextBuffer> buffer;
+    Glib::RefPtr<Gtk::TextTag> tags[MarkdownLexer::TOKEN_COUNT];
+    std::vector<MarkdownLexer::LineState> lineStates; /*!< Lexer state at the start of each line */
+    std::map<int, int> dirtyLines;                   /*!< Dirty line ranges (first line -> last line, inclusive) */
+    std::vector<MarkdownLexer::Token> tokens;
+    MarkdownLexer lexer;              /*!< Lexer of the line being highlighted */
+    int lexedLine;                    /*!< Line being highlighted, -1 if none */
+    std::string lexedText;            /*!< Text of that line */
+    Gtk::TextBuffer::iterator cursor; /*!< Position of the last applied tag within that line */
+    std::size_t cursorIndex;          /*!< Byte index of the cursor */
+    sigc::connection insertTextSignalHandler;
+    sigc::connection deleteTextSignalHandler;
+    sigc::connection idleHandler;
+
+    void createTags();
+    void on_insert(const Gtk::TextBuffer::iterator &pos, const Glib::ustring &text, int bytes);
+    void on_delete(const Gtk::TextBuffer::iterator &range_start, const Gtk::TextBuffer::iterator &range_end);
+    bool process_dirty_lines();
+    bool highlightLine(int line, gint64 deadline);
+    bool continueLine(gint64 deadline);
+    void abandonLine();
+    Gtk::TextBuffer::iterator getIterAtIndex(std::size_t index);
+    void markDirty(int firstLine, int lastLine);
+    void shiftLines(int afterLine, int delta);
+    int takeDirtyLine(int line);
+    void scheduleUpdate();
+};
+#endif
@@ -0,0 +1,424 @@
+#include "text-search.h"
+
+#include <algorithm>
+#include <cstring>
+#include <glib.h>
+#include <memory>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    inline char asciiLower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+
+    inline bool isAsciiLetter(char c)
+    {
+        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+    }
+
+    /**
+     * \brief Compare the pattern with the text at the given position (pattern is already lower-case when case folding)
+     */
+    inline bool equalsAt(const char *text, const std::string &pattern, bool matchCase)
+    {
+        if (matchCase)
+            return std::memcmp(text, pattern.data(), pattern.size()) == 0;
+        for (std::size_t i = 0; i < pattern.size(); ++i)
+        {
+            if (asciiLower(text[i]) != pattern[i])
+                return false;
+        }
+        return true;
+    }
+
+    typedef std::unique_ptr<GRegex, decltype(&g_regex_unref)> RegexPtr;
+
+    /**
+     * \brief Compile a regular expression (PCRE syntax, ^ and $ match at line boundaries)
+     * \throw TextSearch::RegexError when the regular expression is invalid
+     */
+    RegexPtr compileRegex(const std::string &pattern, bool matchCase)
+    {
+        int flags = G_REGEX_MULTILINE | G_REGEX_OPTIMIZE;
+        if (!matchCase)
+            flags |= G_REGEX_CASELESS;
+        GError *error = nullptr;
+        GRegex *regex = g_regex_new(pattern.c_str(), static_cast<GRegexCompileFlags>(flags), static_cast<GRegexMatchFlags>(0), &error);
+        if (regex == nullptr)
+        {
+            g_error_free(error);
+            throw TextSearch::RegexError("Invalid regular expression");
+        }
+        return RegexPtr(regex, g_regex_unref);
+    }
+
+    /**
+     * \brief Append a capture group of the match, an unmatched group is empty
+     */
+    void appendGroup(std::string &out, const std::string &text, const GMatchInfo *matchInfo, int group)
+    {
+        gint start, end;
+        if (g_match_info_fetch_pos(matchInfo, group, &start, &end) && start >= 0)
+            out.append(text, start, end - start);
+    }
+
+    /**
+     * \brief Append the replacement of a match, with the ECMAScript patterns: $$, $&, $`, $' and $1 to $99
+     */
+    void appendReplacement(std::string &out, const std::string &text, const GRegex *regex, const GMatchInfo *matchInfo, const std::string &replacement)
+    {
+        const int groups = g_regex_get_capture_count(regex);
+        gint start = 0, end = 0;
+        g_match_info_fetch_pos(matchInfo, 0, &start, &end);
+        for (std::size_t i = 0; i < replacement.size(); ++i)
+        {
+            char next = (i + 1 < replacement.size()) ? replacement[i + 1] : '\0';
+            if (replacement[i] != '$' || next == '\0')
+            {
+                out += replacement[i];
+                continue;
+            }
+            if (next == '$')
+                out += '$';
+            else if (next == '&')
+                out.append(text, start, end - start);
+            else if (next == '`')
+                out.append(text, 0, start);
+            else if (next == '\'')
+                out.append(text, end, std::string::npos);
+            else if (next >= '0' && next <= '9')
+            {
+                // Two digits when that group exists
+                int group = next - '0';
+                char second = (i + 2 < replacement.size()) ? replacement[i + 2] : '\0';
+                if (second >= '0' && second <= '9' && group * 10 + (second - '0') >= 1 && group * 10 + (second - '0') <= groups)
+                {
+                    group = group * 10 + (second - '0');
+                    ++i;
+                }
+                else if (group < 1 || group > groups)
+                {
+                    out += '$';
+                    continue;
+                }
+                appendGroup(out, text, matchInfo, group);
+            }
+            else
+            {
+                out += '$';
+                continue;
+            }
+            ++i;
+        }
+    }
+} // namespace
+
+TextSearch::TextSearch()
+    : stopWorker(false),
+      hasRequest(false),
+      generation(0),
+      requestMatchCase(false),
+      requestIsRegex(false)
+{
+    this->worker = std::thread(&TextSearch::processRequests, this);
+}
+
+TextSearch::~TextSearch()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopWorker = true;
+    }
+    this->condition.notify_one();
+    if (this->worker.joinable())
+        this->worker.join();
+}
+
+/**
+ * \brief Start a search in the background, a running (older) search will be dropped
+ * \param text Snapshot of the document text (UTF-8)
+ * \param pattern Search string or regular expression
+ * \param matchCase Case-sensitive search
+ * \param isRegex Interpret the pattern as (PCRE) regular expression
+ * \return Generation number of this search request
+ */
+unsigned int TextSearch::search(std::shared_ptr<const std::string> text, const std::string &pattern, bool matchCase, bool isRegex)
+{
+    unsigned int requestGeneration;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        requestGeneration = ++this->generation;
+        this->requestText = text;
+        this->requestPattern = pattern;
+        this->requestMatchCase = matchCase;
+        this->requestIsRegex = isRegex;
+        this->hasRequest = true;
+    }
+    this->condition.notify_one();
+    return requestGeneration;
+}
+
+/**
+ * \brief Drop the pending search request and the last result
+ */
+void TextSearch::cancel()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    ++this->generation;
+    this->hasRequest = false;
+    this->requestText.reset();
+    this->result.reset();
+}
+
+/**
+ * \brief Retrieve the result of the newest search (thread-safe)
+ * \return Search result or nullptr when the newest search is not yet finished
+ */
+std::shared_ptr<const TextSearch::Result> TextSearch::getResult()
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->result && this->result->generation == this->generation)
+        return this->result;
+    return nullptr;
+}
+
+/**
+ * \brief Find all (non-overlapping) matches of the pattern in the text
+ * \throw TextSearch::RegexError when the regular expression is invalid, or too complex to match
+ * \return Matches with both byte and character offsets
+ */
+std::vector<TextSearch::Match> TextSearch::findAll(const std::string &text, const std::string &pattern, bool matchCase, bool isRegex)
+{
+    std::vector<Match> matches;
+    if (pattern.empty())
+        return matches;
+    if (isRegex)
+        findRegex(text, pattern, matchCase, matches);
+    else
+        findLiteral(text, pattern, matchCase, matches);
+    setCharOffsets(text, matches);
+    return matches;
+}
+
+/**
+ * \brief Build the new document text with all the matches replaced, in a single pass
+ * \param text Snapshot the matches were found in
+ * \param matches Matches found by findAll()
+ * \param replacement Replacement string (in regex mode $1, $& etc. refer to the match)
+ * \throw TextSearch::RegexError when the regular expression is invalid, or too complex to match
+ * \return New document text
+ */
+std::string TextSearch::replaceAll(const std::string &text,
+                                   const std::vector<Match> &matches,
+                                   const std::string &pattern,
+                                   const std::string &replacement,
+                                   bool matchCase,
+                                   bool isRegex)
+{
+    std::string newText;
+    if (isRegex)
+    {
+        RegexPtr regex = compileRegex(pattern, matchCase);
+        newText.reserve(text.size());
+        std::size_t last = 0;
+        auto next = matches.begin();
+        // The matches are found again in a single pass, to expand the back-references.
+        // A stored match is only replaced when it's still the same match (same position and length).
+        GMatchInfo *matchInfo = nullptr;
+        GError *error = nullptr;
+        g_regex_match_full(regex.get(), text.data(), text.size(), 0, static_cast<GRegexMatchFlags>(0), &matchInfo, &error);
+        while (error == nullptr && next != matches.end() && g_match_info_matches(matchInfo))
+        {
+            gint start, end;
+            if (g_match_info_fetch_pos(matchInfo, 0, &start, &end))
+            {
+                while (next != matches.end() && next->begin < static_cast<std::size_t>(start))
+                    ++next;
+                if (next != matches.end() && next->begin == static_cast<std::size_t>(start) && next->length == static_cast<std::size_t>(end - start))
+                {
+                    newText.append(text, last, start - last);
+                    appendReplacement(newText, text, regex.get(), matchInfo, replacement);
+                    last = end;
+                    ++next;
+                }
+            }
+            g_match_info_next(matchInfo, &error);
+        }
+        g_match_info_free(matchInfo);
+        if (error != nullptr)
+        {
+            g_error_free(error);
+            throw RegexError("Regular expression is too complex for this document");
+        }
+        newText.append(text, last, std::string::npos);
+    }
+    else
+    {
+        std::size_t newSize = text.size();
+        for (const Match &m : matches)
+            newSize = newSize - m.length + replacement.size();
+        newText.reserve(newSize);
+        std::size_t last = 0;
+        for (const Match &m : matches)
+        {
+            newText.append(text, last, m.begin - last);
+            newText.append(replacement);
+            last = m.begin + m.length;
+        }
+        newText.append(text, last, std::string::npos);
+    }
+    return newText;
+}
+
+/**
+ * \brief Worker thread, processes the newest search request
+ */
+void TextSearch::processRequests()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true)
+    {
+        this->condition.wait(lock, [this] { return this->stopWorker || this->hasRequest; });
+        if (this->stopWorker)
+            break;
+        auto newResult = std::make_shared<Result>();
+        newResult->generation = this->generation;
+        newResult->text = this->requestText;
+        newResult->pattern = this->requestPattern;
+        newResult->matchCase = this->requestMatchCase;
+        newResult->isRegex = this->requestIsRegex;
+        this->hasRequest = false;
+        lock.unlock();
+
+        try
+        {
+            newResult->matches = findAll(*newResult->text, newResult->pattern, newResult->matchCase, newResult->isRegex);
+        }
+        catch (const RegexError &error)
+        {
+            newResult->error = error.what();
+        }
+
+        lock.lock();
+        // Only publish when no newer request came in meanwhile
+        if (newResult->generation == this->generation)
+        {
+            this->result = newResult;
+            this->signal_finished.emit();
+        }
+    }
+}
+
+/**
+ * \brief Literal substring scan. Candidates are filtered 16 bytes at a time on the first and last pattern byte (SSE2),
+ * after which the remaining bytes are compared. Case folding is limited to ASCII.
+ */
+void TextSearch::findLiteral(const std::string &text, const std::string &searchPattern, bool matchCase, std::vector<Match> &matches)
+{
+    const std::size_t size = text.size();
+    const std::size_t length = searchPattern.size();
+    if (length > size)
+        return;
+    std::string pattern = searchPattern;
+    if (!matchCase)
+        std::transform(pattern.begin(), pattern.end(), pattern.begin(), asciiLower);
+
+    const char *data = text.data();
+    std::size_t next = 0; // Matches do not overlap
+    std::size_t pos = 0;
+#if defined(__SSE2__)
+    {
+        const char first = pattern.front();
+        const char last = pattern.back();
+        // Setting bit 5 maps both letter cases to lower-case (only done for letters)
+        const __m128i firstMask = _mm_set1_epi8((!matchCase && isAsciiLetter(first)) ? 0x20 : 0);
+        const __m128i lastMask = _mm_set1_epi8((!matchCase && isAsciiLetter(last)) ? 0x20 : 0);
+        const __m128i firstBytes = _mm_set1_epi8(first);
+        const __m128i lastBytes = _mm_set1_epi8(last);
+        for (; pos + length - 1 + 16 <= size; pos += 16)
+        {
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+            __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos + length - 1));
+            blockFirst = _mm_or_si128(blockFirst, firstMask);
+            blockLast = _mm_or_si128(blockLast, lastMask);
+            unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(blockFirst, firstBytes), _mm_cmpeq_epi8(blockLast, lastBytes))));
+            while (mask != 0)
+            {
+                std::size_t candidate = pos + static_cast<std::size_t>(__builtin_ctz(mask));
+                mask &= mask - 1;
+                if (candidate >= next && equalsAt(data + candidate, pattern, matchCase))
+                {
+                    matches.push_back(Match{candidate, length, 0, 0});
+                    next = candidate + length;
+                }
+            }
+        }
+    }
+#endif
+    // Remaining bytes (or the whole text without SSE2)
+    for (pos = std::max(pos, next); pos + length <= size;)
+    {
+        if (equalsAt(data + pos, pattern, matchCase))
+        {
+            matches.push_back(Match{pos, length, 0, 0});
+            pos += length;
+        }
+        else
+        {
+            ++pos;
+        }
+    }
+}
+
+/**
+ * \brief Regular expression search (PCRE syntax, ^ and $ match at line boundaries).
+ * GRegex backtracks on the heap, a pattern like (.|\n)* on a large document hits the match limit instead of the stack.
+ */
+void TextSearch::findRegex(const std::string &text, const std::string &pattern, bool matchCase, std::vector<Match> &matches)
+{
+    RegexPtr regex = compileRegex(pattern, matchCase);
+    GMatchInfo *matchInfo = nullptr;
+    GError *error = nullptr;
+    g_regex_match_full(regex.get(), text.data(), text.size(), 0, static_cast<GRegexMatchFlags>(0), &matchInfo, &error);
+    while (error == nullptr && g_match_info_matches(matchInfo))
+    {
+        // Empty matches can't be highlighted nor replaced in a meaningful way
+        gint start, end;
+        if (g_match_info_fetch_pos(matchInfo, 0, &start, &end) && end > start)
+            matches.push_back(Match{static_cast<std::size_t>(start), static_cast<std::size_t>(end - start), 0, 0});
+        g_match_info_next(matchInfo, &error);
+    }
+    g_match_info_free(matchInfo);
+    if (error != nullptr)
+    {
+        g_error_free(error);
+        matches.clear();
+        throw RegexError("Regular expression is too complex for this document");
+    }
+}
+
+/**
+ * \brief Convert the byte ranges of the (sorted) matches into character offsets, as used by the GTK text buffer
+ */
+void TextSearch::setCharOffsets(const std::string &text, std::vector<Match> &matches)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(text.data());
+    std::size_t bytePos = 0;
+    int charPos = 0;
+    for (Match &match : matches)
+    {
+        for (; bytePos < match.begin; ++bytePos)
+            charPos += (data[bytePos] & 0xC0) != 0x80;
+        match.offset = charPos;
+        int chars = 0;
+        for (; bytePos < match.begin + match.length; ++bytePos)
+            chars += (data[bytePos] & 0xC0) != 0x80;
+        match.chars = chars;
+        charPos += chars;
+    }
+}
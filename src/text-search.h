@@ -0,0 +1,94 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <glibmm/dispatcher.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \class TextSearch
+ * \brief Searches all matches in a plain-text snapshot of a document on a worker thread.
+ * Supports a (SSE2 accelerated) literal substring scan, with or without case folding, and regular expressions
+ * (PCRE via GRegex, which doesn't run out of stack on large documents like std::regex).
+ * Only the newest search request is processed, signal_finished is emitted on the GUI thread when a result is ready.
+ */
+class TextSearch
+{
+public:
+    /**
+     * \class RegexError
+     * \brief The regular expression is invalid, or too complex to match
+     */
+    class RegexError : public std::runtime_error
+    {
+    public:
+        explicit RegexError(const std::string &message) : std::runtime_error(message) {}
+    };
+
+    /**
+     * \struct Match
+     * \brief Single match, both as byte range (within the snapshot) and as character range (buffer offsets)
+     */
+    struct Match
+    {
+        std::size_t begin;
+        std::size_t length;
+        int offset;
+        int chars;
+    };
+
+    /**
+     * \struct Result
+     * \brief Search result, including the snapshot it is based on
+     */
+    struct Result
+    {
+        unsigned int generation;
+        std::shared_ptr<const std::string> text;
+        std::string pattern;
+        bool matchCase;
+        bool isRegex;
+        std::vector<Match> matches;
+        std::string error; /*!< Non-empty when the regular expression is invalid (or too complex) */
+    };
+
+    Glib::Dispatcher signal_finished;
+
+    TextSearch();
+    ~TextSearch();
+    unsigned int search(std::shared_ptr<const std::string> text, const std::string &pattern, bool matchCase, bool isRegex);
+    void cancel();
+    std::shared_ptr<const Result> getResult();
+
+    static std::vector<Match> findAll(const std::string &text, const std::string &pattern, bool matchCase, bool isRegex);
+    static std::string replaceAll(const std::string &text,
+                                  const std::vector<Match> &matches,
+                                  const std::string &pattern,
+                                  const std::string &replacement,
+                                  bool matchCase,
+                                  bool isRegex);
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopWorker;
+    bool hasRequest;
+    unsigned int generation; /*!< Generation of the newest request, older requests are dropped */
+    std::shared_ptr<const std::string> requestText;
+    std::string requestPattern;
+    bool requestMatchCase;
+    bool requestIsRegex;
+    std::shared_ptr<const Result> result;
+
+    void processRequests();
+    static void findLiteral(const std::string &text, const std::string &pattern, bool matchCase, std::vector<Match> &matches);
+    static void findRegex(const std::string &text, const std::string &pattern, bool matchCase, std::vector<Match> &matches);
+    static void setCharOffsets(const std::string &text, std::vector<Match> &matches);
+};
+#endif